@@ -141,6 +141,7 @@ void arch_init_premain()
 #include "drivers/virtio-rng.hh"
 #include "drivers/virtio-blk.hh"
 #include "drivers/virtio-net.hh"
+#include "drivers/virtio-fs.hh"
 
 void arch_init_drivers()
 {
@@ -171,6 +172,7 @@ void arch_init_drivers()
     drvman->register_driver(virtio::rng::probe);
     drvman->register_driver(virtio::blk::probe);
     drvman->register_driver(virtio::net::probe);
+    drvman->register_driver(virtio::fs::probe);
     boot_time.event("drivers probe");
     drvman->load_all();
     drvman->list_drivers();
@@ -23,7 +23,7 @@ void msix_vector::set_affinity(unsigned apic_id) {}
 interrupt_manager::interrupt_manager(pci::function *dev) {}
 interrupt_manager::~interrupt_manager() {}
 
-bool interrupt_manager::easy_register(std::initializer_list<msix_binding> b)
+bool interrupt_manager::easy_register(const std::vector<msix_binding>& b)
 {
     return false;
 }
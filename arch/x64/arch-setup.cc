@@ -87,6 +87,14 @@ extern boot_time_chart boot_time;
 extern "C" void start32();
 void * __attribute__((section (".start32_address"))) start32_address = reinterpret_cast<void*>(&start32);
 
+static void map_memory_range(uintptr_t addr, size_t size)
+{
+    for (auto&& area : mmu::identity_mapped_areas) {
+        auto base = reinterpret_cast<void*>(get_mem_area_base(area));
+        mmu::linear_map(base + addr, addr, size, ~0);
+    }
+}
+
 void arch_setup_free_memory()
 {
     static ulong edata;
@@ -166,10 +174,17 @@ void arch_setup_free_memory()
         if (intersects(ent, initial_map)) {
             ent = truncate_below(ent, initial_map);
         }
-        for (auto&& area : mmu::identity_mapped_areas) {
-        auto base = reinterpret_cast<void*>(get_mem_area_base(area));
-            mmu::linear_map(base + ent.addr, ent.addr, ent.size, ~0);
+        // Memory past what boot needs is mapped and freed in the background
+        auto online = memory::stats::total();
+        if (online + ent.size > memory::boot_online_memory) {
+            auto boot = online < memory::boot_online_memory ? memory::boot_online_memory - online : 0;
+            memory::defer_initial_memory_range(ent.addr + boot, ent.size - boot, map_memory_range);
+            ent = truncate_above(ent, ent.addr + boot);
+            if (!ent.size) {
+                return;
+            }
         }
+        map_memory_range(ent.addr, ent.size);
         mmu::free_initial_memory_range(ent.addr, ent.size);
     });
 }
@@ -229,6 +244,7 @@ void arch_init_premain()
 #include "drivers/virtio-scsi.hh"
 #include "drivers/virtio-net.hh"
 #include "drivers/virtio-rng.hh"
+#include "drivers/virtio-fs.hh"
 #include "drivers/xenplatform-pci.hh"
 #include "drivers/ahci.hh"
 #include "drivers/vmw-pvscsi.hh"
@@ -257,6 +273,7 @@ void arch_init_drivers()
     drvman->register_driver(virtio::scsi::probe);
     drvman->register_driver(virtio::net::probe);
     drvman->register_driver(virtio::rng::probe);
+    drvman->register_driver(virtio::fs::probe);
     drvman->register_driver(xenfront::xenplatform_pci::probe);
     drvman->register_driver(ahci::hba::probe);
     drvman->register_driver(vmw::pvscsi::probe);
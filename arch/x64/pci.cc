@@ -7,6 +7,8 @@
 
 #include <osv/debug.hh>
 #include <osv/pci.hh>
+#include <osv/spinlock.h>
+#include <osv/mutex.h>
 #include "drivers/pci-function.hh"
 
 namespace pci {
@@ -30,6 +32,11 @@ static inline u32 build_config_address(u8 bus, u8 slot, u8 func, u8 offset) {
         func << PCI_FUNC_OFFSET | (offset & ~0x03);
 }
 
+// Config space is reached through a pair of ports, the address written to
+// one selecting what the other reads or writes. Devices are probed on
+// several cpus at once, so each access takes the pair for itself.
+static spinlock_t pci_config_lock;
+
 static inline void prepare_pci_config_access(u8 bus, u8 slot, u8 func, u8 offset)
 {
     u32 address = build_config_address(bus, slot, func, offset);
@@ -38,36 +45,42 @@ static inline void prepare_pci_config_access(u8 bus, u8 slot, u8 func, u8 offset
 
 u32 read_pci_config(u8 bus, u8 slot, u8 func, u8 offset)
 {
+    SCOPE_LOCK(pci_config_lock);
     prepare_pci_config_access(bus, slot, func, offset);
     return inl(PCI_CONFIG_DATA);
 }
 
 u16 read_pci_config_word(u8 bus, u8 slot, u8 func, u8 offset)
 {
+    SCOPE_LOCK(pci_config_lock);
     prepare_pci_config_access(bus, slot, func, offset);
     return inw(PCI_CONFIG_DATA + (offset & 0x02));
 }
 
 u8 read_pci_config_byte(u8 bus, u8 slot, u8 func, u8 offset)
 {
+    SCOPE_LOCK(pci_config_lock);
     prepare_pci_config_access(bus, slot, func, offset);
     return inb(PCI_CONFIG_DATA + (offset & 0x03));
 }
 
 void write_pci_config(u8 bus, u8 slot, u8 func, u8 offset, u32 val)
 {
+    SCOPE_LOCK(pci_config_lock);
     prepare_pci_config_access(bus, slot, func, offset);
     outl(val, PCI_CONFIG_DATA);
 }
 
 void write_pci_config_word(u8 bus, u8 slot, u8 func, u8 offset, u16 val)
 {
+    SCOPE_LOCK(pci_config_lock);
     prepare_pci_config_access(bus, slot, func, offset);
     outw(val, PCI_CONFIG_DATA + (offset & 0x02));
 }
 
 void write_pci_config_byte(u8 bus, u8 slot, u8 func, u8 offset, u8 val)
 {
+    SCOPE_LOCK(pci_config_lock);
     prepare_pci_config_access(bus, slot, func, offset);
     outb(val, PCI_CONFIG_DATA + (offset & 0x03));
 }
@@ -40,10 +40,14 @@
 
 #include <osv/mutex.h>
 #include <osv/clock.hh>
+#include <boost/intrusive/list.hpp>
 
 struct callout {
-	/* OSv waiter thread for drain (drain) */
-	void *waiter_thread;
+	/* Per-CPU queue this callout was last armed on */
+	void *c_queue;
+	/* Position of this entry on that queue */
+	int c_state;
+	boost::intrusive::list_member_hook<> c_link;
 	/* State of this entry */
 	int c_flags;
 	uint64_t c_ticks;
@@ -57,6 +61,8 @@ struct callout {
 	struct mtx* c_mtx;
 	/* Rwlock */
 	struct rwlock *c_rwlock;
+
+	osv::clock::uptime::time_point get_timeout() { return c_to_ns; }
 };
 
 #endif
@@ -6,11 +6,15 @@
  */
 
 #include <mutex>
-#include <set>
 #include "osv/trace.hh"
 #include <osv/debug.hh>
 #include <osv/sched.hh>
 #include <osv/clock.hh>
+#include <osv/percpu.hh>
+#include <osv/waitqueue.hh>
+#include <osv/timer-set.hh>
+#include <osv/aligned_new.hh>
+#include <osv/printf.hh>
 using namespace osv::clock::literals;
 
 #include <bsd/porting/rwlock.h>
@@ -22,195 +26,215 @@ TRACEPOINT(trace_callout_init, "C=%p", void *);
 TRACEPOINT(trace_callout_reset, "C=%p to_ticks=%d fn=%p arg=%p", void *, uint64_t, void *, void *);
 TRACEPOINT(trace_callout_stop_wait, "C=%p", void *);
 TRACEPOINT(trace_callout_stop, "C=%p flags=%d, is_drain=%d", void *, int, int);
-TRACEPOINT(trace_callout_thread_waiting, "C=%p", void *);
-TRACEPOINT(trace_callout_thread_retry, "C=%p", void *);
+TRACEPOINT(trace_callout_thread_cancelled, "C=%p", void *);
 TRACEPOINT(trace_callout_thread_dispatching, "C=%p fn=%p", void *, void *);
-TRACEPOINT(trace_callout_thread_waking, "C=%p thread=%p", void *, void *);
-
-int _callout_stop_safe_locked(struct callout *c, int safe);
+TRACEPOINT(trace_callout_thread_dispatched, "C=%p", void *);
 
 namespace callouts {
 
-    struct callout_compare {
-        bool operator() (callout *a, callout *b) const {
-            if (a->c_to_ns == b->c_to_ns) {
-                return (a < b);
-            }
+    namespace bi = boost::intrusive;
 
-            return (a->c_to_ns < b->c_to_ns);
-        }
+    // callout::c_state
+    enum {
+        IDLE = 0,       // not queued anywhere
+        QUEUED,         // in callout_queue::timers
+        DUE,            // expired, in callout_queue::due
     };
 
-    // We manage callouts in a single ordered set
-    std::set<callout *, callout_compare> _callouts;
-
-    // Both global data and callout structure are protected using this lock
-    mutex _callout_mutex;
-    void lock(void) { _callout_mutex.lock(); }
-    void unlock(void) { _callout_mutex.unlock(); }
+    //
+    // Every CPU has its own callout queue and dispatcher thread, and a
+    // callout is armed on the queue of the CPU calling callout_reset(), so
+    // its handler runs there. The queue lock only serializes that CPU's
+    // dispatcher with whoever arms or stops a callout queued on it; there
+    // is no global lock.
+    //
+    // callout::c_queue may only change while holding the lock of the
+    // queue it points to (see lock_owner()).
+    //
+    struct callout_queue {
+        explicit callout_queue(sched::cpu* cpu);
+
+        void run();
+        void dispatch(callout& c);
+        void insert(callout& c);
+        bool remove(callout& c);
+
+        mutex lock;
+        timer_set<callout, &callout::c_link, osv::clock::uptime> timers;
+        bi::list<callout,
+            bi::member_hook<callout, bi::list_member_hook<>, &callout::c_link>> due;
+        // The callout being dispatched. curr_locking is set while the
+        // dispatcher acquires the callout's own lock, during which the
+        // handler can still be cancelled via curr_cancelled.
+        callout* curr = nullptr;
+        bool curr_locking = false;
+        bool curr_cancelled = false;
+        waitqueue curr_done;
+        bool have_work = false;
+        std::unique_ptr<sched::thread> thread;
+        sched::timer timer;
+    };
 
-    // The callout dispatcher thread
-    sched::thread *_callout_dispatcher = nullptr;
-    bool _have_work = false;
+    static PERCPU(callout_queue*, _percpu_queue);
 
-    void add_callout(callout *c)
+    static callout_queue* get_queue(callout* c)
     {
-        _callouts.insert(c);
+        return static_cast<callout_queue*>(__atomic_load_n(&c->c_queue, __ATOMIC_ACQUIRE));
     }
 
-    void remove_callout(callout *c)
+    static void set_queue(callout* c, callout_queue* q)
     {
-        _callouts.erase(c);
+        __atomic_store_n(&c->c_queue, static_cast<void*>(q), __ATOMIC_RELEASE);
     }
 
-    callout *get_one(void)
+    // Lock and return the queue c belongs to. A callout which was never
+    // armed is claimed by (but not inserted into) the given queue.
+    static callout_queue* lock_owner(callout* c, callout_queue* claim)
     {
-        if (_callouts.empty()) {
-            return (nullptr);
+        for (;;) {
+            auto q = get_queue(c);
+            if (!q) {
+                if (!claim) {
+                    return nullptr;
+                }
+                void* expected = nullptr;
+                __atomic_compare_exchange_n(&c->c_queue, &expected,
+                    static_cast<void*>(claim), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+                continue;
+            }
+            q->lock.lock();
+            if (get_queue(c) == q) {
+                return q;
+            }
+            q->lock.unlock();
         }
-        return (*_callouts.begin());
     }
 
-    // FIXME: optimize this function
-    bool have_callout(callout *c)
+    callout_queue::callout_queue(sched::cpu* cpu)
+        : thread(sched::thread::make([this] { run(); },
+            sched::thread::attr().pin(cpu).name(osv::sprintf("callout%d", cpu->id))))
+        , timer(*thread)
     {
-        for (auto i: _callouts) {
-            if (i == c) {
-                return (true);
-            }
-        }
-
-        return (false);
+        thread->start();
     }
 
-    void mark_have_work(void)
+    void callout_queue::insert(callout& c)
     {
-        _have_work = true;
+        c.c_state = QUEUED;
+        if (timers.insert(c)) {
+            have_work = true;
+            thread->wake();
+        }
     }
 
-    // wakes the dispatcher
-    void wake_dispatcher(void)
+    // Returns true if c was pending
+    bool callout_queue::remove(callout& c)
     {
-        _callout_dispatcher->wake();
+        switch (c.c_state) {
+        case QUEUED:
+            timers.remove(c);
+            break;
+        case DUE:
+            due.erase(due.iterator_to(c));
+            break;
+        default:
+            return false;
+        }
+        c.c_state = IDLE;
+        return true;
     }
-}
-
-static sched::thread* callout_get_waiter(struct callout *c)
-{
-    return reinterpret_cast<sched::thread*>(c->waiter_thread);
-}
-
-static void callout_set_waiter(struct callout *c, sched::thread* t)
-{
-    if (t != NULL)
-        assert(c->waiter_thread == NULL);
-
-    c->waiter_thread = reinterpret_cast<void*>(t);
-}
 
-static void _callout_thread(void)
-{
-    callouts::lock();
-
-    while (true) {
-
-        // Wait for work
-        sched::thread::wait_until(callouts::_callout_mutex, [] {
-            return (callouts::get_one() != nullptr);
-        });
-
-        // get the first callout with the earliest time
-        callout *c = callouts::get_one();
-
-        assert(c->c_flags & (CALLOUT_ACTIVE | CALLOUT_PENDING));
-
-        //////////////////////
-        // Wait for timeout //
-        //////////////////////
-
-        auto cur = osv::clock::uptime::now();
-        bool expired = true;
-        if (cur < c->c_to_ns-1_ms) {
-            sched::timer t(*sched::thread::current());
-            t.set(c->c_to_ns);
-
-            trace_callout_thread_waiting(c);
-            sched::thread::wait_until(callouts::_callout_mutex, [&] {
-                return ( (t.expired()) || (callouts::_have_work));
-            });
-
-            callouts::_have_work = false;
-            expired = t.expired();
+    void callout_queue::run()
+    {
+        WITH_LOCK(lock) {
+            while (true) {
+                sched::thread::wait_until(lock, [&] {
+                    return timer.expired() || have_work;
+                });
+                have_work = false;
+                timer.cancel();
+
+                timers.expire(osv::clock::uptime::now());
+                while (auto c = timers.pop_expired()) {
+                    c->c_state = DUE;
+                    due.push_back(*c);
+                }
+
+                // Dispatching drops the lock, so callouts may be stopped
+                // (and thus removed from due) or re-armed meanwhile.
+                while (!due.empty()) {
+                    auto& c = due.front();
+                    due.pop_front();
+                    c.c_state = IDLE;
+                    dispatch(c);
+                }
+
+                if (!timers.empty()) {
+                    timer.set(timers.get_next_timeout());
+                }
+            }
         }
+    }
 
-        if (!expired  || (!callouts::have_callout(c))) {
-            trace_callout_thread_retry(c);
-            continue;
+    void callout_queue::dispatch(callout& c)
+    {
+        auto fn = c.c_fn;
+        auto arg = c.c_arg;
+        struct mtx* c_mtx = c.c_mtx;
+        struct rwlock* c_rwlock = c.c_rwlock;
+        bool return_unlocked = ((c.c_flags & CALLOUT_RETURNUNLOCKED) == 0);
+
+        c.c_flags &= ~CALLOUT_PENDING;
+        curr = &c;
+        curr_cancelled = false;
+
+        if (c_rwlock || c_mtx) {
+            curr_locking = true;
+            DROP_LOCK(lock) {
+                if (c_rwlock)
+                    rw_wlock(c_rwlock);
+                if (c_mtx)
+                    mtx_lock(c_mtx);
+            }
+            curr_locking = false;
         }
 
-        ///////////////
-        // Dispatch! //
-        ///////////////
-
-        auto fn = c->c_fn;
-        auto arg = c->c_arg;
-        struct mtx* c_mtx = c->c_mtx;
-        struct rwlock* c_rwlock = c->c_rwlock;
-        bool return_unlocked = ((c->c_flags & CALLOUT_RETURNUNLOCKED) == 0);
-
-        if (c_rwlock)
-            rw_wlock(c_rwlock);
-        if (c_mtx)
-            mtx_lock(c_mtx);
-
-        c->c_flags &= ~CALLOUT_PENDING;
-
-        callouts::unlock();
-
-        // Callout handler
-        trace_callout_thread_dispatching(c, (void*)fn);
-        fn(arg);
-
-        callouts::lock();
-
-        sched::thread* waiter = nullptr;
-
-        //
-        // note: after the handler have been invoked the callout structure
-        // can look much differently, the handler may reschedule the callout
-        // or even freed it.
         //
-        // if the callout is in the set it means that it hasn't been freed
-        // by the user
+        // note: the handler may reschedule the callout or even free it, so
+        // after it is invoked we must not look at the callout structure.
+        // Drainers wait on curr instead.
         //
-        // reset || drain || !stop
-        if (callouts::have_callout(c)) {
-
-            waiter = callout_get_waiter(c);
-            callout_set_waiter(c, NULL);
-            // if the callout hadn't been reschedule, remove it
-            if ( ((c->c_flags & CALLOUT_PENDING) == 0) || (waiter) ) {
-                c->c_flags |= CALLOUT_COMPLETED;
-                callouts::remove_callout(c);
+        if (curr_cancelled) {
+            trace_callout_thread_cancelled(&c);
+            DROP_LOCK(lock) {
+                if (c_mtx)
+                    mtx_unlock(c_mtx);
+                if (c_rwlock)
+                    rw_wunlock(c_rwlock);
+            }
+        } else {
+            DROP_LOCK(lock) {
+                // Callout handler
+                trace_callout_thread_dispatching(&c, (void*)fn);
+                fn(arg);
+                trace_callout_thread_dispatched(&c);
+
+                if (return_unlocked) {
+                    if (c_rwlock)
+                        rw_wunlock(c_rwlock);
+                    if (c_mtx)
+                        mtx_unlock(c_mtx);
+                }
             }
         }
 
-        // FIXME: should we do this in case the caller called callout_stop?
-        if (return_unlocked) {
-            if (c_rwlock)
-                rw_wunlock(c_rwlock);
-            if (c_mtx)
-                mtx_unlock(c_mtx);
-        }
-
-        // if we have a waiter then the callout structure must be valid
-        if (waiter) {
-            trace_callout_thread_waking(c, waiter);
-            waiter->wake();
-        }
+        curr = nullptr;
+        curr_done.wake_all(lock);
     }
 }
 
+using namespace callouts;
+
 int callout_reset_on(struct callout *c, u64 to_ticks, void (*fn)(void *),
     void *arg, int ignore_cpu)
 {
@@ -219,13 +243,33 @@ int callout_reset_on(struct callout *c, u64 to_ticks, void (*fn)(void *),
             std::chrono::duration_cast<std::chrono::nanoseconds>
                 (cur.time_since_epoch()).count());
     int result = 0;
-    bool queued_first = false;
-
-    callouts::lock();
 
     trace_callout_reset(c, to_ticks, (void*)fn, arg);
 
-    result = _callout_stop_safe_locked(c, 0);
+    // Arm on the current cpu, unless the handler is running right now:
+    // then keep the callout where it is so that a drain waiting for that
+    // handler keeps looking at the right queue.
+    auto target = *_percpu_queue;
+    callout_queue* q;
+    while (true) {
+        q = lock_owner(c, target);
+        if (q->remove(*c)) {
+            result = 1;
+        }
+        if (q == target || q->curr == c) {
+            break;
+        }
+        set_queue(c, target);
+        q->lock.unlock();
+    }
+
+    if (q->curr == c && q->curr_locking && !q->curr_cancelled) {
+        // As in _callout_stop_safe(): the dispatcher is still waiting for
+        // the callout's lock, probably held by our caller, and the stale
+        // instance must not run ahead of the re-armed one.
+        q->curr_cancelled = true;
+        result = 1;
+    }
 
     // Reset the callout
     c->c_ticks = to_ticks;
@@ -234,62 +278,53 @@ int callout_reset_on(struct callout *c, u64 to_ticks, void (*fn)(void *),
     c->c_fn = fn;
     c->c_arg = arg;
     c->c_flags |= (CALLOUT_PENDING | CALLOUT_ACTIVE);
+    q->insert(*c);
 
-    callouts::add_callout(c);
-    if (c == callouts::get_one()) {
-        callouts::mark_have_work();
-        queued_first = true;
-    }
-
-    callouts::unlock();
-
-    if (queued_first)
-        callouts::wake_dispatcher();
+    q->lock.unlock();
 
     return result;
 }
 
 // callout_stop() and callout_drain()
-int _callout_stop_safe_locked(struct callout *c, int is_drain)
+//
+// Returns 1 if the callout was pending and will not run, as in FreeBSD.
+// A drain additionally waits for a handler that is already running.
+int _callout_stop_safe(struct callout *c, int is_drain)
 {
     int result = 0;
 
     trace_callout_stop(c, c->c_flags, is_drain);
 
-    if ((is_drain) &&
-        (sched::thread::current() != callouts::_callout_dispatcher) &&
-            (callout_pending(c) ||
-             (callout_active(c) && !callout_completed(c))) ) {
-
-        // Wait for callout
-        callout_set_waiter(c, sched::thread::current());
-        callouts::mark_have_work();
-        callouts::wake_dispatcher();
-
-        trace_callout_stop_wait(c);
-
-        sched::thread::wait_until(callouts::_callout_mutex, [&] {
-            return (c->c_flags & CALLOUT_COMPLETED);
-        });
+    auto q = lock_owner(c, nullptr);
+    if (!q) {
+        // Never armed
+        c->c_flags &= ~(CALLOUT_ACTIVE | CALLOUT_PENDING | CALLOUT_COMPLETED);
+        return (0);
+    }
 
+    if (q->remove(*c)) {
         result = 1;
     }
 
-    callouts::remove_callout(c);
+    if (q->curr == c) {
+        if (q->curr_locking && !q->curr_cancelled) {
+            // The dispatcher is still waiting for the callout's lock,
+            // probably held by our caller; the handler will not run.
+            q->curr_cancelled = true;
+            result = 1;
+        }
+        if (is_drain && sched::thread::current() != q->thread.get()) {
+            trace_callout_stop_wait(c);
+            while (q->curr == c) {
+                q->curr_done.wait(q->lock);
+            }
+        }
+    }
 
     // Clear flags
     c->c_flags &= ~(CALLOUT_ACTIVE | CALLOUT_PENDING | CALLOUT_COMPLETED);
 
-    return (result);
-}
-
-int _callout_stop_safe(struct callout *c, int is_drain)
-{
-    int result = 0;
-
-    callouts::lock();
-    result = _callout_stop_safe_locked(c, is_drain);
-    callouts::unlock();
+    q->lock.unlock();
 
     return (result);
 }
@@ -322,9 +357,8 @@ void callout_init_mtx(struct callout *c, struct mtx *mtx, int flags)
 
 void init_callouts(void)
 {
-    // Start the callout thread
-    callouts::_callout_dispatcher = sched::thread::make(_callout_thread,
-            sched::thread::attr().name("callout"));
-    callouts::_callout_dispatcher->start();
+    // Start a callout thread on each cpu
+    for (auto cpu : sched::cpus) {
+        *_percpu_queue.for_cpu(cpu) = aligned_new<callout_queue>(cpu);
+    }
 }
-
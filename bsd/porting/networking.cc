@@ -19,6 +19,10 @@
 #include <bsd/sys/netinet/in_var.h>
 #include <bsd/sys/sys/socket.h>
 #include <bsd/sys/sys/socketvar.h>
+#include <bsd/sys/netinet/tcp_var.h>
+#include <bsd/sys/netinet/tcp_syncache.h>
+#include <bsd/sys/netinet/tcp_fastopen.h>
+#include <osv/printf.hh>
 
 namespace osv {
 
@@ -194,4 +198,40 @@ std::string if_ip(std::string if_name) {
     }
     return inet_ntoa(((bsd_sockaddr_in*)&(addr.ifr_addr))->sin_addr);
 }
+
+int tcp_syncookies()
+{
+    return syncache_get_cookies();
+}
+
+void set_tcp_syncookies(int mode)
+{
+    syncache_set_cookies(mode);
+}
+
+int tcp_fastopen()
+{
+    return V_tcp_fastopen_mode;
+}
+
+void set_tcp_fastopen(int mode)
+{
+    V_tcp_fastopen_mode = mode & (TFO_CLIENT_ENABLE | TFO_SERVER_ENABLE);
+}
+
+std::string tcp_netstat()
+{
+    auto& st = V_tcpstat;
+    return osv::sprintf(
+        "TcpExt: SyncookiesSent SyncookiesRecv "
+        "TCPFastOpenActive TCPFastOpenActiveFail TCPFastOpenPassive "
+        "TCPFastOpenPassiveFail TCPFastOpenListenOverflow "
+        "TCPFastOpenCookieReqd\n"
+        "TcpExt: %lu %lu %lu %lu %lu %lu %lu %lu\n",
+        st.tcps_sc_sendcookie, st.tcps_sc_recvcookie,
+        st.tcps_tfo_active, st.tcps_tfo_active_fail,
+        st.tcps_tfo_passive, st.tcps_tfo_passive_fail,
+        st.tcps_tfo_overflow, st.tcps_tfo_cookie_req);
+}
+
 }
@@ -22,6 +22,14 @@ namespace osv {
     int stop_if(std::string if_name, std::string ip_addr);
     int ifup(std::string if_name);
     std::string if_ip(std::string if_name);
+
+    /* TCP tunables, with Linux's net.ipv4 semantics */
+    int tcp_syncookies();
+    void set_tcp_syncookies(int mode);
+    int tcp_fastopen();
+    void set_tcp_fastopen(int mode);
+    /* SYN cookie and TCP Fast Open counters, as in /proc/net/netstat */
+    std::string tcp_netstat();
 }
 
 #endif /* __NETWORKING_H__ */
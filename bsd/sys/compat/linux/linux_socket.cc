@@ -61,6 +61,8 @@
 #define __NEED_sa_family_t
 #include <bits/alltypes.h>
 
+#include <vector>
+
 
 static int linux_to_bsd_domain(int);
 
@@ -351,6 +353,8 @@ linux_to_bsd_so_sockopt(int opt)
 		return (SO_TIMESTAMP);
 	case LINUX_SO_ACCEPTCONN:
 		return (SO_ACCEPTCONN);
+	case LINUX_SO_BUSY_POLL:
+		return (SO_BUSY_POLL);
 	}
 	return (-1);
 }
@@ -378,6 +382,10 @@ linux_to_bsd_msg_flags(int flags)
 		ret_flags |= MSG_WAITALL;
 	if (flags & LINUX_MSG_NOSIGNAL)
 		ret_flags |= MSG_NOSIGNAL;
+	if (flags & LINUX_MSG_WAITFORONE)
+		ret_flags |= MSG_WAITFORONE;
+	if (flags & LINUX_MSG_FASTOPEN)
+		ret_flags |= MSG_FASTOPEN;
 #if 0 /* not handled */
 	if (flags & LINUX_MSG_PROXY)
 		;
@@ -1029,6 +1037,70 @@ bad:
 	return (error);
 }
 
+int
+linux_sendmmsg(int s, struct mmsghdr* msgvec, unsigned int vlen, int flags,
+    int *count)
+{
+	struct bsd_sockaddr *to;
+	struct msghdr *msg;
+	unsigned int i, translated;
+	int error = 0;
+
+	if (vlen > UIO_MAXIOV)
+		vlen = UIO_MAXIOV;
+
+	/*
+	 * Translate all the destination addresses up front so that the
+	 * whole vector can be handed to the socket layer as one batch.
+	 * The caller's msg_name pointers are restored afterwards.
+	 */
+	std::vector<void*> names(vlen);
+	for (translated = 0; translated < vlen; translated++) {
+		msg = &msgvec[translated].msg_hdr;
+		names[translated] = msg->msg_name;
+
+		/* See linux_sendmsg() */
+		if (msg->msg_control != NULL && msg->msg_controllen == 0)
+			msg->msg_control = NULL;
+
+		/*
+		 * FIXME: Translate msg control. Until then, refuse it rather
+		 * than silently sending without it.
+		 */
+		if (msg->msg_control != NULL) {
+			error = EINVAL;
+			break;
+		}
+
+		error = linux_to_bsd_msghdr(msg);
+		if (error)
+			break;
+
+		if (msg->msg_name != NULL) {
+			error = linux_getsockaddr(&to,
+			    (const bsd_osockaddr*)msg->msg_name,
+			    msg->msg_namelen);
+			if (error)
+				break;
+			msg->msg_name = to;
+		}
+	}
+
+	if (error == 0) {
+		error = kern_sendmmsg(s, msgvec, vlen,
+		    linux_to_bsd_msg_flags(flags), count);
+	}
+
+	for (i = 0; i < translated; i++) {
+		msg = &msgvec[i].msg_hdr;
+		if (names[i] != NULL) {
+			free(msg->msg_name);
+			msg->msg_name = names[i];
+		}
+	}
+	return (error);
+}
+
 struct linux_recvmsg_args {
 	int s;
 	l_uintptr_t msg;
@@ -1189,6 +1261,56 @@ bad:
 	return (error);
 }
 
+int
+linux_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+    const struct timespec *timeout, int *count)
+{
+	struct msghdr *msg;
+	unsigned int i;
+	int error;
+
+	if (vlen > UIO_MAXIOV)
+		vlen = UIO_MAXIOV;
+
+	for (i = 0; i < vlen; i++) {
+		msg = &msgvec[i].msg_hdr;
+		error = linux_to_bsd_msghdr(msg);
+		if (error)
+			return (error);
+		if (msg->msg_name) {
+			error = linux_to_bsd_sockaddr(
+			    (struct bsd_sockaddr *)msg->msg_name,
+			    msg->msg_namelen);
+			if (error)
+				return (error);
+		}
+	}
+
+	error = kern_recvmmsg(s, msgvec, vlen, linux_to_bsd_msg_flags(flags),
+	    timeout, count);
+	if (error)
+		return (error);
+
+	for (i = 0; i < (unsigned int)*count; i++) {
+		msg = &msgvec[i].msg_hdr;
+		error = bsd_to_linux_msghdr(msg);
+		if (error)
+			return (error);
+		if (msg->msg_name) {
+			error = bsd_to_linux_sockaddr(
+			    (struct bsd_sockaddr *)msg->msg_name);
+			if (error)
+				return (error);
+		}
+		if (msg->msg_name && msg->msg_namelen > 2) {
+			error = linux_sa_put((bsd_osockaddr*)msg->msg_name);
+			if (error)
+				return (error);
+		}
+	}
+	return (0);
+}
+
 int
 linux_shutdown(int s, int how)
 {
@@ -1212,6 +1334,8 @@ int linux_to_bsd_tcp_sockopt(int name)
 		return 0x400;
 	case 13: // TCP_CONGESTION
 		return 0x40;
+	case 23: // TCP_FASTOPEN
+		return 0x401;
 	}
 	// The BSD and Linux constants here are so different, that anything
 	// not explicitly supported is not supported. We return -1, which
@@ -34,6 +34,7 @@
 #include <osv/poll.h>
 #include <osv/clock.hh>
 #include <osv/signal.hh>
+#include <osv/net_busy_poll.hh>
 
 #include <bsd/porting/netport.h>
 #include <bsd/porting/rwlock.h>
@@ -46,6 +47,9 @@
 #include <bsd/sys/sys/socketvar.h>
 #include <bsd/sys/sys/libkern.h>
 
+#include <bsd/sys/net/if.h>
+#include <bsd/sys/net/if_var.h>
+
 /*
  * Function pointer set by the AIO routines so that the socket buffer code
  * can call back into the AIO module if it is loaded.
@@ -138,11 +142,70 @@ void sockbuf_iolock::unlock(mutex& mtx)
 	_wq.wake_all(mtx);
 }
 
+/*
+ * Remember which interface the data appended to a receive buffer came in
+ * on, for SO_BUSY_POLL to poll its receive queue.
+ */
+static inline void
+sbrecord_rcvif(socket* so, struct sockbuf *sb, struct mbuf *m)
+{
+	if (sb == &so->so_rcv && m && (m->m_hdr.mh_flags & M_PKTHDR) &&
+	    m->M_dat.MH.MH_pkthdr.rcvif) {
+		so->so_rcv_ifindex = m->M_dat.MH.MH_pkthdr.rcvif->if_index;
+	}
+}
+
+/*
+ * SO_BUSY_POLL: before sleeping on the receive buffer, spin for up to
+ * usecs microseconds pulling packets off the receive queue of the
+ * interface the socket's data last came in on ourselves.  Returns true if
+ * the socket may now be readable; as with a regular wakeup the caller
+ * re-checks its condition.
+ */
+static bool
+sbbusy_poll(socket* so, unsigned usecs)
+{
+	auto ifindex = so->so_rcv_ifindex;
+	auto nc = so->so_nc_busy ? nullptr : so->so_nc;
+	auto cc = so->so_rcv.sb_cc;
+	bool ready;
+
+	/* Like Linux, only spin once the socket's interface is known */
+	if (!ifindex) {
+		return false;
+	}
+
+	SOCK_UNLOCK(so);
+	ready = osv::busy_poll::spin(usecs, ifindex, [so, nc, cc] {
+		return so->so_rcv.sb_cc != cc || (nc && !nc->empty()) ||
+		    so->so_error != 0 ||
+		    (so->so_rcv.sb_state & SBS_CANTRCVMORE);
+	});
+	SOCK_LOCK(so);
+	if (ready && so->so_nc) {
+		so->so_nc->process_queue();
+	}
+	return ready;
+}
+
 template<typename Clock>
 int sbwait_tmo(socket* so, struct sockbuf *sb, boost::optional<std::chrono::time_point<Clock>> timeout)
 {
 	SOCK_LOCK_ASSERT(so);
 
+	if (sb == &so->so_rcv && so->so_busy_poll) {
+		/* Never spin past the receive timeout */
+		unsigned usecs = so->so_busy_poll;
+		if (timeout) {
+			auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+			    *timeout - Clock::now()).count();
+			usecs = std::min<long>(usecs, std::max<long>(left, 0));
+		}
+		if (usecs && sbbusy_poll(so, usecs)) {
+			return 0;
+		}
+	}
+
 	sb->sb_flags |= SB_WAIT;
 	sched::timer tmr(*sched::thread::current());
 	if (timeout) {
@@ -531,6 +594,7 @@ sbappend_locked(socket* so, struct sockbuf *sb, struct mbuf *m)
 
 	if (m == 0)
 		return;
+	sbrecord_rcvif(so, sb, m);
 
 	SBLASTRECORDCHK(sb);
 	n = sb->sb_mb;
@@ -592,6 +656,8 @@ sbappendstream_locked(socket* so, struct sockbuf *sb, struct mbuf *m)
 {
 	SOCK_LOCK_ASSERT(so);
 
+	sbrecord_rcvif(so, sb, m);
+
 	KASSERT(m->m_hdr.mh_nextpkt == NULL,("sbappendstream 0"));
 	KASSERT(sb->sb_mb == sb->sb_lastrecord,("sbappendstream 1"));
 
@@ -703,6 +769,7 @@ sbappendaddr_locked(socket* so, struct sockbuf *sb, const struct bsd_sockaddr *a
 
 	if (m0 && (m0->m_hdr.mh_flags & M_PKTHDR) == 0)
 		panic("sbappendaddr_locked");
+	sbrecord_rcvif(so, sb, m0);
 	if (m0)
 		space += m0->M_dat.MH.MH_pkthdr.len;
 	space += m_length(control, &n);
@@ -127,6 +127,7 @@
 #include <bsd/sys/net/vnet.h>
 
 #include <osv/zcopy.hh>
+#include <osv/net_busy_poll.hh>
 
 #define uipc_d(...) tprintf_d("uipc_socket", __VA_ARGS__)
 
@@ -325,6 +326,7 @@ socreate(int dom, struct socket **aso, int type, int proto,
 		so->so_fibnum = RT_DEFAULT_FIB;
 	else
 		so->so_fibnum = 0;
+	so->so_busy_poll = osv::busy_poll::read_usecs.load(std::memory_order_relaxed);
 	so->so_proto = prp;
 	so->so_count = 1;
 	/*
@@ -390,6 +392,7 @@ sonewconn(struct socket *head, int connstatus)
 	so->so_linger = head->so_linger;
 	so->so_state = head->so_state | SS_NOFDREF;
 	so->so_fibnum = head->so_fibnum;
+	so->so_busy_poll = head->so_busy_poll;
 	so->so_proto = head->so_proto;
 	VNET_SO_ASSERT(head);
 	if (soreserve_internal(so, head->so_snd.sb_hiwat, head->so_rcv.sb_hiwat) ||
@@ -1073,7 +1076,7 @@ restart:
 			VNET_SO_ASSERT(so);
 			SOCK_UNLOCK(so);
 			error = (*so->so_proto->pr_usrreqs->pru_send)(so,
-			    (flags & MSG_OOB) ? PRUS_OOB :
+			    ((flags & MSG_OOB) ? PRUS_OOB :
 			/*
 			 * If the user set MSG_EOF, the protocol understands
 			 * this flag and nothing left to send then use
@@ -1084,7 +1087,9 @@ restart:
 			     (resid <= 0)) ?
 				PRUS_EOF :
 			/* If there is more to send set PRUS_MORETOCOME. */
-			    (resid > 0 && space > 0) ? PRUS_MORETOCOME : 0,
+			    (resid > 0 && space > 0) ? PRUS_MORETOCOME : 0) |
+			/* Implied connect with TCP Fast Open. */
+			    ((flags & MSG_FASTOPEN) ? PRUS_FASTOPEN : 0),
 			    top, addr, control, td);
 			SOCK_LOCK(so);
 			if (dontroute) {
@@ -2352,48 +2357,24 @@ out:
 }
 
 /*
- * Optimized version of soreceive() for simple datagram cases from userspace.
- * Unlike in the stream case, we're able to drop a datagram if copyout()
- * fails, and because we handle datagrams atomically, we don't need to use a
- * sleep lock to prevent I/O interlacing.
+ * Pull up to 'max' datagram records off the front of the receive buffer,
+ * taking the socket lock only once.  Blocks until at least one record is
+ * available, unless the socket or 'flags' ask for non-blocking I/O.  The
+ * dequeued records are returned in '*recordsp', linked through
+ * m_nextpkt, and their number in '*countp'.  '*countp' may be zero with
+ * no error if the socket can't receive more or 'resid' is zero.
  */
 int
-soreceive_dgram(struct socket *so, struct bsd_sockaddr **psa, struct uio *uio,
-    struct mbuf **mp0, struct mbuf **controlp, int *flagsp)
+soreceive_dgram_dequeue(struct socket *so, int flags, ssize_t resid,
+    int max, struct mbuf **recordsp, int *countp)
 {
 	struct mbuf *m, *m2;
-	int flags, error;
-	ssize_t len;
-	struct protosw *pr = so->so_proto;
 	struct mbuf *nextrecord;
+	struct mbuf **tail = recordsp;
+	int error;
 
-	if (psa != NULL)
-		*psa = NULL;
-	if (controlp != NULL)
-		*controlp = NULL;
-	if (flagsp != NULL)
-		flags = *flagsp &~ MSG_EOR;
-	else
-		flags = 0;
-
-	/*
-	 * For any complicated cases, fall back to the full
-	 * soreceive_generic().
-	 */
-	if (mp0 != NULL || (flags & MSG_PEEK) || (flags & MSG_OOB))
-		return (soreceive_generic(so, psa, uio, mp0, controlp,
-		    flagsp));
-
-	/*
-	 * Enforce restrictions on use.
-	 */
-	KASSERT((pr->pr_flags & PR_WANTRCVD) == 0,
-	    ("soreceive_dgram: wantrcvd"));
-	KASSERT(pr->pr_flags & PR_ATOMIC, ("soreceive_dgram: !atomic"));
-	KASSERT((so->so_rcv.sb_state & SBS_RCVATMARK) == 0,
-	    ("soreceive_dgram: SBS_RCVATMARK"));
-	KASSERT((so->so_proto->pr_flags & PR_CONNREQUIRED) == 0,
-	    ("soreceive_dgram: P_CONNREQUIRED"));
+	*recordsp = NULL;
+	*countp = 0;
 
 	/*
 	 * Loop blocking while waiting for a datagram.
@@ -2410,7 +2391,7 @@ soreceive_dgram(struct socket *so, struct bsd_sockaddr **psa, struct uio *uio,
 			return (error);
 		}
 		if (so->so_rcv.sb_state & SBS_CANTRCVMORE ||
-		    uio->uio_resid == 0) {
+		    resid == 0) {
 			SOCK_UNLOCK(so);
 			return (0);
 		}
@@ -2429,28 +2410,36 @@ soreceive_dgram(struct socket *so, struct bsd_sockaddr **psa, struct uio *uio,
 	}
 	SOCK_LOCK_ASSERT(so);
 
-	SBLASTRECORDCHK(&so->so_rcv);
-	SBLASTMBUFCHK(&so->so_rcv);
-	nextrecord = m->m_hdr.mh_nextpkt;
-	if (nextrecord == NULL) {
-		KASSERT(so->so_rcv.sb_lastrecord == m,
-		    ("soreceive_dgram: lastrecord != m"));
-	}
+	while (*countp < max && (m = so->so_rcv.sb_mb) != NULL) {
+		SBLASTRECORDCHK(&so->so_rcv);
+		SBLASTMBUFCHK(&so->so_rcv);
+		nextrecord = m->m_hdr.mh_nextpkt;
+		if (nextrecord == NULL) {
+			KASSERT(so->so_rcv.sb_lastrecord == m,
+			    ("soreceive_dgram: lastrecord != m"));
+		}
 
-	KASSERT(so->so_rcv.sb_mb->m_hdr.mh_nextpkt == nextrecord,
-	    ("soreceive_dgram: m_hdr.mh_nextpkt != nextrecord"));
+		KASSERT(so->so_rcv.sb_mb->m_hdr.mh_nextpkt == nextrecord,
+		    ("soreceive_dgram: m_hdr.mh_nextpkt != nextrecord"));
 
-	/*
-	 * Pull 'm' and its chain off the front of the packet queue.
-	 */
-	so->so_rcv.sb_mb = NULL;
-	sockbuf_pushsync(so, &so->so_rcv, nextrecord);
+		/*
+		 * Pull 'm' and its chain off the front of the packet queue.
+		 */
+		so->so_rcv.sb_mb = NULL;
+		sockbuf_pushsync(so, &so->so_rcv, nextrecord);
 
-	/*
-	 * Walk 'm's chain and free that many bytes from the socket buffer.
-	 */
-	for (m2 = m; m2 != NULL; m2 = m2->m_hdr.mh_next)
-		sbfree(&so->so_rcv, m2);
+		/*
+		 * Walk 'm's chain and free that many bytes from the socket
+		 * buffer.
+		 */
+		for (m2 = m; m2 != NULL; m2 = m2->m_hdr.mh_next)
+			sbfree(&so->so_rcv, m2);
+
+		m->m_hdr.mh_nextpkt = NULL;
+		*tail = m;
+		tail = &m->m_hdr.mh_nextpkt;
+		++*countp;
+	}
 
 	/*
 	 * Do a few last checks before we let go of the lock.
@@ -2458,6 +2447,29 @@ soreceive_dgram(struct socket *so, struct bsd_sockaddr **psa, struct uio *uio,
 	SBLASTRECORDCHK(&so->so_rcv);
 	SBLASTMBUFCHK(&so->so_rcv);
 	SOCK_UNLOCK(so);
+	return (0);
+}
+
+/*
+ * Copy out a single datagram record previously pulled off the receive
+ * buffer by soreceive_dgram_dequeue().  Consumes the record.  'flags' are
+ * the receive flags; MSG_TRUNC is added to '*flagsp' if the datagram did
+ * not fit into 'uio'.
+ */
+int
+soreceive_dgram_record(struct socket *so, struct mbuf *m,
+    struct bsd_sockaddr **psa, struct uio *uio, struct mbuf **controlp,
+    int flags, int *flagsp)
+{
+	struct mbuf *m2;
+	int error;
+	ssize_t len;
+	struct protosw *pr = so->so_proto;
+
+	if (psa != NULL)
+		*psa = NULL;
+	if (controlp != NULL)
+		*controlp = NULL;
 
 	if (pr->pr_flags & PR_ADDR) {
 		KASSERT(m->m_hdr.mh_type == MT_SONAME,
@@ -2535,6 +2547,57 @@ soreceive_dgram(struct socket *so, struct bsd_sockaddr **psa, struct uio *uio,
 	return (0);
 }
 
+/*
+ * Optimized version of soreceive() for simple datagram cases from userspace.
+ * Unlike in the stream case, we're able to drop a datagram if copyout()
+ * fails, and because we handle datagrams atomically, we don't need to use a
+ * sleep lock to prevent I/O interlacing.
+ */
+int
+soreceive_dgram(struct socket *so, struct bsd_sockaddr **psa, struct uio *uio,
+    struct mbuf **mp0, struct mbuf **controlp, int *flagsp)
+{
+	struct mbuf *m;
+	int flags, error, count;
+	struct protosw *pr = so->so_proto;
+
+	if (psa != NULL)
+		*psa = NULL;
+	if (controlp != NULL)
+		*controlp = NULL;
+	if (flagsp != NULL)
+		flags = *flagsp &~ MSG_EOR;
+	else
+		flags = 0;
+
+	/*
+	 * For any complicated cases, fall back to the full
+	 * soreceive_generic().
+	 */
+	if (mp0 != NULL || (flags & MSG_PEEK) || (flags & MSG_OOB))
+		return (soreceive_generic(so, psa, uio, mp0, controlp,
+		    flagsp));
+
+	/*
+	 * Enforce restrictions on use.
+	 */
+	KASSERT((pr->pr_flags & PR_WANTRCVD) == 0,
+	    ("soreceive_dgram: wantrcvd"));
+	KASSERT(pr->pr_flags & PR_ATOMIC, ("soreceive_dgram: !atomic"));
+	KASSERT((so->so_rcv.sb_state & SBS_RCVATMARK) == 0,
+	    ("soreceive_dgram: SBS_RCVATMARK"));
+	KASSERT((so->so_proto->pr_flags & PR_CONNREQUIRED) == 0,
+	    ("soreceive_dgram: P_CONNREQUIRED"));
+
+	error = soreceive_dgram_dequeue(so, flags, uio->uio_resid, 1, &m,
+	    &count);
+	if (error || count == 0)
+		return (error);
+
+	return (soreceive_dgram_record(so, m, psa, uio, controlp, flags,
+	    flagsp));
+}
+
 int
 soreceive(struct socket *so, struct bsd_sockaddr **psa, struct uio *uio,
     struct mbuf **mp0, struct mbuf **controlp, int *flagsp)
@@ -2764,6 +2827,18 @@ sosetopt(struct socket *so, struct sockopt *sopt)
 			so->so_user_cookie = val32;
 			break;
 
+		case SO_BUSY_POLL:
+			error = sooptcopyin(sopt, &optval, sizeof optval,
+					    sizeof optval);
+			if (error)
+				goto bad;
+			if (optval < 0) {
+				error = EINVAL;
+				goto bad;
+			}
+			so->so_busy_poll = optval;
+			break;
+
 		case SO_SNDBUF:
 		case SO_RCVBUF:
 		case SO_SNDLOWAT:
@@ -3006,6 +3081,10 @@ integer:
 			optval = so->so_incqlen;
 			goto integer;
 
+		case SO_BUSY_POLL:
+			optval = so->so_busy_poll;
+			goto integer;
+
 		default:
 			error = ENOPROTOOPT;
 			break;
@@ -61,6 +61,8 @@
 #include <osv/mempool.hh>
 #include <osv/pagealloc.hh>
 #include <osv/zcopy.hh>
+#include <osv/clock.hh>
+#include <osv/percpu_xmit.hh>
 #include <sys/eventfd.h>
 
 using namespace std;
@@ -473,26 +475,19 @@ bad:
 	return (error);
 }
 
-int
-kern_sendit(int s,
-            struct msghdr *mp,
-            int flags,
-            struct mbuf *control,
-            ssize_t *bytes)
+static int
+sosendit(struct socket *so,
+         struct msghdr *mp,
+         int flags,
+         struct mbuf *control,
+         ssize_t *bytes)
 {
-	struct file *fp;
 	struct uio auio = {};
 	struct iovec *iov;
-	struct socket *so;
 	struct bsd_sockaddr *from = 0;
 	int i, error;
 	ssize_t len;
 
-	error = getsock_cap(s, &fp, NULL);
-	if (error)
-		return (error);
-	so = (struct socket *)file_data(fp);
-
 	// Create a local copy of the user's iovec - sosend() is going to change it!
 	std::vector<iovec> uio_iov(mp->msg_iov, mp->msg_iov + mp->msg_iovlen);
 
@@ -504,8 +499,9 @@ kern_sendit(int s,
 	iov = mp->msg_iov;
 	for (i = 0; i < mp->msg_iovlen; i++, iov++) {
 		if ((auio.uio_resid += iov->iov_len) < 0) {
-			error = EINVAL;
-			goto bad;
+			if (control)
+				m_freem(control);
+			return (EINVAL);
 		}
 	}
 	len = auio.uio_resid;
@@ -528,8 +524,87 @@ kern_sendit(int s,
 	}
 	if (error == 0)
 	    *bytes = len - auio.uio_resid;
-bad:
+	return (error);
+}
+
+int
+kern_sendit(int s,
+            struct msghdr *mp,
+            int flags,
+            struct mbuf *control,
+            ssize_t *bytes)
+{
+	struct file *fp;
+	struct socket *so;
+	int error;
+
+	error = getsock_cap(s, &fp, NULL);
+	if (error)
+		return (error);
+	so = (struct socket *)file_data(fp);
+
+	error = sosendit(so, mp, flags, control, bytes);
+
+	fdrop(fp);
+	return (error);
+}
+
+/*
+ * Send up to 'vlen' messages on a socket, looking the socket up only once.
+ * Packets produced by the batch are handed to the network drivers as one
+ * transmit batch (see osv::xmit_batch), so the hardware is notified once
+ * for the whole batch instead of once per datagram.
+ */
+int
+kern_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+    int *count)
+{
+	struct file *fp;
+	struct socket *so;
+	struct mbuf *control;
+	struct msghdr *mp;
+	ssize_t bytes;
+	unsigned int i;
+	int error;
+
+	*count = 0;
+	if (vlen > UIO_MAXIOV)
+		vlen = UIO_MAXIOV;
+
+	error = getsock_cap(s, &fp, NULL);
+	if (error)
+		return (error);
+	so = (struct socket *)file_data(fp);
+
+	osv::xmit_batch batch;
+	for (i = 0; i < vlen; i++) {
+		mp = &msgvec[i].msg_hdr;
+		control = NULL;
+		if (mp->msg_control) {
+			if (mp->msg_controllen < sizeof(struct cmsghdr)) {
+				error = EINVAL;
+				break;
+			}
+			error = sockargs(&control, (caddr_t)mp->msg_control,
+			    mp->msg_controllen, MT_CONTROL);
+			if (error)
+				break;
+		}
+		error = sosendit(so, mp, flags, control, &bytes);
+		if (error)
+			break;
+		msgvec[i].msg_len = bytes;
+	}
+
 	fdrop(fp);
+
+	/*
+	 * Like Linux, report the error only if nothing at all was sent.
+	 * Otherwise the caller learns about it on its next call.
+	 */
+	*count = i;
+	if (i > 0)
+		error = 0;
 	return (error);
 }
 
@@ -562,19 +637,102 @@ sys_sendmsg(int s, struct msghdr* msg, int flags, ssize_t* bytes)
 	return (error);
 }
 
+/*
+ * Set up 'auio' to describe the buffers of 'mp'.  The iovec array is copied
+ * into 'uio_iov', since soreceive() is going to change it.
+ */
+static int
+recvit_uio(struct msghdr *mp, std::vector<iovec>& uio_iov, struct uio *auio)
+{
+	struct iovec *iov;
+	int i;
+
+	uio_iov.assign(mp->msg_iov, mp->msg_iov + mp->msg_iovlen);
+
+	auio->uio_iov = uio_iov.data();
+	auio->uio_iovcnt = uio_iov.size();
+	auio->uio_rw = UIO_READ;
+	auio->uio_offset = 0;			/* XXX */
+	auio->uio_resid = 0;
+	iov = mp->msg_iov;
+	for (i = 0; i < mp->msg_iovlen; i++, iov++) {
+		if ((auio->uio_resid += iov->iov_len) < 0) {
+			return (EINVAL);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Fill in the source address of a received message into 'mp'.
+ */
+static void
+recvit_name(struct msghdr *mp, struct bsd_sockaddr *fromsa)
+{
+	ssize_t len;
+
+	if (mp->msg_name) {
+		len = mp->msg_namelen;
+		if (len <= 0 || fromsa == 0)
+			len = 0;
+		else {
+			/* save sa_len before it is destroyed by MSG_COMPAT */
+			len = MIN(len, fromsa->sa_len);
+			bcopy(fromsa, mp->msg_name, len);
+		}
+		mp->msg_namelen = len;
+	}
+}
+
+/*
+ * Copy the control messages of a received message into 'mp'.
+ */
+static int
+recvit_control(struct msghdr *mp, struct mbuf *control)
+{
+	struct mbuf *m;
+	caddr_t ctlbuf;
+	ssize_t len;
+	int error;
+
+	len = mp->msg_controllen;
+	m = control;
+	mp->msg_controllen = 0;
+	ctlbuf = (caddr_t)mp->msg_control;
+
+	while (m && len > 0) {
+		unsigned int tocopy;
+
+		if (len >= m->m_hdr.mh_len)
+			tocopy = m->m_hdr.mh_len;
+		else {
+			mp->msg_flags |= MSG_CTRUNC;
+			tocopy = len;
+		}
+
+		if ((error = copyout(mtod(m, caddr_t),
+				ctlbuf, tocopy)) != 0)
+			return (error);
+
+		ctlbuf += tocopy;
+		len -= tocopy;
+		m = m->m_hdr.mh_next;
+	}
+	mp->msg_controllen = ctlbuf - (caddr_t)mp->msg_control;
+	return (0);
+}
+
 int
 kern_recvit(int s, struct msghdr *mp, struct mbuf **controlp, ssize_t* bytes)
 {
 	struct uio auio;
-	struct iovec *iov;
-	int i;
 	ssize_t len;
 	int error;
-	struct mbuf *m, *control = 0;
-	caddr_t ctlbuf;
+	struct mbuf *control = 0;
 	struct file *fp;
 	struct socket *so;
 	struct bsd_sockaddr *fromsa = 0;
+	std::vector<iovec> uio_iov;
 
 	if (controlp != NULL)
 		*controlp = NULL;
@@ -584,20 +742,10 @@ kern_recvit(int s, struct msghdr *mp, struct mbuf **controlp, ssize_t* bytes)
 		return (error);
 	so = (socket*)file_data(fp);
 
-	// Create a local copy of the user's iovec - sorecieve() is going to change it!
-	std::vector<iovec> uio_iov(mp->msg_iov, mp->msg_iov + mp->msg_iovlen);
-
-	auio.uio_iov = uio_iov.data();
-	auio.uio_iovcnt = uio_iov.size();
-	auio.uio_rw = UIO_READ;
-	auio.uio_offset = 0;			/* XXX */
-	auio.uio_resid = 0;
-	iov = mp->msg_iov;
-	for (i = 0; i < mp->msg_iovlen; i++, iov++) {
-		if ((auio.uio_resid += iov->iov_len) < 0) {
-			fdrop(fp);
-			return (EINVAL);
-		}
+	error = recvit_uio(mp, uio_iov, &auio);
+	if (error) {
+		fdrop(fp);
+		return (error);
 	}
 	len = auio.uio_resid;
 	error = soreceive(so, &fromsa, &auio, (struct mbuf **)0,
@@ -611,43 +759,9 @@ kern_recvit(int s, struct msghdr *mp, struct mbuf **controlp, ssize_t* bytes)
 	if (error)
 		goto out;
 	*bytes = len - auio.uio_resid;
-	if (mp->msg_name) {
-		len = mp->msg_namelen;
-		if (len <= 0 || fromsa == 0)
-			len = 0;
-		else {
-			/* save sa_len before it is destroyed by MSG_COMPAT */
-			len = MIN(len, fromsa->sa_len);
-			bcopy(fromsa, mp->msg_name, len);
-		}
-		mp->msg_namelen = len;
-	}
-	if (mp->msg_control && controlp == NULL) {
-		len = mp->msg_controllen;
-		m = control;
-		mp->msg_controllen = 0;
-		ctlbuf = (caddr_t)mp->msg_control;
-
-		while (m && len > 0) {
-			unsigned int tocopy;
-
-			if (len >= m->m_hdr.mh_len)
-				tocopy = m->m_hdr.mh_len;
-			else {
-				mp->msg_flags |= MSG_CTRUNC;
-				tocopy = len;
-			}
-
-			if ((error = copyout(mtod(m, caddr_t),
-					ctlbuf, tocopy)) != 0)
-				goto out;
-
-			ctlbuf += tocopy;
-			len -= tocopy;
-			m = m->m_hdr.mh_next;
-		}
-		mp->msg_controllen = ctlbuf - (caddr_t)mp->msg_control;
-	}
+	recvit_name(mp, fromsa);
+	if (mp->msg_control && controlp == NULL)
+		error = recvit_control(mp, control);
 out:
 	fdrop(fp);
 	if (fromsa)
@@ -661,6 +775,150 @@ out:
 	return (error);
 }
 
+/*
+ * Receive the datagram record 'm', already pulled off the socket's receive
+ * buffer by soreceive_dgram_dequeue(), into 'mp'.
+ */
+static int
+recvit_record(struct socket *so, struct mbuf *m, struct msghdr *mp,
+    ssize_t *bytes)
+{
+	struct uio auio;
+	ssize_t len;
+	int error;
+	struct mbuf *control = 0;
+	struct bsd_sockaddr *fromsa = 0;
+	std::vector<iovec> uio_iov;
+
+	error = recvit_uio(mp, uio_iov, &auio);
+	if (error) {
+		m_freem(m);
+		return (error);
+	}
+	len = auio.uio_resid;
+	error = soreceive_dgram_record(so, m, &fromsa, &auio,
+	    mp->msg_control ? &control : (struct mbuf **)0,
+	    mp->msg_flags & ~MSG_EOR, &mp->msg_flags);
+	if (error == 0) {
+		*bytes = len - auio.uio_resid;
+		recvit_name(mp, fromsa);
+		if (mp->msg_control)
+			error = recvit_control(mp, control);
+	}
+	if (fromsa)
+		free(fromsa);
+	if (control)
+		m_freem(control);
+	return (error);
+}
+
+/*
+ * Receive up to 'vlen' messages from a socket, looking the socket up only
+ * once.  On datagram sockets all the datagrams already queued are pulled off
+ * the receive buffer under a single socket lock acquisition, instead of one
+ * lock round-trip per datagram.
+ *
+ * Blocks until 'vlen' messages were received, unless MSG_WAITFORONE is set,
+ * in which case only the first message is waited for.  As on Linux,
+ * 'timeout' is only checked after each received batch.
+ */
+int
+kern_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+    const struct timespec *timeout, int *count)
+{
+	using namespace std::chrono;
+	struct file *fp;
+	struct socket *so;
+	struct mbuf *records, *next;
+	struct msghdr *mp;
+	osv::clock::uptime::time_point deadline;
+	unsigned int i = 0;
+	int error, n, rflags;
+	ssize_t bytes, resid;
+	bool batch;
+
+	*count = 0;
+	if (vlen > UIO_MAXIOV)
+		vlen = UIO_MAXIOV;
+	if (timeout) {
+		if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 ||
+		    timeout->tv_nsec >= 1000000000L)
+			return (EINVAL);
+		deadline = osv::clock::uptime::now() +
+		    seconds(timeout->tv_sec) + nanoseconds(timeout->tv_nsec);
+	}
+
+	error = getsock_cap(s, &fp, NULL);
+	if (error)
+		return (error);
+	so = (socket*)file_data(fp);
+
+	batch = so->so_proto->pr_usrreqs->pru_soreceive == soreceive_dgram &&
+	    !(flags & (MSG_PEEK | MSG_OOB));
+
+	while (i < vlen) {
+		rflags = flags & ~MSG_WAITFORONE;
+		if (i > 0 && (flags & MSG_WAITFORONE))
+			rflags |= MSG_DONTWAIT;
+
+		if (!batch) {
+			mp = &msgvec[i].msg_hdr;
+			mp->msg_flags = rflags;
+			error = kern_recvit(s, mp, NULL, &bytes);
+			if (error)
+				break;
+			msgvec[i++].msg_len = bytes;
+		} else {
+			mp = &msgvec[i].msg_hdr;
+			resid = 0;
+			for (n = 0; n < mp->msg_iovlen; n++)
+				resid += mp->msg_iov[n].iov_len;
+			error = soreceive_dgram_dequeue(so, rflags, resid,
+			    vlen - i, &records, &n);
+			if (error || n == 0)
+				break;
+			/*
+			 * The records are already off the socket buffer: if
+			 * copying one out fails, the rest of the batch is
+			 * dropped, like the failed datagram itself.
+			 */
+			for (; records != NULL; records = next) {
+				next = records->m_hdr.mh_nextpkt;
+				records->m_hdr.mh_nextpkt = NULL;
+				if (error) {
+					m_freem(records);
+					continue;
+				}
+				mp = &msgvec[i].msg_hdr;
+				mp->msg_flags = rflags;
+				error = recvit_record(so, records, mp, &bytes);
+				if (error == 0)
+					msgvec[i++].msg_len = bytes;
+			}
+			if (error)
+				break;
+		}
+		if (timeout && osv::clock::uptime::now() >= deadline)
+			break;
+	}
+
+	/*
+	 * Like Linux, an error after some messages were received is reported
+	 * by the next call on the socket, and this one returns what it got.
+	 */
+	if (i > 0 && error) {
+		if (error != EWOULDBLOCK) {
+			SOCK_LOCK(so);
+			so->so_error = error;
+			SOCK_UNLOCK(so);
+		}
+		error = 0;
+	}
+	fdrop(fp);
+	*count = i;
+	return (error);
+}
+
 static int
 recvit(int s, struct msghdr *mp, void *namelenp, ssize_t* bytes)
 {
@@ -5,6 +5,7 @@
 
 #include <bsd/uipc_syscalls.h>
 #include <osv/debug.h>
+#include <osv/net_ready.hh>
 #include "libc/af_local.h"
 
 #include "libc/internal/libc.h"
@@ -124,7 +125,9 @@ int connect(int fd, const struct bsd_sockaddr *addr, socklen_t len)
 
 	sock_d("connect(fd=%d, ...)", fd);
 
-	error = linux_connect(fd, (void *)addr, len);
+	error = osv::net_ready::wait_for(fd, 0, addr, len);
+	if (!error)
+		error = linux_connect(fd, (void *)addr, len);
 	if (error) {
 		sock_d("connect() failed, errno=%d", error);
 		errno = error;
@@ -207,6 +210,25 @@ ssize_t recvmsg(int fd, struct msghdr *msg, int flags)
 	return bytes;
 }
 
+extern "C"
+int recvmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen,
+		unsigned int flags, struct timespec *timeout)
+{
+	int error, count;
+
+	sock_d("recvmmsg(fd=%d, msgvec=..., vlen=%u, flags=0x%x)", fd, vlen,
+		flags);
+
+	error = linux_recvmmsg(fd, msgvec, vlen, flags, timeout, &count);
+	if (error) {
+		sock_d("recvmmsg() failed, errno=%d", error);
+		errno = error;
+		return -1;
+	}
+
+	return count;
+}
+
 extern "C"
 ssize_t sendto(int fd, const void *buf, size_t len, int flags,
     const struct bsd_sockaddr *addr, socklen_t alen)
@@ -216,8 +238,10 @@ ssize_t sendto(int fd, const void *buf, size_t len, int flags,
 
 	sock_d("sendto(fd=%d, buf=..., len=%d, flags=0x%x, ...", fd, len, flags);
 
-	error = linux_sendto(fd, (caddr_t)buf, len, flags, (caddr_t)addr,
-			   alen, &bytes);
+	error = osv::net_ready::wait_for(fd, flags, addr, alen);
+	if (!error)
+		error = linux_sendto(fd, (caddr_t)buf, len, flags,
+		    (caddr_t)addr, alen, &bytes);
 	if (error) {
 		sock_d("sendto() failed, errno=%d", error);
 		errno = error;
@@ -253,7 +277,10 @@ ssize_t sendmsg(int fd, const struct msghdr *msg, int flags)
 
 	sock_d("sendmsg(fd=%d, msg=..., flags=0x%x)", fd, flags)
 
-	error = linux_sendmsg(fd, (struct msghdr *)msg, flags, &bytes);
+	error = osv::net_ready::wait_for(fd, flags, msg->msg_name,
+	    msg->msg_namelen);
+	if (!error)
+		error = linux_sendmsg(fd, (struct msghdr *)msg, flags, &bytes);
 	if (error) {
 		sock_d("sendmsg() failed, errno=%d", error);
 		errno = error;
@@ -263,6 +290,31 @@ ssize_t sendmsg(int fd, const struct msghdr *msg, int flags)
 	return bytes;
 }
 
+extern "C"
+int sendmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen,
+		unsigned int flags)
+{
+	int error = 0, count;
+
+	sock_d("sendmmsg(fd=%d, msgvec=..., vlen=%u, flags=0x%x)", fd, vlen,
+		flags);
+
+	for (unsigned int i = 0; i < vlen && !error &&
+	    !osv::net_ready::is_set(); i++) {
+		error = osv::net_ready::wait_for(fd, flags,
+		    msgvec[i].msg_hdr.msg_name, msgvec[i].msg_hdr.msg_namelen);
+	}
+	if (!error)
+		error = linux_sendmmsg(fd, msgvec, vlen, flags, &count);
+	if (error) {
+		sock_d("sendmmsg() failed, errno=%d", error);
+		errno = error;
+		return -1;
+	}
+
+	return count;
+}
+
 extern "C"
 int getsockopt(int fd, int level, int optname, void *__restrict optval,
 		socklen_t *__restrict optlen)
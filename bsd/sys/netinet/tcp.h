@@ -131,11 +131,17 @@ struct tcphdr {
 #define    TCPOLEN_TSTAMP_APPA		(TCPOLEN_TIMESTAMP+2) /* appendix A */
 #define	TCPOPT_SIGNATURE	19		/* Keyed MD5: RFC 2385 */
 #define	   TCPOLEN_SIGNATURE		18
+#define	TCPOPT_FAST_OPEN	34		/* TCP Fast Open: RFC 7413 */
+#define	   TCPOLEN_FAST_OPEN_EMPTY	2
 
 /* Miscellaneous constants */
 #define	MAX_SACK_BLKS	6	/* Max # SACK blocks stored at receiver side */
 #define	TCP_MAX_SACK	4	/* MAX # SACKs sent in any segment */
 
+/* TCP Fast Open cookie lengths, RFC 7413 */
+#define	TCP_FASTOPEN_MIN_COOKIE_LEN	4
+#define	TCP_FASTOPEN_MAX_COOKIE_LEN	16
+
 
 /*
  * The default maximum segment size (MSS) to be used for new TCP connections
@@ -197,6 +203,7 @@ struct tcphdr {
 #define	TCP_KEEPIDLE	0x100	/* L,N,X start keeplives after this period */
 #define	TCP_KEEPINTVL	0x200	/* L,N interval between keepalives */
 #define	TCP_KEEPCNT	0x400	/* L,N number of keepalives before close */
+#define	TCP_FASTOPEN	0x401	/* enable TFO / listen queue length */
 
 #define	TCP_CA_NAME_MAX	16	/* max congestion control name length */
 
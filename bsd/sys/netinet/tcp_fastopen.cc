@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+/*
+ * TCP Fast Open (RFC 7413).
+ *
+ * A client which has previously obtained a cookie from a server may send
+ * data in its SYN, and the server delivers that data to the application
+ * as soon as it has validated the cookie, saving a round trip.
+ *
+ * Server: the cookie is a MAC of the client address, keyed with a secret
+ * chosen at boot, so validating it needs no per-client state.  A SYN
+ * with a valid cookie creates the connection right away (see
+ * syncache_add()); any other SYN carrying the option, including an empty
+ * cookie request, gets a fresh cookie in the SYN|ACK.  The number of such
+ * connections which have not yet completed the 3-way handshake is bounded
+ * by the listen socket's TCP_FASTOPEN queue length.
+ *
+ * Client: cookies are kept per host in the TCP host cache.  A connect
+ * with MSG_FASTOPEN sends its data in the SYN if we have a cookie for the
+ * peer, and a cookie request otherwise.
+ */
+
+#include <sys/cdefs.h>
+
+#include <bsd/porting/netport.h>
+#include <bsd/porting/sync_stub.h>
+
+#include <bsd/sys/sys/param.h>
+#include <bsd/sys/sys/libkern.h>
+#include <bsd/sys/sys/md5.h>
+#include <bsd/sys/sys/socket.h>
+#include <bsd/sys/sys/socketvar.h>
+
+#include <bsd/sys/net/vnet.h>
+
+#include <bsd/sys/netinet/in.h>
+#include <bsd/sys/netinet/in_pcb.h>
+#include <bsd/sys/netinet/tcp.h>
+#include <bsd/sys/netinet/tcp_var.h>
+#include <bsd/sys/netinet/tcp_fastopen.h>
+
+#include <machine/atomic.h>
+
+VNET_DEFINE(int, tcp_fastopen_mode) = TFO_CLIENT_ENABLE;
+SYSCTL_VNET_INT(_net_inet_tcp, OID_AUTO, fastopen, CTLFLAG_RW,
+	&VNET_NAME(tcp_fastopen_mode), 0,
+	"TCP Fast Open: 1 enables the client side, 2 the server side");
+
+static u_int8_t tcp_fastopen_key[TCP_FASTOPEN_KEY_LEN];
+
+void
+tcp_fastopen_init(void)
+{
+	arc4rand(tcp_fastopen_key, sizeof(tcp_fastopen_key), 0);
+}
+
+static void
+tcp_fastopen_make_cookie(struct in_conninfo *inc, u_int8_t *cookie)
+{
+	MD5_CTX ctx;
+	u_int8_t digest[MD5_DIGEST_LENGTH];
+
+	MD5Init(&ctx);
+	MD5Update(&ctx, tcp_fastopen_key, sizeof(tcp_fastopen_key));
+#ifdef INET6
+	if (inc->inc_flags & INC_ISIPV6)
+		MD5Update(&ctx, &inc->inc6_faddr, sizeof(inc->inc6_faddr));
+	else
+#endif
+		MD5Update(&ctx, &inc->inc_faddr, sizeof(inc->inc_faddr));
+	MD5Final(digest, &ctx);
+	bcopy(digest, cookie, TCP_FASTOPEN_COOKIE_LEN);
+}
+
+/*
+ * Check the cookie a client sent in its SYN.  Returns 1 if it is valid,
+ * 0 if it is not (or is a cookie request).  Either way, the client's
+ * current cookie is returned in response.
+ */
+int
+tcp_fastopen_check_cookie(struct in_conninfo *inc, u_int8_t *cookie,
+    u_int len, u_int8_t *response)
+{
+	tcp_fastopen_make_cookie(inc, response);
+	if (len != TCP_FASTOPEN_COOKIE_LEN)
+		return (0);
+	return (bcmp(cookie, response, len) == 0);
+}
+
+/*
+ * The counter of pending TFO connections is shared by a listen socket and
+ * the connections it accepted with TFO, which each hold a reference until
+ * they are established or closed.  It starts out with the listener's
+ * reference.
+ */
+u_int *
+tcp_fastopen_alloc_counter(void)
+{
+	u_int *counter;
+
+	counter = (u_int *)malloc(sizeof(*counter));
+	if (counter != NULL)
+		*counter = 1;
+	return (counter);
+}
+
+void
+tcp_fastopen_decrement_counter(u_int *counter)
+{
+	if (atomic_fetchadd_int(counter, -1) == 1)
+		free(counter);
+}
+
+/*
+ * Client side: called when connecting a TFO socket.  Picks up the cookie
+ * we have for the peer, if any.  Without one, the SYN carries a cookie
+ * request and no data.
+ */
+void
+tcp_fastopen_connect(struct tcpcb *tp)
+{
+	INP_LOCK_ASSERT(tp->t_inpcb);
+
+	tp->t_tfo_client_cookie_len =
+	    tcp_hc_gettfo(&tp->t_inpcb->inp_inc, tp->t_tfo_cookie);
+	if (tp->t_tfo_client_cookie_len == 0)
+		TCPSTAT_INC(tcps_tfo_cookie_req);
+}
+
+/*
+ * Client side: the SYN|ACK carried a cookie; remember it for next time.
+ */
+void
+tcp_fastopen_update_cache(struct tcpcb *tp, u_int8_t *cookie, u_int len)
+{
+	if (len < TCP_FASTOPEN_MIN_COOKIE_LEN ||
+	    len > TCP_FASTOPEN_MAX_COOKIE_LEN || (len & 1))
+		return;
+	tcp_hc_updatetfo(&tp->t_inpcb->inp_inc, cookie, len);
+}
+
+/*
+ * Client side: the peer ignored our SYN data, or our SYN got lost,
+ * possibly to a middlebox dropping SYNs with data.  Forget the cookie so
+ * that the next connection starts over with a plain cookie request.
+ */
+void
+tcp_fastopen_disable_path(struct tcpcb *tp)
+{
+	tcp_hc_updatetfo(&tp->t_inpcb->inp_inc, NULL, 0);
+	TCPSTAT_INC(tcps_tfo_active_fail);
+}
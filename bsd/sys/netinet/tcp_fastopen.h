@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef _NETINET_TCP_FASTOPEN_H_
+#define _NETINET_TCP_FASTOPEN_H_
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+#ifdef _KERNEL
+
+#define	TCP_FASTOPEN_COOKIE_LEN	8	/* length of the cookies we issue */
+#define	TCP_FASTOPEN_KEY_LEN	16
+
+/*
+ * Bits of tcp_fastopen_mode, as in Linux's net.ipv4.tcp_fastopen.
+ */
+#define	TFO_CLIENT_ENABLE	0x1	/* send data in SYNs */
+#define	TFO_SERVER_ENABLE	0x2	/* accept data in SYNs */
+
+VNET_DECLARE(int, tcp_fastopen_mode);
+#define	V_tcp_fastopen_mode	VNET(tcp_fastopen_mode)
+
+struct in_conninfo;
+class tcpcb;
+
+void	tcp_fastopen_init(void);
+int	tcp_fastopen_check_cookie(struct in_conninfo *, u_int8_t *, u_int,
+	    u_int8_t *);
+u_int	*tcp_fastopen_alloc_counter(void);
+void	tcp_fastopen_decrement_counter(u_int *);
+void	tcp_fastopen_connect(struct tcpcb *);
+void	tcp_fastopen_update_cache(struct tcpcb *, u_int8_t *, u_int);
+void	tcp_fastopen_disable_path(struct tcpcb *);
+
+#endif /* _KERNEL */
+
+__END_DECLS
+
+#endif /* _NETINET_TCP_FASTOPEN_H_ */
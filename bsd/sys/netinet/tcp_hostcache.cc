@@ -502,6 +502,58 @@ tcp_hc_updatemtu(struct in_conninfo *inc, u_long mtu)
 	THC_UNLOCK(&hc_entry->rmx_head->hch_mtx);
 }
 
+/*
+ * External function: look up the TCP Fast Open cookie the host gave us.
+ * Copies it to cookie and returns its length, or returns 0 if we have none.
+ */
+int
+tcp_hc_gettfo(struct in_conninfo *inc, u_int8_t *cookie)
+{
+	struct hc_metrics *hc_entry;
+	int len;
+
+	hc_entry = tcp_hc_lookup(inc);
+	if (hc_entry == NULL) {
+		return 0;
+	}
+	hc_entry->rmx_hits++;
+	hc_entry->rmx_expire = V_tcp_hostcache.expire; /* start over again */
+
+	len = hc_entry->rmx_tfo_cookie_len;
+	bcopy(hc_entry->rmx_tfo_cookie, cookie, len);
+	THC_UNLOCK(&hc_entry->rmx_head->hch_mtx);
+	return len;
+}
+
+/*
+ * External function: remember the TCP Fast Open cookie of a host, or
+ * forget it if len is 0.  Creates a new entry if none was found.
+ */
+void
+tcp_hc_updatetfo(struct in_conninfo *inc, u_int8_t *cookie, u_int len)
+{
+	struct hc_metrics *hc_entry;
+
+	KASSERT(len <= TCP_FASTOPEN_MAX_COOKIE_LEN,
+	    ("%s: TFO cookie too long", __func__));
+
+	hc_entry = tcp_hc_lookup(inc);
+	if (hc_entry == NULL) {
+		if (len == 0)
+			return;
+		hc_entry = tcp_hc_insert(inc);
+		if (hc_entry == NULL)
+			return;
+	}
+	hc_entry->rmx_updates++;
+	hc_entry->rmx_expire = V_tcp_hostcache.expire; /* start over again */
+
+	hc_entry->rmx_tfo_cookie_len = len;
+	bcopy(cookie, hc_entry->rmx_tfo_cookie, len);
+
+	THC_UNLOCK(&hc_entry->rmx_head->hch_mtx);
+}
+
 /*
  * External function: update the TCP metrics of an entry in the hostcache.
  * Creates a new entry if none was found.
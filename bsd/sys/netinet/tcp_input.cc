@@ -83,6 +83,7 @@
 #include <bsd/sys/netinet/tcp_var.h>
 #include <bsd/sys/netinet/tcpip.h>
 #include <bsd/sys/netinet/tcp_syncache.h>
+#include <bsd/sys/netinet/tcp_fastopen.h>
 #ifdef TCPDEBUG
 #include <netinet/tcp_debug.h>
 #endif /* TCPDEBUG */
@@ -772,6 +773,7 @@ relocked:
 				rstreason = BANDLIM_RST_OPENPORT;
 				goto dropwithreset;
 			}
+tfo_socket_result:
 			if (so == NULL) {
 				/*
 				 * We completed the 3-way handshake
@@ -938,7 +940,12 @@ relocked:
 			    (void *)tcp_saveipgen, &tcp_savetcp, 0);
 #endif
 		tcp_dooptions(&to, optp, optlen, TO_SYN);
-		syncache_add(&inc, &to, th, inp, &so, m);
+		/*
+		 * A SYN with a valid TCP Fast Open cookie creates the
+		 * connection right away; process the SYN and its data on it.
+		 */
+		if (syncache_add(&inc, &to, th, inp, &so, m))
+			goto tfo_socket_result;
 		/*
 		 * Entry added to syncache and mbuf consumed.
 		 * Everything already unlocked by syncache_add().
@@ -1012,7 +1019,7 @@ tcp_do_segment(struct mbuf *m, struct tcphdr *th, struct socket *so,
     struct tcpcb *tp, int drop_hdrlen, int tlen, uint8_t iptos,
     int ti_locked, bool& want_close)
 {
-	int thflags, acked, ourfinisacked, needoutput = 0;
+	int thflags, acked, ourfinisacked, needoutput = 0, tfo_syn;
 	int rstreason, todrop, win;
 	u_long tiwin;
 	struct tcpopt to;
@@ -1452,6 +1459,24 @@ tcp_do_segment(struct mbuf *m, struct tcphdr *th, struct socket *so,
 				rstreason = BANDLIM_RST_OPENPORT;
 				goto dropwithreset;
 		}
+		if (tp->t_flags & TF_FASTOPEN) {
+			/*
+			 * A TCP Fast Open connection in SYN_RECEIVED has only
+			 * seen the initial SYN; the valid segments now are
+			 * a copy of it (possibly with part of its data), the
+			 * ACK of our SYN|ACK, a FIN or a RST.
+			 */
+			if ((thflags & (TH_SYN|TH_ACK)) == (TH_SYN|TH_ACK)) {
+				rstreason = BANDLIM_RST_OPENPORT;
+				goto dropwithreset;
+			} else if (thflags & TH_SYN) {
+				/* Only the initial SYN is processed */
+				if (tcp_timer_active(tp, TT_DELACK) ||
+				    tcp_timer_active(tp, TT_REXMT))
+					goto drop;
+			} else if (!(thflags & (TH_ACK|TH_FIN|TH_RST)))
+				goto drop;
+		}
 		break;
 
 	/*
@@ -1497,6 +1522,27 @@ tcp_do_segment(struct mbuf *m, struct tcphdr *th, struct socket *so,
 			tp->rcv_adv += imin(tp->rcv_wnd,
 			    TCP_MAXWIN << tp->rcv_scale);
 			tp->snd_una++;		/* SYN is acked */
+			if (tp->t_flags & TF_FASTOPEN) {
+				if (to.to_flags & TOF_FASTOPEN)
+					tcp_fastopen_update_cache(tp,
+					    to.to_tfo_cookie, to.to_tfo_len);
+				if (tp->snd_max > tp->iss + 1) {
+					if (th->th_ack == tp->snd_max)
+						TCPSTAT_INC(tcps_tfo_active);
+					else {
+						/*
+						 * The data sent with our SYN
+						 * was not accepted; send it
+						 * again.
+						 */
+						if (to.to_flags & TOF_FASTOPEN)
+							TCPSTAT_INC(tcps_tfo_active_fail);
+						else
+							tcp_fastopen_disable_path(tp);
+						tp->snd_nxt = th->th_ack;
+					}
+				}
+			}
 			/*
 			 * If there's data, delay ACK; if there's also a FIN
 			 * ACKNOW will be turned on later.
@@ -1893,8 +1939,19 @@ tcp_do_segment(struct mbuf *m, struct tcphdr *th, struct socket *so,
 	 */
 	if ((thflags & TH_ACK) == 0) {
 		if (tp->get_state() == TCPS_SYN_RECEIVED ||
-		    (tp->t_flags & TF_NEEDSYN))
+		    (tp->t_flags & TF_NEEDSYN)) {
+			if (tp->get_state() == TCPS_SYN_RECEIVED &&
+			    (tp->t_flags & TF_FASTOPEN)) {
+				/*
+				 * The initial SYN of a TCP Fast Open
+				 * connection: we may send data before
+				 * the handshake completes.
+				 */
+				tp->snd_wnd = tiwin;
+				cc_conn_init(tp);
+			}
 			goto step6;
+		}
 		else if (tp->t_flags & TF_ACKNOW)
 			goto dropafterack;
 		else
@@ -1914,8 +1971,11 @@ tcp_do_segment(struct mbuf *m, struct tcphdr *th, struct socket *so,
 	case TCPS_SYN_RECEIVED:
 
 		TCPSTAT_INC(tcps_connects);
-		SOCK_LOCK(so);
-		soisconnected(so);
+		/* A TCP Fast Open connection was handed out already */
+		if (!(tp->t_flags & TF_FASTOPEN)) {
+			SOCK_LOCK(so);
+			soisconnected(so);
+		}
 		/* Do window scaling? */
 		if ((tp->t_flags & (TF_RCVD_SCALE|TF_REQ_SCALE)) ==
 			(TF_RCVD_SCALE|TF_REQ_SCALE)) {
@@ -1934,9 +1994,14 @@ tcp_do_segment(struct mbuf *m, struct tcphdr *th, struct socket *so,
 		} else {
 			tp->set_state(TCPS_ESTABLISHED);
 			tcp_setup_net_channel(tp, m->M_dat.MH.MH_pkthdr.rcvif);
-			cc_conn_init(tp);
+			if (!(tp->t_flags & TF_FASTOPEN))
+				cc_conn_init(tp);
 			tcp_timer_activate(tp, TT_KEEP, TP_KEEPIDLE(tp));
 		}
+		if (tp->t_tfo_pending != NULL) {
+			tcp_fastopen_decrement_counter(tp->t_tfo_pending);
+			tp->t_tfo_pending = NULL;
+		}
 		/*
 		 * If segment contains data or ACK, will call tcp_reass()
 		 * later; if not, do so now to pass queued data to user.
@@ -2397,6 +2462,9 @@ step6:
 dodata:							/* XXX */
 	INP_LOCK_ASSERT(tp->t_inpcb);
 
+	tfo_syn = (tp->get_state() == TCPS_SYN_RECEIVED &&
+	    (tp->t_flags & TF_FASTOPEN));
+
 	/*
 	 * Process the segment text, merging it into the TCP sequencing queue,
 	 * and arranging for acknowledgment of receipt if necessary.
@@ -2405,7 +2473,7 @@ dodata:							/* XXX */
 	 * case PRU_RCVD).  If a FIN has already been received on this
 	 * connection then we just ignore the text.
 	 */
-	if ((tlen || (thflags & TH_FIN)) &&
+	if ((tlen || (thflags & TH_FIN) || tfo_syn) &&
 	    TCPS_HAVERCVDFIN(tp->get_state()) == 0) {
 		tcp_seq save_start = th->th_seq;
 		m_adj(m, drop_hdrlen);	/* delayed header drop */
@@ -2423,8 +2491,12 @@ dodata:							/* XXX */
 		 */
 		if (th->th_seq == tp->rcv_nxt &&
 		    LIST_EMPTY(&tp->t_segq) &&
-		    TCPS_HAVEESTABLISHED(tp->get_state())) {
-			if (DELAY_ACK(tp))
+		    (TCPS_HAVEESTABLISHED(tp->get_state()) || tfo_syn)) {
+			/*
+			 * Delay the SYN|ACK of a TCP Fast Open connection,
+			 * so that it may carry the application's response.
+			 */
+			if (DELAY_ACK(tp) || tfo_syn)
 				tp->t_flags |= TF_DELACK;
 			else
 				tp->t_flags |= TF_ACKNOW;
@@ -2724,6 +2796,25 @@ tcp_dooptions(struct tcpopt *to, u_char *cp, int cnt, int flags)
 			to->to_sacks = cp + 2;
 			TCPSTAT_INC(tcps_sack_rcv_blocks);
 			break;
+		case TCPOPT_FAST_OPEN:
+			/*
+			 * A cookie request is just the option header; a
+			 * cookie, if present, is 4 to 16 bytes long.
+			 */
+			if (optlen != TCPOLEN_FAST_OPEN_EMPTY &&
+			    (optlen < TCPOLEN_FAST_OPEN_EMPTY +
+			     TCP_FASTOPEN_MIN_COOKIE_LEN ||
+			     optlen > TCPOLEN_FAST_OPEN_EMPTY +
+			     TCP_FASTOPEN_MAX_COOKIE_LEN))
+				continue;
+			if (!(flags & TO_SYN))
+				continue;
+			if (!V_tcp_fastopen_mode)
+				continue;
+			to->to_flags |= TOF_FASTOPEN;
+			to->to_tfo_len = optlen - TCPOLEN_FAST_OPEN_EMPTY;
+			to->to_tfo_cookie = to->to_tfo_len ? cp + 2 : NULL;
+			break;
 		default:
 			continue;
 		}
@@ -253,6 +253,16 @@ tcp_output(struct tcpcb *tp)
 
 	INP_LOCK_ASSERT(tp->t_inpcb);
 
+	/*
+	 * Until the handshake of a TCP Fast Open connection completes, only
+	 * the initial SYN (or SYN|ACK) and its retransmissions are sent.
+	 */
+	if ((tp->t_flags & TF_FASTOPEN) &&
+	    (tp->get_state() == TCPS_SYN_SENT ||
+	     tp->get_state() == TCPS_SYN_RECEIVED) &&
+	    tp->snd_max > tp->snd_una && tp->snd_nxt != tp->snd_una)
+		return (0);
+
 	/*
 	 * Determine length of data that should be transmitted,
 	 * and flags that will be used.
@@ -459,6 +469,18 @@ after_sack_rexmit:
 		flags &= ~TH_FIN;
 	}
 
+	/*
+	 * TCP Fast Open: no data with a cookie request, nor with a
+	 * retransmitted SYN, since a middlebox may be dropping SYNs
+	 * with data.
+	 */
+	if ((tp->t_flags & TF_FASTOPEN) && (flags & TH_SYN) &&
+	    (tp->t_rxtshift > 0 || (tp->get_state() == TCPS_SYN_SENT &&
+	     tp->t_tfo_client_cookie_len == 0))) {
+		len = 0;
+		flags &= ~TH_FIN;
+	}
+
 	if (len < 0) {
 		/*
 		 * If FIN has been sent but not acked,
@@ -834,6 +856,13 @@ send:
 		if (tp->t_flags & TF_SIGNATURE)
 			to.to_flags |= TOF_SIGNATURE;
 #endif /* TCP_SIGNATURE */
+		/* TCP Fast Open cookie, or cookie request. */
+		if ((flags & TH_SYN) && (tp->t_flags & TF_FASTOPEN) &&
+		    tp->get_state() == TCPS_SYN_SENT) {
+			to.to_tfo_len = tp->t_tfo_client_cookie_len;
+			to.to_tfo_cookie = tp->t_tfo_cookie;
+			to.to_flags |= TOF_FASTOPEN;
+		}
 
 		/* Processing the options. */
 		hdrlen += optlen = tcp_addoptions(&to, opt);
@@ -1643,6 +1672,24 @@ tcp_addoptions(struct tcpopt *to, u_char *optp)
 			TCPSTAT_INC(tcps_sack_send_blocks);
 			break;
 			}
+		case TOF_FASTOPEN:
+			{
+			int total_len;
+
+			total_len = TCPOLEN_FAST_OPEN_EMPTY + to->to_tfo_len;
+			if (TCP_MAXOLEN - optlen < total_len) {
+				to->to_flags &= ~TOF_FASTOPEN;
+				continue;
+			}
+			*optp++ = TCPOPT_FAST_OPEN;
+			*optp++ = total_len;
+			if (to->to_tfo_len > 0) {
+				bcopy(to->to_tfo_cookie, optp, to->to_tfo_len);
+				optp += to->to_tfo_len;
+			}
+			optlen += total_len;
+			break;
+			}
 		default:
 			panic("%s: unknown TCP option type", __func__);
 			break;
@@ -69,6 +69,7 @@
 #include <bsd/sys/netinet/tcp_timer.h>
 #include <bsd/sys/netinet/tcp_var.h>
 #include <bsd/sys/netinet/tcp_syncache.h>
+#include <bsd/sys/netinet/tcp_fastopen.h>
 #ifdef INET6
 #include <bsd/sys/netinet6/tcp6_var.h>
 #endif
@@ -278,6 +279,7 @@ tcp_init(void)
 	tcp_tw_init();
 	syncache_init();
 	tcp_hc_init();
+	tcp_fastopen_init();
 	tcp_reass_init();
 
 	TUNABLE_INT_FETCH("net.inet.tcp.sack.enable", &V_tcp_do_sack);
@@ -877,6 +879,12 @@ tcp_discardcb(struct tcpcb *tp)
 
 	tcp_free_net_channel(tp);
 
+	/* Drop our reference to the pending TFO connection counter */
+	if (tp->t_tfo_pending != NULL) {
+		tcp_fastopen_decrement_counter(tp->t_tfo_pending);
+		tp->t_tfo_pending = NULL;
+	}
+
 	/* Allow the CC algorithm to clean up after itself. */
 	if (CC_ALGO(tp)->cb_destroy != NULL)
 		CC_ALGO(tp)->cb_destroy(tp->ccv);
@@ -948,6 +948,39 @@ failed:
 	return (0);
 }
 
+/*
+ * Create the connection for a SYN carrying a valid TCP Fast Open cookie.
+ * It is handed to the application right away, even though our SYN|ACK
+ * has not been sent yet: tcp_output() sends it once the SYN's data has
+ * been queued, so that the application's reply may go along with it.
+ */
+static void
+syncache_tfo_expand(struct syncache *sc, struct socket **lsop, struct mbuf *m,
+	u_int *pending)
+{
+	struct inpcb *inp;
+	struct tcpcb *tp;
+
+	*lsop = syncache_socket(sc, *lsop, m);
+	if (*lsop == NULL) {
+		TCPSTAT_INC(tcps_sc_aborted);
+		tcp_fastopen_decrement_counter(pending);
+		return;
+	}
+	inp = sotoinpcb(*lsop);
+	INP_LOCK(inp);
+	tp = intotcpcb(inp);
+	tp->t_flags |= TF_FASTOPEN;
+	tp->t_tfo_pending = pending;
+	tp->snd_max = tp->iss;
+	tp->snd_nxt = tp->iss;
+	SOCK_LOCK(*lsop);
+	soisconnected(*lsop);
+	INP_UNLOCK(inp);
+	TCPSTAT_INC(tcps_sc_completed);
+	TCPSTAT_INC(tcps_tfo_passive);
+}
+
 /*
  * Given a LISTEN socket and an inbound SYN request, add
  * this to the syn cache, and send back a segment:
@@ -960,8 +993,15 @@ failed:
  * DoS attack, an attacker could send data which would eventually
  * consume all available buffer space if it were ACKed.  By not ACKing
  * the data, we avoid this DoS scenario.
+ *
+ * The exception is a SYN carrying a valid TCP Fast Open cookie: then the
+ * connection is created right away, in SYN_RECEIVED state, and 1 is
+ * returned with *lsop pointing to the new socket (or NULL if it could not
+ * be created).  The caller then processes the SYN and its data on the new
+ * socket; the mbuf is not consumed and no locks are dropped.  Otherwise
+ * 0 is returned, the mbuf is consumed and everything is unlocked.
  */
-static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
+static int _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 	struct tcphdr *th, struct inpcb *inp, struct socket **lsop, struct mbuf *m,
 	struct toe_usrreqs *tu, void *toepcb)
 {
@@ -974,6 +1014,9 @@ static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 	u_int ltflags;
 	int win, sb_hiwat, ip_ttl, ip_tos;
 	char *s;
+	int tfo_cookie_valid = 0, tfo_response_cookie_valid = 0;
+	u_int8_t tfo_cookie[TCP_FASTOPEN_COOKIE_LEN];
+	u_int *tfo_pending = NULL;
 #ifdef INET6
 	int autoflowlabel = 0;
 #endif
@@ -1005,6 +1048,28 @@ static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 	sb_hiwat = so->so_rcv.sb_hiwat;
 	ltflags = (tp->t_flags & (TF_NOOPT | TF_SIGNATURE));
 
+	/*
+	 * TCP Fast Open: a valid cookie lets the SYN's data through, as long
+	 * as the listener's TFO queue has room.  Any other SYN asking for
+	 * TFO gets its cookie in the SYN|ACK.
+	 */
+	if ((V_tcp_fastopen_mode & TFO_SERVER_ENABLE) &&
+	    (tp->t_flags & TF_FASTOPEN) && tp->t_tfo_pending != NULL &&
+	    (to->to_flags & TOF_FASTOPEN) && !(ltflags & TF_NOOPT)) {
+		tfo_response_cookie_valid = 1;
+		if (tcp_fastopen_check_cookie(inc, to->to_tfo_cookie,
+		    to->to_tfo_len, tfo_cookie)) {
+			/* The counter includes the listener's own reference */
+			if (*tp->t_tfo_pending - 1 < tp->t_tfo_qlen) {
+				atomic_add_int(tp->t_tfo_pending, 1);
+				tfo_pending = tp->t_tfo_pending;
+				tfo_cookie_valid = 1;
+			} else
+				TCPSTAT_INC(tcps_tfo_overflow);
+		} else if (to->to_tfo_len != 0)
+			TCPSTAT_INC(tcps_tfo_passive_fail);
+	}
+
 	/* By the time we drop the lock these should no longer be used. */
 	so = NULL;
 	tp = NULL;
@@ -1017,8 +1082,11 @@ static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 	} else
 	mac_syncache_create(maclabel, inp);
 #endif
-	INP_UNLOCK(inp);
-	INP_INFO_WUNLOCK(&V_tcbinfo);
+	/* A TFO connection is created below, under the same locks */
+	if (!tfo_cookie_valid) {
+		INP_UNLOCK(inp);
+		INP_INFO_WUNLOCK(&V_tcbinfo);
+	}
 
 	/*
 	 * Remember the IP options, if any.
@@ -1048,6 +1116,13 @@ static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 	SCH_LOCK_ASSERT(sch);
 	if (sc != NULL ) {
 		TCPSTAT_INC(tcps_sc_dupsyn);
+		if (tfo_cookie_valid) {
+			/* Already handshaking without TFO, carry on that way */
+			tcp_fastopen_decrement_counter(tfo_pending);
+			tfo_cookie_valid = 0;
+			INP_UNLOCK(inp);
+			INP_INFO_WUNLOCK(&V_tcbinfo);
+		}
 		if (ipopts) {
 			/*
 			 * If we were remembering a previous source route,
@@ -1088,6 +1163,13 @@ static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 		goto done;
 	}
 
+	/* A TFO connection needs no syncache entry */
+	if (tfo_cookie_valid) {
+		bzero(&scs, sizeof(scs));
+		sc = &scs;
+		goto skip_alloc;
+	}
+
 	sc = (syncache *)uma_zalloc(V_tcp_syncache.zone, M_NOWAIT | M_ZERO);
 	if (sc == NULL ) {
 		/*
@@ -1112,6 +1194,7 @@ static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 		}
 	}
 
+skip_alloc:
 	/*
 	 * Fill in the syncache values.
 	 */
@@ -1204,8 +1287,12 @@ static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 		sc->sc_flags |= SCF_NOOPT;
 	if ((th->th_flags & (TH_ECE | TH_CWR)) && V_tcp_do_ecn)
 		sc->sc_flags |= SCF_ECN;
+	if (tfo_response_cookie_valid && !tfo_cookie_valid) {
+		bcopy(tfo_cookie, sc->sc_tfo_cookie, sizeof(sc->sc_tfo_cookie));
+		sc->sc_flags |= SCF_TFO;
+	}
 
-	if (V_tcp_syncookies) {
+	if (V_tcp_syncookies && !tfo_cookie_valid) {
 		syncookie_generate(sch, sc, &flowtmp);
 #ifdef INET6
 		if (autoflowlabel)
@@ -1220,6 +1307,13 @@ static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 	}
 	SCH_UNLOCK(sch);
 
+	if (tfo_cookie_valid) {
+		syncache_tfo_expand(sc, lsop, m, tfo_pending);
+		if (sc->sc_ipopts)
+			(void)m_free(sc->sc_ipopts);
+		return (1);
+	}
+
 	/*
 	 * Do a standard 3-way handshake.
 	 */
@@ -1246,6 +1340,7 @@ static void _syncache_add(struct in_conninfo *inc, struct tcpopt *to,
 		*lsop = NULL;
 		m_freem(m);
 	}
+	return (0);
 }
 
 static int syncache_respond(struct syncache *sc)
@@ -1372,6 +1467,12 @@ static int syncache_respond(struct syncache *sc)
 		if (sc->sc_flags & SCF_SIGNATURE)
 		to.to_flags |= TOF_SIGNATURE;
 #endif
+		if (sc->sc_flags & SCF_TFO) {
+			to.to_tfo_len = TCP_FASTOPEN_COOKIE_LEN;
+			to.to_tfo_cookie = sc->sc_tfo_cookie;
+			to.to_flags |= TOF_FASTOPEN;
+			TCPSTAT_INC(tcps_tfo_cookie_sent);
+		}
 		optlen = tcp_addoptions(&to, (u_char *)(th + 1));
 
 		/* Adjust headers by option size. */
@@ -1418,10 +1519,28 @@ static int syncache_respond(struct syncache *sc)
 	return (error);
 }
 
-void syncache_add(struct in_conninfo *inc, struct tcpopt *to, struct tcphdr *th,
+int syncache_add(struct in_conninfo *inc, struct tcpopt *to, struct tcphdr *th,
 	struct inpcb *inp, struct socket **lsop, struct mbuf *m)
 {
-	_syncache_add(inc, to, th, inp, lsop, m, NULL, NULL );
+	return _syncache_add(inc, to, th, inp, lsop, m, NULL, NULL );
+}
+
+/*
+ * SYN cookie mode, as in Linux's net.ipv4.tcp_syncookies: 0 disables SYN
+ * cookies, 1 uses them when the syncache overflows, and 2 uses them for
+ * every connection without keeping syncache entries at all.
+ */
+int syncache_get_cookies(void)
+{
+	if (!V_tcp_syncookies)
+		return (0);
+	return (V_tcp_syncookiesonly ? 2 : 1);
+}
+
+void syncache_set_cookies(int mode)
+{
+	V_tcp_syncookies = (mode != 0);
+	V_tcp_syncookiesonly = (mode >= 2);
 }
 
 /*
@@ -35,6 +35,7 @@
 
 #include <sys/cdefs.h>
 #include <osv/async.hh>
+#include <bsd/sys/netinet/tcp_fastopen.h>
 
 __BEGIN_DECLS
 
@@ -49,12 +50,14 @@ void	syncache_destroy(void);
 void	 syncache_unreach(struct in_conninfo *, struct tcphdr *);
 int	 syncache_expand(struct in_conninfo *, struct tcpopt *,
 	     struct tcphdr *, struct socket **, struct mbuf *);
-void	 syncache_add(struct in_conninfo *, struct tcpopt *,
+int	 syncache_add(struct in_conninfo *, struct tcpopt *,
 	     struct tcphdr *, struct inpcb *, struct socket **, struct mbuf *);
 
 void	 syncache_chkrst(struct in_conninfo *, struct tcphdr *);
 void	 syncache_badack(struct in_conninfo *);
 int	 syncache_pcbcount(void);
+int	 syncache_get_cookies(void);
+void	 syncache_set_cookies(int);
 #if 0
 int	 syncache_pcblist(struct sysctl_req *req, int max_pcbs, int *pcbs_exported);
 #endif
@@ -83,6 +86,8 @@ struct syncache {
 	void		*sc_toepcb;		/* TOE protocol block */
 #endif			
 
+	u_int8_t	sc_tfo_cookie[TCP_FASTOPEN_COOKIE_LEN]; /* TFO cookie to send */
+
 	u_int32_t	sc_spare[2];		/* UTO */
 };
 
@@ -97,6 +102,7 @@ struct syncache {
 #define SCF_SIGNATURE	0x20			/* send MD5 digests */
 #define SCF_SACK	0x80			/* send SACK option */
 #define SCF_ECN		0x100			/* send ECN setup packet */
+#define SCF_TFO		0x200			/* send TCP Fast Open cookie */
 
 #define	SYNCOOKIE_SECRET_SIZE	8	/* dwords */
 #define	SYNCOOKIE_LIFETIME	16	/* seconds */
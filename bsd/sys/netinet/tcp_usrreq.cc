@@ -78,6 +78,7 @@
 #include <bsd/sys/netinet/tcp_timer.h>
 #include <bsd/sys/netinet/tcp_var.h>
 #include <bsd/sys/netinet/tcpip.h>
+#include <bsd/sys/netinet/tcp_fastopen.h>
 #ifdef TCPDEBUG
 #include <bsd/sys/netinet/tcp_debug.h>
 #endif
@@ -816,6 +817,15 @@ tcp_usr_send(struct socket *so, int flags, struct mbuf *m,
 				goto out;
 			tp->snd_wnd = TTCP_CLIENT_SND_WND;
 			tcp_mss(tp, -1);
+			/*
+			 * TCP Fast Open: send the data with the SYN if we
+			 * have a cookie for the peer, else ask for one.
+			 */
+			if ((flags & PRUS_FASTOPEN) &&
+			    (V_tcp_fastopen_mode & TFO_CLIENT_ENABLE)) {
+				tp->t_flags |= TF_FASTOPEN;
+				tcp_fastopen_connect(tp);
+			}
 		}
 		if (flags & PRUS_EOF) {
 			/*
@@ -1492,6 +1502,40 @@ tcp_ctloutput(struct socket *so, struct sockopt *sopt)
 			INP_UNLOCK(inp);
 			break;
 
+		case TCP_FASTOPEN:
+			/*
+			 * On a listen socket, the maximum number of TCP Fast
+			 * Open connections which have not yet completed the
+			 * 3-way handshake; 0 disables TFO.
+			 */
+			INP_UNLOCK(inp);
+			error = sooptcopyin(sopt, &optval, sizeof optval,
+			    sizeof optval);
+			if (error)
+				return (error);
+
+			INP_LOCK_RECHECK(inp);
+			if (optval < 0 || (tp->get_state() != TCPS_CLOSED &&
+			    tp->get_state() != TCPS_LISTEN)) {
+				INP_UNLOCK(inp);
+				error = EINVAL;
+				break;
+			}
+			if (optval > 0) {
+				if (tp->t_tfo_pending == NULL)
+					tp->t_tfo_pending =
+					    tcp_fastopen_alloc_counter();
+				if (tp->t_tfo_pending == NULL)
+					error = ENOMEM;
+				else {
+					tp->t_tfo_qlen = optval;
+					tp->t_flags |= TF_FASTOPEN;
+				}
+			} else
+				tp->t_flags &= ~TF_FASTOPEN;
+			INP_UNLOCK(inp);
+			break;
+
 		default:
 			INP_UNLOCK(inp);
 			error = ENOPROTOOPT;
@@ -1556,6 +1600,12 @@ tcp_ctloutput(struct socket *so, struct sockopt *sopt)
 			INP_UNLOCK(inp);
 			error = sooptcopyout(sopt, &optval, sizeof optval);
 			break;
+		case TCP_FASTOPEN:
+			optval = (tp->t_flags & TF_FASTOPEN) &&
+			    tp->get_state() <= TCPS_LISTEN ? tp->t_tfo_qlen : 0;
+			INP_UNLOCK(inp);
+			error = sooptcopyout(sopt, &optval, sizeof optval);
+			break;
 		default:
 			INP_UNLOCK(inp);
 			error = ENOPROTOOPT;
@@ -224,6 +224,12 @@ public:
 	net_channel* nc;
 	struct ifnet* nc_intf;
 
+/* TCP Fast Open (RFC 7413) */
+	u_int	*t_tfo_pending;		/* TFO connections not yet established */
+	u_int	t_tfo_qlen;		/* listener: limit on *t_tfo_pending */
+	u_int8_t t_tfo_client_cookie_len; /* client cookie, 0 requests one */
+	u_int8_t t_tfo_cookie[TCP_FASTOPEN_MAX_COOKIE_LEN];
+
 	uint32_t t_ispare[8];		/* 5 UTO, 3 TBD */
 	void	*t_pspare2[4];		/* 4 TBD */
 	uint64_t _pad[6];		/* 6 TBD (1-2 CC/RTT?) */
@@ -273,6 +279,7 @@ public:
 #define	TF_ECN_SND_ECE	0x10000000	/* ECN ECE in queue */
 #define	TF_CONGRECOVERY	0x20000000	/* congestion recovery mode */
 #define	TF_WASCRECOVERY	0x40000000	/* was in congestion recovery */
+#define	TF_FASTOPEN	0x80000000	/* TCP Fast Open requested */
 
 #define	IN_FASTRECOVERY(t_flags)	(t_flags & TF_FASTRECOVERY)
 #define	ENTER_FASTRECOVERY(t_flags)	t_flags |= TF_FASTRECOVERY
@@ -325,7 +332,8 @@ struct tcpopt {
 #define	TOF_TS		0x0010		/* timestamp */
 #define	TOF_SIGNATURE	0x0040		/* TCP-MD5 signature option (RFC2385) */
 #define	TOF_SACK	0x0080		/* Peer sent SACK option */
-#define	TOF_MAXOPT	0x0100
+#define	TOF_FASTOPEN	0x0100		/* TCP Fast Open (TFO) cookie */
+#define	TOF_MAXOPT	0x0200
 	u_int32_t	to_tsval;	/* new timestamp */
 	u_int32_t	to_tsecr;	/* reflected timestamp */
 	u_char		*to_sacks;	/* pointer to the first SACK blocks */
@@ -333,6 +341,8 @@ struct tcpopt {
 	u_int16_t	to_mss;		/* maximum segment size */
 	u_int8_t	to_wscale;	/* window scaling */
 	u_int8_t	to_nsacks;	/* number of SACK blocks */
+	u_int8_t	to_tfo_len;	/* TFO cookie length */
+	u_char		*to_tfo_cookie;	/* pointer to the TFO cookie */
 	u_int32_t	to_spare;	/* UTO */
 };
 
@@ -526,7 +536,16 @@ struct	tcpstat {
 	u_long	tcps_sig_err_sigopt;	/* No signature expected by socket */
 	u_long	tcps_sig_err_nosigopt;	/* No signature provided by segment */
 
-	u_long	_pad[12];		/* 6 UTO, 6 TBD */
+	/* TCP Fast Open (RFC 7413) */
+	u_long	tcps_tfo_active;	/* our SYN data was acked */
+	u_long	tcps_tfo_active_fail;	/* our SYN data was not acked */
+	u_long	tcps_tfo_cookie_req;	/* cookie requests sent */
+	u_long	tcps_tfo_passive;	/* SYNs accepted with a valid cookie */
+	u_long	tcps_tfo_passive_fail;	/* SYNs with an invalid cookie */
+	u_long	tcps_tfo_cookie_sent;	/* cookies sent in SYN|ACKs */
+	u_long	tcps_tfo_overflow;	/* TFO refused, too many pending */
+
+	u_long	_pad[5];		/* 5 TBD */
 };
 
 #ifdef _KERNEL
@@ -747,6 +766,8 @@ void	 tcp_hc_get(struct in_conninfo *, struct hc_metrics_lite *);
 u_long	 tcp_hc_getmtu(struct in_conninfo *);
 void	 tcp_hc_updatemtu(struct in_conninfo *, u_long);
 void	 tcp_hc_update(struct in_conninfo *, struct hc_metrics_lite *);
+int	 tcp_hc_gettfo(struct in_conninfo *, u_int8_t *);
+void	 tcp_hc_updatetfo(struct in_conninfo *, u_int8_t *, u_int);
 
 extern	struct pr_usrreqs tcp_usrreqs;
 extern	u_long tcp_sendspace;
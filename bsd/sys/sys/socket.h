@@ -113,6 +113,7 @@
 #define	SO_SETFIB	0x1014		/* use this FIB to route */
 #define	SO_USER_COOKIE	0x1015		/* user cookie (dummynet etc.) */
 #define	SO_PROTOCOL	0x1016		/* get socket protocol (Linux name) */
+#define	SO_BUSY_POLL	0x1017		/* busy poll budget, usecs (Linux name) */
 #define	SO_PROTOTYPE	SO_PROTOCOL	/* alias for SO_PROTOCOL (SunOS name) */
 #endif
 
@@ -403,6 +404,8 @@ struct sockproto {
 #endif
 #if __BSD_VISIBLE
 #define	MSG_NOSIGNAL	0x20000		/* do not generate SIGPIPE on EOF */
+#define	MSG_WAITFORONE	0x80000		/* for recvmmsg() */
+#define	MSG_FASTOPEN	0x100000	/* send data in SYN (TCP Fast Open) */
 #endif
 
 #if __BSD_VISIBLE
@@ -121,6 +121,8 @@ struct socket {
 	 */
 	int so_fibnum;		/* routing domain for this socket */
 	uint32_t so_user_cookie;
+	u_int	so_busy_poll;		/* SO_BUSY_POLL budget, usecs */
+	u_short	so_rcv_ifindex;		/* interface data last came in on */
 	net_channel* so_nc = nullptr;
 	// a net channel only supports one consumer, so let others wait on a waitqueue instead
 	bool so_nc_busy = false;
@@ -353,6 +355,11 @@ int	soreceive_stream(struct socket *so, struct bsd_sockaddr **paddr,
 int	soreceive_dgram(struct socket *so, struct bsd_sockaddr **paddr,
 	    struct uio *uio, struct mbuf **mp0, struct mbuf **controlp,
 	    int *flagsp);
+int	soreceive_dgram_dequeue(struct socket *so, int flags, ssize_t resid,
+	    int max, struct mbuf **recordsp, int *countp);
+int	soreceive_dgram_record(struct socket *so, struct mbuf *m,
+	    struct bsd_sockaddr **paddr, struct uio *uio, struct mbuf **controlp,
+	    int flags, int *flagsp);
 int	soreceive_generic(struct socket *so, struct bsd_sockaddr **paddr,
 	    struct uio *uio, struct mbuf **mp0, struct mbuf **controlp,
 	    int *flagsp);
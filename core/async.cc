@@ -31,6 +31,7 @@ TRACEPOINT(trace_async_timer_task_fire, "timer=%x, task=%x", timer_task*, percpu
 TRACEPOINT(trace_async_timer_task_misfire, "timer=%x, task=%x", timer_task*, percpu_timer_task*);
 TRACEPOINT(trace_async_timer_task_insert, "worker=%x, task=%x", async_worker*, percpu_timer_task*);
 TRACEPOINT(trace_async_timer_task_remove, "worker=%x, task=%x", async_worker*, percpu_timer_task*);
+TRACEPOINT(trace_async_serial_timer_task_postpone, "timer=%x, delay=%d", serial_timer_task*, u64);
 
 TRACEPOINT(trace_async_worker_started, "worker=%x", async_worker*);
 TRACEPOINT(trace_async_worker_timer_fire, "worker=%x, percpu=%x, delay=%u", async_worker*, percpu_timer_task*, u64);
@@ -390,14 +391,29 @@ void serial_timer_task::reschedule(clock::duration delay)
 {
     assert(_lock.owned());
 
-    if (_task.reschedule(delay)) {
+    auto deadline = clock::now() + delay;
+    _deadline = deadline;
+
+    if (_active && _task.is_pending() && _armed_at <= deadline) {
+        // Postponed; try_fire() takes care of the difference.
+        trace_async_serial_timer_task_postpone(this, delay.count());
+        return;
+    }
+
+    if (_task.reschedule(deadline)) {
         _n_scheduled--;
     }
 
+    _armed_at = deadline;
     _n_scheduled++;
     _active = true;
 }
 
+bool serial_timer_task::fired_early()
+{
+    return !_task.is_pending() && _active && clock::now() < _deadline;
+}
+
 void serial_timer_task::cancel()
 {
     assert(_lock.owned());
@@ -430,13 +446,21 @@ bool serial_timer_task::is_active()
 bool serial_timer_task::can_fire()
 {
     assert(_lock.owned());
-    return !_task.is_pending() && _active;
+    return !_task.is_pending() && _active && clock::now() >= _deadline;
 }
 
 bool serial_timer_task::try_fire()
 {
     assert(_lock.owned());
 
+    if (fired_early()) {
+        // The timer was postponed after it had been armed. Re-arm it in
+        // place of this callback, so _n_scheduled stays the same.
+        _task.reschedule(_deadline);
+        _armed_at = _deadline;
+        return false;
+    }
+
     if (--_n_scheduled == 0) {
         _all_done.wake_all(_lock);
     }
@@ -4,6 +4,7 @@
 #include "drivers/clock.hh"
 #include <osv/barrier.hh>
 #include <osv/boot.hh>
+#include <algorithm>
 
 double boot_time_chart::to_msec(u64 time)
 {
@@ -34,6 +35,18 @@ void boot_time_chart::event(int event_idx, const char *str, u64 stamp)
     arrays[event_idx].stamp = stamp;
 }
 
+void boot_time_chart::span(const char *str, u64 start, u64 end, unsigned cpu)
+{
+    int idx = _span.fetch_add(1, std::memory_order_relaxed);
+    if (idx >= int(sizeof(spans) / sizeof(spans[0]))) {
+        return;
+    }
+    snprintf(spans[idx].str, sizeof(spans[idx].str), "%s", str);
+    spans[idx].start = start;
+    spans[idx].end = end;
+    spans[idx].cpu = cpu;
+}
+
 void boot_time_chart::print_chart()
 {
     if (clock::get()->processor_to_nano(10000) == 0) {
@@ -44,6 +57,13 @@ void boot_time_chart::print_chart()
     for (auto i = 1; i < events; ++i) {
         print_one_time(i);
     }
+    int nr_spans = std::min(_span.load(), int(sizeof(spans) / sizeof(spans[0])));
+    auto initial = arrays[0].stamp;
+    for (auto i = 0; i < nr_spans; ++i) {
+        auto& s = spans[i];
+        printf("\t  %s: %.2fms, (%.2fms on cpu %u)\n", s.str, to_msec(s.start - initial),
+               to_msec(s.end - s.start), s.cpu);
+    }
 }
 
 void boot_time_chart::print_total_time()
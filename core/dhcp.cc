@@ -26,6 +26,7 @@
 #include <osv/debug.hh>
 #include <osv/dhcp.hh>
 #include <osv/clock.hh>
+#include <osv/net_ready.hh>
 #include <libc/network/__dns.hh>
 
 using namespace boost::asio;
@@ -802,6 +803,13 @@ namespace dhcp {
     void dhcp_worker::start(bool wait)
     {
         // FIXME: clear routing table (use case run dhclient 2nd time)
+        if (!wait) {
+            // Keep sending discovers in the background until a lease
+            // arrives, which releases the network ready latch
+            sched::thread::make([this] { _send_and_wait(true, &dhcp_interface_state::discover); },
+                sched::thread::attr().detached().name("dhcp-discover"))->start();
+            return;
+        }
         _send_and_wait(wait, &dhcp_interface_state::discover);
     }
 
@@ -844,6 +852,7 @@ namespace dhcp {
 
             // Check if we got an ip
             if (it->second->is_acknowledged()) {
+                osv::net_ready::set();
                 _have_ip = true;
                 if (_waiter) {
                     _waiter->wake();
@@ -20,6 +20,8 @@
 #include <boost/range/algorithm/find.hpp>
 #include <functional>
 #include <iterator>
+#include <algorithm>
+#include <limits>
 #include <osv/sched.hh>
 #include <osv/trace.hh>
 #include <osv/version.hh>
@@ -33,6 +35,7 @@ TRACEPOINT(trace_elf_load, "%s", const char *);
 TRACEPOINT(trace_elf_unload, "%s", const char *);
 TRACEPOINT(trace_elf_lookup, "%s", const char *);
 TRACEPOINT(trace_elf_lookup_addr, "%p", const void *);
+TRACEPOINT(trace_elf_reloc_cache, "%s", const char *);
 
 using namespace boost::range;
 
@@ -110,6 +113,9 @@ object::object(program& prog, std::string pathname)
     , _dynamic_table(nullptr)
     , _module_index(_prog.register_dtv(this))
     , _is_executable(false)
+    , _fingerprint(0)
+    , _nsyms(0)
+    , _addr_index(nullptr)
     , _visibility(nullptr)
 {
 }
@@ -117,6 +123,7 @@ object::object(program& prog, std::string pathname)
 object::~object()
 {
     _prog.free_dtv(this);
+    delete _addr_index.load(std::memory_order_relaxed);
 }
 
 ulong object::module_index() const
@@ -584,7 +591,10 @@ symbol_module object::symbol(unsigned idx, bool ignore_missing)
     auto sym = &symtab[idx];
     auto nameidx = sym->st_name;
     auto name = dynamic_ptr<const char>(DT_STRTAB) + nameidx;
-    auto ret = _prog.lookup(name);
+    auto ret = cached_symbol(idx, name);
+    if (!ret.symbol) {
+        ret = _prog.lookup(name);
+    }
     auto binding = symbol_binding(*sym);
     if (!ret.symbol && binding == STB_WEAK) {
         return symbol_module(sym, this);
@@ -599,6 +609,30 @@ symbol_module object::symbol(unsigned idx, bool ignore_missing)
     return ret;
 }
 
+// Returns the resolution of symbol idx recorded in the relocation cache, or
+// an empty symbol_module if there is none or it does not hold for name, in
+// which case the symbol has to be looked up.
+symbol_module object::cached_symbol(unsigned idx, const char* name)
+{
+    if (idx >= _cached_resolutions.size()) {
+        return symbol_module();
+    }
+    auto& c = _cached_resolutions[idx];
+    if (c.module >= _cached_modules.size()) {
+        return symbol_module();
+    }
+    auto obj = _cached_modules[c.module];
+    if (c.sym >= obj->_nsyms) {
+        return symbol_module();
+    }
+    auto sym = &obj->dynamic_ptr<Elf64_Sym>(DT_SYMTAB)[c.sym];
+    if (sym->st_shndx == SHN_UNDEF ||
+        strcmp(obj->dynamic_ptr<const char>(DT_STRTAB) + sym->st_name, name) != 0) {
+        return symbol_module();
+    }
+    return symbol_module(sym, obj);
+}
+
 // symbol_other(idx) is similar to symbol(idx), except that the symbol is not
 // looked up in the object itself, just in the other objects.
 symbol_module object::symbol_other(unsigned idx)
@@ -731,15 +765,142 @@ void* object::resolve_pltgot(unsigned index)
     return *static_cast<void**>(addr);
 }
 
+// The relocation cache of an object is a file next to it, which
+// scripts/gen-reloc-cache.py writes when building the image:
+//
+//   char magic[8] = "OSVRELC", u32 version, u32 ncontexts, then ncontexts
+//   times: u32 nmodules, u32 nresolutions,
+//          u64 fingerprints[nmodules], cached_resolution[nresolutions]
+//
+// Each context holds the resolutions of the symbols referenced by the
+// relocations of the object, when it is relocated against the listed
+// modules, in search order. A resolution is the index of the defining
+// module in that list and of the symbol in its symbol table, or ~0u for
+// symbols left to lookup.
+static constexpr char reloc_cache_magic[8] = "OSVRELC";
+static constexpr u32 reloc_cache_version = 1;
+
+u64 object::fingerprint()
+{
+    if (_fingerprint) {
+        return _fingerprint;
+    }
+    _nsyms = dynsym_count();
+    // 64-bit FNV-1a over what symbol lookup depends on: the names, types
+    // and bindings of the symbols and whether they are defined
+    u64 h = 14695981039346656037ull;
+    auto mix = [&h] (const void* data, size_t len) {
+        auto p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < len; i++) {
+            h = (h ^ p[i]) * 1099511628211ull;
+        }
+    };
+    auto symtab = dynamic_ptr<Elf64_Sym>(DT_SYMTAB);
+    for (unsigned i = 0; i < _nsyms; i++) {
+        u32 name = symtab[i].st_name;
+        u8 info = symtab[i].st_info;
+        u8 defined = symtab[i].st_shndx != SHN_UNDEF;
+        mix(&name, sizeof(name));
+        mix(&info, sizeof(info));
+        mix(&defined, sizeof(defined));
+    }
+    if (dynamic_exists(DT_STRSZ)) {
+        mix(dynamic_ptr<const char>(DT_STRTAB), dynamic_val(DT_STRSZ));
+    }
+    _fingerprint = h ? h : 1;
+    return _fingerprint;
+}
+
+// Picks the context of the relocation cache built for the modules loaded
+// now, if there is one
+bool object::load_reloc_cache()
+{
+    if (_pathname.empty()) {
+        return false;
+    }
+    auto f = fileref_from_fname(_pathname + ".relcache");
+    if (!f) {
+        return false;
+    }
+    auto len = ::size(f);
+    std::unique_ptr<char[]> buf(new char[len]);
+    ::read(f, buf.get(), 0, len);
+    auto p = buf.get(), end = p + len;
+    auto get = [&] (void* data, size_t size) {
+        if (size > size_t(end - p)) {
+            return false;
+        }
+        memcpy(data, p, size);
+        p += size;
+        return true;
+    };
+
+    char magic[8];
+    u32 version, ncontexts;
+    if (!get(magic, sizeof(magic)) || memcmp(magic, reloc_cache_magic, sizeof(magic)) ||
+        !get(&version, sizeof(version)) || version != reloc_cache_version ||
+        !get(&ncontexts, sizeof(ncontexts))) {
+        debug("%s: ignoring bad relocation cache\n", _pathname.c_str());
+        return false;
+    }
+    std::vector<object*> modules;
+    _prog.with_modules([&](const elf::program::modules_list &ml) {
+        modules = ml.objects;
+    });
+    for (u32 i = 0; i < ncontexts; i++) {
+        u32 nmodules, nresolutions;
+        if (!get(&nmodules, sizeof(nmodules)) || !get(&nresolutions, sizeof(nresolutions))) {
+            return false;
+        }
+        auto fingerprints = p;
+        size_t size = nmodules * sizeof(u64) + nresolutions * sizeof(cached_resolution);
+        if (size > size_t(end - p)) {
+            return false;
+        }
+        p += size;
+        if (nmodules != modules.size()) {
+            continue;
+        }
+        bool match = true;
+        for (u32 m = 0; m < nmodules && match; m++) {
+            u64 fp;
+            memcpy(&fp, fingerprints + m * sizeof(u64), sizeof(fp));
+            // Objects private to another thread are not searched by lookup
+            match = modules[m]->visible() && modules[m]->fingerprint() == fp;
+        }
+        if (match) {
+            auto resolutions = reinterpret_cast<const cached_resolution*>(
+                    fingerprints + nmodules * sizeof(u64));
+            _cached_resolutions.assign(resolutions, resolutions + nresolutions);
+            _cached_modules = std::move(modules);
+            return true;
+        }
+    }
+    return false;
+}
+
 void object::relocate()
 {
     assert(!dynamic_exists(DT_REL));
+    // Resolving the symbols of relocations dominates loading large
+    // libraries, so use those recorded at build time, if the modules
+    // loaded now are still the ones they were recorded for. Each of them
+    // is still checked, and looked up if it does not hold.
+    if (load_reloc_cache()) {
+        trace_elf_reloc_cache(_pathname.c_str());
+    }
     if (dynamic_exists(DT_RELA)) {
         relocate_rela();
     }
     if (dynamic_exists(DT_JMPREL)) {
         relocate_pltgot();
     }
+    // Lazily bound PLT entries are resolved against whatever is loaded
+    // by then
+    _cached_modules.clear();
+    _cached_modules.shrink_to_fit();
+    _cached_resolutions.clear();
+    _cached_resolutions.shrink_to_fit();
 }
 
 unsigned long
@@ -837,6 +998,38 @@ Elf64_Sym* object::lookup_symbol(const char* name)
     return sym;
 }
 
+// Calls func(name, hash, sym) on each symbol lookup_symbol() may return,
+// that is the first symbol of each name in the hash table, if defined
+template <typename Func>
+void object::for_each_exported_symbol(Func func)
+{
+    auto symtab = dynamic_ptr<Elf64_Sym>(DT_SYMTAB);
+    auto strtab = dynamic_ptr<const char>(DT_STRTAB);
+    bool gnu = dynamic_exists(DT_GNU_HASH);
+    auto len = dynsym_count();
+    for (unsigned i = 1; i < len; ++i) {
+        auto sym = &symtab[i];
+        auto name = strtab + sym->st_name;
+        if (sym->st_shndx == SHN_UNDEF || !*name) {
+            continue;
+        }
+        if ((gnu ? lookup_symbol_gnu(name) : lookup_symbol_old(name)) == sym) {
+            func(name, dl_new_hash(name), sym);
+        }
+    }
+}
+
+unsigned object::dynsym_count()
+{
+    // symtab_len() only counts the hashed symbols of a DT_GNU_HASH table,
+    // which are all those past the first symndx
+    auto len = symtab_len();
+    if (!dynamic_exists(DT_HASH)) {
+        len += dynamic_ptr<Elf64_Word>(DT_GNU_HASH)[1];
+    }
+    return len;
+}
+
 unsigned object::symtab_len()
 {
     if (dynamic_exists(DT_HASH)) {
@@ -863,18 +1056,22 @@ unsigned object::symtab_len()
     return len;
 }
 
-dladdr_info object::lookup_addr(const void* addr)
+// The symbols lookup_addr() may return, sorted by address, built the
+// first time it is called
+const std::vector<object::addr_symbol>& object::addr_index()
 {
-    dladdr_info ret;
-    if (addr < _base || addr >= _end) {
-        return ret;
+    auto index = _addr_index.load(std::memory_order_acquire);
+    if (index) {
+        return *index;
     }
-    ret.fname = _pathname.c_str();
-    ret.base = _base;
-    auto strtab = dynamic_ptr<char>(DT_STRTAB);
+    SCOPE_LOCK(_addr_index_mutex);
+    index = _addr_index.load(std::memory_order_relaxed);
+    if (index) {
+        return *index;
+    }
+    index = new std::vector<addr_symbol>();
     auto symtab = dynamic_ptr<Elf64_Sym>(DT_SYMTAB);
-    auto len = symtab_len();
-    symbol_module best;
+    auto len = dynsym_count();
     for (unsigned i = 1; i < len; ++i) {
         auto& sym = symtab[i];
         auto type = sym.st_info & 15;
@@ -886,19 +1083,41 @@ dladdr_info object::lookup_addr(const void* addr)
             continue;
         }
         symbol_module sm{&sym, this};
-        auto s_addr = sm.relocated_addr();
-        if (s_addr > addr) {
-            continue;
-        }
-        if (!best.symbol || sm.relocated_addr() > best.relocated_addr()) {
-            best = sm;
-        }
+        index->push_back({sm.relocated_addr(), &sym});
     }
-    if (!best.symbol || addr > best.relocated_addr() + best.size()) {
+    // Of symbols at the same address, the one first in the symbol table
+    // is found
+    std::stable_sort(index->begin(), index->end(),
+            [] (const addr_symbol& a, const addr_symbol& b) { return a.addr < b.addr; });
+    _addr_index.store(index, std::memory_order_release);
+    return *index;
+}
+
+dladdr_info object::lookup_addr(const void* addr)
+{
+    dladdr_info ret;
+    if (addr < _base || addr >= _end) {
+        return ret;
+    }
+    ret.fname = _pathname.c_str();
+    ret.base = _base;
+    // The closest symbol at or below addr, which must also contain it
+    auto& index = addr_index();
+    auto i = std::upper_bound(index.begin(), index.end(), addr,
+            [] (const void* addr, const addr_symbol& s) { return addr < s.addr; });
+    if (i == index.begin()) {
         return ret;
     }
+    auto best_addr = std::prev(i)->addr;
+    i = std::lower_bound(index.begin(), i, best_addr,
+            [] (const addr_symbol& s, const void* addr) { return s.addr < addr; });
+    symbol_module best{i->sym, this};
+    if (addr > best_addr + best.size()) {
+        return ret;
+    }
+    auto strtab = dynamic_ptr<char>(DT_STRTAB);
     ret.sym = strtab + best.symbol->st_name;
-    ret.addr = best.relocated_addr();
+    ret.addr = best_addr;
     return ret;
 }
 
@@ -1201,6 +1420,7 @@ program::load_object(std::string name, std::vector<std::string> extra_path,
         _modules_rcu.assign(new_modules.release());
         osv::rcu_dispose(old_modules);
         ef->load_segments();
+        add_symbols(ef.get());
         _next_alloc = ef->end();
         add_debugger_obj(ef.get());
         loaded_objects.push_back(ef);
@@ -1299,6 +1519,7 @@ void program::remove_object(object *ef)
     new_modules->subs++;
     _modules_rcu.assign(new_modules.release());
     osv::rcu_dispose(old_modules);
+    remove_symbols(ef);
 
     ef->unload_needed();
 
@@ -1330,19 +1551,56 @@ void program::del_debugger_obj(object* obj)
     }
 }
 
+// The symbols of the loaded objects, which are searched in the order they
+// were loaded, are all in _symbols, each object having the rank it was
+// loaded with. The kernel, which is searched last, looks its symbols up
+// in its own hash table.
+void program::add_symbols(object* obj)
+{
+    auto rank = _next_symbols_rank++;
+    obj->for_each_exported_symbol([&] (const char* name, uint_fast32_t hash, Elf64_Sym* sym) {
+        _symbols.emplace(global_symbol{name, hash, rank, obj, sym});
+    });
+}
+
+void program::remove_symbols(object* obj)
+{
+    obj->for_each_exported_symbol([&] (const char* name, uint_fast32_t hash, Elf64_Sym* sym) {
+        auto i = _symbols.owner_find(sym, [=] (Elf64_Sym*) { return hash; },
+                [] (Elf64_Sym* key, const global_symbol& s) { return s.sym == key; });
+        if (i) {
+            _symbols.erase(i);
+        }
+    });
+    // Make sure no lookup still looks at obj, which is about to be freed
+    osv::rcu_synchronize();
+}
+
 symbol_module program::lookup(const char* name)
 {
     trace_elf_lookup(name);
     symbol_module ret(nullptr,nullptr);
-    with_modules([&](const elf::program::modules_list &ml)
-    {
-        for (auto module : ml.objects) {
-            if (auto sym = module->lookup_symbol(name)) {
-                ret = symbol_module(sym, module);
-                return;
-            }
+    auto hash = dl_new_hash(name);
+    WITH_LOCK(osv::rcu_read_lock) {
+        u64 rank = std::numeric_limits<u64>::max();
+        _symbols.reader_for_each_match(hash, [] (uint_fast32_t hash) { return hash; },
+                [=] (uint_fast32_t hash, const global_symbol& s) {
+                    return s.hash == hash && strcmp(s.name, name) == 0;
+                },
+                [&] (const global_symbol& s) {
+                    // The same symbol in objects private to other threads
+                    // does not interpose
+                    if (s.rank < rank && s.obj->visible()) {
+                        rank = s.rank;
+                        ret = symbol_module(s.sym, s.obj);
+                    }
+                });
+    }
+    if (!ret.symbol) {
+        if (auto sym = _core->lookup_symbol(name)) {
+            ret = symbol_module(sym, _core.get());
         }
-    });
+    }
     return ret;
 }
 
@@ -1362,16 +1620,22 @@ dladdr_info program::lookup_addr(const void* addr)
 {
     trace_elf_lookup_addr(addr);
     dladdr_info ret;
-    with_modules([&](const elf::program::modules_list &ml)
-    {
-        for (auto module : ml.objects) {
-            ret = module->lookup_addr(addr);
-            if (ret.fname) {
-                return;
+    // Only the object containing addr can have a symbol for it, so there
+    // is no need to copy the list of modules to search them all
+    module_delete_disable();
+    object* obj = nullptr;
+    WITH_LOCK(osv::rcu_read_lock) {
+        for (object *module : _modules_rcu.read()->objects) {
+            if (module->contains_addr(addr)) {
+                obj = module;
+                break;
             }
         }
-        ret = {};
-    });
+    }
+    if (obj) {
+        ret = obj->lookup_addr(addr);
+    }
+    module_delete_enable();
     return ret;
 }
 
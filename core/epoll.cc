@@ -25,6 +25,7 @@
 #include <algorithm>
 
 #include <osv/trace.hh>
+#include <osv/net_busy_poll.hh>
 TRACEPOINT(trace_epoll_create, "returned fd=%d", int);
 TRACEPOINT(trace_epoll_ctl, "epfd=%d, fd=%d, op=%s event=0x%x", int, int, const char*, int);
 TRACEPOINT(trace_epoll_wait, "epfd=%d, maxevents=%d, timeout=%d", int, int, int);
@@ -134,8 +135,22 @@ public:
             tmr.set(*tmo);
         }
         int nr = 0;
+        auto busy_poll = osv::busy_poll::poll_usecs.load(std::memory_order_relaxed);
         WITH_LOCK(_activity_lock) {
             while (!tmr.expired() && nr == 0) {
+                if (tmo && busy_poll && _activity.empty()) {
+                    // Pull packets off the NIC ourselves for a while before
+                    // going to sleep; only once per call. The epoll doesn't
+                    // know which interfaces its files' traffic comes from,
+                    // so every receive queue is polled.
+                    DROP_LOCK(_activity_lock) {
+                        osv::busy_poll::spin(busy_poll, 0, [&] {
+                            return !_activity_ring.empty() ||
+                                _activity_ring_overflow.load(std::memory_order_relaxed);
+                        });
+                    }
+                    busy_poll = 0;
+                }
                 if (tmo) {
                     _activity_ring_owner.reset(*sched::thread::current());
                     sched::thread::wait_for(_activity_lock,
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// Each thread counts down the bytes it allocates, and samples the
+// allocation which takes the count past zero, then draws the next count
+// from an exponential distribution, as tcmalloc does. Sampled allocations
+// and their call stacks go into tables allocated when the profiler starts,
+// since malloc() and free() calling in here cannot allocate memory. A
+// counting filter on the sampled addresses lets free() skip the lock for
+// all the allocations which were not sampled.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <osv/heapprof.hh>
+#include <osv/sched.hh>
+#include <osv/mutex.h>
+#include <osv/spinlock.h>
+#include <osv/clock.hh>
+#include <osv/execinfo.hh>
+#include <osv/elf.hh>
+#include <osv/printf.hh>
+#include <osv/ilog2.hh>
+
+namespace heapprof {
+
+bool enabled;
+bool tracking;
+
+constexpr unsigned max_frames = 32;
+// allocated() and malloc(), std_malloc() being inlined into it, leaving
+// malloc()'s caller as the innermost frame
+constexpr unsigned skip_frames = 2;
+
+constexpr unsigned filter_size = 16384;
+
+static size_t hash_ptr(const void* p)
+{
+    auto h = (reinterpret_cast<uintptr_t>(p) >> 4) * 0x9e3779b97f4a7c15ull;
+    return h ^ (h >> 29);
+}
+
+static size_t hash_stack(void** pc, unsigned len)
+{
+    size_t r = len;
+    std::hash<const void*> hashfn;
+    for (unsigned i = 0; i < len; ++i) {
+        r = (r << 7) | (r >> (sizeof(r)*8 - 7));
+        r ^= hashfn(pc[i]);
+    }
+    return r;
+}
+
+struct stack_entry {
+    size_t hash;
+    unsigned len;
+    void* pc[max_frames];
+    u64 inuse_count;
+    u64 inuse_bytes;
+    u64 alloc_count;
+    u64 alloc_bytes;
+};
+
+struct sample {
+    void* addr;
+    size_t size;
+    unsigned stack;
+    // Index of the next sample in the same bucket, or on the free list,
+    // plus one, so that 0 ends the list
+    unsigned next;
+};
+
+// The samples of one run of the profiler, only accessed with _lock held
+struct profile {
+    explicit profile(const config& c);
+    void add(void* addr, size_t size, void** pc, unsigned len);
+    void remove(void* addr);
+    unsigned* sample_bucket(void* addr) {
+        return &sample_buckets[hash_ptr(addr) & (sample_buckets.size() - 1)];
+    }
+
+    std::vector<stack_entry> stacks;
+    // Open addressing hash table of indices into stacks, plus one, so that
+    // 0 marks a free bucket
+    std::vector<unsigned> stack_buckets;
+    unsigned nstacks = 0;
+    std::vector<sample> samples;
+    // Heads of the chains of samples, like sample::next
+    std::vector<unsigned> sample_buckets;
+    unsigned free_samples;
+};
+
+static mutex _control_lock;
+static spinlock _lock;
+static profile* _profile;
+static std::atomic<size_t> _sample_bytes{config().sample_bytes};
+// Tells the sampling intervals of this run of the profiler from those of
+// earlier ones
+static std::atomic<unsigned> _session;
+// Number of live samples whose address hashes to each counter
+static std::atomic<unsigned> _filter[filter_size];
+
+static __thread int64_t bytes_until_sample;
+static __thread unsigned thread_session;
+static __thread u64 rng;
+
+static std::atomic<unsigned>& filter(void* addr)
+{
+    return _filter[hash_ptr(addr) & (filter_size - 1)];
+}
+
+profile::profile(const config& c)
+    : stacks(std::max(c.max_stacks, 1u))
+    , stack_buckets(size_t(1) << ilog2_roundup(2 * stacks.size()))
+    , samples(std::max(c.max_samples, 1u))
+    , sample_buckets(size_t(1) << ilog2_roundup(samples.size()))
+{
+    for (unsigned i = 0; i < samples.size(); ++i) {
+        samples[i].next = i + 2;
+    }
+    samples.back().next = 0;
+    free_samples = 1;
+}
+
+void profile::add(void* addr, size_t size, void** pc, unsigned len)
+{
+    if (!free_samples) {
+        return;
+    }
+    auto hash = hash_stack(pc, len);
+    auto mask = stack_buckets.size() - 1;
+    stack_entry* s;
+    for (auto b = hash & mask; ; b = (b + 1) & mask) {
+        if (!stack_buckets[b]) {
+            if (nstacks == stacks.size()) {
+                return;
+            }
+            s = &stacks[nstacks++];
+            *s = stack_entry();
+            s->hash = hash;
+            s->len = len;
+            std::copy(pc, pc + len, s->pc);
+            stack_buckets[b] = nstacks;
+            break;
+        }
+        s = &stacks[stack_buckets[b] - 1];
+        if (s->hash == hash && s->len == len && std::equal(pc, pc + len, s->pc)) {
+            break;
+        }
+    }
+    ++s->inuse_count;
+    s->inuse_bytes += size;
+    ++s->alloc_count;
+    s->alloc_bytes += size;
+
+    auto i = free_samples - 1;
+    auto& smp = samples[i];
+    free_samples = smp.next;
+    smp.addr = addr;
+    smp.size = size;
+    smp.stack = s - stacks.data();
+    auto bucket = sample_bucket(addr);
+    smp.next = *bucket;
+    *bucket = i + 1;
+    filter(addr).fetch_add(1, std::memory_order_relaxed);
+}
+
+void profile::remove(void* addr)
+{
+    for (auto p = sample_bucket(addr); *p; p = &samples[*p - 1].next) {
+        auto i = *p - 1;
+        auto& smp = samples[i];
+        if (smp.addr != addr) {
+            continue;
+        }
+        *p = smp.next;
+        auto& s = stacks[smp.stack];
+        --s.inuse_count;
+        s.inuse_bytes -= smp.size;
+        smp.next = free_samples;
+        free_samples = i + 1;
+        filter(addr).fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+}
+
+// Bytes to allocate until the next sample, exponentially distributed
+// around _sample_bytes
+static int64_t next_interval()
+{
+    if (!rng) {
+        rng = reinterpret_cast<uintptr_t>(sched::thread::current()) ^
+                osv::clock::uptime::now().time_since_epoch().count();
+        rng |= 1;
+    }
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    // Uniform in (0, 1]
+    double u = ((rng >> 11) + 1) * (1.0 / (u64(1) << 53));
+    auto mean = _sample_bytes.load(std::memory_order_relaxed);
+    return std::max(int64_t(-std::log(u) * mean), int64_t(1));
+}
+
+void allocated(void* addr, size_t size)
+{
+    if (!addr) {
+        return;
+    }
+    auto session = _session.load(std::memory_order_relaxed);
+    if (thread_session != session) {
+        thread_session = session;
+        bytes_until_sample = next_interval();
+    }
+    bytes_until_sample -= size;
+    if (bytes_until_sample > 0) {
+        return;
+    }
+    bytes_until_sample = next_interval();
+
+    void* bt[skip_frames + max_frames];
+    int nr = backtrace_safe(bt, skip_frames + max_frames);
+    if (nr <= int(skip_frames)) {
+        return;
+    }
+    WITH_LOCK(_lock) {
+        if (_profile && _session.load(std::memory_order_relaxed) == session) {
+            _profile->add(addr, size, bt + skip_frames, nr - skip_frames);
+        }
+    }
+}
+
+void released(void* addr)
+{
+    if (!filter(addr).load(std::memory_order_relaxed)) {
+        return;
+    }
+    WITH_LOCK(_lock) {
+        if (_profile) {
+            _profile->remove(addr);
+        }
+    }
+}
+
+void start(config c)
+{
+    SCOPE_LOCK(_control_lock);
+    enabled = false;
+    std::unique_ptr<profile> p(new profile(c));
+    profile* old;
+    WITH_LOCK(_lock) {
+        old = _profile;
+        _profile = p.release();
+        for (auto& f : _filter) {
+            f.store(0, std::memory_order_relaxed);
+        }
+        _sample_bytes.store(std::max(c.sample_bytes, size_t(1)),
+                std::memory_order_relaxed);
+        _session.fetch_add(1, std::memory_order_relaxed);
+    }
+    delete old;
+    tracking = true;
+    enabled = true;
+}
+
+void stop()
+{
+    SCOPE_LOCK(_control_lock);
+    enabled = false;
+}
+
+std::string get_profile()
+{
+    std::vector<stack_entry> stacks;
+    size_t sample_bytes;
+
+    WITH_LOCK(_control_lock) {
+        sample_bytes = _sample_bytes.load(std::memory_order_relaxed);
+        if (_profile) {
+            // Nothing may be allocated with _lock held
+            stacks.resize(_profile->stacks.size());
+            WITH_LOCK(_lock) {
+                std::copy(_profile->stacks.begin(),
+                        _profile->stacks.begin() + _profile->nstacks, stacks.begin());
+                stacks.resize(_profile->nstacks);
+            }
+        }
+    }
+
+    stack_entry total = {};
+    for (auto& s : stacks) {
+        total.inuse_count += s.inuse_count;
+        total.inuse_bytes += s.inuse_bytes;
+        total.alloc_count += s.alloc_count;
+        total.alloc_bytes += s.alloc_bytes;
+    }
+
+    std::string ret = osv::sprintf("heap profile: %6d: %8d [%6d: %8d] @ heap_v2/%d\n",
+            total.inuse_count, total.inuse_bytes, total.alloc_count,
+            total.alloc_bytes, sample_bytes);
+    for (auto& s : stacks) {
+        ret += osv::sprintf("%6d: %8d [%6d: %8d] @", s.inuse_count,
+                s.inuse_bytes, s.alloc_count, s.alloc_bytes);
+        for (unsigned i = 0; i < s.len; ++i) {
+            ret += osv::sprintf(" %p", s.pc[i]);
+        }
+        ret += "\n";
+    }
+
+    ret += "\nMAPPED_LIBRARIES:\n";
+    elf::get_program()->with_modules([&](const elf::program::modules_list& ml) {
+        for (auto module : ml.objects) {
+            ret += osv::sprintf("%08x-%08x r-xp 00000000 00:00 0 %s\n",
+                    reinterpret_cast<uintptr_t>(module->base()),
+                    reinterpret_cast<uintptr_t>(module->end()), module->pathname());
+        }
+    });
+    return ret;
+}
+
+}
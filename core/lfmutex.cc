@@ -9,6 +9,7 @@
 #include <osv/trace.hh>
 #include <osv/sched.hh>
 #include <osv/wait_record.hh>
+#include <osv/lockstat.hh>
 
 namespace lockfree {
 
@@ -33,6 +34,9 @@ void mutex::lock()
         // just for implementing a recursive mutex.
         owner.store(current, std::memory_order_relaxed);
         depth = 1;
+        if (lockstat::enabled) {
+            lockstat::acquired(this, lockstat::lock_type::mutex, __builtin_return_address(0), 0);
+        }
         return;
     }
 
@@ -45,6 +49,8 @@ void mutex::lock()
         return;
     }
 
+    uint64_t wait_start = lockstat::enabled ? lockstat::now() : 0;
+
     // If we're here still here the lock is owned by a different thread.
     // Put this thread in a waiting queue, so it will eventually be woken
     // when another thread releases the lock.
@@ -77,6 +83,10 @@ void mutex::lock()
                     assert(other == &waiter);
                     owner.store(current, std::memory_order_relaxed);
                     depth = 1;
+                    if (lockstat::enabled) {
+                        lockstat::acquired(this, lockstat::lock_type::mutex,
+                                __builtin_return_address(0), wait_start);
+                    }
                     return;
                 }
             }
@@ -89,6 +99,10 @@ void mutex::lock()
     trace_mutex_lock_wake(this);
     owner.store(current, std::memory_order_relaxed);
     depth = 1;
+    if (lockstat::enabled) {
+        lockstat::acquired(this, lockstat::lock_type::mutex,
+                __builtin_return_address(0), wait_start);
+    }
 }
 
 // send_lock() is used for implementing a "wait morphing" technique, where
@@ -172,6 +186,9 @@ void mutex::receive_lock()
     trace_mutex_receive_lock(this);
     owner.store(sched::thread::current(), std::memory_order_relaxed);
     depth = 1;
+    if (lockstat::enabled) {
+        lockstat::acquired(this, lockstat::lock_type::mutex, __builtin_return_address(0), 0);
+    }
 }
 
 bool mutex::try_lock()
@@ -183,6 +200,9 @@ bool mutex::try_lock()
         owner.store(current, std::memory_order_relaxed);
         depth = 1;
         trace_mutex_try_lock(this, true);
+        if (lockstat::enabled) {
+            lockstat::acquired(this, lockstat::lock_type::mutex, __builtin_return_address(0), 0);
+        }
         return true;
     }
 
@@ -203,6 +223,9 @@ bool mutex::try_lock()
         owner.store(current, std::memory_order_relaxed);
         depth = 1;
         trace_mutex_try_lock(this, true);
+        if (lockstat::enabled) {
+            lockstat::acquired(this, lockstat::lock_type::mutex, __builtin_return_address(0), 0);
+        }
         return true;
     }
 
@@ -222,6 +245,10 @@ void mutex::unlock()
     if (--depth)
         return; // recursive mutex still locked.
 
+    if (lockstat::enabled) {
+        lockstat::released(this);
+    }
+
     // When we return from unlock(), we will no longer be holding the lock.
     // We can't leave owner==current, otherwise a later lock() in the same
     // thread will think it's a recursive lock, while actually another thread
@@ -0,0 +1,408 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// Lock statistics are counted per lock, and per lock and waiting call
+// site, in fixed size tables kept per cpu. They are only updated by their
+// cpu with interrupts disabled, since the lock primitives calling in here
+// can neither take a lock nor allocate memory. The hold time of a lock is
+// measured from an array of the locks held by the current thread.
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <osv/lockstat.hh>
+#include <osv/sched.hh>
+#include <osv/mutex.h>
+#include <osv/clock.hh>
+#include <osv/elf.hh>
+#include <osv/demangle.hh>
+#include <osv/printf.hh>
+#include <osv/rcu.hh>
+#include <osv/ilog2.hh>
+#include "arch.hh"
+
+namespace lockstat {
+
+bool enabled;
+
+// Capacity of the tables of each cpu
+constexpr unsigned max_locks = 4096;
+constexpr unsigned max_sites = 4096;
+// Most locks whose hold time is measured which a thread holds at once
+constexpr unsigned max_held = 16;
+
+static size_t hash_ptr(const void* p)
+{
+    return (reinterpret_cast<uintptr_t>(p) >> 3) * 0x9e3779b97f4a7c15ull;
+}
+
+struct lock_entry {
+    typedef const void* key_type;
+    static size_t hash(key_type key) { return hash_ptr(key); }
+
+    key_type key;
+    // Where the lock was first acquired on this cpu, if it was
+    const void* first_site;
+    lock_type type;
+    u64 acquired;
+    u64 contended;
+    u64 wait_ns;
+    u64 max_wait_ns;
+    u64 hold_ns;
+    u64 max_hold_ns;
+};
+
+struct site_entry {
+    typedef std::pair<const void*, const void*> key_type; // lock, call site
+    static size_t hash(const key_type& key) {
+        return hash_ptr(key.first) ^ (hash_ptr(key.second) >> 7);
+    }
+
+    key_type key;
+    u64 contended;
+    u64 wait_ns;
+};
+
+// Open addressing hash table which never allocates once constructed
+template <typename Entry>
+class stat_table {
+public:
+    explicit stat_table(unsigned capacity)
+        : _entries(capacity)
+        , _buckets(size_t(1) << ilog2_roundup(2 * capacity))
+    {
+    }
+    // The entry for @key, added if needed, or nullptr if the table is full
+    Entry* get(const typename Entry::key_type& key) {
+        auto mask = _buckets.size() - 1;
+        for (auto b = Entry::hash(key) & mask; ; b = (b + 1) & mask) {
+            if (!_buckets[b]) {
+                if (_used == _entries.size()) {
+                    return nullptr;
+                }
+                auto& e = _entries[_used++];
+                e = Entry();
+                e.key = key;
+                _buckets[b] = _used;
+                return &e;
+            }
+            auto& e = _entries[_buckets[b] - 1];
+            if (e.key == key) {
+                return &e;
+            }
+        }
+    }
+    const Entry* begin() const { return _entries.data(); }
+    const Entry* end() const { return _entries.data() + _used; }
+    size_t capacity() const { return _entries.size(); }
+private:
+    std::vector<Entry> _entries;
+    // Indices into _entries, plus one, so that 0 marks a free bucket
+    std::vector<unsigned> _buckets;
+    unsigned _used = 0;
+};
+
+struct cpu_stats {
+    cpu_stats() : locks(max_locks), sites(max_sites) {}
+    stat_table<lock_entry> locks;
+    stat_table<site_entry> sites;
+    u64 dropped = 0;
+};
+
+struct stats_set {
+    u64 generation;
+    std::vector<std::unique_ptr<cpu_stats>> cpus;
+};
+
+static mutex _control_lock;
+static u64 _generation;
+// Interrupts being disabled while the tables are updated, replacing them
+// only needs an RCU grace period
+static osv::rcu_ptr<stats_set> _stats;
+
+struct held_lock {
+    const void* lock;
+    u64 since;
+    u64 generation;
+};
+
+static __thread held_lock held[max_held];
+static __thread unsigned nheld;
+
+static u64 now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            osv::clock::uptime::now().time_since_epoch()).count();
+}
+
+uint64_t now()
+{
+    return std::max(now_ns(), u64(1));
+}
+
+static void push_held(const void* lock, u64 since, u64 generation)
+{
+    if (nheld == max_held) {
+        // Forget the locks acquired before the statistics were restarted
+        nheld = std::remove_if(held, held + nheld, [=] (const held_lock& h) {
+            return h.generation != generation;
+        }) - held;
+        if (nheld == max_held) {
+            return;
+        }
+    }
+    held[nheld++] = held_lock{lock, since, generation};
+}
+
+void acquired(const void* lock, lock_type type, const void* site, uint64_t wait_start)
+{
+    auto since = now_ns();
+    arch::irq_flag_notrace irq;
+    irq.save();
+    arch::irq_disable_notrace();
+    auto s = _stats.read();
+    if (s) {
+        auto& c = *s->cpus[sched::cpu::current()->id];
+        auto e = c.locks.get(lock);
+        if (e) {
+            if (!e->first_site) {
+                e->type = type;
+                e->first_site = site;
+            }
+            ++e->acquired;
+            if (wait_start) {
+                auto wait = since - std::min(since, wait_start);
+                ++e->contended;
+                e->wait_ns += wait;
+                e->max_wait_ns = std::max(e->max_wait_ns, wait);
+                auto se = c.sites.get(site_entry::key_type(lock, site));
+                if (se) {
+                    ++se->contended;
+                    se->wait_ns += wait;
+                } else {
+                    ++c.dropped;
+                }
+            }
+        } else {
+            ++c.dropped;
+        }
+        push_held(lock, since, s->generation);
+    }
+    irq.restore();
+}
+
+void released(const void* lock)
+{
+    if (!nheld) {
+        return;
+    }
+    auto until = now_ns();
+    arch::irq_flag_notrace irq;
+    irq.save();
+    arch::irq_disable_notrace();
+    for (unsigned i = nheld; i-- > 0; ) {
+        if (held[i].lock != lock) {
+            continue;
+        }
+        auto h = held[i];
+        std::copy(held + i + 1, held + nheld, held + i);
+        --nheld;
+        auto s = _stats.read();
+        if (s && s->generation == h.generation) {
+            auto& c = *s->cpus[sched::cpu::current()->id];
+            auto e = c.locks.get(lock);
+            if (e) {
+                auto hold = until - std::min(until, h.since);
+                e->hold_ns += hold;
+                e->max_hold_ns = std::max(e->max_hold_ns, hold);
+            } else {
+                ++c.dropped;
+            }
+        }
+        break;
+    }
+    irq.restore();
+}
+
+void start()
+{
+    SCOPE_LOCK(_control_lock);
+    enabled = false;
+    std::unique_ptr<stats_set> s(new stats_set);
+    s->generation = ++_generation;
+    s->cpus.resize(sched::cpus.size());
+    for (auto c : sched::cpus) {
+        s->cpus[c->id].reset(new cpu_stats);
+    }
+    auto old = _stats.read_by_owner();
+    _stats.assign(s.release());
+    osv::rcu_synchronize();
+    delete old;
+    enabled = true;
+}
+
+void stop()
+{
+    SCOPE_LOCK(_control_lock);
+    enabled = false;
+}
+
+const char* type_name(lock_type type)
+{
+    switch (type) {
+    case lock_type::mutex:
+        return "mutex";
+    case lock_type::rwlock:
+        return "rwlock";
+    case lock_type::spinlock:
+        return "spinlock";
+    }
+    return "?";
+}
+
+// Copy the tables of a cpu, which may be being updated
+static void copy_stats(sched::cpu* cpu, const cpu_stats& c,
+        std::vector<lock_entry>& locks, std::vector<site_entry>& sites, u64& dropped)
+{
+    std::vector<lock_entry> lcopy(c.locks.capacity());
+    std::vector<site_entry> scopy(c.sites.capacity());
+    size_t nlocks, nsites;
+    std::unique_ptr<sched::thread> t(sched::thread::make([&] {
+        arch::irq_flag_notrace irq;
+        irq.save();
+        arch::irq_disable_notrace();
+        nlocks = std::copy(c.locks.begin(), c.locks.end(), lcopy.begin()) - lcopy.begin();
+        nsites = std::copy(c.sites.begin(), c.sites.end(), scopy.begin()) - scopy.begin();
+        dropped += c.dropped;
+        irq.restore();
+    }, sched::thread::attr().pin(cpu)));
+    t->start();
+    t->join();
+    locks.insert(locks.end(), lcopy.begin(), lcopy.begin() + nlocks);
+    sites.insert(sites.end(), scopy.begin(), scopy.begin() + nsites);
+}
+
+static std::string function_name(const void* addr, osv::demangler& demangle)
+{
+    auto ei = elf::get_program()->lookup_addr(addr);
+    if (!ei.sym) {
+        return osv::sprintf("%p", addr);
+    }
+    auto name = demangle(ei.sym);
+    return name ? name : ei.sym;
+}
+
+std::vector<class_stats> get_stats(unsigned n_sites, uint64_t& dropped)
+{
+    std::vector<lock_entry> locks;
+    std::vector<site_entry> sites;
+    dropped = 0;
+
+    WITH_LOCK(_control_lock) {
+        auto s = _stats.read_by_owner();
+        if (s) {
+            for (auto c : sched::cpus) {
+                copy_stats(c, *s->cpus[c->id], locks, sites, dropped);
+            }
+        }
+    }
+
+    // Merge the entries of each lock from the different cpus
+    std::map<const void*, lock_entry> by_lock;
+    for (auto& e : locks) {
+        auto i = by_lock.emplace(e.key, e);
+        if (i.second) {
+            continue;
+        }
+        auto& m = i.first->second;
+        if (!m.first_site) {
+            m.first_site = e.first_site;
+            m.type = e.type;
+        }
+        m.acquired += e.acquired;
+        m.contended += e.contended;
+        m.wait_ns += e.wait_ns;
+        m.max_wait_ns = std::max(m.max_wait_ns, e.max_wait_ns);
+        m.hold_ns += e.hold_ns;
+        m.max_hold_ns = std::max(m.max_hold_ns, e.max_hold_ns);
+    }
+
+    osv::demangler demangle;
+    std::map<std::string, class_stats> classes;
+    std::map<const void*, class_stats*> lock_class;
+    for (auto& l : by_lock) {
+        auto& e = l.second;
+        if (!e.first_site) {
+            // Only released since the statistics started
+            continue;
+        }
+        std::string name;
+        auto ei = elf::get_program()->lookup_addr(e.key);
+        if (ei.sym) {
+            auto n = demangle(ei.sym);
+            name = n ? n : ei.sym;
+            if (ei.addr != e.key) {
+                name += osv::sprintf("+%d", static_cast<const char*>(e.key)
+                        - static_cast<const char*>(ei.addr));
+            }
+        } else {
+            name = osv::sprintf("%s locked in %s", type_name(e.type),
+                    function_name(e.first_site, demangle));
+        }
+        auto i = classes.emplace(name, class_stats());
+        auto& c = i.first->second;
+        if (i.second) {
+            c.name = name;
+            c.type = e.type;
+        }
+        ++c.locks;
+        c.acquired += e.acquired;
+        c.contended += e.contended;
+        c.wait_ns += e.wait_ns;
+        c.max_wait_ns = std::max(c.max_wait_ns, e.max_wait_ns);
+        c.hold_ns += e.hold_ns;
+        c.max_hold_ns = std::max(c.max_hold_ns, e.max_hold_ns);
+        lock_class[e.key] = &c;
+    }
+
+    std::map<std::pair<class_stats*, const void*>, site_stats> by_site;
+    for (auto& e : sites) {
+        auto lc = lock_class.find(e.key.first);
+        if (lc == lock_class.end()) {
+            continue;
+        }
+        auto& s = by_site[std::make_pair(lc->second, e.key.second)];
+        s.contended += e.contended;
+        s.wait_ns += e.wait_ns;
+    }
+    for (auto& s : by_site) {
+        char name[1024];
+        osv::lookup_name_demangled(const_cast<void*>(s.first.second), name, sizeof(name));
+        s.second.site = name;
+        s.first.first->top_sites.push_back(s.second);
+    }
+
+    std::vector<class_stats> ret;
+    for (auto& c : classes) {
+        auto& sites = c.second.top_sites;
+        std::sort(sites.begin(), sites.end(), [] (const site_stats& a, const site_stats& b) {
+            return a.contended > b.contended || (a.contended == b.contended && a.wait_ns > b.wait_ns);
+        });
+        if (sites.size() > n_sites) {
+            sites.resize(n_sites);
+        }
+        ret.push_back(std::move(c.second));
+    }
+    std::sort(ret.begin(), ret.end(), [] (const class_stats& a, const class_stats& b) {
+        return a.wait_ns > b.wait_ns || (a.wait_ns == b.wait_ns && a.acquired > b.acquired);
+    });
+    return ret;
+}
+
+}
@@ -18,6 +18,7 @@
 #include <osv/align.hh>
 #include <osv/debug.hh>
 #include <osv/alloctracker.hh>
+#include <osv/heapprof.hh>
 #include <atomic>
 #include <osv/mmu.hh>
 #include <osv/trace.hh>
@@ -25,6 +26,7 @@
 #include <osv/percpu-worker.hh>
 #include <osv/preempt-lock.hh>
 #include <osv/sched.hh>
+#include <osv/condvar.h>
 #include <algorithm>
 #include <osv/prio.hh>
 #include <stdlib.h>
@@ -86,6 +88,21 @@ static inline void tracker_forget(void *addr)
     }
 }
 
+// Sampling heap profiler, see heapprof.hh. Unlike the tracker above, it
+// only looks at malloc() and free().
+static inline void heapprof_allocated(void *addr, size_t size)
+{
+    if (__builtin_expect(heapprof::enabled, false)) {
+        heapprof::allocated(addr, size);
+    }
+}
+static inline void heapprof_released(void *addr)
+{
+    if (__builtin_expect(heapprof::tracking, false)) {
+        heapprof::released(addr);
+    }
+}
+
 //
 // Before smp_allocator=true, threads are not yet available. malloc and free
 // are used immediately after virtual memory is being initialized.
@@ -505,6 +522,8 @@ void oom()
     abort("Out of memory: could not reclaim any further. Current memory: %d Kb", stats::free() >> 10);
 }
 
+static bool wait_for_deferred_memory();
+
 void reclaimer::wait_for_minimum_memory()
 {
     if (emergency_alloc_level) {
@@ -512,6 +531,9 @@ void reclaimer::wait_for_minimum_memory()
     }
 
     if (stats::free() < min_emergency_pool_size) {
+        if (wait_for_deferred_memory()) {
+            return;
+        }
         // Nothing could possibly give us memory back, might as well use up
         // everything in the hopes that we only need a tiny bit more..
         if (!_active_shrinkers) {
@@ -528,6 +550,9 @@ void reclaimer::wait_for_minimum_memory()
 // memory, there is very little hope and we would might as well give up.
 void reclaimer::wait_for_memory(size_t mem)
 {
+    if (wait_for_deferred_memory()) {
+        return;
+    }
     // If we're asked for an impossibly large allocation, abort now instead of
     // the reclaimer thread aborting later. By aborting here, the application
     // bug will be easier for the user to debug. An allocation larger than RAM
@@ -551,6 +576,8 @@ public:
     void free(page_range* pr);
 
     void initial_add(page_range* pr);
+    // Sizes the bitmap for memory up to end, to be added later
+    void reserve(void* end);
 
     template<typename Func>
     void for_each(unsigned min_order, Func f);
@@ -571,6 +598,8 @@ public:
     }
 
 private:
+    void resize_bitmap(size_t size);
+
     template<bool UseBitmap = true>
     void insert(page_range& pr) {
         auto addr = static_cast<void*>(&pr);
@@ -789,19 +818,32 @@ void page_range_allocator::initial_add(page_range* pr)
             pr = pr2;
         }
         insert<false>(*pr);
-        _bitmap.reset();
-        _bitmap.resize(idx);
-
-        for_each([this] (page_range& pr) { set_bits(pr, true); return true; });
-        if (_deferred_free) {
-            free(_deferred_free);
-            _deferred_free = nullptr;
-        }
+        resize_bitmap(idx);
     } else {
         free(pr);
     }
 }
 
+void page_range_allocator::resize_bitmap(size_t size)
+{
+    _bitmap.reset();
+    _bitmap.resize(size);
+
+    for_each([this] (page_range& pr) { set_bits(pr, true); return true; });
+    if (_deferred_free) {
+        free(_deferred_free);
+        _deferred_free = nullptr;
+    }
+}
+
+void page_range_allocator::reserve(void* end)
+{
+    size_t idx = (static_cast<char*>(end) - mmu::phys_mem) / page_size;
+    if (idx > _bitmap.size()) {
+        resize_bitmap(idx);
+    }
+}
+
 template<typename Func>
 void page_range_allocator::for_each(unsigned min_order, Func f)
 {
@@ -1650,6 +1692,129 @@ void free_initial_memory_range(void* addr, size_t size)
     free_page_ranges.initial_add(pr);
 }
 
+TRACEPOINT(trace_memory_deferred, "addr=%p, size=%d", void*, size_t);
+TRACEPOINT(trace_memory_online, "addr=%p, size=%d", void*, size_t);
+
+// Memory not online yet, in ranges which are carved in chunks as they are
+// brought online. Boot has one range per e820 entry at most.
+struct deferred_range {
+    uintptr_t addr;
+    size_t size;
+};
+constexpr unsigned max_deferred_ranges = 64;
+constexpr size_t deferred_chunk_size = size_t(1) << 30;
+static deferred_range deferred_ranges[max_deferred_ranges]; // protected by deferred_lock
+static unsigned nr_deferred_ranges;
+static mutex deferred_lock;
+static void (*deferred_map)(uintptr_t addr, size_t size);
+static uintptr_t deferred_end;
+static bool deferred_reserved; // protected by free_page_ranges_lock
+// Whether the stats count the memory not online yet, as free; protected
+// by free_page_ranges_lock
+static bool deferred_counted;
+// Bytes not online yet, including those being brought online; protected
+// by free_page_ranges_lock, and waited for with it
+static size_t deferred_pending;
+static condvar deferred_online;
+
+void defer_initial_memory_range(uintptr_t addr, size_t size,
+                                void (*map)(uintptr_t addr, size_t size))
+{
+    auto end = align_down(addr + size, page_size);
+    addr = align_up(addr, page_size);
+    if (end <= addr) {
+        return;
+    }
+    if (nr_deferred_ranges == max_deferred_ranges) {
+        map(addr, end - addr);
+        free_initial_memory_range(mmu::phys_cast<void>(addr), end - addr);
+        return;
+    }
+    trace_memory_deferred(mmu::phys_cast<void>(addr), end - addr);
+    deferred_ranges[nr_deferred_ranges++] = deferred_range{addr, end - addr};
+    deferred_map = map;
+    deferred_end = std::max(deferred_end, end);
+    deferred_pending += end - addr;
+}
+
+// Returns false if no chunk is left to bring online
+static bool online_deferred_chunk()
+{
+    deferred_range chunk;
+    WITH_LOCK(deferred_lock) {
+        if (!nr_deferred_ranges) {
+            return false;
+        }
+        auto& r = deferred_ranges[nr_deferred_ranges - 1];
+        chunk.addr = r.addr;
+        chunk.size = std::min(r.size, deferred_chunk_size);
+        r.addr += chunk.size;
+        r.size -= chunk.size;
+        if (!r.size) {
+            nr_deferred_ranges--;
+        }
+    }
+
+    deferred_map(chunk.addr, chunk.size);
+
+    auto addr = mmu::phys_cast<void>(chunk.addr);
+    WITH_LOCK(free_page_ranges_lock) {
+        // Sized once for all of it, rather than again for every chunk
+        if (!deferred_reserved) {
+            free_page_ranges.reserve(mmu::phys_cast<void>(deferred_end));
+            deferred_reserved = true;
+        }
+        if (deferred_counted) {
+            free_page_ranges.initial_add(new (addr) page_range(chunk.size));
+        } else {
+            free_initial_memory_range(addr, chunk.size);
+        }
+        deferred_pending -= chunk.size;
+    }
+    deferred_online.wake_all();
+    trace_memory_online(addr, chunk.size);
+    return true;
+}
+
+// Called with free_page_ranges_lock held, by allocations which ran out of
+// memory. Returns false if there is no more memory to bring online.
+static bool wait_for_deferred_memory()
+{
+    if (!deferred_pending) {
+        return false;
+    }
+    DROP_LOCK(free_page_ranges_lock) {
+        if (online_deferred_chunk()) {
+            return true;
+        }
+    }
+    // All chunks are taken, by threads yet to add them
+    if (deferred_pending) {
+        deferred_online.wait(&free_page_ranges_lock);
+    }
+    return true;
+}
+
+void start_deferred_memory_init()
+{
+    // Applications size themselves by the memory they find when they
+    // start, which is about to come online anyway
+    WITH_LOCK(free_page_ranges_lock) {
+        if (!deferred_pending) {
+            return;
+        }
+        on_new_memory(deferred_pending);
+        on_free(deferred_pending);
+        deferred_counted = true;
+    }
+    for (auto c : sched::cpus) {
+        sched::thread::make([] {
+            while (online_deferred_chunk()) {
+            }
+        }, sched::thread::attr().pin(c).detached().name("memory-online"))->start();
+    }
+}
+
 void  __attribute__((constructor(init_prio::mempool))) setup()
 {
     arch_setup_free_memory();
@@ -1693,6 +1858,7 @@ static inline void* std_malloc(size_t size, size_t alignment)
         ret = memory::malloc_large(size, alignment);
     }
     memory::tracker_remember(ret, size);
+    memory::heapprof_allocated(ret, size);
     return ret;
 }
 
@@ -1761,6 +1927,7 @@ void free(void* object)
         return;
     }
     memory::tracker_forget(object);
+    memory::heapprof_released(object);
     switch (mmu::get_mem_area(object)) {
     case mmu::mem_area::page:
         object = mmu::translate_mem_area(mmu::mem_area::page,
@@ -1699,8 +1699,13 @@ void file_vma::fault(uintptr_t addr, exception_frame *ef)
         size = page_size;
     }
 
-    populate_vma<account_opt::no>(this, (void*)addr, size,
-            mmu::is_page_fault_write(ef->get_error()));
+    try {
+        populate_vma<account_opt::no>(this, (void*)addr, size,
+                mmu::is_page_fault_write(ef->get_error()));
+    } catch (error&) {
+        // the file could not be read
+        vm_sigbus(addr, ef);
+    }
 }
 
 file_vma::~file_vma()
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include <osv/net_busy_poll.hh>
+#include <osv/rwlock.h>
+#include <osv/sched.hh>
+#include <osv/clock.hh>
+#include <osv/trace.hh>
+
+#include <vector>
+#include <algorithm>
+
+TRACEPOINT(trace_net_busy_poll_spin, "usecs=%d, if=%d", unsigned, unsigned);
+TRACEPOINT(trace_net_busy_poll_spin_ret, "ready=%d, polls=%d", bool, unsigned);
+
+namespace osv {
+namespace busy_poll {
+
+std::atomic<unsigned> read_usecs{0};
+std::atomic<unsigned> poll_usecs{0};
+
+struct poller {
+    poller_id id;
+    unsigned ifindex;
+    std::function<bool ()> poll;
+};
+
+// Pollers run packets up the network stack, which may sleep, so an
+// rwlock (rather than RCU) protects the list while spinning.
+static rwlock pollers_lock;
+static std::vector<poller> pollers;
+static poller_id next_id;
+
+poller_id register_poller(unsigned ifindex, std::function<bool ()> poll)
+{
+    WITH_LOCK(pollers_lock.for_write()) {
+        auto id = ++next_id;
+        pollers.push_back(poller{id, ifindex, std::move(poll)});
+        return id;
+    }
+}
+
+void unregister_poller(poller_id id)
+{
+    WITH_LOCK(pollers_lock.for_write()) {
+        pollers.erase(std::remove_if(pollers.begin(), pollers.end(),
+                [id] (const poller& p) { return p.id == id; }),
+                pollers.end());
+    }
+}
+
+bool spin(unsigned usecs, unsigned ifindex, std::function<bool ()> ready)
+{
+    trace_net_busy_poll_spin(usecs, ifindex);
+    auto end = osv::clock::uptime::now() + std::chrono::microseconds(usecs);
+    unsigned polls = 0;
+    bool ret;
+    WITH_LOCK(pollers_lock.for_read()) {
+        auto polled = [ifindex] (const poller& p) {
+            return !ifindex || p.ifindex == ifindex;
+        };
+        // Traffic from interfaces without a poller, like loopback, only
+        // arrives by the regular path: spinning would not bring it sooner
+        bool any = std::any_of(pollers.begin(), pollers.end(), polled);
+        while (!(ret = ready()) && any) {
+            bool progress = false;
+            for (auto& p : pollers) {
+                if (polled(p)) {
+                    progress |= p.poll();
+                }
+            }
+            polls++;
+            if (osv::clock::uptime::now() >= end) {
+                ret = ready();
+                break;
+            }
+            if (!progress) {
+                // Nothing arrived; let anything else runnable on this
+                // cpu (including the rx threads themselves) make progress.
+                sched::thread::yield();
+            }
+        }
+    }
+    trace_net_busy_poll_spin_ret(ret, polls);
+    return ret;
+}
+
+}
+}
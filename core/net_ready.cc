@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include <osv/net_ready.hh>
+#include <osv/mutex.h>
+#include <osv/waitqueue.hh>
+#include <osv/signal.hh>
+#include <osv/sched.hh>
+#include <osv/trace.hh>
+
+#include <atomic>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+TRACEPOINT(trace_net_ready_set, "");
+TRACEPOINT(trace_net_ready_wait, "");
+TRACEPOINT(trace_net_ready_wait_ret, "error=%d", int);
+
+namespace osv {
+namespace net_ready {
+
+static mutex lock;
+static waitqueue waiters; // protected by lock
+static std::atomic<bool> ready;
+
+void set()
+{
+    SCOPE_LOCK(lock);
+    if (!ready.load(std::memory_order_relaxed)) {
+        trace_net_ready_set();
+        ready.store(true, std::memory_order_release);
+        waiters.wake_all(lock);
+    }
+}
+
+bool is_set()
+{
+    return ready.load(std::memory_order_acquire);
+}
+
+int wait(std::chrono::nanoseconds timeout)
+{
+    if (is_set()) {
+        return 0;
+    }
+    trace_net_ready_wait();
+    sched::timer tmr(*sched::thread::current());
+    tmr.set(timeout);
+    signal_catcher sc;
+    int error = 0;
+    SCOPE_LOCK(lock);
+    while (!is_set()) {
+        if (sc.interrupted()) {
+            error = EINTR;
+            break;
+        }
+        if (tmr.expired()) {
+            error = ENETUNREACH;
+            break;
+        }
+        sched::thread::wait_for(lock, waiters, tmr, sc);
+    }
+    trace_net_ready_wait_ret(error);
+    return error;
+}
+
+static bool needs_network(const void *addr, socklen_t len)
+{
+    if (!addr || len < sizeof(sa_family_t)) {
+        return false;
+    }
+    sa_family_t family;
+    memcpy(&family, addr, sizeof(family));
+    if (family == AF_INET && len >= sizeof(struct sockaddr_in)) {
+        struct sockaddr_in sin;
+        memcpy(&sin, addr, sizeof(sin));
+        auto a = ntohl(sin.sin_addr.s_addr);
+        return a != INADDR_ANY && (a >> 24) != IN_LOOPBACKNET;
+    }
+    if (family == AF_INET6 && len >= sizeof(struct sockaddr_in6)) {
+        struct sockaddr_in6 sin6;
+        memcpy(&sin6, addr, sizeof(sin6));
+        return !IN6_IS_ADDR_UNSPECIFIED(&sin6.sin6_addr) && !IN6_IS_ADDR_LOOPBACK(&sin6.sin6_addr);
+    }
+    return false;
+}
+
+int wait_for(int fd, int flags, const void *addr, socklen_t len)
+{
+    if (is_set() || !needs_network(addr, len)) {
+        return 0;
+    }
+    if ((flags & MSG_DONTWAIT) || (fcntl(fd, F_GETFL) & O_NONBLOCK)) {
+        return ENETUNREACH;
+    }
+    return wait();
+}
+
+}
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// The off-CPU profiler attaches probes to the sched_wait and sched_wait_ret
+// tracepoints, which sched::thread::wait() hits when the current thread
+// goes to sleep and when it runs again. The blocked time, from one to the
+// other, is added up per call stack, in tables kept per cpu so that the
+// probes, which run with interrupts disabled, never take a lock or
+// allocate memory.
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string.h>
+#include <vector>
+
+#include <osv/offcpu.hh>
+#include <osv/sched.hh>
+#include <osv/trace.hh>
+#include <osv/mutex.h>
+#include <osv/clock.hh>
+#include <osv/execinfo.hh>
+#include <osv/elf.hh>
+#include <osv/demangle.hh>
+#include <osv/printf.hh>
+#include <osv/rcu.hh>
+#include <osv/ilog2.hh>
+#include <osv/debug.hh>
+#include "arch.hh"
+
+namespace prof {
+
+constexpr unsigned offcpu_max_frames = 32;
+// The probe's hit(), tracepoint_base::run_probes() and the tracepoint's
+// slow path, leaving sched::thread::wait() as the innermost frame
+constexpr unsigned offcpu_skip_frames = 3;
+
+struct offcpu_stack {
+    u64 ns;
+    size_t hash;
+    unsigned len;
+    void* pc[offcpu_max_frames];
+};
+
+// The stacks recorded on one cpu, only ever modified by the probes on that
+// cpu, with interrupts disabled
+struct offcpu_table {
+    explicit offcpu_table(unsigned max_stacks)
+        : stacks(max_stacks)
+        , buckets(size_t(1) << ilog2_roundup(2 * max_stacks))
+    {
+    }
+    void add(void** pc, unsigned len, u64 ns);
+
+    std::vector<offcpu_stack> stacks;
+    // Open addressing hash table of indices into stacks, plus one, so that
+    // 0 marks a free bucket
+    std::vector<unsigned> buckets;
+    unsigned used = 0;
+    // Blocked time of the stacks which did not fit
+    u64 dropped_ns = 0;
+};
+
+static size_t hash_stack(void** pc, unsigned len)
+{
+    size_t r = len;
+    std::hash<const void*> hashfn;
+    for (unsigned i = 0; i < len; ++i) {
+        r = (r << 7) | (r >> (sizeof(r)*8 - 7));
+        r ^= hashfn(pc[i]);
+    }
+    return r;
+}
+
+void offcpu_table::add(void** pc, unsigned len, u64 ns)
+{
+    auto hash = hash_stack(pc, len);
+    auto mask = buckets.size() - 1;
+    for (auto b = hash & mask; ; b = (b + 1) & mask) {
+        if (!buckets[b]) {
+            if (used == stacks.size()) {
+                dropped_ns += ns;
+                return;
+            }
+            auto& s = stacks[used++];
+            s.ns = ns;
+            s.hash = hash;
+            s.len = len;
+            std::copy(pc, pc + len, s.pc);
+            buckets[b] = used;
+            return;
+        }
+        auto& s = stacks[buckets[b] - 1];
+        if (s.hash == hash && s.len == len && std::equal(pc, pc + len, s.pc)) {
+            s.ns += ns;
+            return;
+        }
+    }
+}
+
+static mutex _control_lock;
+static bool _running;
+static std::vector<std::unique_ptr<offcpu_table>> _tables;
+// Tells the waits of this run of the profiler from those of earlier ones
+static std::atomic<unsigned> _session;
+
+static __thread u64 wait_start;
+static __thread unsigned wait_session;
+
+static u64 now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            osv::clock::uptime::now().time_since_epoch()).count();
+}
+
+struct wait_probe : tracepoint_base::probe {
+    virtual void hit() override {
+        wait_start = now_ns();
+        wait_session = _session.load(std::memory_order_relaxed);
+    }
+};
+
+// The thread runs again, with the same call stack as when it went to
+// sleep; this records both
+struct wait_ret_probe : tracepoint_base::probe {
+    virtual void hit() override {
+        if (!wait_start || wait_session != _session.load(std::memory_order_relaxed)) {
+            return;
+        }
+        auto ns = now_ns() - wait_start;
+        wait_start = 0;
+        void* bt[offcpu_skip_frames + offcpu_max_frames];
+        int nr = backtrace_safe(bt, offcpu_skip_frames + offcpu_max_frames);
+        if (nr <= int(offcpu_skip_frames)) {
+            return;
+        }
+        _tables[sched::cpu::current()->id]->add(bt + offcpu_skip_frames,
+                nr - offcpu_skip_frames, ns);
+    }
+};
+
+static wait_probe _wait_probe;
+static wait_ret_probe _wait_ret_probe;
+
+static tracepoint_base& find_tracepoint(const char* name)
+{
+    for (auto& tp : tracepoint_base::tp_list) {
+        if (!strcmp(tp.name, name)) {
+            return tp;
+        }
+    }
+    abort("tracepoint %s not found\n", name);
+}
+
+static void stop_locked()
+{
+    if (!_running) {
+        return;
+    }
+    find_tracepoint("sched_wait").del_probe(&_wait_probe);
+    find_tracepoint("sched_wait_ret").del_probe(&_wait_ret_probe);
+    // Probes run with interrupts disabled, like RCU readers
+    osv::rcu_synchronize();
+    _running = false;
+}
+
+void start_offcpu_profiler(offcpu_config config)
+{
+    SCOPE_LOCK(_control_lock);
+    stop_locked();
+
+    _tables.clear();
+    _tables.resize(sched::cpus.size());
+    for (auto c : sched::cpus) {
+        _tables[c->id].reset(new offcpu_table(std::max(config.max_stacks, 1u)));
+    }
+    _session.fetch_add(1, std::memory_order_relaxed);
+
+    find_tracepoint("sched_wait_ret").add_probe(&_wait_ret_probe);
+    find_tracepoint("sched_wait").add_probe(&_wait_probe);
+    _running = true;
+}
+
+void stop_offcpu_profiler()
+{
+    SCOPE_LOCK(_control_lock);
+    stop_locked();
+}
+
+// Copy the stacks of a cpu's table, which its probes may be adding to
+static void copy_table(sched::cpu* cpu, offcpu_table& table,
+        std::vector<offcpu_stack>& stacks, u64& dropped_ns)
+{
+    std::vector<offcpu_stack> copy(table.stacks.size());
+    unsigned used;
+    std::unique_ptr<sched::thread> t(sched::thread::make([&] {
+        arch::irq_flag_notrace irq;
+        irq.save();
+        arch::irq_disable_notrace();
+        used = table.used;
+        std::copy(table.stacks.begin(), table.stacks.begin() + used, copy.begin());
+        dropped_ns += table.dropped_ns;
+        irq.restore();
+    }, sched::thread::attr().pin(cpu)));
+    t->start();
+    t->join();
+    stacks.insert(stacks.end(), copy.begin(), copy.begin() + used);
+}
+
+std::string offcpu_folded_stacks()
+{
+    std::vector<offcpu_stack> stacks;
+    u64 dropped_ns = 0;
+
+    WITH_LOCK(_control_lock) {
+        for (auto c : sched::cpus) {
+            if (!_tables.size()) {
+                break;
+            }
+            auto& table = *_tables[c->id];
+            if (_running) {
+                copy_table(c, table, stacks, dropped_ns);
+            } else {
+                stacks.insert(stacks.end(), table.stacks.begin(),
+                        table.stacks.begin() + table.used);
+                dropped_ns += table.dropped_ns;
+            }
+        }
+    }
+
+    // Different return addresses in the same functions fold into one line
+    std::map<std::string, u64> folded;
+    osv::demangler demangle;
+    for (auto& s : stacks) {
+        std::string line;
+        for (int i = s.len - 1; i >= 0; --i) {
+            // A return address may be past the end of the calling function
+            auto pc = static_cast<char*>(s.pc[i]) - 1;
+            auto ei = elf::get_program()->lookup_addr(pc);
+            if (!line.empty()) {
+                line += ';';
+            }
+            if (ei.sym) {
+                auto name = demangle(ei.sym);
+                line += name ? name : ei.sym;
+            } else {
+                line += osv::sprintf("%p", s.pc[i]);
+            }
+        }
+        folded[line] += s.ns;
+    }
+    if (dropped_ns) {
+        folded["[dropped]"] += dropped_ns;
+    }
+
+    std::string ret;
+    for (auto& f : folded) {
+        auto us = f.second / 1000;
+        if (us) {
+            ret += f.first + " " + std::to_string(us) + "\n";
+        }
+    }
+    return ret;
+}
+
+}
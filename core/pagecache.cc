@@ -6,16 +6,23 @@
  */
 
 
+#include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
+#include <map>
+#include <vector>
 #include <deque>
 #include <stack>
 #include <boost/variant.hpp>
+#include <boost/intrusive/list.hpp>
 #include <osv/pagecache.hh>
 #include <osv/mempool.hh>
 #include <fs/vfs/vfs.h>
 #include <osv/trace.hh>
 #include <osv/prio.hh>
+#include <osv/clock.hh>
+#include <osv/condvar.h>
+#include <osv/error.h>
 #include <chrono>
 
 extern "C" {
@@ -67,14 +74,47 @@ static unsigned lru_free_count = 20;
 constexpr unsigned max_lru_free_count = 200;
 static void* zero_page;
 
+// Pages of the write cache dirtied through shared mappings are written back
+// in the background by a flusher thread per device: those dirty for longer
+// than dirty_expire, and all of them once more than dirty_background_ratio
+// percent of the cache is dirty. Threads about to dirty a page are paused
+// while more than dirty_ratio percent is dirty or being written back.
+constexpr unsigned dirty_background_ratio = 25;
+constexpr unsigned dirty_ratio = 50;
+static unsigned dirty_background_pages;
+static unsigned dirty_limit_pages;
+constexpr std::chrono::seconds writeback_interval(1);
+constexpr std::chrono::seconds dirty_expire(5);
+constexpr std::chrono::milliseconds max_dirty_pause(200);
+constexpr unsigned max_writeback_batch = 64; // pages in one VOP_WRITE
+
 void  __attribute__((constructor(init_prio::pagecache))) setup()
 {
     lru_max_length = std::max(memory::phys_mem_size / memory::page_size / 100, size_t(100));
     lru_free_count = std::min(lru_max_length/5, max_lru_free_count);
+    dirty_background_pages = lru_max_length * dirty_background_ratio / 100;
+    dirty_limit_pages = lru_max_length * dirty_ratio / 100;
     zero_page = memory::alloc_page();
     memset(zero_page, 0, mmu::page_size);
 }
 
+// The error of a writeback nobody waits for stays on the vnode until the
+// next fsync() or msync() of the file reports it. Called with the vnode
+// lock held.
+static void record_writeback_error(struct vnode* vp, int error)
+{
+    if (error && !vp->v_wberror) {
+        vp->v_wberror = error;
+    }
+}
+
+int take_writeback_error(struct vnode* vp)
+{
+    int error = vp->v_wberror;
+    vp->v_wberror = 0;
+    return error;
+}
+
 class cached_page {
 protected:
     const hashkey _key;
@@ -189,10 +229,23 @@ public:
     }
 };
 
+// Pages of the write cache that are dirty, and being written back; both
+// protected by write_lock
+static unsigned write_dirty_pages;
+static unsigned writeback_pages;
+
 class cached_page_write : public cached_page {
 private:
     struct vnode* _vp;
     bool _dirty = false;
+    osv::clock::uptime::time_point _dirtied; // when the page last got dirty
+    unsigned _pins = 0; // writebacks in flight, which need the page kept
+    void mark_clean() {
+        if (_dirty) {
+            _dirty = false;
+            write_dirty_pages--;
+        }
+    }
 public:
     cached_page_write(hashkey key, vfs_file* fp) : cached_page(key, memory::alloc_page()) {
         _vp = fp->f_dentry->d_vnode;
@@ -213,10 +266,11 @@ public:
         struct iovec iov {_page, mmu::page_size};
         struct uio uio {&iov, 1, _key.offset, mmu::page_size, UIO_WRITE};
 
-        _dirty = false;
+        mark_clean();
 
         vn_lock(_vp);
         error = VOP_WRITE(_vp, &uio, 0);
+        record_writeback_error(_vp, error);
         vn_unlock(_vp);
 
         return error;
@@ -229,53 +283,103 @@ public:
         return p;
     }
     void mark_dirty() {
-        _dirty |= true;
+        if (!_dirty) {
+            _dirty = true;
+            _dirtied = osv::clock::uptime::now();
+            write_dirty_pages++;
+        }
+    }
+    bool dirty() const {
+        return _dirty;
+    }
+    osv::clock::uptime::time_point dirtied() const {
+        return _dirtied;
     }
     bool flush_check_dirty() {
         return for_each_pte([] (mmu::hw_ptep<0> pte) { return mmu::clear_pte(pte).dirty(); }, std::logical_or<bool>(), false);
     }
+    // The page is written back outside write_lock by write_pages(), and is
+    // not evicted until it is done. Writes to it from now on dirty it again.
+    void start_writeback() {
+        mark_clean();
+        _pins++;
+        writeback_pages++;
+    }
+    void end_writeback() {
+        _pins--;
+        writeback_pages--;
+    }
+    bool pinned() const {
+        return _pins;
+    }
+    bool mapped() {
+        return boost::get<std::nullptr_t>(&_ptes) == nullptr;
+    }
+    struct vnode* vnode() {
+        return _vp;
+    }
 };
 
 class cached_page_arc;
 
 unsigned drop_read_cached_page(cached_page_arc* cp, bool flush = true);
 
+// A page of a ZFS ARC buffer, or of another filesystem's shared_buf, in the
+// read cache. Both kinds are indexed by the address of their buffer.
 class cached_page_arc : public cached_page {
 public:
-    typedef std::unordered_multimap<arc_buf_t*, cached_page_arc*> arc_map;
+    typedef std::unordered_multimap<void*, cached_page_arc*> arc_map;
 
     static arc_map arc_cache_map;
 
 private:
-    arc_buf_t* _ab;
+    arc_buf_t* _ab = nullptr;
+    shared_buf* _sb = nullptr;
     bool _removed = false;
 
-    static arc_buf_t* ref(arc_buf_t* ab, cached_page_arc* pc)
+    // Returns true if this is the first page of the buffer
+    static bool ref(void* buf, cached_page_arc* pc)
     {
-        arc_cache_map.emplace(ab, pc);
-        return ab;
+        bool first = arc_cache_map.find(buf) == arc_cache_map.end();
+        arc_cache_map.emplace(buf, pc);
+        return first;
     }
 
-    static bool unref(arc_buf_t* ab, cached_page_arc* pc)
+    static bool unref(void* buf, cached_page_arc* pc)
     {
-        auto it = arc_cache_map.equal_range(ab);
+        auto it = arc_cache_map.equal_range(buf);
 
         arc_cache_map.erase(std::find(it.first, it.second, pc));
 
-        return arc_cache_map.find(ab) == arc_cache_map.end();
+        return arc_cache_map.find(buf) == arc_cache_map.end();
     }
 
 public:
-    cached_page_arc(hashkey key, void* page, arc_buf_t* ab) : cached_page(key, page), _ab(ref(ab, this)) {}
+    cached_page_arc(hashkey key, void* page, arc_buf_t* ab) : cached_page(key, page), _ab(ab) {
+        ref(ab, this);
+    }
+    cached_page_arc(hashkey key, void* page, shared_buf* sb) : cached_page(key, page), _sb(sb) {
+        if (ref(sb, this)) {
+            sb->share();
+        }
+    }
     ~cached_page_arc() {
-        if (!_removed && unref(_ab, this)) {
-            arc_unshare_buf(_ab);
+        if (!_removed && unref(buf(), this)) {
+            if (_sb) {
+                _sb->unshare();
+            } else {
+                arc_unshare_buf(_ab);
+            }
         }
     }
+    void* buf() {
+        return _sb ? static_cast<void*>(_sb) : static_cast<void*>(_ab);
+    }
+    // Null for pages of a shared_buf
     arc_buf_t* arcbuf() {
         return _ab;
     }
-    static void unmap_arc_buf(arc_buf_t* ab) {
+    static void unmap_arc_buf(void* ab) {
         auto it = arc_cache_map.equal_range(ab);
         unsigned count = 0;
 
@@ -295,7 +399,7 @@ static bool operator==(const cached_page_arc::arc_map::value_type& l, const cach
     return l.second == r;
 }
 
-std::unordered_multimap<arc_buf_t*, cached_page_arc*> cached_page_arc::arc_cache_map;
+std::unordered_multimap<void*, cached_page_arc*> cached_page_arc::arc_cache_map;
 static std::unordered_map<hashkey, cached_page_arc*> read_cache;
 static std::unordered_map<hashkey, cached_page_write*> write_cache;
 static std::deque<cached_page_write*> write_lru;
@@ -317,14 +421,14 @@ static T find_in_cache(std::unordered_map<hashkey, T>& cache, hashkey& key)
 TRACEPOINT(trace_add_read_mapping, "buf=%p, addr=%p, ptep=%p", void*, void*, void*);
 void add_read_mapping(cached_page_arc *cp, mmu::hw_ptep<0> ptep)
 {
-    trace_add_read_mapping(cp->arcbuf(), cp->addr(), ptep.release());
+    trace_add_read_mapping(cp->buf(), cp->addr(), ptep.release());
     cp->map(ptep);
 }
 
 TRACEPOINT(trace_remove_mapping, "buf=%p, addr=%p, ptep=%p", void*, void*, void*);
 void remove_read_mapping(cached_page_arc* cp, mmu::hw_ptep<0> ptep)
 {
-    trace_remove_mapping(cp->arcbuf(), cp->addr(), ptep.release());
+    trace_remove_mapping(cp->buf(), cp->addr(), ptep.release());
     if (cp->unmap(ptep) == 0) {
         read_cache.erase(cp->key());
         delete cp;
@@ -343,7 +447,7 @@ void remove_read_mapping(hashkey& key, mmu::hw_ptep<0> ptep)
 TRACEPOINT(trace_drop_read_cached_page, "buf=%p, addr=%p", void*, void*);
 unsigned drop_read_cached_page(cached_page_arc* cp, bool flush)
 {
-    trace_drop_read_cached_page(cp->arcbuf(), cp->addr());
+    trace_drop_read_cached_page(cp->buf(), cp->addr());
     int flushed = cp->flush();
     read_cache.erase(cp->key());
 
@@ -383,6 +487,39 @@ void map_arc_buf(hashkey *key, arc_buf_t* ab, void *page)
     arc_share_buf(ab);
 }
 
+TRACEPOINT(trace_map_shared_buf, "buf=%p page=%p", void*, void*);
+void map_shared_buf(hashkey *key, shared_buf* buf, void *page)
+{
+    trace_map_shared_buf(buf, page);
+    SCOPE_LOCK(arc_lock);
+    // Raced with another fault on the same page
+    if (read_cache.count(*key)) {
+        return;
+    }
+    cached_page_arc* pc = new cached_page_arc(*key, page, buf);
+    read_cache.emplace(*key, pc);
+}
+
+TRACEPOINT(trace_unmap_shared_buf, "buf=%p", void*);
+void unmap_shared_buf(shared_buf* buf)
+{
+    trace_unmap_shared_buf(buf);
+    SCOPE_LOCK(arc_lock);
+    cached_page_arc::unmap_arc_buf(buf);
+}
+
+bool try_unmap_shared_buf(shared_buf* buf)
+{
+    if (!arc_lock.try_lock()) {
+        return false;
+    }
+    trace_unmap_shared_buf(buf);
+    cached_page_arc::unmap_arc_buf(buf);
+    buf->unshare();
+    arc_lock.unlock();
+    return true;
+}
+
 static int create_read_cached_page(vfs_file* fp, hashkey& key)
 {
     return fp->get_arcbuf(&key, key.offset);
@@ -398,69 +535,909 @@ static std::unique_ptr<cached_page_write> create_write_cached_page(vfs_file* fp,
     return std::unique_ptr<cached_page_write>(cp);
 }
 
+static condvar writeback_done; // waited on with write_lock
+
+TRACEPOINT(trace_writeback_pages, "vp=%p, offset=%ld, pages=%u, error=%d", void*, off_t, unsigned, int);
+// Writes back pages taken by start_writeback(), sorted so that each run of
+// pages contiguous in a file goes in one VOP_WRITE, and lets them go.
+// Errors are recorded on the vnode, for the next fsync() or msync() of
+// the file. Called without write_lock.
+static void write_pages(std::vector<cached_page_write*>& pages)
+{
+    std::sort(pages.begin(), pages.end(), [] (cached_page_write* a, cached_page_write* b) {
+        return a->vnode() < b->vnode() || (a->vnode() == b->vnode() && a->key().offset < b->key().offset);
+    });
+
+    std::vector<struct iovec> iov;
+    for (size_t i = 0; i < pages.size();) {
+        auto vp = pages[i]->vnode();
+        off_t offset = pages[i]->key().offset;
+        iov.clear();
+        while (i + iov.size() < pages.size() && iov.size() < max_writeback_batch) {
+            auto cp = pages[i + iov.size()];
+            if (cp->vnode() != vp || cp->key().offset != offset + off_t(iov.size() * mmu::page_size)) {
+                break;
+            }
+            iov.push_back({cp->addr(), mmu::page_size});
+        }
+        struct uio uio {iov.data(), int(iov.size()), offset, ssize_t(iov.size() * mmu::page_size), UIO_WRITE};
+
+        vn_lock(vp);
+        int err = VOP_WRITE(vp, &uio, 0);
+        record_writeback_error(vp, err);
+        vn_unlock(vp);
+
+        trace_writeback_pages(vp, offset, iov.size(), err);
+        i += iov.size();
+    }
+
+    WITH_LOCK(write_lock) {
+        for (auto cp: pages) {
+            cp->end_writeback();
+        }
+    }
+    writeback_done.wake_all();
+}
+
+TRACEPOINT(trace_writeback_flusher, "dev=%lu, dirty=%u, writeback=%u", unsigned long, unsigned, unsigned);
+// Background writeback of the dirty pages of one device. Every
+// writeback_interval, or when kicked, it collects the dirty bits of the
+// ptes mapping its pages, and writes back the pages dirty for longer than
+// dirty_expire, or all of them when too many are dirty. While none of its
+// pages is mapped, dirty or being written back it sleeps until kicked or
+// woken by touch().
+class writeback_flusher {
+    const dev_t _dev;
+    // The device's pages in the write cache; all protected by write_lock
+    std::unordered_set<cached_page_write*> _pages;
+    bool _kicked = false;
+    bool _stopping = false;
+    condvar _wake;
+    std::unique_ptr<sched::thread> _thread;
+public:
+    explicit writeback_flusher(dev_t dev) : _dev(dev),
+        _thread(sched::thread::make(std::bind(&writeback_flusher::run, this),
+                sched::thread::attr().name("writeback-" + std::to_string(dev)))) {
+        _thread->start();
+    }
+    // Called without write_lock, once the device has no pages left
+    void stop() {
+        WITH_LOCK(write_lock) {
+            _stopping = true;
+            _wake.wake_one();
+        }
+        _thread->join();
+    }
+    // The rest is called with write_lock held
+    void kick() {
+        _kicked = true;
+        _wake.wake_one();
+    }
+    void add(cached_page_write* cp) {
+        _pages.insert(cp);
+        _wake.wake_one();
+    }
+    void remove(cached_page_write* cp) {
+        _pages.erase(cp);
+    }
+    bool empty() const {
+        return _pages.empty();
+    }
+    // A page got mapped, and may get dirty from now on
+    void touch() {
+        _wake.wake_one();
+    }
+
+private:
+    bool idle() {
+        return std::none_of(_pages.begin(), _pages.end(), [] (cached_page_write* cp) {
+            return cp->mapped() || cp->dirty() || cp->pinned();
+        });
+    }
+
+    void run()
+    {
+        std::vector<cached_page_write*> pages;
+        SCOPE_LOCK(write_lock);
+        while (!_stopping) {
+            if (!_kicked) {
+                if (idle()) {
+                    _wake.wait(&write_lock);
+                } else {
+                    _wake.wait(&write_lock, writeback_interval);
+                }
+            }
+            if (_stopping) {
+                break;
+            }
+            _kicked = false;
+
+            bool harvested = false;
+            for (auto cp: _pages) {
+                if (cp->clear_dirty()) {
+                    cp->mark_dirty();
+                    harvested = true;
+                }
+            }
+            // Writes through stale tlb entries would not dirty the ptes again
+            if (harvested) {
+                mmu::flush_tlb_all();
+            }
+
+            auto expired = osv::clock::uptime::now() - dirty_expire;
+            bool all = write_dirty_pages > dirty_background_pages;
+            for (auto cp: _pages) {
+                if (cp->dirty() && !cp->pinned() && (all || cp->dirtied() <= expired)) {
+                    cp->start_writeback();
+                    pages.push_back(cp);
+                }
+            }
+            trace_writeback_flusher(_dev, write_dirty_pages, writeback_pages);
+
+            if (!pages.empty()) {
+                DROP_LOCK(write_lock) {
+                    write_pages(pages);
+                }
+                pages.clear();
+            }
+        }
+    }
+};
+
+static std::unordered_map<dev_t, std::unique_ptr<writeback_flusher>> flushers; // protected by write_lock
+
+static void kick_flushers()
+{
+    for (auto&& f: flushers) {
+        f.second->kick();
+    }
+}
+
+TRACEPOINT(trace_dirty_throttle, "dirty=%u, writeback=%u", unsigned, unsigned);
+// Pauses a thread about to dirty a page of the write cache while too many
+// are dirty or under writeback, so that the flushers catch up. The pause
+// is bounded, as the thread may hold a vnode lock a flusher waits for.
+// Called with write_lock held, which is dropped while waiting.
+static void throttle_dirty()
+{
+    if (write_dirty_pages + writeback_pages <= dirty_limit_pages) {
+        return;
+    }
+    trace_dirty_throttle(write_dirty_pages, writeback_pages);
+    kick_flushers();
+    writeback_done.wait(&write_lock, max_dirty_pause);
+}
+
+// Below the low watermark the reclaimer is at work, and dirty pages are
+// written back on eviction instead of waiting for the flushers
+static bool memory_critical()
+{
+    return memory::stats::free() < memory::stats::total() - memory::stats::max_no_reclaim();
+}
+
 TRACEPOINT(trace_drop_write_cached_page, "addr=%p", void*);
 static void insert(cached_page_write* cp) {
     static cached_page_write* tofree[max_lru_free_count];
     write_cache.emplace(cp->key(), cp);
     write_lru.push_front(cp);
 
+    auto& flusher = flushers[cp->key().dev];
+    if (!flusher) {
+        flusher.reset(new writeback_flusher(cp->key().dev));
+    }
+    flusher->add(cp);
+
     if (write_lru.size() > lru_max_length) {
+        bool critical = memory_critical();
+        unsigned count = 0;
         for (unsigned i = 0; i < lru_free_count; i++) {
             cached_page_write *p = write_lru.back();
             write_lru.pop_back();
+            if (p->clear_dirty()) {
+                p->mark_dirty();
+            }
+            // Dirty pages are left to the flushers, evicting clean ones
+            if (p->pinned() || (p->dirty() && !critical)) {
+                write_lru.push_front(p);
+                continue;
+            }
             trace_drop_write_cached_page(p->addr());
             write_cache.erase(p->key());
+            flushers[p->key().dev]->remove(p);
             if (p->flush_check_dirty()) {
                 p->mark_dirty();
             }
-            tofree[i] = p;
+            tofree[count++] = p;
+        }
+        mmu::flush_tlb_all();
+        for (unsigned i = 0; i < count; i++) {
+            delete tofree[i];
+        }
+        if (count < lru_free_count) {
+            kick_flushers();
+        }
+    }
+    if (write_dirty_pages > dirty_background_pages) {
+        kick_flushers();
+    }
+}
+
+// Page cache for regular files on filesystems mounted with MNT_PAGECACHE.
+//
+// read() and write() go through these pages, and mmap() faults map them, so
+// a file read and mapped by several users is in memory once. Pages are kept
+// per file, keyed by the mount and inode number: unlike st_dev/st_ino these
+// need no VOP_GETATTR on every lookup. write() is write-through, so a page
+// only gets dirty through a shared writable mapping; it is written back by
+// msync() or when it is evicted.
+//
+// Consistency is close-to-open: the first access after each open() of the
+// file compares its mtime and size with those seen when its pages were
+// cached, and drops the pages on mismatch.
+//
+// Pages are pinned while data is copied to or from them outside file_lock,
+// and only unpinned pages are reclaimed by the shrinker. A pinned page that
+// is dropped from the cache is freed by its last unpin.
+class cached_page_file : public cached_page {
+private:
+    size_t _valid; // bytes at the start of the page that hold file data
+    struct vnode* _vp = nullptr; // held once mapped shared, for writeback
+    bool _dirty = false;
+    bool _dropped = false;
+    unsigned _pins = 0;
+public:
+    boost::intrusive::list_member_hook<> _lru_link;
+
+    cached_page_file(hashkey key, void* page, size_t valid) : cached_page(key, page), _valid(valid) {}
+    ~cached_page_file() {
+        memory::free_page(_page);
+        if (_vp) {
+            vrele(_vp);
+        }
+    }
+    size_t valid() const {
+        return _valid;
+    }
+    void set_valid(size_t valid) {
+        _valid = valid;
+    }
+    void hold_vnode(struct vnode* vp) {
+        if (!_vp) {
+            vref(vp);
+            _vp = vp;
         }
+    }
+    void mark_dirty() {
+        _dirty |= (_vp != nullptr);
+    }
+    bool dirty() const {
+        return _dirty;
+    }
+    struct vnode* vnode() const {
+        return _vp;
+    }
+    bool mapped() {
+        return boost::get<std::nullptr_t>(&_ptes) == nullptr;
+    }
+    bool flush_check_dirty() {
+        return for_each_pte([] (mmu::hw_ptep<0> pte) { return mmu::clear_pte(pte).dirty(); }, std::logical_or<bool>(), false);
+    }
+    void pin() {
+        _pins++;
+    }
+    bool pinned() const {
+        return _pins;
+    }
+    // Returns true if the page was dropped and should now be freed
+    bool unpin() {
+        return --_pins == 0 && _dropped;
+    }
+    // Returns true if the page can be freed right away
+    bool drop() {
+        _dropped = true;
+        return _pins == 0;
+    }
+    bool dropped() const {
+        return _dropped;
+    }
+    int writeback();
+};
+
+typedef boost::intrusive::list<cached_page_file,
+        boost::intrusive::member_hook<cached_page_file,
+                                      boost::intrusive::list_member_hook<>,
+                                      &cached_page_file::_lru_link>> file_lru_list;
+
+struct cached_file {
+    struct timespec mtime;
+    off_t size;
+    bool attrs_valid = false;
+    std::map<off_t, cached_page_file*> pages;
+};
+
+static std::unordered_map<hashkey, cached_file> file_cache; // key.offset is 0
+static file_lru_list file_lru; // most recently used first
+static mutex file_lock; // protects file_cache, file_lru and page pins
+
+bool enabled(struct vnode* vp)
+{
+    return vp->v_type == VREG && (vp->v_mount->m_flags & MNT_PAGECACHE);
+}
+
+static hashkey file_key(struct vnode* vp, off_t offset = 0)
+{
+    return hashkey {(dev_t)(uintptr_t)vp->v_mount, (ino_t)vp->v_ino, offset};
+}
+
+static hashkey file_key(cached_page_file* cp)
+{
+    return hashkey {cp->key().dev, cp->key().ino, 0};
+}
+
+static bool same_attrs(const cached_file& f, const struct vattr& va)
+{
+    return f.attrs_valid && f.size == va.va_size &&
+           f.mtime.tv_sec == va.va_mtime.tv_sec && f.mtime.tv_nsec == va.va_mtime.tv_nsec;
+}
+
+// Records the file's current attributes after we changed it ourselves.
+// Called with the vnode lock held.
+static void refresh_attrs(struct vnode* vp)
+{
+    struct vattr va;
+    int error = VOP_GETATTR(vp, &va);
+    SCOPE_LOCK(file_lock);
+    auto it = file_cache.find(file_key(vp));
+    if (it != file_cache.end()) {
+        auto& f = it->second;
+        f.attrs_valid = !error;
+        f.mtime = va.va_mtime;
+        f.size = va.va_size;
+    }
+}
+
+int cached_page_file::writeback()
+{
+    int error;
+    _dirty = false;
+    if (!_valid) {
+        return 0;
+    }
+
+    struct iovec iov {_page, _valid};
+    struct uio uio {&iov, 1, _key.offset, (ssize_t)_valid, UIO_WRITE};
+
+    vn_lock(_vp);
+    error = VOP_WRITE(_vp, &uio, 0);
+    if (!error) {
+        refresh_attrs(_vp);
+    }
+    record_writeback_error(_vp, error);
+    vn_unlock(_vp);
+
+    return error;
+}
+
+TRACEPOINT(trace_drop_file_cached_page, "addr=%p", void*);
+// Takes a page out of the LRU and unmaps it; the caller removes it from its
+// file. Returns true if the page was mapped, so a TLB flush is needed.
+// Called with file_lock held.
+static bool evict_file_page(cached_page_file* cp, std::vector<cached_page_file*>& tofree)
+{
+    trace_drop_file_cached_page(cp->addr());
+    file_lru.erase(file_lru.iterator_to(*cp));
+    bool mapped = cp->mapped();
+    if (cp->flush_check_dirty()) {
+        cp->mark_dirty();
+    }
+    if (cp->drop()) {
+        tofree.push_back(cp);
+    }
+    return mapped;
+}
+
+static void free_file_pages(std::vector<cached_page_file*>& pages, bool flush, bool writeback)
+{
+    if (flush) {
         mmu::flush_tlb_all();
-        for (auto p: tofree) {
-            delete p;
+    }
+    for (auto cp : pages) {
+        if (writeback && cp->dirty()) {
+            cp->writeback();
+        }
+        delete cp;
+    }
+}
+
+static void unpin(cached_page_file* cp)
+{
+    bool free;
+    WITH_LOCK(file_lock) {
+        free = cp->unpin();
+    }
+    if (free) {
+        delete cp;
+    }
+}
+
+// Drops the file's pages if it changed since they were cached. Called with
+// the vnode lock held before accessing the file's pages through it.
+static int validate(struct vnode* vp)
+{
+    auto key = file_key(vp);
+    if (vp->v_flags & VPAGECACHE) {
+        SCOPE_LOCK(file_lock);
+        auto it = file_cache.find(key);
+        if (it != file_cache.end() && it->second.attrs_valid) {
+            return 0;
+        }
+    }
+
+    struct vattr va;
+    int error = VOP_GETATTR(vp, &va);
+    if (error) {
+        return error;
+    }
+
+    std::vector<cached_page_file*> stale;
+    bool flush = false;
+    WITH_LOCK(file_lock) {
+        auto& f = file_cache[key];
+        // Pages cached since this vnode was validated are current, even
+        // if the shrinker lost the attributes meanwhile.
+        if (!(vp->v_flags & VPAGECACHE) && !same_attrs(f, va)) {
+            for (auto&& p : f.pages) {
+                flush |= evict_file_page(p.second, stale);
+            }
+            f.pages.clear();
         }
+        f.mtime = va.va_mtime;
+        f.size = va.va_size;
+        f.attrs_valid = true;
+    }
+    vp->v_flags |= VPAGECACHE;
+    free_file_pages(stale, flush, false);
+
+    return 0;
+}
+
+void open(struct vnode* vp)
+{
+    vp->v_flags &= ~VPAGECACHE;
+}
+
+// Largest read issued for a run of missing pages
+constexpr size_t max_cluster = 1 << 20;
+// Pages a fault reads along with the faulting one if they are missing
+constexpr size_t fault_cluster = 64 << 10;
+
+// Returns the page at the given offset pinned, reading it in if it is not
+// cached yet. A miss reads the whole run of missing pages up to end in one
+// VOP_READ, so that a large read or read-ahead makes few large requests to
+// the filesystem. Pages past the end of the file are not cached: past it
+// this returns nullptr with *error == 0. Called with the vnode lock held.
+static cached_page_file* get_file_page(struct vnode* vp, struct file* fp, off_t offset, off_t end, int* error)
+{
+    auto key = file_key(vp);
+    off_t run_end = std::min(end, offset + (off_t)max_cluster);
+    run_end = std::max(run_end, offset + (off_t)mmu::page_size);
+    WITH_LOCK(file_lock) {
+        auto it = file_cache.find(key);
+        if (it != file_cache.end()) {
+            auto& f = it->second;
+            auto p = f.pages.lower_bound(offset);
+            if (p != f.pages.end() && p->first == offset) {
+                auto cp = p->second;
+                cp->pin();
+                file_lru.erase(file_lru.iterator_to(*cp));
+                file_lru.push_front(*cp);
+                return cp;
+            }
+            if (p != f.pages.end()) {
+                run_end = std::min(run_end, p->first);
+            }
+            if (f.attrs_valid) {
+                if (offset >= f.size) {
+                    *error = 0;
+                    return nullptr;
+                }
+                run_end = std::min(run_end, f.size);
+            }
+        }
+    }
+    size_t npages = (run_end - offset + mmu::page_size - 1) / mmu::page_size;
+
+    std::vector<struct iovec> iov(npages);
+    for (auto&& v : iov) {
+        v.iov_base = memory::alloc_page();
+        v.iov_len = mmu::page_size;
+    }
+    ssize_t len = npages * mmu::page_size;
+    struct uio uio {iov.data(), (int)npages, offset, len, UIO_READ};
+
+    *error = VOP_READ(vp, fp, &uio, 0);
+    size_t got = *error ? 0 : len - uio.uio_resid;
+
+    cached_page_file* ret = nullptr;
+    std::vector<cached_page_file*> pages;
+    for (size_t i = 0; i < npages; i++) {
+        size_t valid = std::min(got, mmu::page_size);
+        got -= valid;
+        if (!valid) {
+            memory::free_page(iov[i].iov_base);
+            continue;
+        }
+        memset(static_cast<char*>(iov[i].iov_base) + valid, 0, mmu::page_size - valid);
+        pages.push_back(new cached_page_file(file_key(vp, offset + i * mmu::page_size),
+                                             iov[i].iov_base, valid));
+    }
+
+    // Pages are only added with the vnode lock held, so nobody can have
+    // added these meanwhile.
+    SCOPE_LOCK(file_lock);
+    auto& f = file_cache[key];
+    for (auto cp : pages) {
+        f.pages.emplace(cp->key().offset, cp);
+        file_lru.push_front(*cp);
+    }
+    if (!pages.empty()) {
+        ret = pages.front();
+        ret->pin();
+    }
+    return ret;
+}
+
+int read(struct vnode* vp, struct file* fp, struct uio* uio, int ioflag)
+{
+    if (uio->uio_offset < 0) {
+        return EINVAL;
+    }
+    int error = validate(vp);
+    if (error) {
+        return error;
+    }
+
+    off_t end = uio->uio_offset + uio->uio_resid;
+    while (uio->uio_resid > 0) {
+        off_t offset = uio->uio_offset & ~(off_t)(mmu::page_size - 1);
+        size_t in_page = uio->uio_offset - offset;
+        auto cp = get_file_page(vp, fp, offset, end, &error);
+        if (!cp) {
+            break;
+        }
+        size_t valid = cp->valid();
+        if (valid > in_page) {
+            error = uiomove(static_cast<char*>(cp->addr()) + in_page,
+                            std::min<size_t>(valid - in_page, uio->uio_resid), uio);
+        }
+        unpin(cp);
+        if (error || valid < mmu::page_size) {
+            // a partial page is the end of the file
+            break;
+        }
+    }
+
+    return error;
+}
+
+void readahead(struct vnode* vp, struct file* fp, off_t offset, size_t len)
+{
+    if (offset < 0 || validate(vp)) {
+        return;
+    }
+    off_t end = offset + len;
+    for (offset &= ~(off_t)(mmu::page_size - 1); offset < end; offset += mmu::page_size) {
+        int error;
+        auto cp = get_file_page(vp, fp, offset, end, &error);
+        if (!cp) {
+            break;
+        }
+        bool eof = cp->valid() < mmu::page_size;
+        unpin(cp);
+        if (eof) {
+            break;
+        }
+    }
+}
+
+static void copy_from_iov(const std::vector<struct iovec>& iov, size_t skip, char* dst, size_t len)
+{
+    for (auto&& v : iov) {
+        if (!len) {
+            break;
+        }
+        if (skip >= v.iov_len) {
+            skip -= v.iov_len;
+            continue;
+        }
+        size_t n = std::min(v.iov_len - skip, len);
+        memcpy(dst, static_cast<char*>(v.iov_base) + skip, n);
+        dst += n;
+        len -= n;
+        skip = 0;
+    }
+}
+
+int write(struct vnode* vp, struct uio* uio, int ioflag)
+{
+    std::vector<struct iovec> iov(uio->uio_iov, uio->uio_iov + uio->uio_iovcnt);
+    ssize_t bytes = uio->uio_resid;
+
+    int error = VOP_WRITE(vp, uio, ioflag);
+    size_t written = bytes - uio->uio_resid;
+    if (!written) {
+        return error;
+    }
+    // uio_offset is where the write ended, also for IO_APPEND
+    off_t start = uio->uio_offset - written;
+    off_t end = uio->uio_offset;
+
+    std::vector<cached_page_file*> pages;
+    bool cached = false;
+    WITH_LOCK(file_lock) {
+        auto it = file_cache.find(file_key(vp));
+        if (it != file_cache.end()) {
+            auto& f = it->second;
+            cached = !f.pages.empty();
+            for (auto p = f.pages.lower_bound(start & ~(off_t)(mmu::page_size - 1));
+                 p != f.pages.end() && p->first < end; ++p) {
+                p->second->pin();
+                pages.push_back(p->second);
+            }
+            if (!cached) {
+                // Nothing to update; validate() will pick up the new
+                // attributes should we cache anything later.
+                file_cache.erase(it);
+            }
+        }
+    }
+
+    for (auto cp : pages) {
+        off_t offset = cp->key().offset;
+        size_t from = std::max(start, offset) - offset;
+        size_t to = std::min(end, offset + (off_t)mmu::page_size) - offset;
+        char* addr = static_cast<char*>(cp->addr());
+        if (from > cp->valid()) {
+            // the write left a hole after the old end of the file
+            memset(addr + cp->valid(), 0, from - cp->valid());
+        }
+        copy_from_iov(iov, offset + from - start, addr + from, to - from);
+        cp->set_valid(std::max(cp->valid(), to));
+        unpin(cp);
+    }
+
+    if (cached) {
+        refresh_attrs(vp);
+    }
+
+    return error;
+}
+
+void truncate(struct vnode* vp, off_t length)
+{
+    std::vector<cached_page_file*> tofree;
+    bool flush = false;
+    WITH_LOCK(file_lock) {
+        auto it = file_cache.find(file_key(vp));
+        if (it == file_cache.end()) {
+            return;
+        }
+        auto& f = it->second;
+        for (auto p = f.pages.lower_bound(length); p != f.pages.end(); ) {
+            flush |= evict_file_page(p->second, tofree);
+            p = f.pages.erase(p);
+        }
+        if (!f.pages.empty()) {
+            auto cp = f.pages.rbegin()->second;
+            size_t valid = length - cp->key().offset;
+            if (valid < cp->valid()) {
+                memset(static_cast<char*>(cp->addr()) + valid, 0, cp->valid() - valid);
+                cp->set_valid(valid);
+            }
+        }
+    }
+    free_file_pages(tofree, flush, false);
+    refresh_attrs(vp);
+}
+
+// Writes back and drops the write cache pages of the filesystem's files
+// which are no longer mapped, and stops the flushers left without pages
+static void unmount_write_cache(struct mount* mp)
+{
+    std::vector<std::unique_ptr<writeback_flusher>> stopped;
+    WITH_LOCK(write_lock) {
+        auto busy = [mp] (cached_page_write* cp) {
+            return cp->vnode()->v_mount == mp && cp->pinned();
+        };
+        while (std::any_of(write_lru.begin(), write_lru.end(), busy)) {
+            writeback_done.wait(&write_lock);
+        }
+        for (auto it = write_lru.begin(); it != write_lru.end(); ) {
+            auto cp = *it;
+            if (cp->vnode()->v_mount != mp || cp->mapped()) {
+                ++it;
+                continue;
+            }
+            it = write_lru.erase(it);
+            write_cache.erase(cp->key());
+            flushers[cp->key().dev]->remove(cp);
+            delete cp;
+        }
+        for (auto it = flushers.begin(); it != flushers.end(); ) {
+            if (it->second->empty()) {
+                stopped.push_back(std::move(it->second));
+                it = flushers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto&& f : stopped) {
+        f->stop();
+    }
+}
+
+void unmount(struct mount* mp)
+{
+    unmount_write_cache(mp);
+    if (!(mp->m_flags & MNT_PAGECACHE)) {
+        return;
+    }
+
+    std::vector<cached_page_file*> tofree;
+    bool flush = false;
+    WITH_LOCK(file_lock) {
+        for (auto it = file_cache.begin(); it != file_cache.end(); ) {
+            if (it->first.dev != (dev_t)(uintptr_t)mp) {
+                ++it;
+                continue;
+            }
+            for (auto&& p : it->second.pages) {
+                flush |= evict_file_page(p.second, tofree);
+            }
+            it = file_cache.erase(it);
+        }
+    }
+    free_file_pages(tofree, flush, true);
+}
+
+static bool get_file(vfs_file* fp, struct vnode* vp, off_t offset, mmu::hw_ptep<0> ptep, mmu::pt_element<0> pte, bool write, bool shared)
+{
+    int error;
+    cached_page_file* cp = nullptr;
+
+    vn_lock(vp);
+    error = validate(vp);
+    if (!error) {
+        cp = get_file_page(vp, fp, offset, offset + fault_cluster, &error);
+    }
+    vn_unlock(vp);
+
+    if (!cp) {
+        // past the end of the file, or it could not be read: map as a hole
+        return mmu::write_pte(zero_page, ptep, mmu::pte_mark_cow(pte, true));
+    }
+
+    bool ret = false;
+    if (write && !shared) {
+        // cow of private page from the page cache
+        void* page = memory::alloc_page();
+        memcpy(page, cp->addr(), mmu::page_size);
+        WITH_LOCK(file_lock) {
+            auto old = ptep.read();
+            if (old.valid() && old.addr() == mmu::virt_to_phys(cp->addr())) {
+                cp->unmap(ptep);
+            }
+        }
+        unpin(cp);
+        return mmu::write_pte(page, ptep, pte);
+    }
+
+    WITH_LOCK(file_lock) {
+        // a dropped page makes the faulting thread re-fault and try again
+        if (!cp->dropped()) {
+            if (shared) {
+                cp->hold_vnode(vp);
+            }
+            cp->map(ptep);
+            ret = mmu::write_pte(cp->addr(), ptep, mmu::pte_mark_cow(pte, !shared));
+        }
+    }
+    unpin(cp);
+
+    return ret;
+}
+
+static bool release_file(struct vnode* vp, void *addr, off_t offset, mmu::hw_ptep<0> ptep)
+{
+    auto old = clear_pte(ptep);
+
+    WITH_LOCK(file_lock) {
+        auto it = file_cache.find(file_key(vp));
+        if (it != file_cache.end()) {
+            auto p = it->second.pages.find(offset);
+            if (p != it->second.pages.end() && mmu::virt_to_phys(p->second->addr()) == old.addr()) {
+                p->second->unmap(ptep);
+                if (old.dirty()) {
+                    p->second->mark_dirty();
+                }
+                return false;
+            }
+        }
+    }
+
+    // if a private page, caller will free it
+    return addr != zero_page;
+}
+
+static void sync_file(struct vnode* vp, off_t start, off_t end)
+{
+    std::vector<cached_page_file*> dirty;
+    WITH_LOCK(file_lock) {
+        auto it = file_cache.find(file_key(vp));
+        if (it == file_cache.end()) {
+            return;
+        }
+        auto& f = it->second;
+        for (auto p = f.pages.lower_bound(start); p != f.pages.end() && p->first < end; ++p) {
+            auto cp = p->second;
+            if (cp->clear_dirty()) {
+                cp->mark_dirty();
+            }
+            if (cp->dirty()) {
+                cp->pin();
+                dirty.push_back(cp);
+            }
+        }
+    }
+
+    mmu::flush_tlb_all();
+
+    int err = 0;
+    for (auto cp : dirty) {
+        if (!err) {
+            err = cp->writeback();
+        }
+        unpin(cp);
+    }
+    // Also reports the errors of earlier writebacks on eviction
+    vn_lock(vp);
+    err = take_writeback_error(vp);
+    vn_unlock(vp);
+    if (err) {
+        throw make_error(err);
     }
 }
 
 bool get(vfs_file* fp, off_t offset, mmu::hw_ptep<0> ptep, mmu::pt_element<0> pte, bool write, bool shared)
 {
+    struct vnode* vp = fp->f_dentry->d_vnode;
+    if (enabled(vp)) {
+        return get_file(fp, vp, offset, ptep, pte, write, shared);
+    }
+
     struct stat st;
     fp->stat(&st);
     hashkey key {st.st_dev, st.st_ino, offset};
     SCOPE_LOCK(write_lock);
+    if (write && shared && !(vp->v_mount->m_flags & MNT_DIRECTMAP)) {
+        throttle_dirty();
+    }
     cached_page_write* wcp = find_in_cache(write_cache, key);
 
-    if (write) {
-        if (!wcp) {
-            auto newcp = create_write_cached_page(fp, key);
-            if (shared) {
-                // write fault into shared mapping, there page is not in write cache yet, add it.
-                wcp = newcp.release();
-                insert(wcp);
-                // page is moved from ARC to write cache
-                // drop ARC page if exists, removing all mappings
-                drop_read_cached_page(key);
-            } else {
-                // remove mapping to ARC page if exists
-                remove_read_mapping(key, ptep);
-                // cow of private page from ARC
-                return mmu::write_pte(newcp->release(), ptep, pte);
-            }
-        } else if (!shared) {
-            // cow of private page from write cache
-            void* page = memory::alloc_page();
-            memcpy(page, wcp->addr(), mmu::page_size);
-            return mmu::write_pte(page, ptep, pte);
-        }
-    } else if (!wcp) {
+    // The pages of filesystems like ramfs are the file data itself, so
+    // shared mappings map them writable, with nothing to write back
+    bool direct = shared && !wcp && (vp->v_mount->m_flags & MNT_DIRECTMAP);
+
+    if (!wcp && (!write || direct)) {
         int ret;
-        // read fault and page is not in write cache yet, return one from ARC, mark it cow
+        // page is not in write cache yet, return one from ARC, mark it cow unless direct
         do {
             WITH_LOCK(arc_lock) {
                 cached_page_arc* cp = find_in_cache(read_cache, key);
                 if (cp) {
                     add_read_mapping(cp, ptep);
-                    return mmu::write_pte(cp->addr(), ptep, mmu::pte_mark_cow(pte, true));
+                    return mmu::write_pte(cp->addr(), ptep, mmu::pte_mark_cow(pte, !direct));
                 }
             }
 
@@ -469,6 +1446,10 @@ bool get(vfs_file* fp, off_t offset, mmu::hw_ptep<0> ptep, mmu::pt_element<0> pt
                 // function may sleep so drop write lock while executing it
                 ret = create_read_cached_page(fp, key);
             }
+            if (ret > 0) {
+                // the page could not be read, fail the fault
+                throw make_error(ret);
+            }
 
             // we dropped write lock, need to re-check write cache again
             wcp = find_in_cache(write_cache, key);
@@ -480,17 +1461,52 @@ bool get(vfs_file* fp, off_t offset, mmu::hw_ptep<0> ptep, mmu::pt_element<0> pt
 
         } while (ret != -1);
 
-        // try to access a hole in a file, map by zero_page            }
-        return mmu::write_pte(zero_page, ptep, mmu::pte_mark_cow(pte, true));
+        if (!write) {
+            // try to access a hole in a file, map by zero_page
+            return mmu::write_pte(zero_page, ptep, mmu::pte_mark_cow(pte, true));
+        }
+        // direct write past the end of the file, go through the write cache
+    }
+
+    if (write) {
+        if (!wcp) {
+            auto newcp = create_write_cached_page(fp, key);
+            if (shared) {
+                // write fault into shared mapping, there page is not in write cache yet, add it.
+                wcp = newcp.release();
+                insert(wcp);
+                // page is moved from ARC to write cache
+                // drop ARC page if exists, removing all mappings
+                drop_read_cached_page(key);
+            } else {
+                // remove mapping to ARC page if exists
+                remove_read_mapping(key, ptep);
+                // cow of private page from ARC
+                return mmu::write_pte(newcp->release(), ptep, pte);
+            }
+        } else if (!shared) {
+            // cow of private page from write cache
+            void* page = memory::alloc_page();
+            memcpy(page, wcp->addr(), mmu::page_size);
+            return mmu::write_pte(page, ptep, pte);
+        }
     }
 
     wcp->map(ptep);
+    if (shared) {
+        flushers[wcp->key().dev]->touch();
+    }
 
     return mmu::write_pte(wcp->addr(), ptep, mmu::pte_mark_cow(pte, !shared));
 }
 
 bool release(vfs_file* fp, void *addr, off_t offset, mmu::hw_ptep<0> ptep)
 {
+    struct vnode* vp = fp->f_dentry->d_vnode;
+    if (enabled(vp)) {
+        return release_file(vp, addr, offset, ptep);
+    }
+
     struct stat st;
     fp->stat(&st);
     hashkey key {st.st_dev, st.st_ino, offset};
@@ -528,28 +1544,45 @@ bool release(vfs_file* fp, void *addr, off_t offset, mmu::hw_ptep<0> ptep)
 
 void sync(vfs_file* fp, off_t start, off_t end)
 {
-    static std::stack<cached_page_write*> dirty; // protected by write_lock
+    struct vnode* vp = fp->f_dentry->d_vnode;
+    if (enabled(vp)) {
+        return sync_file(vp, start, end);
+    }
+
     struct stat st;
     fp->stat(&st);
     hashkey key {st.st_dev, st.st_ino, 0};
-    SCOPE_LOCK(write_lock);
+    std::vector<cached_page_write*> dirty;
 
-    for (key.offset = start; key.offset < end; key.offset += mmu::page_size) {
-        cached_page_write* cp = find_in_cache(write_cache, key);
-        if (cp && cp->clear_dirty()) {
-            dirty.push(cp);
+    WITH_LOCK(write_lock) {
+        for (key.offset = start; key.offset < end; key.offset += mmu::page_size) {
+            cached_page_write* cp;
+            // A writeback in flight may have copied the page before its last write
+            while ((cp = find_in_cache(write_cache, key)) && cp->pinned()) {
+                writeback_done.wait(&write_lock);
+            }
+            if (!cp) {
+                continue;
+            }
+            if (cp->clear_dirty()) {
+                cp->mark_dirty();
+            }
+            if (cp->dirty()) {
+                cp->start_writeback();
+                dirty.push_back(cp);
+            }
         }
-    }
 
-    mmu::flush_tlb_all();
+        mmu::flush_tlb_all();
+    }
 
-    while(!dirty.empty()) {
-        auto cp = dirty.top();
-        auto err = cp->writeback();
-        if (err) {
-            throw make_error(err);
-        }
-        dirty.pop();
+    write_pages(dirty);
+    // Also reports the errors of earlier writebacks in the background
+    vn_lock(vp);
+    auto err = take_writeback_error(vp);
+    vn_unlock(vp);
+    if (err) {
+        throw make_error(err);
     }
 }
 
@@ -602,8 +1635,11 @@ private:
                     }
                     std::for_each(cached_page_arc::arc_cache_map.begin(current_bucket), cached_page_arc::arc_cache_map.end(current_bucket),
                             [&accessed, &scanned, &cleared](cached_page_arc::arc_map::value_type& p) {
-                        auto arcbuf = p.first;
                         auto cp = p.second;
+                        auto arcbuf = cp->arcbuf();
+                        if (!arcbuf) {
+                            return;
+                        }
                         if (cp->clear_accessed()) {
                             arc_hashkey arc_hashkey;
                             arc_buf_get_hashkey(arcbuf, arc_hashkey.key);
@@ -649,5 +1685,60 @@ private:
 constexpr double access_scanner::_max_cpu;
 constexpr double access_scanner::_min_cpu;
 
+// Evicts least recently used pages of the file page cache, writing back
+// those dirtied through shared mappings. Writing back needs the vnode lock,
+// which the thread we are reclaiming memory for may hold while it allocates
+// a page in get_file_page(), so pages which may be dirty are skipped when
+// their vnode lock is taken.
+static class file_cache_shrinker : public memory::shrinker {
+public:
+    file_cache_shrinker() : shrinker("pagecache") {}
+    size_t request_memory(size_t n, bool hard)
+    {
+        std::vector<cached_page_file*> tofree;
+        std::vector<struct vnode*> locked;
+        bool flush = false;
+        size_t freed = 0;
+
+        // Whoever holds file_lock may be allocating memory itself
+        if (!file_lock.try_lock()) {
+            return 0;
+        }
+        auto it = file_lru.end();
+        while (freed < n && it != file_lru.begin()) {
+            auto cp = &*--it;
+            if (cp->pinned()) {
+                continue;
+            }
+            // Only pages mapped shared hold their vnode, and can be dirty
+            auto vp = cp->vnode();
+            if (vp) {
+                if (!vn_trylock(vp)) {
+                    continue;
+                }
+                // Freeing the page may drop the last reference
+                vref(vp);
+                locked.push_back(vp);
+            }
+            ++it; // evicting cp leaves iterators to other pages valid
+            auto f = file_cache.find(file_key(cp));
+            f->second.pages.erase(cp->key().offset);
+            if (f->second.pages.empty()) {
+                file_cache.erase(f);
+            }
+            flush |= evict_file_page(cp, tofree);
+            freed += mmu::page_size;
+        }
+        file_lock.unlock();
+
+        free_file_pages(tofree, flush, true);
+        for (auto vp : locked) {
+            vn_unlock(vp);
+            vrele(vp);
+        }
+        return freed;
+    }
+} s_file_cache_shrinker;
+
 
 }
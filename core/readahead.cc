@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include <osv/readahead.hh>
+#include <osv/trace.hh>
+#include <fcntl.h>
+#include <algorithm>
+
+TRACEPOINT(trace_readahead, "start=%d, len=%d, window=%d", off_t, size_t, size_t);
+
+namespace osv {
+namespace readahead {
+
+std::atomic<size_t> max_bytes{2 << 20};
+
+// First window of a stream, unless the reads themselves are larger
+constexpr size_t min_window = 64 << 10;
+
+state::range state::on_read(off_t offset, size_t len)
+{
+    off_t end = offset + len;
+    bool sequential = (offset == _next);
+    size_t max = max_bytes.load(std::memory_order_relaxed);
+
+    _next = end;
+    if (_advice == POSIX_FADV_RANDOM || !max || !len) {
+        return {end, 0};
+    }
+    if (!sequential && _advice != POSIX_FADV_SEQUENTIAL) {
+        _window = 0;
+        return {end, 0};
+    }
+
+    if (!sequential || !_window || _ra_end < end) {
+        // A new stream, or the reader caught up with the read-ahead
+        if (_advice == POSIX_FADV_SEQUENTIAL) {
+            _window = max;
+        } else {
+            _window = std::min(max, std::max(4 * len, min_window));
+        }
+        _ra_end = end;
+    } else if (_ra_end - end > (off_t)_window / 2) {
+        // Still well ahead of the reader
+        return {end, 0};
+    } else {
+        _window = std::min(max, 2 * _window);
+    }
+
+    off_t start = _ra_end;
+    _ra_end = end + _window;
+    trace_readahead(start, _ra_end - start, _window);
+    return {start, size_t(_ra_end - start)};
+}
+
+void state::advise(int advice)
+{
+    _advice = advice;
+    _window = 0;
+}
+
+}
+}
@@ -8,6 +8,7 @@
 #include <mutex>
 #include <osv/sched.hh>
 #include <osv/rwlock.h>
+#include <osv/lockstat.hh>
 
 rwlock::rwlock()
     : _readers(0),
@@ -26,9 +27,13 @@ rwlock::~rwlock()
 void rwlock::rlock()
 {
     std::lock_guard<mutex> guard(_mtx);
+    uint64_t wait_start = lockstat::enabled && !read_lockable() ? lockstat::now() : 0;
     reader_wait_lockable();
 
     _readers++;
+    if (lockstat::enabled) {
+        lockstat::acquired(this, lockstat::lock_type::rwlock, __builtin_return_address(0), wait_start);
+    }
 }
 
 bool rwlock::try_rlock()
@@ -39,6 +44,9 @@ bool rwlock::try_rlock()
     }
 
     _readers++;
+    if (lockstat::enabled) {
+        lockstat::acquired(this, lockstat::lock_type::rwlock, __builtin_return_address(0), 0);
+    }
     return true;
 }
 
@@ -47,6 +55,9 @@ void rwlock::runlock()
     WITH_LOCK(_mtx) {
         assert(_wowner == nullptr);
         assert(_readers > 0);
+        if (lockstat::enabled) {
+            lockstat::released(this);
+        }
 
         // If we are the last reader and we have a write waiter,
         // then wake up one writer
@@ -74,11 +85,14 @@ bool rwlock::try_upgrade()
 void rwlock::wlock()
 {
     std::lock_guard<mutex> guard(_mtx);
+    uint64_t wait_start = lockstat::enabled && !write_lockable() ? lockstat::now() : 0;
     writer_wait_lockable();
 
     // recursive write lock
     if (_wowner == sched::thread::current()) {
         _wrecurse++;
+    } else if (lockstat::enabled) {
+        lockstat::acquired(this, lockstat::lock_type::rwlock, __builtin_return_address(0), wait_start);
     }
 
     _wowner = sched::thread::current();
@@ -94,6 +108,8 @@ bool rwlock::try_wlock()
     // recursive write lock
     if (_wowner == sched::thread::current()) {
         _wrecurse++;
+    } else if (lockstat::enabled) {
+        lockstat::acquired(this, lockstat::lock_type::rwlock, __builtin_return_address(0), 0);
     }
 
     _wowner = sched::thread::current();
@@ -109,6 +125,9 @@ void rwlock::wunlock()
             _wrecurse--;
         } else {
             _wowner = nullptr;
+            if (lockstat::enabled) {
+                lockstat::released(this);
+            }
         }
 
         if (!_write_waiters.empty()) {
@@ -3,6 +3,7 @@
 #include <osv/debug.hh>
 #include <osv/sched.hh>
 #include <osv/dhcp.hh>
+#include <osv/tracecontrol.hh>
 
 extern void vfs_exit(void);
 
@@ -33,6 +34,10 @@ void shutdown()
         });
     }
 
+    // Write out what is left of the trace stream while its file, if any,
+    // can still be written to
+    trace::stop_trace_stream();
+
     vfs_exit();
     debug("Powering off.\n");
     osv::poweroff();
@@ -7,15 +7,23 @@
 
 #include <osv/spinlock.h>
 #include <osv/sched.hh>
+#include <osv/lockstat.hh>
 
 void spin_lock(spinlock_t *sl)
 {
     sched::preempt_disable();
+    uint64_t wait_start = 0;
     while (__sync_lock_test_and_set(&sl->_lock, 1)) {
+        if (lockstat::enabled && !wait_start) {
+            wait_start = lockstat::now();
+        }
         while (sl->_lock) {
             barrier();
         }
     }
+    if (lockstat::enabled) {
+        lockstat::acquired(sl, lockstat::lock_type::spinlock, __builtin_return_address(0), wait_start);
+    }
 }
 
 bool spin_trylock(spinlock_t *sl)
@@ -25,11 +33,17 @@ bool spin_trylock(spinlock_t *sl)
         sched::preempt_enable();
         return false;
     }
+    if (lockstat::enabled) {
+        lockstat::acquired(sl, lockstat::lock_type::spinlock, __builtin_return_address(0), 0);
+    }
     return true;
 }
 
 void spin_unlock(spinlock_t *sl)
 {
+    if (lockstat::enabled) {
+        lockstat::released(sl);
+    }
     __sync_lock_release(&sl->_lock, 0);
     sched::preempt_enable();
 }
@@ -13,7 +13,10 @@
 #include <atomic>
 #include <regex>
 #include <fstream>
+#include <sstream>
+#include <system_error>
 #include <unordered_map>
+#include <unordered_set>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/range/algorithm/remove.hpp>
 #include <sys/types.h>
@@ -26,6 +29,7 @@
 #include <osv/ilog2.hh>
 #include <osv/semaphore.hh>
 #include <osv/elf.hh>
+#include <osv/printf.hh>
 #include <cxxabi.h>
 
 using namespace std;
@@ -95,6 +99,11 @@ struct trace_buf {
         return index(_last);
     }
 
+    // The page holding position @pos, as counted by _last
+    const char * page(size_t pos) const {
+        return &_base.get()[index(align_down(pos, trace_page_size))];
+    }
+
     trace_record * allocate_trace_record(size_t size) {
         size += sizeof(trace_record);
         size = align_up(size, sizeof(long));
@@ -516,43 +525,29 @@ trace::remove_symbol_callback(generator_id id) {
     }
 }
 
-// Helper type to build trace dump binary files
-class trace_out: public std::ofstream {
+// Helper type to build trace dump binary files, either in a file
+// (trace_out) or in memory (trace_chunk_out)
+template <typename Stream>
+class basic_trace_out: public Stream {
 public:
-    std::string path;
-
-    trace_out() {
-        for (;;) {
-            std::unique_ptr<char> tmp(::tempnam(nullptr, nullptr));
-            if (tmp) {
-                auto f = ::open(tmp.get(), O_EXCL | O_CREAT);
-                if (f != -1) {
-                    ofstream::open(tmp.get(), ios::out|ios::binary);
-                    path = tmp.get();
-                    ::close(f);
-                    break;
-                }
-            }
-        }
-    }
-    trace_out & align(size_t a) {
-        while (tellp() & (a - 1)) {
-            put(0);
+    basic_trace_out & align(size_t a) {
+        while (this->tellp() & (a - 1)) {
+            this->put(0);
         }
         return *this;
     }
-    template<typename T> trace_out & align() {
+    template<typename T> basic_trace_out & align() {
         return align(std::alignment_of<T>::value);
     }
 
-    using std::ofstream::write;
+    using Stream::write;
 
-    template<typename T> trace_out & write(T && t) {
+    template<typename T> basic_trace_out & write(T && t) {
         align<T>();
-        write(reinterpret_cast<const char_type*>(&t), sizeof(t));
+        write(reinterpret_cast<const typename Stream::char_type*>(&t), sizeof(t));
         return *this;
     }
-    template<typename T> trace_out & twrite(const char *& s) {
+    template<typename T> basic_trace_out & twrite(const char *& s) {
         const auto a = object_serializer<T>().alignment();
         s = align_up(s, a);
         align(a);
@@ -560,29 +555,51 @@ public:
         s += sizeof(T);
         return *this;
     }
-    template<typename T> trace_out & twrite(const char *& s, size_t n) {
+    template<typename T> basic_trace_out & twrite(const char *& s, size_t n) {
         while (n-- > 0) {
             twrite<T>(s);
         }
         return *this;
     }
-    trace_out & swrite(const char * s) {
+    basic_trace_out & swrite(const char * s) {
         size_t len = s != nullptr ? strlen(s) : 0;
         write(u16(len));
         write(s, len);
         return *this;
     }
-    trace_out & swrite(const std::string & s) {
+    basic_trace_out & swrite(const std::string & s) {
         write(u16(s.size()));
         write(s.c_str(), s.size());
         return *this;
     }
 };
 
-template<typename T = uint32_t>
+class trace_out: public basic_trace_out<std::ofstream> {
+public:
+    std::string path;
+
+    trace_out() {
+        for (;;) {
+            std::unique_ptr<char> tmp(::tempnam(nullptr, nullptr));
+            if (tmp) {
+                auto f = ::open(tmp.get(), O_EXCL | O_CREAT);
+                if (f != -1) {
+                    ofstream::open(tmp.get(), ios::out|ios::binary);
+                    path = tmp.get();
+                    ::close(f);
+                    break;
+                }
+            }
+        }
+    }
+};
+
+typedef basic_trace_out<std::ostringstream> trace_chunk_out;
+
+template<typename Out, typename T = uint32_t>
 struct length {
 public:
-    length(trace_out & out, T v = T()) :
+    length(Out & out, T v = T()) :
             value(v), _out(out), _pos(out.tellp()) {
         out.write(T());
     }
@@ -594,10 +611,48 @@ public:
     }
     T value;
 private:
-    trace_out & _out;
-    trace_out::pos_type _pos;
+    Out & _out;
+    typename Out::pos_type _pos;
+};
+
+// Dealing with 'FOUR' fourcc tags
+struct tag {
+    tag(const char (&s)[5]) :
+        _val((s[0] << 24) | (s[1] << 16) | (s[2] << 8) | s[3])
+    {}
+    operator uint32_t() const {
+        return _val;
+    }
+    const uint32_t _val;
+};
+
+// RIFF-like chunk (see file format description).
+// Always aligned on 8
+template<typename Out>
+class chunk {
+public:
+    chunk(Out & out, const tag & tt) :
+            _out(out) {
+        out.align(8);
+        out.write(uint32_t(tt));
+        out.align(8);
+        _pos = out.tellp();
+        out.write(uint64_t(0));
+    }
+    ~chunk() {
+        auto p = _out.tellp();
+        _out.seekp(_pos);
+        _out.write(uint64_t(p - _pos - sizeof(uint64_t)));
+        _out.seekp(p);
+    }
+private:
+    Out & _out;
+    typename Out::pos_type _pos;
 };
 
+static const int tf_version_major = 0;
+static const int tf_version_minor = 1;
+
 /*
   Format (please keep in sync with doc/wiki)
 
@@ -690,24 +745,247 @@ dump = <chunk> {
     <align 8>
     //<raw traces, but with gaps removed>
   } +; // 1 or more
+
+  lost_pages = <chunk, align 8> {
+    uint32_t tag = 'LOST';
+    uint64_t size = <chunk size>;
+    uint32_t cpu;
+    uint64_t n_pages; // trace pages overwritten before they were streamed
+  } *; // zero or more, streams only
 };
 
+A stream (see trace::start_trace_stream()) is a dump of unknown size, so
+its size is written as 0. Its trace data chunks, each holding the records
+of consecutive pages of one cpu's buffer, follow the other chunks as they
+are produced, and module lists and symbol tables are repeated when
+modules are loaded or unloaded.
+
  */
-std::string
-trace::create_trace_dump()
+
+template<typename Out>
+static void write_trace_dictionary(Out & out)
 {
-    semaphore signal(0);
-    std::vector<trace_buf> copies;
+    chunk<Out> dict(out, "TRCD");
 
-    auto is_valid_tracepoint = [](const tracepoint_base * tp_test) {
-        for (auto & tp : tracepoint_base::tp_list) {
-            if (&tp == tp_test) {
-                return true;
+    out.write(uint32_t(tracepoint_base::backtrace_len));
+    out.write(uint32_t(tracepoint_base::tp_list.size()));
+
+    for (auto & tp : tracepoint_base::tp_list) {
+        out.write(reinterpret_cast<uint64_t>(&tp)); // tag/ptr
+        out.swrite(tp.name); // id
+        out.swrite(tp.name); // name (TODO: useful names)
+        out.swrite("OSv"); // provider
+        out.swrite(tp.format); // print format (?)
+        out.template write<uint32_t>(strlen(tp.sig));
+        int n = 0;
+        auto s = tp.sig;
+        while (*s) {
+            out.swrite(std::to_string(n++)); // no arg names
+            out.write(*s);
+            ++s;
+        }
+    }
+}
+
+template<typename Out>
+static void write_module_tables(Out & out, const elf::program::modules_list &ml)
+{
+    {
+        chunk<Out> mods(out, "MODS");
+        out.write(uint32_t(ml.objects.size()));
+        for (auto module : ml.objects) {
+            out.swrite(module->pathname());
+            out.write(uint64_t(module->base()));
+            out.write(uint64_t(module->end()) - uint64_t(module->base()));
+
+            if (module->module_index() == elf::program::core_module_index) {
+                out.write(uint32_t(0));
+                continue;
+            }
+            // Sections
+            auto sections = module->sections();
+            out.write(uint32_t(sections.size()));
+            for (auto & section : sections) {
+                out.swrite(module->section_name(section));
+                out.write(uint32_t(section.sh_type));
+                out.write(uint32_t(section.sh_info));
+                out.write(uint64_t(section.sh_flags));
+                out.write(uint64_t(section.sh_addr));
+                out.write(uint64_t(section.sh_offset));
+                out.write(uint64_t(section.sh_size));
+            }
+        }
+    }
+
+    struct demangler {
+        demangler()
+        {}
+        ~demangler()
+        {
+            if (buf) {
+                free(buf);
             }
         }
-        return false;
+        const char * operator()(const char * name) {
+            int status;
+            auto * demangled = abi::__cxa_demangle(name, buf, &len, &status);
+            if (demangled) {
+                buf = demangled;
+                return buf;
+            }
+            return name;
+        }
+    private:
+        char * buf = nullptr;
+        size_t len = 0;
     };
 
+    demangler demangle;
+
+    for (auto module : ml.objects) {
+        auto syms = module->symbols();
+        if (syms.empty()) {
+            continue;
+        }
+        chunk<Out> mods(out, "SYMB");
+        length<Out> len(out);
+        for (auto & es : syms) {
+            auto t = es.st_info & elf::STT_HIPROC;
+            if (t != elf::STT_FUNC && t != elf::STT_OBJECT) {
+                continue;
+            }
+            auto * n = module->symbol_name(&es);
+            if (n && *n) {
+                elf::symbol_module m(&es, module);
+                ++len.value;
+                out.swrite(demangle(n));
+                out.write(uint64_t(m.relocated_addr()));
+                out.write(uint64_t(m.size()));
+                out.swrite(nullptr);
+                out.write(uint32_t(0));
+            }
+        }
+    }
+}
+
+template<typename Out>
+static void write_symbol_tables(Out & out)
+{
+    WITH_LOCK(symbol_func_mutex) {
+        for (auto & p : symbol_functions) {
+            chunk<Out> symb(out, "SYMB");
+            length<Out> len(out);
+            p.second([&](const trace::symbol & s) {
+                ++len.value;
+                out.swrite(s.name);
+                out.write(uint64_t(s.addr));
+                out.write(uint64_t(s.size));
+                out.swrite(s.filename);
+                out.write(s.n_locations);
+                for (uint32_t i = 0; i < s.n_locations; ++i) {
+                    auto loc = s.location(i);
+                    out.write(loc.first);
+                    out.write(loc.second);
+                }
+            });
+        }
+    }
+}
+
+typedef std::unordered_set<const tracepoint_base*> tracepoint_set;
+
+static tracepoint_set valid_tracepoints()
+{
+    tracepoint_set ret;
+    for (auto & tp : tracepoint_base::tp_list) {
+        ret.insert(&tp);
+    }
+    return ret;
+}
+
+// Writes the trace records in [s, e), a page aligned region of a trace
+// buffer, without the padding at the end of its pages
+template<typename Out>
+static void write_trace_records(Out & out, const char * s, const char * e,
+        const tracepoint_set & valid)
+{
+    const char * start = s;
+
+    while (s < e) {
+        auto * tr = reinterpret_cast<const trace_record*>(s);
+        if (tr->tp == nullptr) {
+            // alignment up to 8 is fine on the pointer itself.
+            // page alignment we must do per offset.
+            size_t off = s - start;
+            s = start + align_up(off + 1, trace_page_size);
+            continue;
+        }
+        if (tr->tp == trace_buf::invalid_trace_point) {
+            break;
+        }
+
+        assert(valid.count(tr->tp));
+
+        out.template twrite<trace_record>(s);
+
+        if (tr->backtrace) {
+            out.template twrite<void *>(s, tracepoint_base::backtrace_len);
+        }
+        auto sig = tr->tp->sig;
+        while (*sig != 0) {
+            switch (*sig++) {
+            case 'c':
+                out.template twrite<char>(s);
+                break;
+            case 'b':
+            case 'B':
+                out.template twrite<u8>(s);
+                break;
+            case 'h':
+            case 'H':
+                out.template twrite<u16>(s);
+                break;
+            case 'i':
+            case 'I':
+            case 'f':
+                out.template twrite<u32>(s);
+                break;
+            case 'q':
+            case 'Q':
+            case 'd':
+            case 'P':
+                out.template twrite<u64>(s);
+                break;
+            case '?':
+                out.template twrite<bool>(s);
+                break;
+            case 'p': {
+                out.template twrite<char>(s,
+                        object_serializer<const char*>::max_len);
+                break;
+            }
+            case '*': {
+                s = align_up(s, sizeof(u16));
+                auto len = *reinterpret_cast<const u16*>(s);
+                s += 2;
+                out.write(len);
+                out.template twrite<char>(s, len);
+                break;
+            }
+            default:
+                assert(0 && "should not reach");
+            }
+        }
+        s = align_up(s, sizeof(long));
+    }
+}
+
+std::string
+trace::create_trace_dump()
+{
+    semaphore signal(0);
+    std::vector<trace_buf> copies;
+
     // Copy the trace buffers from each cpu, locking out trace generation
     // during the extraction (disable preemption, just like trace write)
     unsigned i = 0;
@@ -728,42 +1006,7 @@ trace::create_trace_dump()
     // Redundant. But just to verify.
     signal.wait(sched::cpus.size());
 
-    // Dealing with 'FOUR' fourcc tags
-    struct tag {
-        tag(const char (&s)[5]) :
-            _val((s[0] << 24) | (s[1] << 16) | (s[2] << 8) | s[3])
-        {}
-        operator uint32_t() const {
-            return _val;
-        }
-        const uint32_t _val;
-    };
-
-    // RIFF-like chunk (see file format description).
-    // Always aligned on 8
-    class chunk {
-    public:
-        chunk(trace_out & out, const tag & tt) :
-                _out(out) {
-            out.align(8);
-            out.write(uint32_t(tt));
-            out.align(8);
-            _pos = out.tellp();
-            out.write(uint64_t(0));
-        }
-        ~chunk() {
-            auto p = _out.tellp();
-            _out.seekp(_pos);
-            _out.write(uint64_t(p - _pos - sizeof(uint64_t)));
-            _out.seekp(p);
-        }
-    private:
-        trace_out & _out;
-        trace_out::pos_type _pos;
-    };
-
-    static const int tf_version_major = 0;
-    static const int tf_version_minor = 1;
+    auto valid = valid_tracepoints();
 
     trace_out out;
 
@@ -771,141 +1014,22 @@ trace::create_trace_dump()
     out.exceptions(trace_out::failbit);
 
     {
-        chunk osvt(out, "OSVT"); // magic
+        chunk<trace_out> osvt(out, "OSVT"); // magic
         out.write(uint32_t(1)); // endian (verify)
         out.write(uint32_t((tf_version_major << 16) | tf_version_minor)); // version
 
         // Trace dictionary
-        {
-            chunk dict(out, "TRCD");
-
-            out.write(uint32_t(tracepoint_base::backtrace_len));
-            out.write(uint32_t(tracepoint_base::tp_list.size()));
-
-            for (auto & tp : tracepoint_base::tp_list) {
-                out.write(reinterpret_cast<uint64_t>(&tp)); // tag/ptr
-                out.swrite(tp.name); // id
-                out.swrite(tp.name); // name (TODO: useful names)
-                out.swrite("OSv"); // provider
-                out.swrite(tp.format); // print format (?)
-                out.write<uint32_t>(strlen(tp.sig));
-                int n = 0;
-                auto s = tp.sig;
-                while (*s) {
-                    out.swrite(std::to_string(n++)); // no arg names
-                    out.write(*s);
-                    ++s;
-                }
-            }
-        }
+        write_trace_dictionary(out);
 
-        { // Module list
-            elf::get_program()->with_modules(
-                    [&](const elf::program::modules_list &ml)
-                    {
-                        {
-                            chunk mods(out, "MODS");
-                            out.write(uint32_t(ml.objects.size()));
-                            for (auto module : ml.objects) {
-                                out.swrite(module->pathname());
-                                out.write(uint64_t(module->base()));
-                                out.write(uint64_t(module->end()) - uint64_t(module->base()));
-
-                                if (module->module_index() == elf::program::core_module_index) {
-                                    out.write(uint32_t(0));
-                                    continue;
-                                }
-                                // Sections
-                                auto sections = module->sections();
-                                out.write(uint32_t(sections.size()));
-                                for (auto & section : sections) {
-                                    out.swrite(module->section_name(section));
-                                    out.write(uint32_t(section.sh_type));
-                                    out.write(uint32_t(section.sh_info));
-                                    out.write(uint64_t(section.sh_flags));
-                                    out.write(uint64_t(section.sh_addr));
-                                    out.write(uint64_t(section.sh_offset));
-                                    out.write(uint64_t(section.sh_size));
-                                }
-                            }
-                        }
-
-                        struct demangler {
-                            demangler()
-                            {}
-                            ~demangler()
-                            {
-                                if (buf) {
-                                    free(buf);
-                                }
-                            }
-                            const char * operator()(const char * name) {
-                                int status;
-                                auto * demangled = abi::__cxa_demangle(name, buf, &len, &status);
-                                if (demangled) {
-                                    buf = demangled;
-                                    return buf;
-                                }
-                                return name;
-                            }
-                        private:
-                            char * buf = nullptr;
-                            size_t len = 0;
-                        };
-
-                        demangler demangle;
-
-                        for (auto module : ml.objects) {
-                            auto syms = module->symbols();
-                            if (syms.empty()) {
-                                continue;
-                            }
-                            chunk mods(out, "SYMB");
-                            length<> len(out);
-                            for (auto & es : syms) {
-                                auto t = es.st_info & elf::STT_HIPROC;
-                                if (t != elf::STT_FUNC && t != elf::STT_OBJECT) {
-                                    continue;
-                                }
-                                auto * n = module->symbol_name(&es);
-                                if (n && *n) {
-                                    elf::symbol_module m(&es, module);
-                                    ++len.value;
-                                    out.swrite(demangle(n));
-                                    out.write(uint64_t(m.relocated_addr()));
-                                    out.write(uint64_t(m.size()));
-                                    out.swrite(nullptr);
-                                    out.write(uint32_t(0));
-                                }
-                            }
-
-                        }
-                    });
-        }
+        // Module list
+        elf::get_program()->with_modules(
+                [&](const elf::program::modules_list &ml)
+                {
+                    write_module_tables(out, ml);
+                });
 
-
-        {
-            // Symbol tables
-            WITH_LOCK(symbol_func_mutex) {
-                for (auto & p : symbol_functions) {
-                    chunk symb(out, "SYMB");
-                    length<> len(out);
-                    p.second([&](const symbol & s) {
-                        ++len.value;
-                        out.swrite(s.name);
-                        out.write(uint64_t(s.addr));
-                        out.write(uint64_t(s.size));
-                        out.swrite(s.filename);
-                        out.write(s.n_locations);
-                        for (uint32_t i = 0; i < s.n_locations; ++i) {
-                            auto loc = s.location(i);
-                            out.write(loc.first);
-                            out.write(loc.second);
-                        }
-                    });
-                }
-            }
-        }
+        // Symbol tables
+        write_symbol_tables(out);
 
         // Trace data, one chunk for each cpu buffer
         for (auto & buf : copies) {
@@ -915,87 +1039,242 @@ trace::create_trace_dump()
                     buf._base.get() + buf._size), std::make_pair(
                     buf._base.get(), buf._base.get() + last) };
 
-            chunk trcs(out, "TRCS");
+            chunk<trace_out> trcs(out, "TRCS");
 
             out.align(8);
 
             for (auto & r : regs) {
-                const char * s = r.first;
-                const char * e = r.second;
-
-                while (s < e) {
-                    auto * tr = reinterpret_cast<const trace_record*>(s);
-                    if (tr->tp == nullptr) {
-                        // alignment up to 8 is fine on the pointer itself.
-                        // page alignment we must do per offset.
-                        size_t off = s - r.first;
-                        s = r.first + align_up(off + 1, trace_page_size);
-                        continue;
-                    }
-                    if (tr->tp == trace_buf::invalid_trace_point) {
-                        break;
-                    }
+                write_trace_records(out, r.first, r.second, valid);
+            }
+        }
 
-                    assert(is_valid_tracepoint(tr->tp));
+    }
+    out.flush();
+    out.close();
 
-                    out.twrite<trace_record>(s);
+    return std::move(out.path);
+}
 
-                    if (tr->backtrace) {
-                        out.twrite<void *>(s, tracepoint_base::backtrace_len);
-                    }
-                    auto sig = tr->tp->sig;
-                    while (*sig != 0) {
-                        switch (*sig++) {
-                        case 'c':
-                            out.twrite<char>(s);
-                            break;
-                        case 'b':
-                        case 'B':
-                            out.twrite<u8>(s);
-                            break;
-                        case 'h':
-                        case 'H':
-                            out.twrite<u16>(s);
-                            break;
-                        case 'i':
-                        case 'I':
-                        case 'f':
-                            out.twrite<u32>(s);
-                            break;
-                        case 'q':
-                        case 'Q':
-                        case 'd':
-                        case 'P':
-                            out.twrite<u64>(s);
-                            break;
-                        case '?':
-                            out.twrite<bool>(s);
-                            break;
-                        case 'p': {
-                            out.twrite<char>(s,
-                                    object_serializer<const char*>::max_len);
-                            break;
-                        }
-                        case '*': {
-                            s = align_up(s, sizeof(u16));
-                            auto len = *reinterpret_cast<const u16*>(s);
-                            s += 2;
-                            out.write(len);
-                            out.twrite<char>(s, len);
-                            break;
-                        }
-                        default:
-                            assert(0 && "should not reach");
-                        }
+// Trace streaming: a thread on each cpu copies the pages of the cpu's
+// trace buffer as they complete, and writes their records to the sink.
+// Tracepoints never wait for the stream: pages overwritten before they
+// are copied are counted as lost, and reported by a LOST chunk.
+constexpr std::chrono::milliseconds trace_stream_interval(100);
+constexpr size_t trace_stream_batch_pages = 16;
+
+struct trace_stream {
+    trace::stream_sink_func sink;
+    tracepoint_set valid;
+    std::atomic<bool> stopping = { false };
+    std::vector<std::unique_ptr<sched::thread>> threads;
+    std::atomic<u64> written_pages = { 0 };
+    std::atomic<u64> lost_pages = { 0 };
+
+    // Serializes the writes to sink and protects the fields below
+    lockfree::mutex lock;
+    bool failed = false;
+    int modules_adds = -1, modules_subs = -1;
+
+    void drain(sched::cpu * cpu);
+    void write(trace_chunk_out & out);
+};
+
+static lockfree::mutex trace_stream_lock;
+static std::unique_ptr<trace_stream> the_trace_stream;
+
+void trace_stream::write(trace_chunk_out & out)
+{
+    out.align(8);
+    auto data = out.str();
+    WITH_LOCK(lock) {
+        if (failed) {
+            return;
+        }
+        // Loading or unloading modules changes how addresses resolve, so
+        // the module tables are written again before the next records
+        elf::get_program()->with_modules(
+                [&](const elf::program::modules_list &ml)
+                {
+                    if (ml.adds == modules_adds && ml.subs == modules_subs) {
+                        return;
                     }
-                    s = align_up(s, sizeof(long));
+                    trace_chunk_out mods;
+                    write_module_tables(mods, ml);
+                    mods.align(8);
+                    auto m = mods.str();
+                    failed = !sink(m.data(), m.size());
+                    modules_adds = ml.adds;
+                    modules_subs = ml.subs;
+                });
+        if (!failed) {
+            failed = !sink(data.data(), data.size());
+        }
+        if (failed) {
+            debug("trace: writing the trace stream failed, stopping it\n");
+        }
+    }
+}
+
+void trace_stream::drain(sched::cpu * cpu)
+{
+    auto * tbp = percpu_trace_buffer.for_cpu(cpu);
+    std::unique_ptr<char[]> pages(new char[trace_stream_batch_pages * trace_page_size]);
+    // Position in the buffer up to which pages were copied, as counted by
+    // trace_buf::_last, starting with the oldest page still there
+    size_t drained = 0;
+    bool first = true;
+
+    for (;;) {
+        bool stop = stopping.load(std::memory_order_acquire);
+        size_t n = 0, tail = 0;
+        u64 lost = 0;
+
+        // Like trace writes, which only ever happen on this cpu, the copy
+        // runs with interrupts disabled, so no page changes under it
+        arch::irq_flag_notrace irq;
+        irq.save();
+        arch::irq_disable_notrace();
+        auto done = align_down(tbp->_last, trace_page_size);
+        auto oldest = done >= tbp->_size ? done - tbp->_size + trace_page_size : 0;
+        if (first) {
+            drained = oldest;
+            first = false;
+        } else if (drained < oldest) {
+            lost = (oldest - drained) / trace_page_size;
+            drained = oldest;
+        }
+        n = std::min((done - drained) / trace_page_size, trace_stream_batch_pages);
+        for (size_t i = 0; i < n; i++) {
+            memcpy(pages.get() + i * trace_page_size, tbp->page(drained), trace_page_size);
+            drained += trace_page_size;
+        }
+        // When stopping, also take the records of the page being filled,
+        // ending them like the padding at the end of a page
+        if (stop && drained == done && n < trace_stream_batch_pages) {
+            tail = tbp->_last - done;
+            memcpy(pages.get() + n * trace_page_size, tbp->page(drained), tail);
+            reinterpret_cast<trace_record*>(pages.get() + n * trace_page_size + tail)->tp = nullptr;
+            drained = tbp->_last;
+        }
+        irq.restore();
+
+        if (n || tail || lost) {
+            trace_chunk_out out;
+            if (lost) {
+                lost_pages += lost;
+                chunk<trace_chunk_out> c(out, "LOST");
+                out.write(uint32_t(cpu->id));
+                out.write(uint64_t(lost));
+            }
+            if (n || tail) {
+                written_pages += n;
+                chunk<trace_chunk_out> trcs(out, "TRCS");
+                out.align(8);
+                write_trace_records(out, pages.get(),
+                        pages.get() + align_up(n * trace_page_size + tail, trace_page_size), valid);
+            }
+            write(out);
+        }
+        if (n == trace_stream_batch_pages) {
+            continue;
+        }
+        if (stop) {
+            return;
+        }
+        sched::thread::sleep(trace_stream_interval);
+    }
+}
+
+void trace::start_trace_stream(stream_sink_func sink)
+{
+    ensure_log_initialized();
+    SCOPE_LOCK(trace_stream_lock);
+    if (the_trace_stream) {
+        throw std::runtime_error("trace stream already started");
+    }
+    std::unique_ptr<trace_stream> s(new trace_stream());
+    s->sink = sink;
+    s->valid = valid_tracepoints();
+
+    trace_chunk_out out;
+    out.write(uint32_t(tag("OSVT")));
+    out.write(uint64_t(0)); // size, unknown
+    out.write(uint32_t(1)); // endian (verify)
+    out.write(uint32_t((tf_version_major << 16) | tf_version_minor)); // version
+    write_trace_dictionary(out);
+    write_symbol_tables(out);
+    out.align(8);
+    auto header = out.str();
+    if (!sink(header.data(), header.size())) {
+        throw std::runtime_error("could not write the trace stream");
+    }
+
+    for (auto cpu : sched::cpus) {
+        auto p = s.get();
+        s->threads.emplace_back(sched::thread::make([p, cpu] { p->drain(cpu); },
+                sched::thread::attr().pin(cpu).name(osv::sprintf("trace-stream%d", cpu->id))));
+    }
+    for (auto & t : s->threads) {
+        t->start();
+    }
+    the_trace_stream = std::move(s);
+}
+
+void trace::start_trace_stream(const std::string & path)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), "open " + path);
+    }
+    auto fdp = std::make_shared<int>(fd);
+    auto sink = [fdp] (const char * data, size_t len) {
+        if (!data) {
+            ::close(*fdp);
+            return true;
+        }
+        while (len) {
+            auto n = ::write(*fdp, data, len);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
                 }
+                return false;
             }
+            data += n;
+            len -= n;
         }
+        return true;
+    };
+    try {
+        start_trace_stream(sink);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
 
+void trace::stop_trace_stream()
+{
+    SCOPE_LOCK(trace_stream_lock);
+    if (!the_trace_stream) {
+        return;
     }
-    out.flush();
-    out.close();
+    the_trace_stream->stopping.store(true, std::memory_order_release);
+    for (auto & t : the_trace_stream->threads) {
+        t->join();
+    }
+    // The end of the stream
+    the_trace_stream->sink(nullptr, 0);
+    the_trace_stream.reset();
+}
 
-    return std::move(out.path);
+trace::stream_stats trace::get_trace_stream_stats()
+{
+    stream_stats ret = {};
+    SCOPE_LOCK(trace_stream_lock);
+    if (the_trace_stream) {
+        ret.written_pages = the_trace_stream->written_pages.load(std::memory_order_relaxed);
+        ret.lost_pages = the_trace_stream->lost_pages.load(std::memory_order_relaxed);
+    }
+    return ret;
 }
@@ -15,7 +15,7 @@
 
 namespace ahci {
 
-int hba::_disk_idx = 0;
+std::atomic<int> hba::_disk_idx(0);
 
 struct hba_priv {
     devop_strategy_t strategy;
@@ -222,7 +222,7 @@ private:
     bool _poll_mode = false;
     pci::device& _pci_dev;
     interrupt_manager _msi;
-    static int _disk_idx;
+    static std::atomic<int> _disk_idx;
     pci::bar *_bar6;
 };
 
@@ -6,13 +6,20 @@
  */
 
 #include "drivers/driver.hh"
+#include "drivers/virtio.hh"
 #include <osv/pci.hh>
 #include <osv/debug.hh>
+#include <osv/sched.hh>
+#include <osv/boot.hh>
+#include <algorithm>
+#include <atomic>
 
 #include "driver.hh"
 
 using namespace pci;
 
+extern boot_time_chart boot_time;
+
 namespace hw {
 
     driver_manager* driver_manager::_instance = nullptr;
@@ -32,18 +39,86 @@ namespace hw {
         _probes.push_back(probe);
     }
 
-    void driver_manager::load_all()
+    void driver_manager::probe_device(hw_device* dev)
     {
-        auto dm = device_manager::instance();
-        dm->for_each_device([this] (hw_device* dev) {
-            for (auto probe : _probes) {
-                if (auto drv = probe(dev)) {
-                    dev->set_attached();
+        for (auto probe : _probes) {
+            auto start = processor::ticks();
+            if (auto drv = probe(dev)) {
+                boot_time.span(drv->get_name().c_str(), start, processor::ticks(),
+                               sched::cpu::current()->id);
+                dev->set_attached();
+                WITH_LOCK(_lock) {
                     _drivers.push_back(drv);
-                    break;
                 }
+                break;
             }
+        }
+    }
+
+    // Disk drivers name their disks from counters shared by several of
+    // them: virtio-blk and virtio-scsi disks are both vblkN, and the root
+    // filesystem is mounted from /dev/vblk0.1.
+    static bool is_disk(hw_device* dev)
+    {
+        if (dev->get_id().make32() >> 16 == virtio::VIRTIO_VENDOR_ID) {
+            auto type = dev->get_id().make32() & 0xffff;
+            return type == virtio::VIRTIO_ID_BLOCK || type == virtio::VIRTIO_ID_SCSI;
+        }
+        auto func = dynamic_cast<pci::function*>(dev);
+        return func && func->get_base_class_code() == pci::function::PCI_CLASS_STORAGE;
+    }
+
+    // Devices are probed by worker threads spread over the cpus. Devices
+    // with the same id are claimed by the same driver, so each group of
+    // them is probed by one worker in turn, which keeps the numbering of
+    // their instances stable, while different groups are probed in
+    // parallel. Disks are all probed by one worker, in enumeration order,
+    // so that they get the same names on every boot. Whatever needs the
+    // devices, like mounting the root filesystem, comes after load_all()
+    // returns.
+    void driver_manager::load_all()
+    {
+        std::vector<std::vector<hw_device*>> groups(1);
+        auto dm = device_manager::instance();
+        dm->for_each_device([&groups] (hw_device* dev) {
+            if (is_disk(dev)) {
+                groups.front().push_back(dev);
+                return;
+            }
+            if (groups.size() == 1 || !(groups.back().front()->get_id() == dev->get_id())) {
+                groups.emplace_back();
+            }
+            groups.back().push_back(dev);
         });
+        if (groups.front().empty()) {
+            groups.erase(groups.begin());
+        }
+
+        std::atomic<size_t> next(0);
+        auto worker = [this, &groups, &next] {
+            size_t i;
+            while ((i = next.fetch_add(1)) < groups.size()) {
+                for (auto dev : groups[i]) {
+                    probe_device(dev);
+                }
+            }
+        };
+
+        auto nr_workers = std::min(groups.size(), sched::cpus.size());
+        if (nr_workers <= 1) {
+            worker();
+            return;
+        }
+        std::vector<std::unique_ptr<sched::thread>> workers;
+        for (size_t i = 0; i < nr_workers; i++) {
+            auto cpu = sched::cpus[(i + 1) % sched::cpus.size()];
+            workers.emplace_back(sched::thread::make(worker,
+                sched::thread::attr().pin(cpu).name("probe" + std::to_string(i))));
+            workers.back()->start();
+        }
+        for (auto& t : workers) {
+            t->join();
+        }
     }
 
     void driver_manager::unload_all()
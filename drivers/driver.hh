@@ -10,6 +10,7 @@
 
 #include <osv/pci.hh>
 #include "drivers/pci-device.hh"
+#include <osv/mutex.h>
 #include <vector>
 #include <string>
 
@@ -48,8 +49,11 @@ namespace hw {
         void list_drivers();
 
     private:
+        void probe_device(hw_device* dev);
+
         static driver_manager* _instance;
         std::vector<std::function<hw_driver* (hw_device*)>> _probes;
+        mutex _lock; // protects _drivers while devices are probed
         std::vector<hw_driver*> _drivers;
     };
 }
@@ -41,6 +41,7 @@
 
 #include <string>
 #include <string.h>
+#include <algorithm>
 #include <map>
 #include <errno.h>
 #include <osv/debug.h>
@@ -50,6 +51,7 @@
 
 #include <osv/device.h>
 #include <osv/bio.h>
+#include <osv/uio.h>
 
 TRACEPOINT(trace_virtio_9p_read_config_tag_len, "len=%d", int);
 TRACEPOINT(trace_virtio_vt9p_read_config_mount_tag, "tag=%s", char *);
@@ -163,24 +165,43 @@ void vt9p::req_done()
         virtio_driver::wait_for_queue(queue, &vring::used_ring_not_empty);
         trace_virtio_vt9p_wake();
 
+        // Requests complete in any order, each wakes its own thread
         u32 len;
-        if((req = static_cast<struct p9_req_t *>(queue->get_buf_elem(&len))) != nullptr) {
-            if (len)
+        while((req = static_cast<struct p9_req_t *>(queue->get_buf_elem(&len))) != nullptr) {
+            if (len) {
                 p9_client::p9_client_cb(req, REQ_STATUS_RCVD);
+            } else {
+                req->t_err = -EIO;
+                p9_client::p9_client_cb(req, REQ_STATUS_ERROR);
+            }
             queue->get_buf_finalize();
-            // wake up the requesting thread in case the ring was full before
-            queue->wakeup_waiter();
         }
-        
+
+        // wake up the requesting thread in case the ring was full before
+        queue->wakeup_waiter();
     }
 }
 
 
-static const int sector_size = 512;
+// Adds the next len bytes of a uio, which is left as it is
+static void add_uio_sg(vring* queue, struct uio* uio, size_t len,
+                       vring_desc::flags desc_flags)
+{
+    for (int i = 0; i < uio->uio_iovcnt && len; i++) {
+        auto& iov = uio->uio_iov[i];
+        size_t n = std::min(len, iov.iov_len);
+        if (n) {
+            queue->add_sg(iov.iov_base, n, desc_flags);
+            len -= n;
+        }
+    }
+}
 
-int vt9p::make_request(struct p9_req_t *req)
+int vt9p::make_request(struct p9_req_t *req, struct uio *uidata,
+    struct uio *uodata, int inlen, int outlen, int in_hdrlen)
 {
-    // The lock is here for parallel requests protection
+    // The lock only covers posting the request: it is not held while
+    // waiting for the response, so many requests may be in flight
     WITH_LOCK(_lock) {
 
         if (!req)
@@ -193,8 +214,14 @@ int vt9p::make_request(struct p9_req_t *req)
         queue->init_sg();
         if (req->tc->size)
             queue->add_out_sg(req->tc->sdata, req->tc->size);
-        if (req->rc->capacity)
+        if (uodata)
+            add_uio_sg(queue, uodata, outlen, vring_desc::VRING_DESC_F_READ);
+        if (uidata) {
+            queue->add_in_sg(req->rc->sdata, in_hdrlen);
+            add_uio_sg(queue, uidata, inlen, vring_desc::VRING_DESC_F_WRITE);
+        } else if (req->rc->capacity) {
             queue->add_in_sg(req->rc->sdata, req->rc->capacity);
+        }
 
         queue->add_buf_wait(req);
 
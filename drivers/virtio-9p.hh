@@ -74,7 +74,11 @@ public:
 
     virtual u32 get_driver_features();
 
-    int make_request(struct p9_req_t *req);
+    // With uidata or uodata, the data of the response or of the request
+    // is placed directly in those iovecs rather than in the fcalls
+    int make_request(struct p9_req_t *req, struct uio *uidata = nullptr,
+        struct uio *uodata = nullptr, int inlen = 0, int outlen = 0,
+        int in_hdrlen = 0);
 
     void req_done();
 
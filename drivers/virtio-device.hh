@@ -78,6 +78,10 @@ public:
 
     virtual bool is_modern() = 0;
     virtual size_t get_vring_alignment() = 0;
+
+    // Looks up the shared memory region with the given id, which the device
+    // shares with the driver (e.g. the DAX window of virtio-fs)
+    virtual bool get_shm(u8 id, mmioaddr_t& addr, u64& length) { return false; }
 };
 
 }
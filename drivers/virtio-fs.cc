@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include <sys/cdefs.h>
+
+#include "drivers/virtio.hh"
+#include "drivers/virtio-fs.hh"
+#include <osv/interrupt.hh>
+
+#include <osv/mmu.hh>
+
+#include <string>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <errno.h>
+#include <assert.h>
+#include <osv/debug.h>
+
+#include <osv/sched.hh>
+#include "osv/trace.hh"
+
+#include <osv/device.h>
+
+TRACEPOINT(trace_virtio_fs_read_config, "num_request_queues=%u", u32);
+TRACEPOINT(trace_virtio_fs_dax_window, "addr=%p, len=%lu", void*, u64);
+TRACEPOINT(trace_virtio_fs_make_request, "queue=%u, opcode=%u, nodeid=%lu", unsigned, u32, u64);
+TRACEPOINT(trace_virtio_fs_wake, "queue=%u", unsigned);
+TRACEPOINT(trace_virtio_fs_req_done, "opcode=%u, unique=%lu, error=%d", u32, u64, s32);
+
+namespace virtio {
+
+int fs::_instance = 0;
+
+static struct devops fs_devops {
+    no_open,
+    no_close,
+    no_read,
+    no_write,
+    no_ioctl,
+    no_devctl,
+    nullptr,
+};
+
+struct driver fs_driver = {
+    "virtio_fs",
+    &fs_devops,
+    sizeof(struct fs_priv),
+};
+
+bool fs::ack_irq()
+{
+    auto isr = _dev.read_and_ack_isr();
+
+    if (isr) {
+        for (unsigned i = 0; i <= _nr_request_queues; i++) {
+            get_virt_queue(i)->disable_interrupts();
+        }
+        return true;
+    } else {
+        return false;
+    }
+}
+
+fs::fs(virtio_device& virtio_dev)
+    : virtio_driver(virtio_dev), _dax{}
+{
+    _driver_name = "virtio-fs";
+    _id = _instance++;
+    virtio_i("VIRTIO FS INSTANCE %d", _id);
+
+    // Steps 4, 5 & 6 - negotiate and confirm features
+    setup_features();
+    read_config();
+
+    // Step 7 - generic init of virtqueues
+    probe_virt_queues();
+
+    assert(_num_queues > 1);
+    _nr_request_queues = std::min<unsigned>(std::max(_config.num_request_queues, 1u), _num_queues - 1);
+    _request_queues.reset(new request_queue[_nr_request_queues + 1]);
+    for (unsigned i = 0; i <= _nr_request_queues; i++) {
+        _request_queues[i].thread = sched::thread::make([this, i] { this->req_done(i); },
+            sched::thread::attr().name("virtio-fs" + std::to_string(_id) + "-" + std::to_string(i)));
+        _request_queues[i].thread->start();
+        get_virt_queue(i)->set_use_indirect(true);
+    }
+
+    register_interrupts();
+
+    // The DAX window is optional, virtiofsd only offers it with
+    // -o cache=always and a cache size
+    if (_dev.get_shm(VIRTIO_FS_SHMCAP_ID_CACHE, _dax.addr, _dax.len)) {
+        trace_virtio_fs_dax_window(const_cast<void*>(_dax.addr), _dax.len);
+    } else {
+        _dax = {};
+    }
+
+    // Step 8
+    add_dev_status(VIRTIO_CONFIG_S_DRIVER_OK);
+
+    std::string dev_name("virtiofs");
+    dev_name += std::to_string(_id);
+
+    struct device* dev = device_create(&fs_driver, dev_name.c_str(), D_CHR);
+    auto* prv = reinterpret_cast<struct fs_priv*>(dev->private_data);
+    prv->drv = this;
+
+    debugf("virtio-fs: Add device instance %d as %s, tag=%s, request queues=%u, dax window=%lu bytes\n",
+        _id, dev_name.c_str(), get_tag().c_str(), _nr_request_queues, _dax.len);
+}
+
+fs::~fs()
+{
+    //TODO: In theory maintain the list of free instances and gc it
+    // including the thread objects and their stack
+}
+
+// Each queue gets its own MSI-X vector and completion thread, so that
+// replies on different queues are handled in parallel
+void fs::register_interrupts()
+{
+    interrupt_factory int_factory;
+    int_factory.register_msi_bindings = [this](interrupt_manager &msi) {
+        std::vector<msix_binding> bindings;
+        for (unsigned i = 0; i <= _nr_request_queues; i++) {
+            auto queue = get_virt_queue(i);
+            bindings.push_back({ i, [=] { queue->disable_interrupts(); }, _request_queues[i].thread });
+        }
+        msi.easy_register(bindings);
+    };
+
+    int_factory.create_pci_interrupt = [this](pci::device &pci_dev) {
+        return new pci_interrupt(
+            pci_dev,
+            [=] { return this->ack_irq(); },
+            [=] {
+                for (unsigned i = 0; i <= _nr_request_queues; i++) {
+                    _request_queues[i].thread->wake();
+                }
+            });
+    };
+
+#ifndef AARCH64_PORT_STUB
+    int_factory.create_gsi_edge_interrupt = [this]() {
+        return new gsi_edge_interrupt(
+                _dev.get_irq(),
+                [=] {
+                    if (this->ack_irq()) {
+                        for (unsigned i = 0; i <= _nr_request_queues; i++) {
+                            _request_queues[i].thread->wake();
+                        }
+                    }
+                });
+    };
+#endif
+
+    _dev.register_interrupt(int_factory);
+}
+
+#define READ_CONFIGURATION_FIELD(config,field_name,field) \
+    virtio_conf_read(offsetof(config,field_name), &field, sizeof(field));
+
+void fs::read_config()
+{
+    READ_CONFIGURATION_FIELD(fs_config,tag,_config.tag)
+    READ_CONFIGURATION_FIELD(fs_config,num_request_queues,_config.num_request_queues)
+    trace_virtio_fs_read_config(_config.num_request_queues);
+}
+
+// The tag is NUL terminated only if it is shorter than the field
+std::string fs::get_tag() const
+{
+    return std::string(_config.tag, strnlen(_config.tag, sizeof(_config.tag)));
+}
+
+void fs::req_done(unsigned idx)
+{
+    auto* queue = get_virt_queue(idx);
+    fuse_request* req;
+
+    while (1) {
+
+        virtio_driver::wait_for_queue(queue, &vring::used_ring_not_empty);
+        trace_virtio_fs_wake(idx);
+
+        // Requests complete in any order, each wakes its own thread
+        u32 len;
+        while ((req = static_cast<fuse_request*>(queue->get_buf_elem(&len))) != nullptr) {
+            if (idx != 0 && len < sizeof(req->out_header)) {
+                req->out_header.error = -EIO;
+            }
+            trace_virtio_fs_req_done(req->in_header.opcode, req->in_header.unique, req->out_header.error);
+            queue->get_buf_finalize();
+            if (req->done) {
+                req->done(req);
+            } else {
+                req->wq->wake();
+            }
+        }
+
+        // wake up the requesting thread in case the ring was full before
+        queue->wakeup_waiter();
+    }
+}
+
+int fs::make_request(fuse_request* req, bool hiprio)
+{
+    unsigned idx = hiprio ? 0 : 1 + sched::cpu::current()->id % _nr_request_queues;
+    auto* queue = get_virt_queue(idx);
+    waiter w(sched::thread::current());
+    // An asynchronous request may be freed as soon as it is posted
+    bool async = req->done != nullptr;
+
+    static std::atomic<u64> unique;
+    req->in_header.unique = unique.fetch_add(1, std::memory_order_relaxed);
+    req->in_header.len = sizeof(req->in_header) + req->input_args_size;
+    req->out_header = {};
+    req->wq = async ? nullptr : &w;
+    trace_virtio_fs_make_request(idx, req->in_header.opcode, req->in_header.nodeid);
+
+    // The lock only covers posting the request: it is not held while
+    // waiting for the reply, so many requests may be in flight
+    WITH_LOCK(_request_queues[idx].lock) {
+        queue->init_sg();
+        queue->add_out_sg(&req->in_header, sizeof(req->in_header));
+        if (req->input_args_size) {
+            queue->add_out_sg(req->input_args, req->input_args_size);
+        }
+        if (!hiprio) {
+            queue->add_in_sg(&req->out_header, sizeof(req->out_header));
+            if (req->output_args_size) {
+                queue->add_in_sg(req->output_args, req->output_args_size);
+            }
+        }
+        queue->add_buf_wait(req);
+        queue->kick();
+    }
+
+    if (async) {
+        return 0;
+    }
+    w.wait();
+    return -req->out_header.error;
+}
+
+hw_driver* fs::probe(hw_device* dev)
+{
+    return virtio::probe<fs, VIRTIO_ID_FS>(dev);
+}
+
+}
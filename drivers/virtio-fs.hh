@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef VIRTIO_FS_DRIVER_H
+#define VIRTIO_FS_DRIVER_H
+
+#include <memory>
+#include <string>
+#include <osv/mutex.h>
+#include <osv/wait_record.hh>
+#include "drivers/virtio.hh"
+#include "drivers/virtio-device.hh"
+#include "fs/virtiofs/fuse_kernel.h"
+
+namespace virtio {
+
+// A FUSE request and the buffers for its reply, all of which must be in
+// memory the device can reach. The thread sending the request waits for
+// the reply, unless done is set: done is then called from the completion
+// thread once the device is through with the request, e.g. to free it.
+struct fuse_request {
+    struct fuse_in_header in_header;
+    void* input_args;
+    size_t input_args_size;
+
+    struct fuse_out_header out_header;
+    void* output_args;
+    size_t output_args_size;
+
+    waiter* wq;
+    void (*done)(fuse_request* req);
+};
+
+// virtio-fs: FUSE requests over virtqueues. The device has one high
+// priority queue, for requests which get no reply (FORGET), and one or
+// more request queues, each served by a thread of its own. Devices with a
+// DAX window let the driver map ranges of host files into it, where they
+// can be read, and mapped by applications, without any copy.
+class fs : public virtio_driver {
+public:
+    enum {
+        VIRTIO_FS_SHMCAP_ID_CACHE = 0,  /* Shared memory region of the DAX window */
+    };
+
+    struct fs_config {
+        char tag[36];
+        u32 num_request_queues;
+    } __attribute__((packed));
+
+    struct dax_window {
+        mmioaddr_t addr;
+        u64 len;
+    };
+
+    explicit fs(virtio_device& dev);
+    virtual ~fs();
+
+    virtual std::string get_name() const { return _driver_name; }
+    void read_config();
+
+    // Sends req on a request queue, picked by the current cpu, and waits
+    // for its reply unless req->done is set. Requests sent with hiprio
+    // go to the high priority queue and never get a reply.
+    int make_request(fuse_request* req, bool hiprio = false);
+
+    // The DAX window of the device, or nullptr if it has none
+    const dax_window* get_dax() const { return _dax.len ? &_dax : nullptr; }
+
+    std::string get_tag() const;
+
+    bool ack_irq();
+
+    static hw_driver* probe(hw_device* dev);
+
+private:
+    struct request_queue {
+        mutex lock;     // Serializes adding requests to the queue
+        sched::thread* thread;
+    };
+
+    void req_done(unsigned idx);
+    void register_interrupts();
+
+    std::string _driver_name;
+    fs_config _config;
+    dax_window _dax;
+
+    // Queue 0 is the high priority queue, request queues come after it
+    unsigned _nr_request_queues;
+    std::unique_ptr<request_queue[]> _request_queues;
+
+    //maintains the virtio instance number for multiple devices
+    static int _instance;
+    int _id;
+};
+
+// Private data of the virtiofs%d devices, through which virtiofs finds
+// the driver of the device it mounts
+struct fs_priv {
+    fs* drv;
+};
+
+}
+#endif
@@ -40,6 +40,7 @@
 
 TRACEPOINT(trace_virtio_net_rx_packet, "if=%d, len=%d", int, int);
 TRACEPOINT(trace_virtio_net_rx_wake, "");
+TRACEPOINT(trace_virtio_net_rx_busy_poll, "if=%d, packets=%d", int, int);
 TRACEPOINT(trace_virtio_net_fill_rx_ring, "if=%d", int);
 TRACEPOINT(trace_virtio_net_fill_rx_ring_added, "if=%d, added=%d", int, int);
 TRACEPOINT(trace_virtio_net_tx_packet, "if=%d, len=%d", int, int);
@@ -329,6 +330,10 @@ net::net(virtio_device& dev)
 
     fill_rx_ring();
 
+    _busy_poller = osv::busy_poll::register_poller(_ifn->if_index, [this] {
+        return this->rx_busy_poll();
+    });
+
     // Step 8
     add_dev_status(VIRTIO_CONFIG_S_DRIVER_OK);
 }
@@ -344,6 +349,7 @@ net::~net()
     // Since this will involve the rework of the virtio layer - make it for
     // all virtio drivers in a separate patchset.
 
+    osv::busy_poll::unregister_poller(_busy_poller);
     ether_ifdetach(_ifn);
     if_free(_ifn);
 }
@@ -440,10 +446,7 @@ bool net::bad_rx_csum(struct mbuf* m, struct net_hdr* hdr)
 void net::receiver()
 {
     vring* vq = _rxq.vqueue;
-    std::vector<iovec> packet;
-    u64 rx_drops = 0, rx_packets = 0, csum_ok = 0;
-    u64 csum_err = 0, rx_bytes = 0;
-    static const u16 refill_thresh = 16;
+    u64 rx_packets = 0;
 
     while (1) {
 
@@ -454,90 +457,118 @@ void net::receiver()
         _rxq.stats.rx_bh_wakeups++;
         _rxq.update_wakeup_stats(rx_packets);
 
-        u32 len;
-        int nbufs;
-        rx_drops = rx_packets = csum_ok = 0;
-        csum_err = rx_bytes = 0;
+        WITH_LOCK(_rxq.lock) {
+            rx_packets = rx_process();
+        }
+    }
+}
 
-        // use local header that we copy out of the mbuf since we're
-        // truncating it.
-        net_hdr_mrg_rxbuf* mhdr;
+bool net::rx_busy_poll()
+{
+    // Called by threads spinning in SO_BUSY_POLL. If the rx thread (or
+    // another poller) is already draining the ring, it will deliver the
+    // packets for us.
+    if (!_rxq.vqueue->used_ring_not_empty() || !_rxq.lock.try_lock()) {
+        return false;
+    }
+    u64 rx_packets = rx_process();
+    _rxq.stats.rx_busy_polled += rx_packets;
+    _rxq.lock.unlock();
+    trace_virtio_net_rx_busy_poll(_ifn->if_index, rx_packets);
+    return rx_packets != 0;
+}
 
-        while (void* page = vq->get_buf_elem(&len)) {
+u64 net::rx_process()
+{
+    vring* vq = _rxq.vqueue;
+    std::vector<iovec>& packet = _rxq.packet;
+    u64 rx_drops = 0, rx_packets = 0, csum_ok = 0;
+    u64 csum_err = 0, rx_bytes = 0;
+    static const u16 refill_thresh = 16;
 
-            vq->get_buf_finalize();
+    u32 len;
+    int nbufs;
 
-            if (vq->effective_avail_ring_count() >= refill_thresh)
-                fill_rx_ring();
+    // use local header that we copy out of the mbuf since we're
+    // truncating it.
+    net_hdr_mrg_rxbuf* mhdr;
 
-            // Bad packet/buffer - discard and continue to the next one
-            if (len < _hdr_size + ETHER_HDR_LEN) {
-                rx_drops++;
-                memory::free_page(page);
+    while (void* page = vq->get_buf_elem(&len)) {
 
-                continue;
-            }
+        vq->get_buf_finalize();
 
-            mhdr = static_cast<net_hdr_mrg_rxbuf*>(page);
+        if (vq->effective_avail_ring_count() >= refill_thresh)
+            fill_rx_ring();
 
-            if (!_mergeable_bufs) {
-                nbufs = 1;
-            } else {
-                nbufs = mhdr->num_buffers;
-            }
+        // Bad packet/buffer - discard and continue to the next one
+        if (len < _hdr_size + ETHER_HDR_LEN) {
+            rx_drops++;
+            memory::free_page(page);
 
-            packet.push_back({page + _hdr_size, len - _hdr_size});
-
-            // Read the fragments
-            while (--nbufs > 0) {
-                page = vq->get_buf_elem(&len);
-                if (!page) {
-                    rx_drops++;
-                    for (auto&& v : packet) {
-                        free_buffer(v);
-                    }
-                    break;
-                }
-                packet.push_back({page, len});
-                vq->get_buf_finalize();
-            }
+            continue;
+        }
 
-            auto m_head = packet_to_mbuf(packet);
-            packet.clear();
+        mhdr = static_cast<net_hdr_mrg_rxbuf*>(page);
 
-            if ((_ifn->if_capenable & IFCAP_RXCSUM) &&
-                (mhdr->hdr.flags &
-                 net_hdr::VIRTIO_NET_HDR_F_NEEDS_CSUM)) {
-                if (bad_rx_csum(m_head, &mhdr->hdr))
-                    csum_err++;
-                else
-                    csum_ok++;
+        if (!_mergeable_bufs) {
+            nbufs = 1;
+        } else {
+            nbufs = mhdr->num_buffers;
+        }
+
+        packet.push_back({page + _hdr_size, len - _hdr_size});
 
+        // Read the fragments
+        while (--nbufs > 0) {
+            page = vq->get_buf_elem(&len);
+            if (!page) {
+                rx_drops++;
+                for (auto&& v : packet) {
+                    free_buffer(v);
+                }
+                break;
             }
+            packet.push_back({page, len});
+            vq->get_buf_finalize();
+        }
 
-            rx_packets++;
-            rx_bytes += m_head->M_dat.MH.MH_pkthdr.len;
+        auto m_head = packet_to_mbuf(packet);
+        packet.clear();
 
-            bool fast_path = _ifn->if_classifier.post_packet(m_head);
-            if (!fast_path) {
-                (*_ifn->if_input)(_ifn, m_head);
-            }
+        if ((_ifn->if_capenable & IFCAP_RXCSUM) &&
+            (mhdr->hdr.flags &
+             net_hdr::VIRTIO_NET_HDR_F_NEEDS_CSUM)) {
+            if (bad_rx_csum(m_head, &mhdr->hdr))
+                csum_err++;
+            else
+                csum_ok++;
 
-            trace_virtio_net_rx_packet(_ifn->if_index, rx_bytes);
+        }
 
-            // The interface may have been stopped while we were
-            // passing the packet up the network stack.
-            if ((_ifn->if_drv_flags & IFF_DRV_RUNNING) == 0)
-                break;
+        rx_packets++;
+        rx_bytes += m_head->M_dat.MH.MH_pkthdr.len;
+
+        bool fast_path = _ifn->if_classifier.post_packet(m_head);
+        if (!fast_path) {
+            (*_ifn->if_input)(_ifn, m_head);
         }
 
-        // Update the stats
-        _rxq.stats.rx_drops      += rx_drops;
-        _rxq.stats.rx_packets    += rx_packets;
-        _rxq.stats.rx_csum       += csum_ok;
-        _rxq.stats.rx_csum_err   += csum_err;
-        _rxq.stats.rx_bytes      += rx_bytes;
+        trace_virtio_net_rx_packet(_ifn->if_index, rx_bytes);
+
+        // The interface may have been stopped while we were
+        // passing the packet up the network stack.
+        if ((_ifn->if_drv_flags & IFF_DRV_RUNNING) == 0)
+            break;
     }
+
+    // Update the stats
+    _rxq.stats.rx_drops      += rx_drops;
+    _rxq.stats.rx_packets    += rx_packets;
+    _rxq.stats.rx_csum       += csum_ok;
+    _rxq.stats.rx_csum_err   += csum_err;
+    _rxq.stats.rx_bytes      += rx_bytes;
+
+    return rx_packets;
 }
 
 mbuf* net::packet_to_mbuf(const std::vector<iovec>& packet)
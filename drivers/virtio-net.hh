@@ -14,6 +14,7 @@
 #include <bsd/sys/sys/mbuf.h>
 
 #include <osv/percpu_xmit.hh>
+#include <osv/net_busy_poll.hh>
 
 #include "drivers/virtio.hh"
 #include "drivers/pci-device.hh"
@@ -215,6 +216,8 @@ public:
     void wait_for_queue(vring* queue);
     bool bad_rx_csum(struct mbuf* m, struct net_hdr* hdr);
     void receiver();
+    u64 rx_process();
+    bool rx_busy_poll();
     void fill_rx_ring();
     mbuf* packet_to_mbuf(const std::vector<iovec>& iovec);
     static void free_buffer_and_refcnt(void* buffer, void* refcnt);
@@ -276,6 +279,7 @@ private:
         u64 rx_csum;    /* number of packets with correct csum */
         u64 rx_csum_err;/* number of packets with a bad checksum */
         u64 rx_bh_wakeups;
+        u64 rx_busy_polled; /* packets received by SO_BUSY_POLL spinners */
 
         wakeup_stats rx_wakeup_stats;
     };
@@ -310,6 +314,9 @@ private:
                                     name("virtio-net-rx"))) {};
         vring* vqueue;
         std::unique_ptr<sched::thread> poll_task;
+        // Serializes draining the ring between poll_task and busy pollers
+        mutex lock;
+        std::vector<iovec> packet;
         struct rxq_stats stats = { 0 };
 
         void update_wakeup_stats(const u64 wakeup_packets) {
@@ -486,6 +493,7 @@ private:
     static int _instance;
     int _id;
     struct ifnet* _ifn;
+    osv::busy_poll::poller_id _busy_poller = 0;
 };
 
 }
@@ -305,6 +305,35 @@ void virtio_modern_pci_device::parse_virtio_capability(std::unique_ptr<virtio_ca
     }
 }
 
+bool virtio_modern_pci_device::get_shm(u8 id, mmioaddr_t& addr, u64& length)
+{
+    u8 cfg_offset = _dev->find_capability(pci::function::PCI_CAP_VENDOR, [id] (pci::function *fun, u8 offset) {
+        u8 cfg_type = fun->pci_readb(offset + offsetof(struct virtio_pci_cap, cfg_type));
+        u8 cap_id = fun->pci_readb(offset + offsetof(struct virtio_pci_cap, padding[0]));
+        return cfg_type == VIRTIO_PCI_CAP_SHARED_MEMORY_CFG && cap_id == id;
+    });
+
+    if (cfg_offset == 0xFF) {
+        return false;
+    }
+
+    u8 bar_index = _dev->pci_readb(cfg_offset + offsetof(struct virtio_pci_cap, bar));
+    u64 offset = _dev->pci_readl(cfg_offset + offsetof(struct virtio_pci_cap, offset)) |
+        (u64)_dev->pci_readl(cfg_offset + offsetof(struct virtio_pci_cap64, offset_hi)) << 32;
+    length = _dev->pci_readl(cfg_offset + offsetof(struct virtio_pci_cap, length)) |
+        (u64)_dev->pci_readl(cfg_offset + offsetof(struct virtio_pci_cap64, length_hi)) << 32;
+
+    auto bar = _dev->get_bar(bar_index + 1);
+    if (!bar || !bar->is_mmio()) {
+        return false;
+    }
+    if (!bar->is_mapped()) {
+        bar->map();
+    }
+    addr = bar->get_mmio() + offset;
+    return true;
+}
+
 virtio_device* create_virtio_pci_device(pci::device *dev) {
     if (dev->get_device_id() >= VIRTIO_PCI_MODERN_ID_MIN && dev->get_device_id() <= VIRTIO_PCI_MODERN_ID_MAX)
         return new virtio_modern_pci_device(dev);
@@ -145,6 +145,8 @@ enum VIRTIO_MODERN_PCI_CONFIG {
     VIRTIO_PCI_CAP_DEVICE_CFG = 4,
     /* PCI configuration access */
     VIRTIO_PCI_CAP_PCI_CFG = 5,
+    /* Shared memory region */
+    VIRTIO_PCI_CAP_SHARED_MEMORY_CFG = 8,
 };
 
 /* This is the PCI capability header: */
@@ -159,6 +161,15 @@ struct virtio_pci_cap {
     u32 length;     /* Length of the structure, in bytes. */
 };
 
+/* Shared memory regions may be larger than 4GB, so their capability carries
+ * the high halves of the offset and length as well. The id of the region is
+ * held in the first padding byte of the header. */
+struct virtio_pci_cap64 {
+    struct virtio_pci_cap cap;
+    u32 offset_hi;
+    u32 length_hi;
+};
+
 /* The notification location is found using the VIRTIO_PCI_CAP_NOTIFY_CFG capability.
  * This capability is immediately followed by an additional field, like so:*/
 struct virtio_pci_notify_cap {
@@ -273,6 +284,8 @@ public:
 
     virtual bool is_modern() { return true; };
 
+    virtual bool get_shm(u8 id, mmioaddr_t& addr, u64& length);
+
 protected:
     virtual bool parse_pci_config();
 private:
@@ -59,6 +59,7 @@ enum {
     VIRTIO_ID_SCSI    = 8,
     VIRTIO_ID_9P      = 9,
     VIRTIO_ID_RPROC_SERIAL = 11,
+    VIRTIO_ID_FS      = 26,
 };
 
 const unsigned max_virtqueues_nr = 64;
@@ -112,7 +113,7 @@ protected:
     u32 _num_queues;
     bool _cap_indirect_buf;
     bool _cap_event_idx = false;
-    static int _disk_idx;
+    static std::atomic<int> _disk_idx;
     u64 _enabled_features;
 };
 
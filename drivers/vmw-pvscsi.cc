@@ -27,7 +27,7 @@ using namespace memory;
 
 namespace vmw {
 int pvscsi::_instance = 0;
-int pvscsi::_disk_idx = 0;
+std::atomic<int> pvscsi::_disk_idx(0);
 
 struct pvscsi_priv {
     devop_strategy_t strategy;
@@ -173,7 +173,7 @@ private:
     int _id;
 
     // Disk index number
-    static int _disk_idx;
+    static std::atomic<int> _disk_idx;
 
     // This mutex protects parallel make_request invocations
     mutex _lock;
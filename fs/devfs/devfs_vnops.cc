@@ -269,6 +269,7 @@ struct vnops devfs_vnops = {
 	devfs_fallocate,	/* fallocate */
 	devfs_readlink,		/* read link */
 	devfs_symlink,		/* symbolic link */
+	(vnop_readahead_t) nullptr, /* read-ahead */
 };
 
 /*
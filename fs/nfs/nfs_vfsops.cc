@@ -38,6 +38,9 @@ static int nfs_op_mount(struct mount *mp, const char *dev, int flags,
         return err_no;
     }
 
+    // File data is cached with close-to-open consistency, as NFS clients do
+    mp->m_flags |= MNT_PAGECACHE;
+
     return 0;
 }
 
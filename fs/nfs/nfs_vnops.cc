@@ -618,4 +618,5 @@ struct vnops nfs_vnops = {
     nfs_op_fallocate,        /* fallocate */
     nfs_op_readlink,         /* read link */
     nfs_op_symlink,          /* symbolic link */
+    (vnop_readahead_t) nullptr, /* read-ahead */
 };
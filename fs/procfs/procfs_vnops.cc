@@ -22,6 +22,8 @@
 #include <libgen.h>
 #include <osv/mempool.hh>
 #include <osv/printf.hh>
+#include <osv/net_busy_poll.hh>
+#include <bsd/porting/networking.hh>
 
 #include <sys/resource.h>
 #include <mntent.h>
@@ -375,8 +377,29 @@ procfs_mount(mount* mp, const char *dev, int flags, const void* data)
     auto kernel = make_shared<proc_dir_node>(inode_count++);
     kernel->add("hostname", inode_count++, procfs_hostname);
 
+    auto core = make_shared<proc_dir_node>(inode_count++);
+    core->add("busy_read", inode_count++, [] {
+        return std::to_string(osv::busy_poll::read_usecs.load()) + "\n";
+    });
+    core->add("busy_poll", inode_count++, [] {
+        return std::to_string(osv::busy_poll::poll_usecs.load()) + "\n";
+    });
+
+    auto ipv4 = make_shared<proc_dir_node>(inode_count++);
+    ipv4->add("tcp_syncookies", inode_count++, [] {
+        return std::to_string(osv::tcp_syncookies()) + "\n";
+    });
+    ipv4->add("tcp_fastopen", inode_count++, [] {
+        return std::to_string(osv::tcp_fastopen()) + "\n";
+    });
+
+    auto net = make_shared<proc_dir_node>(inode_count++);
+    net->add("core", core);
+    net->add("ipv4", ipv4);
+
     auto sys = make_shared<proc_dir_node>(inode_count++);
     sys->add("kernel", kernel);
+    sys->add("net", net);
 
     auto* root = new proc_dir_node(vp->v_ino);
     root->add("self", self);
@@ -384,6 +407,10 @@ procfs_mount(mount* mp, const char *dev, int flags, const void* data)
     root->add("mounts", inode_count++, procfs_mounts);
     root->add("sys", sys);
 
+    auto procnet = make_shared<proc_dir_node>(inode_count++);
+    procnet->add("netstat", inode_count++, osv::tcp_netstat);
+    root->add("net", procnet);
+
     root->add("cpuinfo", inode_count++, [] { return processor::features_str(); });
 
     vp->v_data = static_cast<void*>(root);
@@ -438,6 +465,7 @@ vnops procfs_vnops = {
     (vnop_fallocate_t) vop_nullop, // vop_fallocate
     (vnop_readlink_t)  vop_nullop, // vop_readlink
     (vnop_symlink_t)   vop_nullop, // vop_symlink
+    (vnop_readahead_t) nullptr,   // vop_readahead
 };
 
 vfsops procfs_vfsops = {
@@ -31,6 +31,10 @@
 #define _RAMFS_H
 
 #include <osv/prex.h>
+#include <osv/pagecache.hh>
+#include <atomic>
+#include <string>
+#include <unordered_map>
 
 /* #define DEBUG_RAMFS 1 */
 
@@ -42,18 +46,63 @@
 
 #define ASSERT(e)    assert(e)
 
+struct ramfs_node;
+
+/*
+ * Data of a regular file, kept in pages indexed by a radix tree: files
+ * grow without being copied, and pages never written to are holes which
+ * read as zeroes. mmap() maps the pages themselves (see ramfs_cache()).
+ * Callers hold the vnode lock.
+ */
+class ramfs_pages : public pagecache::shared_buf {
+public:
+    ~ramfs_pages();
+    /* page holding offset, nullptr for a hole unless alloc */
+    void *page(off_t offset, bool alloc);
+    /* frees the pages past offset, and zeroes the rest of its page */
+    void truncate(off_t offset);
+    /* frees the pages in [start, end), and zeroes the partial ones */
+    void punch_hole(off_t start, off_t end);
+    /* zeroes the rest of the page holding offset */
+    void zero_tail(off_t offset);
+    size_t count() const { return _count; }
+
+    virtual void share() override { _shared = true; }
+    virtual void unshare() override { _shared = false; }
+private:
+    void free_range(void **slot, unsigned level, uint64_t base, uint64_t start, uint64_t end);
+    void zero(off_t from, off_t to);
+    void unmap();
+
+    void *_root = nullptr;    /* data page if _height is 0, else index page */
+    unsigned _height = 0;     /* levels of index pages */
+    size_t _count = 0;        /* data pages allocated */
+    std::atomic<bool> _shared {false};
+};
+
+/*
+ * Children of a directory by name, so that lookups do not have to walk
+ * the rn_child list, which is kept for readdir() to see entries in the
+ * order they were created.
+ */
+typedef std::unordered_map<std::string, struct ramfs_node *> ramfs_names;
+
 /*
  * File/directory node for RAMFS
  */
 struct ramfs_node {
     struct ramfs_node *rn_next;   /* next node in the same directory */
+    struct ramfs_node *rn_prev;   /* previous node in the same directory */
     struct ramfs_node *rn_child;  /* first child node */
+    struct ramfs_node *rn_last_child;  /* last child node */
+    ramfs_names *rn_names;    /* children by name, allocated with the first one */
     int rn_type;    /* file or directory */
     char *rn_name;    /* name (null-terminated) */
     size_t rn_namelen;    /* length of name not including terminator */
     size_t rn_size;    /* file size */
-    char *rn_buf;    /* buffer to the file data */
+    char *rn_buf;    /* symlink target, or file data unpacked from bootfs */
     size_t rn_bufsize;    /* allocated buffer size */
+    ramfs_pages *rn_pages;    /* file data, unless in rn_buf */
     struct timespec rn_ctime;
     struct timespec rn_atime;
     struct timespec rn_mtime;
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+//
+// Radix tree of the pages of a ramfs file. Index pages hold one pointer
+// per child, so a tree of height h covers 512^h pages: two levels are
+// enough for a 1GB file, and appending a page costs the same whatever
+// the size of the file.
+//
+
+#include <string.h>
+#include <algorithm>
+#include <osv/mempool.hh>
+
+#include "ramfs.h"
+
+static constexpr unsigned radix_shift = 9;
+static constexpr uint64_t radix_slots = 1 << radix_shift;
+static_assert(radix_slots * sizeof(void *) == PAGE_SIZE, "an index page is one page");
+
+// Pages covered by a subtree with the given number of index levels
+static uint64_t span(unsigned level)
+{
+    return uint64_t(1) << (level * radix_shift);
+}
+
+static void *alloc_zeroed_page()
+{
+    void *page = memory::alloc_page();
+    memset(page, 0, PAGE_SIZE);
+    return page;
+}
+
+ramfs_pages::~ramfs_pages()
+{
+    unmap();
+    free_range(&_root, _height, 0, 0, UINT64_MAX);
+}
+
+void *ramfs_pages::page(off_t offset, bool alloc)
+{
+    uint64_t index = offset / PAGE_SIZE;
+
+    if (!_root) {
+        if (!alloc) {
+            return nullptr;
+        }
+        // An empty tree can start out as tall as it needs to be
+        _height = 0;
+        while (index >= span(_height)) {
+            _height++;
+        }
+    }
+    while (index >= span(_height)) {
+        if (!alloc) {
+            return nullptr;
+        }
+        auto node = static_cast<void **>(alloc_zeroed_page());
+        node[0] = _root;
+        _root = node;
+        _height++;
+    }
+
+    void **slot = &_root;
+    for (unsigned level = _height; level > 0; level--) {
+        if (!*slot) {
+            if (!alloc) {
+                return nullptr;
+            }
+            *slot = alloc_zeroed_page();
+        }
+        auto node = static_cast<void **>(*slot);
+        slot = &node[(index >> ((level - 1) * radix_shift)) & (radix_slots - 1)];
+    }
+    if (!*slot && alloc) {
+        *slot = alloc_zeroed_page();
+        _count++;
+    }
+    return *slot;
+}
+
+// Frees the data pages with index in [start, end) of the subtree in slot,
+// which starts at page base, and the index pages left empty
+void ramfs_pages::free_range(void **slot, unsigned level, uint64_t base, uint64_t start, uint64_t end)
+{
+    if (!*slot || base >= end || base + span(level) <= start) {
+        return;
+    }
+    if (level == 0) {
+        memory::free_page(*slot);
+        *slot = nullptr;
+        _count--;
+        return;
+    }
+
+    auto node = static_cast<void **>(*slot);
+    uint64_t child_span = span(level - 1);
+    uint64_t first = start > base ? (start - base) / child_span : 0;
+    uint64_t last = std::min((end - 1 - base) / child_span, radix_slots - 1);
+    for (uint64_t i = first; i <= last; i++) {
+        free_range(&node[i], level - 1, base + i * child_span, start, end);
+    }
+    if (std::all_of(node, node + radix_slots, [] (void *p) { return p == nullptr; })) {
+        memory::free_page(node);
+        *slot = nullptr;
+    }
+}
+
+// Pages mapped by mmap() must not be mapped any more once freed
+void ramfs_pages::unmap()
+{
+    if (_shared) {
+        pagecache::unmap_shared_buf(this);
+    }
+}
+
+// Zeroes [from, to), which lies within a single page
+void ramfs_pages::zero(off_t from, off_t to)
+{
+    if (from < to) {
+        auto p = static_cast<char *>(page(from, false));
+        if (p) {
+            memset(p + from % PAGE_SIZE, 0, to - from);
+        }
+    }
+}
+
+void ramfs_pages::zero_tail(off_t offset)
+{
+    zero(offset, round_page(offset));
+}
+
+void ramfs_pages::truncate(off_t offset)
+{
+    punch_hole(offset, INT64_MAX);
+}
+
+void ramfs_pages::punch_hole(off_t start, off_t end)
+{
+    off_t first = round_page(start);
+    off_t last = end == INT64_MAX ? end : end - end % PAGE_SIZE;
+
+    if (first < last && _root) {
+        unmap();
+        free_range(&_root, _height, 0, first / PAGE_SIZE,
+                   end == INT64_MAX ? UINT64_MAX : last / PAGE_SIZE);
+        if (!_root) {
+            _height = 0;
+        }
+    }
+
+    // Zero the parts of the range in pages which are not freed whole
+    zero(start, std::min(end, first));
+    if (last != INT64_MAX) {
+        zero(std::max(start, last), end);
+    }
+}
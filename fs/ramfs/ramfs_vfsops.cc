@@ -72,6 +72,8 @@ ramfs_mount(struct mount *mp, const char *dev, int flags, const void *data)
     if (np == NULL)
         return ENOMEM;
     mp->m_root->d_vnode->v_data = np;
+    /* File pages live in memory, mmap() maps them rather than copies */
+    mp->m_flags |= MNT_DIRECTMAP;
     return 0;
 }
 
@@ -39,17 +39,20 @@
 #include <string.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <algorithm>
 
 #include <osv/prex.h>
 #include <osv/vnode.h>
 #include <osv/file.h>
 #include <osv/mount.h>
 #include <osv/vnode_attr.h>
+#include <osv/mempool.hh>
 
 #include "ramfs.h"
 
 static mutex_t ramfs_lock = MUTEX_INITIALIZER;
 static uint64_t inode_count = 1; /* inode 0 is reserved to root */
+static char ramfs_zeroes[PAGE_SIZE]; /* read from holes */
 
 static void
 set_times_to_now(struct timespec *time1, struct timespec *time2 = nullptr, struct timespec *time3 = nullptr)
@@ -105,6 +108,8 @@ ramfs_free_node(struct ramfs_node *np)
     if (np->rn_buf != NULL && np->rn_owns_buf)
         free(np->rn_buf);
 
+    delete np->rn_pages;
+    delete np->rn_names;
     free(np->rn_name);
     free(np);
 }
@@ -112,7 +117,7 @@ ramfs_free_node(struct ramfs_node *np)
 static struct ramfs_node *
 ramfs_add_node(struct ramfs_node *dnp, char *name, int type)
 {
-    struct ramfs_node *np, *prev;
+    struct ramfs_node *np;
 
     np = ramfs_allocate_node(name, type);
     if (np == NULL)
@@ -120,15 +125,17 @@ ramfs_add_node(struct ramfs_node *dnp, char *name, int type)
 
     mutex_lock(&ramfs_lock);
 
-    /* Link to the directory list */
-    if (dnp->rn_child == NULL) {
+    if (dnp->rn_names == NULL)
+        dnp->rn_names = new ramfs_names;
+    (*dnp->rn_names)[np->rn_name] = np;
+
+    /* Link to the end of the directory list */
+    np->rn_prev = dnp->rn_last_child;
+    if (dnp->rn_last_child == NULL)
         dnp->rn_child = np;
-    } else {
-        prev = dnp->rn_child;
-        while (prev->rn_next != NULL)
-            prev = prev->rn_next;
-        prev->rn_next = np;
-    }
+    else
+        dnp->rn_last_child->rn_next = np;
+    dnp->rn_last_child = np;
 
     set_times_to_now(&(dnp->rn_mtime), &(dnp->rn_ctime));
 
@@ -139,26 +146,27 @@ ramfs_add_node(struct ramfs_node *dnp, char *name, int type)
 static int
 ramfs_remove_node(struct ramfs_node *dnp, struct ramfs_node *np)
 {
-    struct ramfs_node *prev;
-
     if (dnp->rn_child == NULL)
         return EBUSY;
 
     mutex_lock(&ramfs_lock);
 
+    auto it = dnp->rn_names->find(np->rn_name);
+    if (it == dnp->rn_names->end() || it->second != np) {
+        mutex_unlock(&ramfs_lock);
+        return ENOENT;
+    }
+    dnp->rn_names->erase(it);
+
     /* Unlink from the directory list */
-    if (dnp->rn_child == np) {
+    if (np->rn_prev == NULL)
         dnp->rn_child = np->rn_next;
-    } else {
-        for (prev = dnp->rn_child; prev->rn_next != np;
-             prev = prev->rn_next) {
-            if (prev->rn_next == NULL) {
-                mutex_unlock(&ramfs_lock);
-                return ENOENT;
-            }
-        }
-        prev->rn_next = np->rn_next;
-    }
+    else
+        np->rn_prev->rn_next = np->rn_next;
+    if (np->rn_next == NULL)
+        dnp->rn_last_child = np->rn_prev;
+    else
+        np->rn_next->rn_prev = np->rn_prev;
     ramfs_free_node(np);
 
     set_times_to_now(&(dnp->rn_mtime), &(dnp->rn_ctime));
@@ -168,7 +176,7 @@ ramfs_remove_node(struct ramfs_node *dnp, struct ramfs_node *np)
 }
 
 static int
-ramfs_rename_node(struct ramfs_node *np, char *name)
+ramfs_rename_node(struct ramfs_node *dnp, struct ramfs_node *np, char *name)
 {
     size_t len;
     char *tmp;
@@ -177,20 +185,30 @@ ramfs_rename_node(struct ramfs_node *np, char *name)
     if (len > NAME_MAX) {
         return ENAMETOOLONG;
     }
+
+    mutex_lock(&ramfs_lock);
+
+    dnp->rn_names->erase(np->rn_name);
     if (len <= np->rn_namelen) {
         /* Reuse current name buffer */
         strlcpy(np->rn_name, name, np->rn_namelen + 1);
     } else {
         /* Expand name buffer */
         tmp = (char *) malloc(len + 1);
-        if (tmp == NULL)
+        if (tmp == NULL) {
+            (*dnp->rn_names)[np->rn_name] = np;
+            mutex_unlock(&ramfs_lock);
             return ENOMEM;
+        }
         strlcpy(tmp, name, len + 1);
         free(np->rn_name);
         np->rn_name = tmp;
     }
     np->rn_namelen = len;
+    (*dnp->rn_names)[np->rn_name] = np;
     set_times_to_now(&(np->rn_ctime));
+
+    mutex_unlock(&ramfs_lock);
     return 0;
 }
 
@@ -199,8 +217,6 @@ ramfs_lookup(struct vnode *dvp, char *name, struct vnode **vpp)
 {
     struct ramfs_node *np, *dnp;
     struct vnode *vp;
-    size_t len;
-    int found;
 
     *vpp = NULL;
 
@@ -209,17 +225,14 @@ ramfs_lookup(struct vnode *dvp, char *name, struct vnode **vpp)
 
     mutex_lock(&ramfs_lock);
 
-    len = strlen(name);
     dnp = (ramfs_node *) dvp->v_data;
-    found = 0;
-    for (np = dnp->rn_child; np != NULL; np = np->rn_next) {
-        if (np->rn_namelen == len &&
-            memcmp(name, np->rn_name, len) == 0) {
-            found = 1;
-            break;
-        }
+    np = NULL;
+    if (dnp->rn_names != NULL) {
+        auto it = dnp->rn_names->find(name);
+        if (it != dnp->rn_names->end())
+            np = it->second;
     }
-    if (found == 0) {
+    if (np == NULL) {
         mutex_unlock(&ramfs_lock);
         return ENOENT;
     }
@@ -324,39 +337,45 @@ ramfs_remove(struct vnode *dvp, struct vnode *vp, char *name)
     return ramfs_remove_node((ramfs_node *) dvp->v_data, (ramfs_node *) vp->v_data);
 }
 
+/*
+ * Move the data of a file unpacked from bootfs, which is not ours, to
+ * pages of its own before it changes.
+ */
+static void
+ramfs_own_pages(struct ramfs_node *np)
+{
+    if (np->rn_pages == NULL)
+        np->rn_pages = new ramfs_pages;
+    if (np->rn_buf == NULL)
+        return;
+
+    for (size_t off = 0; off < np->rn_size; off += PAGE_SIZE) {
+        memcpy(np->rn_pages->page(off, true), np->rn_buf + off,
+               std::min(size_t(PAGE_SIZE), np->rn_size - off));
+    }
+    if (np->rn_owns_buf)
+        free(np->rn_buf);
+    np->rn_buf = NULL;
+    np->rn_bufsize = 0;
+    np->rn_owns_buf = true;
+}
+
 /* Truncate file */
 static int
 ramfs_truncate(struct vnode *vp, off_t length)
 {
     struct ramfs_node *np;
-    void *new_buf;
-    size_t new_size;
 
     DPRINTF(("truncate %s length=%d\n", vp->v_path, length));
     np = (ramfs_node *) vp->v_data;
 
-    if (length == 0) {
-        if (np->rn_buf != NULL) {
-            if(np->rn_owns_buf)
-                free(np->rn_buf);
-            np->rn_buf = NULL;
-            np->rn_bufsize = 0;
-        }
-    } else if (size_t(length) > np->rn_bufsize) {
-        // XXX: this could use a page level allocator
-        new_size = round_page(length);
-        new_buf = malloc(new_size);
-        if (!new_buf)
-            return EIO;
-        if (np->rn_size != 0) {
-            memcpy(new_buf, np->rn_buf, vp->v_size);
-            if(np->rn_owns_buf)
-                free(np->rn_buf);
-        }
-        np->rn_buf = (char *) new_buf;
-        np->rn_bufsize = new_size;
-        np->rn_owns_buf = true;
-    }
+    /* Pages past the end are freed, and a new end reads zeroes after it */
+    ramfs_own_pages(np);
+    if (size_t(length) < np->rn_size)
+        np->rn_pages->truncate(length);
+    else
+        np->rn_pages->zero_tail(np->rn_size);
+
     np->rn_size = length;
     vp->v_size = length;
     set_times_to_now(&(np->rn_mtime), &(np->rn_ctime));
@@ -414,7 +433,23 @@ ramfs_read(struct vnode *vp, struct file *fp, struct uio *uio, int ioflag)
 
     set_times_to_now(&(np->rn_atime));
 
-    return uiomove(np->rn_buf + uio->uio_offset, len, uio);
+    if (np->rn_buf != NULL)
+        return uiomove(np->rn_buf + uio->uio_offset, len, uio);
+
+    while (len > 0) {
+        off_t off = uio->uio_offset;
+        size_t n = std::min(len, size_t(PAGE_SIZE - off % PAGE_SIZE));
+        void *page = np->rn_pages ? np->rn_pages->page(off, false) : NULL;
+        int error;
+        if (page != NULL)
+            error = uiomove((char *) page + off % PAGE_SIZE, n, uio);
+        else
+            error = uiomove(ramfs_zeroes, n, uio);   /* a hole */
+        if (error)
+            return error;
+        len -= n;
+    }
+    return 0;
 }
 
 int
@@ -465,30 +500,84 @@ ramfs_write(struct vnode *vp, struct uio *uio, int ioflag)
     if (ioflag & IO_APPEND)
         uio->uio_offset = np->rn_size;
 
+    ramfs_own_pages(np);
     if (size_t(uio->uio_offset + uio->uio_resid) > (size_t) vp->v_size) {
         /* Expand the file size before writing to it */
         off_t end_pos = uio->uio_offset + uio->uio_resid;
-        if (end_pos > (off_t) np->rn_bufsize) {
-            // XXX: this could use a page level allocator
-            size_t new_size = round_page(end_pos);
-            void *new_buf = malloc(new_size);
-            if (!new_buf)
-                return EIO;
-            if (np->rn_size != 0) {
-                memcpy(new_buf, np->rn_buf, vp->v_size);
-                if(np->rn_owns_buf)
-                    free(np->rn_buf);
-            }
-            np->rn_buf = (char *) new_buf;
-            np->rn_bufsize = new_size;
-        }
+        if (uio->uio_offset > (off_t) np->rn_size)
+            np->rn_pages->zero_tail(np->rn_size);
         np->rn_size = end_pos;
         vp->v_size = end_pos;
-        np->rn_owns_buf = true;
     }
 
     set_times_to_now(&(np->rn_mtime), &(np->rn_ctime));
-    return uiomove(np->rn_buf + uio->uio_offset, uio->uio_resid, uio);
+    while (uio->uio_resid > 0) {
+        off_t off = uio->uio_offset;
+        size_t n = std::min(size_t(uio->uio_resid), size_t(PAGE_SIZE - off % PAGE_SIZE));
+        char *page = (char *) np->rn_pages->page(off, true);
+        int error = uiomove(page + off % PAGE_SIZE, n, uio);
+        if (error)
+            return error;
+    }
+    return 0;
+}
+
+/*
+ * Allocate the pages of a range of the file, or free them with
+ * FALLOC_FL_PUNCH_HOLE.
+ */
+static int
+ramfs_fallocate(struct vnode *vp, int mode, loff_t offset, loff_t len)
+{
+    struct ramfs_node *np = (ramfs_node *) vp->v_data;
+    off_t end;
+
+    if (vp->v_type == VDIR)
+        return EISDIR;
+    if (mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE))
+        return EOPNOTSUPP;
+    if (len > LONG_MAX - offset)
+        return EFBIG;
+    end = offset + len;
+
+    ramfs_own_pages(np);
+    if (mode & FALLOC_FL_PUNCH_HOLE) {
+        np->rn_pages->punch_hole(offset, std::min(end, (off_t) np->rn_size));
+    } else {
+        if (size_t(len) > memory::stats::free())
+            return ENOSPC;
+        for (off_t off = offset - offset % PAGE_SIZE; off < end; off += PAGE_SIZE)
+            np->rn_pages->page(off, true);
+        if (!(mode & FALLOC_FL_KEEP_SIZE) && end > (off_t) np->rn_size) {
+            np->rn_pages->zero_tail(np->rn_size);
+            np->rn_size = end;
+            vp->v_size = end;
+        }
+    }
+    set_times_to_now(&(np->rn_mtime), &(np->rn_ctime));
+    return 0;
+}
+
+/*
+ * Put a page of the file in the page cache, for mmap() to map it rather
+ * than a copy. Holes get a page of their own, as the mapping may write to
+ * it; past the end of the file, the zero page gets mapped.
+ */
+static int
+ramfs_cache(struct vnode *vp, struct file *fp, struct uio *uio)
+{
+    struct ramfs_node *np = (ramfs_node *) vp->v_data;
+    void *page;
+
+    if (vp->v_type != VREG || uio->uio_offset >= (off_t) np->rn_size)
+        return 0;
+
+    ramfs_own_pages(np);
+    page = np->rn_pages->page(uio->uio_offset, true);
+    pagecache::map_shared_buf((pagecache::hashkey *) uio->uio_iov->iov_base,
+                              np->rn_pages, page);
+    uio->uio_resid = 0;
+    return 0;
 }
 
 static int
@@ -507,7 +596,7 @@ ramfs_rename(struct vnode *dvp1, struct vnode *vp1, char *name1,
     /* Same directory ? */
     if (dvp1 == dvp2) {
         /* Change the name of existing file */
-        error = ramfs_rename_node((ramfs_node *) vp1->v_data, name2);
+        error = ramfs_rename_node((ramfs_node *) dvp1->v_data, (ramfs_node *) vp1->v_data, name2);
         if (error)
             return error;
     } else {
@@ -522,8 +611,15 @@ ramfs_rename(struct vnode *dvp1, struct vnode *vp1, char *name1,
             np->rn_buf = old_np->rn_buf;
             np->rn_size = old_np->rn_size;
             np->rn_bufsize = old_np->rn_bufsize;
+            np->rn_owns_buf = old_np->rn_owns_buf;
             old_np->rn_buf = NULL;
         }
+        if (old_np->rn_pages) {
+            /* Move file pages */
+            np->rn_pages = old_np->rn_pages;
+            np->rn_size = old_np->rn_size;
+            old_np->rn_pages = NULL;
+        }
         /* Remove source file */
         ramfs_remove_node((ramfs_node *) dvp1->v_data, (ramfs_node *) vp1->v_data);
     }
@@ -636,7 +732,6 @@ ramfs_setattr(struct vnode *vnode, struct vattr *attr) {
 #define ramfs_fsync     ((vnop_fsync_t)vop_nullop)
 #define ramfs_inactive  ((vnop_inactive_t)vop_nullop)
 #define ramfs_link      ((vnop_link_t)vop_eperm)
-#define ramfs_fallocate ((vnop_fallocate_t)vop_nullop)
 
 /*
  * vnode operations
@@ -661,9 +756,10 @@ struct vnops ramfs_vnops = {
         ramfs_inactive,         /* inactive */
         ramfs_truncate,         /* truncate */
         ramfs_link,             /* link */
-        (vnop_cache_t) nullptr, /* arc */
+        ramfs_cache,            /* arc */
         ramfs_fallocate,        /* fallocate */
         ramfs_readlink,         /* read link */
         ramfs_symlink,          /* symbolic link */
+        (vnop_readahead_t) nullptr, /* read-ahead */
 };
 
@@ -49,6 +49,20 @@
 // in memory forever as there is no LRU logic implemented that could limit
 // memory used.
 //
+// On top of that, when a file is read sequentially the VFS read-ahead
+// engine (see include/osv/readahead.hh) asks ROFS to load segments past
+// the reader; these are read from disk asynchronously and a read that
+// gets to a segment still in flight waits for it to complete.
+//
+// Images can also be compressed (version 2, see gen-rofs-img.py -c), in
+// which case file data is stored as independently compressed chunks of one
+// cache segment each. A segment is then read from disk compressed and
+// inflated in memory; segments loaded by read-ahead are inflated by a pool
+// of "rofs-decompress" threads, one per cpu, so that decompressing a file
+// read sequentially happens in parallel with the reader consuming it.
+// Compressed images always use the cache, as a chunk has to be inflated
+// as a whole anyway.
+//
 // The structure of the data on disk is explained in scripts/gen-rofs-img.py
 
 #ifndef __INCLUDE_ROFS_H__
@@ -59,8 +73,10 @@
 #include <osv/dentry.h>
 #include <osv/prex.h>
 #include <osv/buf.h>
+#include <osv/pagecache.hh>
+#include <functional>
 
-#define ROFS_VERSION            1
+#define ROFS_VERSION            2
 #define ROFS_MAGIC              0xDEADBEAD
 
 #define ROFS_INODE_SIZE ((uint64_t)sizeof(struct rofs_inode))
@@ -68,6 +84,17 @@
 #define ROFS_SUPERBLOCK_SIZE sizeof(struct rofs_super_block)
 #define ROFS_SUPERBLOCK_BLOCK 0
 
+// Bits of rofs_super_block::flags
+#define ROFS_FLAG_SORTED_DIRS   0x1     // entries of each directory are sorted by name
+
+// Values of rofs_super_block::compression
+#define ROFS_COMPRESSION_NONE   0
+#define ROFS_COMPRESSION_ZLIB   1
+#define ROFS_COMPRESSION_LZ4    2
+
+// Compressed images store file data in chunks of one cache segment
+#define ROFS_CHUNK_SIZE         (32 * 1024)
+
 //#define ROFS_DEBUG_ENABLED 1
 
 #if defined(ROFS_DEBUG_ENABLED)
@@ -101,6 +128,11 @@ struct rofs_super_block {
     uint64_t directory_entries_count;
     uint64_t symlinks_count;
     uint64_t inodes_count;
+    // Version 2 only; read as zero from version 1 images
+    uint64_t compression;
+    uint64_t chunk_size;
+    uint64_t chunks_count;          // entries in the chunk table
+    uint64_t flags;                 // ROFS_FLAG_*, zero in older images
 };
 
 struct rofs_inode {
@@ -123,14 +155,35 @@ struct rofs_info {
     struct rofs_dir_entry *dir_entries;
     char **symlinks;
     struct rofs_inode *inodes;
+    // Byte offsets on disk of the compressed chunks of all files, or null if
+    // the image is not compressed. A compressed file's data_offset is the
+    // index of its first chunk, and chunk i of the table spans
+    // [chunk_offsets[i], chunk_offsets[i + 1]).
+    uint64_t *chunk_offsets;
 };
 
 namespace rofs {
     int
-    cache_read(struct rofs_inode *inode, struct device *device, struct rofs_super_block *sb, struct uio *uio);
+    cache_read(struct rofs_inode *inode, struct device *device, struct rofs_info *rofs, struct uio *uio);
+    void
+    cache_readahead(struct rofs_inode *inode, struct device *device, struct rofs_info *rofs,
+                    uint64_t offset, uint64_t len);
+    int
+    cache_map(struct rofs_inode *inode, struct device *device, struct rofs_info *rofs,
+              pagecache::hashkey *key, struct uio *uio);
+
+    void
+    start_decompress_threads();
+    int
+    decompress_chunk(uint64_t compression, void *src, uint64_t src_len, void *dst, uint64_t dst_len);
+    void
+    decompress_async(std::function<void ()> work);
 }
 
 int rofs_read_blocks(struct device *device, uint64_t starting_block, uint64_t blocks_count, void* buf);
+struct bio *rofs_read_blocks_async(struct device *device, uint64_t starting_block, uint64_t blocks_count, void* buf,
+                                   void (*done)(struct bio *) = nullptr, void *arg = nullptr);
+int rofs_wait_blocks(struct bio *bio);
 void rofs_set_vnode(struct vnode* vnode, struct rofs_inode *inode);
 
 #endif
@@ -12,11 +12,28 @@
 #include <include/osv/uio.h>
 #include <osv/debug.h>
 #include <osv/sched.hh>
+#include <osv/bio.h>
+#include <osv/condvar.h>
+#include <osv/mempool.hh>
+#include <osv/rofs_cache.hh>
+#include <osv/pagecache.hh>
+#include <osv/align.hh>
+#include <boost/intrusive/list.hpp>
 
 /*
  * From cache perspective let us divide each file into sequence of contiguous 32K segments.
  * The files smaller or equal than 32K get loaded in one read, others get loaded
  * segment by segment.
+ *
+ * Segments of all files are kept on a single LRU list. Once the cache holds more
+ * than osv::rofs_cache::max_bytes, or when the memory reclaimer calls the "rofs"
+ * shrinker, the least recently used segments are evicted. Segments being read by
+ * cache_read() are pinned, and segments still being loaded are skipped.
+ *
+ * Segments are made of whole pages which mmap() maps directly (see cache_map()),
+ * so that all mappings of a file, shared libraries in particular, and read()
+ * share the cached data. Mapped segments are only evicted under memory
+ * pressure, after their pages are unmapped.
  **/
 //
 //TODO These 2 values can be made configurable
@@ -30,25 +47,42 @@ extern std::atomic<long> rofs_cache_misses;
 #endif
 
 namespace rofs {
+//
+// Bytes of segments being read ahead, from when the read is issued until
+// it completes
+static std::atomic<uint64_t> read_ahead_bytes;
+
 //
 // This structure holds cache information and data of specific file
 struct file_cache {
     std::unordered_map<uint64_t, struct file_cache_segment *> segments_by_index;
     struct rofs_inode *inode;
     struct rofs_super_block *sb;
+    uint64_t *chunk_offsets;  // Chunk table of compressed images, null otherwise
 };
 
+static_assert(CACHE_SEGMENT_SIZE_IN_BLOCKS * BSIZE == ROFS_CHUNK_SIZE,
+              "compressed chunks must match cache segments");
+
 //
 // This structure holds block_count (typically CACHE_SEGMENT_SIZE_IN_BLOCKS) of 512 blocks
 // of file data starting at starting_block * 512 byte offset relative to the beginning
 // of the file.
-class file_cache_segment {
+class file_cache_segment : public pagecache::shared_buf {
 private:
     struct file_cache *cache; // Parent file cache
     void *data;               // Copy of data on disk
     uint64_t starting_block;  // This is relative to the 512-block of the inode itself
     uint64_t block_count;     // Length of data in 512 blocks
     bool data_ready;          // Has data been fully read from disk?
+    bool read_ahead;          // Read ahead of the reader, not waited for yet
+    //
+    // Completion of the read ahead, signalled by the disk or decompression
+    mutex load_lock;
+    condvar load_done;
+    bool loading;
+    int load_error;
+    void *compressed;         // Chunk read from disk, until inflated into data
 
 public:
     file_cache_segment(struct file_cache *_cache, uint64_t _starting_block, uint64_t _block_count) {
@@ -56,16 +90,67 @@ public:
         this->starting_block = _starting_block;
         this->block_count = _block_count;
         this->data_ready = false;   // Data has to be loaded from disk
-        this->data = malloc(_cache->sb->block_size * _block_count);
+        this->read_ahead = false;
+        this->loading = false;
+        this->load_error = 0;
+        this->compressed = nullptr;
+        //
+        // Whole pages, so that they can be mapped, and zero past the end
+        // of the file as mmap() requires
+        auto alloc_size = align_up(length(), (uint64_t)mmu::page_size);
+        this->data = aligned_alloc(mmu::page_size, alloc_size);
+        auto data_size = std::min(length(), _cache->inode->file_size - _starting_block * _cache->sb->block_size);
+        memset(this->data + data_size, 0, alloc_size - data_size);
 #if defined(ROFS_DIAGNOSTICS_ENABLED)
         rofs_block_allocated += block_count;
 #endif
     }
 
     ~file_cache_segment() {
+        if (in_flight()) {
+            wait_for_disk();
+        }
+        if (shared) {
+            pagecache::unmap_shared_buf(this);
+        }
         free(this->data);
     }
 
+    //
+    // Pages of the segment are mapped directly by mmap() (see cache_map())
+    std::atomic<bool> shared = { false };
+
+    virtual void share() override {
+        shared = true;
+    }
+
+    virtual void unshare() override {
+        shared = false;
+    }
+
+    void *page(uint64_t offset_in_segment) {
+        return this->data + align_down(offset_in_segment, (uint64_t)mmu::page_size);
+    }
+
+    //
+    // Eviction state, protected by file_cache_lock
+    boost::intrusive::list_member_hook<> lru_link;
+    unsigned pins = 0;
+
+    struct file_cache *file() {
+        return this->cache;
+    }
+
+    uint64_t index() {
+        return this->starting_block / CACHE_SEGMENT_SIZE_IN_BLOCKS;
+    }
+
+    bool in_flight() {
+        WITH_LOCK(load_lock) {
+            return this->loading;
+        }
+    }
+
     uint64_t length() {
         return this->block_count * this->cache->sb->block_size;
     }
@@ -74,6 +159,10 @@ public:
         return this->data_ready;
     }
 
+    bool is_loading() {
+        return this->read_ahead;
+    }
+
     //
     // Read data from memory per uio
     int read(struct uio *uio, uint64_t offset_in_segment, uint64_t bytes_to_read) {
@@ -84,37 +173,223 @@ public:
     }
 
     //
-    // Read all segment data from disk and copy to memory
-    int read_from_disk(struct device *device) {
-        auto block = cache->inode->data_offset + starting_block;
+    // Number of blocks of the segment holding file data
+    uint64_t blocks_to_read() {
         auto bytes_remaining = cache->inode->file_size - starting_block * cache->sb->block_size;
         auto blocks_remaining = bytes_remaining / cache->sb->block_size;
         if (bytes_remaining % cache->sb->block_size > 0) {
             blocks_remaining++;
         }
-        auto block_count_to_read = std::min(block_count, blocks_remaining);
+        return std::min(block_count, blocks_remaining);
+    }
+
+    //
+    // Read all segment data from disk and copy to memory
+    int read_from_disk(struct device *device) {
+        uint64_t block, block_count_to_read;
+        disk_extent(block, block_count_to_read);
         print("[rofs] [%d] -> file_cache_segment::write() i-node: %d, starting block %d, reading [%d] blocks at disk offset [%d]\n",
               sched::thread::current()->id(), cache->inode->inode_no, starting_block, block_count_to_read, block);
-        auto error = rofs_read_blocks(device, block, block_count_to_read, data);
+        int error;
+        if (!cache->chunk_offsets) {
+            error = rofs_read_blocks(device, block, block_count_to_read, data);
+        } else {
+            void *buf = malloc(block_count_to_read * cache->sb->block_size);
+            error = rofs_read_blocks(device, block, block_count_to_read, buf);
+            if (!error) {
+                error = inflate(buf);
+            }
+            free(buf);
+        }
         this->data_ready = (error == 0);
         if (error) {
             print("!!!!! Error reading from disk\n");
         }
         return error;
     }
+
+    //
+    // Start reading segment data from disk ahead of the reader. Compressed
+    // segments are inflated by the decompression threads once read.
+    void read_from_disk_async(struct device *device) {
+        uint64_t block, block_count_to_read;
+        disk_extent(block, block_count_to_read);
+        print("[rofs] [%d] -> file_cache_segment::read_from_disk_async() i-node: %d, starting block %d\n",
+              sched::thread::current()->id(), cache->inode->inode_no, starting_block);
+        void *buf = data;
+        if (cache->chunk_offsets) {
+            buf = this->compressed = malloc(block_count_to_read * cache->sb->block_size);
+        }
+        this->read_ahead = true;
+        this->loading = true;
+        read_ahead_bytes += length();
+        if (!rofs_read_blocks_async(device, block, block_count_to_read, buf, disk_read_done, this)) {
+            // Leave it to cache_read() to read the segment
+            finish_loading(ENOMEM);
+        }
+    }
+
+    //
+    // Wait for the read started by read_from_disk_async()
+    int wait_for_disk() {
+        WITH_LOCK(load_lock) {
+            while (this->loading) {
+                load_done.wait(load_lock);
+            }
+        }
+        this->read_ahead = false;
+        this->data_ready = (this->load_error == 0);
+        return this->load_error;
+    }
+
+private:
+    //
+    // The blocks on disk holding the segment data, compressed or not
+    void disk_extent(uint64_t &block, uint64_t &count) {
+        if (!cache->chunk_offsets) {
+            block = cache->inode->data_offset + starting_block;
+            count = blocks_to_read();
+            return;
+        }
+        auto block_size = cache->sb->block_size;
+        auto chunk = cache->inode->data_offset + starting_block / CACHE_SEGMENT_SIZE_IN_BLOCKS;
+        block = cache->chunk_offsets[chunk] / block_size;
+        count = (cache->chunk_offsets[chunk + 1] + block_size - 1) / block_size - block;
+    }
+
+    //
+    // Decompress the segment chunk from the blocks read from disk into data
+    int inflate(void *buf) {
+        auto chunk = cache->inode->data_offset + starting_block / CACHE_SEGMENT_SIZE_IN_BLOCKS;
+        auto chunk_start = cache->chunk_offsets[chunk];
+        auto chunk_len = cache->chunk_offsets[chunk + 1] - chunk_start;
+        auto data_len = std::min(length(), cache->inode->file_size - starting_block * cache->sb->block_size);
+        return decompress_chunk(cache->sb->compression, buf + chunk_start % cache->sb->block_size,
+                                chunk_len, data, data_len);
+    }
+
+    void finish_loading(int error) {
+        free(this->compressed);
+        this->compressed = nullptr;
+        read_ahead_bytes -= length();
+        WITH_LOCK(load_lock) {
+            this->load_error = error;
+            this->loading = false;
+            load_done.wake_all();
+        }
+    }
+
+    static void disk_read_done(struct bio *bio) {
+        auto segment = static_cast<file_cache_segment *>(bio->bio_caller1);
+        int error = (bio->bio_flags & BIO_ERROR) ? EIO : 0;
+        destroy_bio(bio);
+        if (!error && segment->compressed) {
+            decompress_async([segment] {
+                segment->finish_loading(segment->inflate(segment->compressed));
+            });
+        } else {
+            segment->finish_loading(error);
+        }
+    }
 };
 
 static std::unordered_map<uint64_t, struct file_cache *> file_cache_by_node_id;
 static mutex file_cache_lock;
 
-static struct file_cache *get_or_create_file_cache(struct rofs_inode *inode, struct rofs_super_block *sb) {
+static boost::intrusive::list<file_cache_segment,
+    boost::intrusive::member_hook<file_cache_segment, boost::intrusive::list_member_hook<>,
+                                  &file_cache_segment::lru_link>> segments_lru;
+static uint64_t cached_bytes;
+
+static std::atomic<uint64_t> stat_reads, stat_hits, stat_misses, stat_read_aheads, stat_evictions;
+
+//
+// Make a segment, just created or used, the most recently used one
+static void touch_segment(file_cache_segment *segment) {
+    if (segment->lru_link.is_linked()) {
+        segments_lru.erase(segments_lru.iterator_to(*segment));
+    } else {
+        cached_bytes += segment->length();
+    }
+    segments_lru.push_front(*segment);
+}
+
+//
+// Unlink least recently used segments until at least bytes are freed, and
+// return them for the caller to delete once it has dropped file_cache_lock.
+// Segments mapped by mmap() are only evicted if evict_shared is set, by the
+// shrinker. It unmaps them right away, unless that would wait for the page
+// cache lock, which may be held by a thread waiting for memory.
+static std::vector<file_cache_segment *> evict_segments(uint64_t bytes, bool evict_shared) {
+    std::vector<file_cache_segment *> evicted;
+    uint64_t freed = 0;
+    auto it = segments_lru.end();
+    while (freed < bytes && it != segments_lru.begin()) {
+        auto segment = &*--it;
+        if (segment->pins || segment->in_flight()) {
+            continue;
+        }
+        if (segment->shared && (!evict_shared || !pagecache::try_unmap_shared_buf(segment))) {
+            continue;
+        }
+        it = segments_lru.erase(it);
+        segment->file()->segments_by_index.erase(segment->index());
+        cached_bytes -= segment->length();
+        freed += segment->length();
+        evicted.push_back(segment);
+    }
+    stat_evictions += evicted.size();
+    return evicted;
+}
+
+//
+// Evicts segments until the cache and incoming more bytes fit the budget
+static std::vector<file_cache_segment *> evict_over_budget(uint64_t incoming = 0) {
+    uint64_t max = osv::rofs_cache::max_bytes.load(std::memory_order_relaxed);
+    if (!max || cached_bytes + incoming <= max) {
+        return {};
+    }
+    return evict_segments(cached_bytes + incoming - max, false);
+}
+
+static void free_segments(const std::vector<file_cache_segment *> &segments) {
+    for (auto segment : segments) {
+        delete segment;
+    }
+}
+
+//
+// Gives memory back to the system under pressure
+static class rofs_cache_shrinker : public memory::shrinker {
+public:
+    rofs_cache_shrinker() : shrinker("rofs") {}
+    size_t request_memory(size_t n, bool hard) {
+        std::vector<file_cache_segment *> evicted;
+        // Whoever holds file_cache_lock may be allocating memory itself
+        if (!file_cache_lock.try_lock()) {
+            return 0;
+        }
+        evicted = evict_segments(n, true);
+        file_cache_lock.unlock();
+
+        size_t freed = 0;
+        for (auto segment : evicted) {
+            freed += segment->length();
+        }
+        free_segments(evicted);
+        return freed;
+    }
+} s_rofs_cache_shrinker;
+
+static struct file_cache *get_or_create_file_cache(struct rofs_inode *inode, struct rofs_info *rofs) {
     // This is the only global mutex
     WITH_LOCK(file_cache_lock) {
         auto cache_entry = file_cache_by_node_id.find(inode->inode_no);
         if (cache_entry == file_cache_by_node_id.end()) {
             struct file_cache *new_cache = new file_cache();
             new_cache->inode = inode;
-            new_cache->sb = sb;
+            new_cache->sb = rofs->sb;
+            new_cache->chunk_offsets = rofs->chunk_offsets;
             file_cache_by_node_id.emplace(inode->inode_no, new_cache);
             return new_cache;
         } else {
@@ -151,7 +426,7 @@ struct cache_segment_transaction {
 // This function analyzes uio against existing segments in file_cache
 // and builds a vector of transactions/operation that is used by cache_read to tell it
 // to either read data from memory in cache segment or read data from disk into
-// new segment
+// new segment. Called with file_cache_lock held.
 static std::vector<struct cache_segment_transaction>
 plan_cache_transactions(struct file_cache *cache, struct uio *uio) {
 
@@ -212,23 +487,84 @@ plan_cache_transactions(struct file_cache *cache, struct uio *uio) {
     return transactions;
 }
 
+//
+// Plans the transactions for uio and pins their segments until
+// unpin_transactions() so that they cannot be evicted meanwhile
+static std::vector<struct cache_segment_transaction>
+pin_transactions(struct file_cache *cache, struct uio *uio) {
+    std::vector<struct cache_segment_transaction> transactions;
+    std::vector<file_cache_segment *> evicted;
+    WITH_LOCK(file_cache_lock) {
+        transactions = plan_cache_transactions(cache, uio);
+        for (auto &transaction : transactions) {
+            transaction.segment->pins++;
+            touch_segment(transaction.segment);
+        }
+        evicted = evict_over_budget();
+    }
+    free_segments(evicted);
+    return transactions;
+}
+
+static void
+unpin_transactions(std::vector<struct cache_segment_transaction> &transactions) {
+    WITH_LOCK(file_cache_lock) {
+        for (auto &transaction : transactions) {
+            transaction.segment->pins--;
+        }
+    }
+}
+
+//
+// Makes sure the data of the transaction segment is in memory
+static int
+load_segment(struct cache_segment_transaction &transaction, struct device *device) {
+    int error = 0;
+#if defined(ROFS_DIAGNOSTICS_ENABLED)
+    rofs_cache_reads += 1;
+#endif
+    stat_reads++;
+    if (transaction.transaction_type == CacheTransactionType::READ_FROM_MEMORY) {
+        stat_hits++;
+        return 0;
+    }
+    //
+    // Read from disk into segment missing in cache or empty segment that was in cache but had not data because
+    // of failure to read. Wait for the segment if it is being read ahead, and fall back
+    // to reading it ourselves should that have failed
+    if (transaction.segment->is_loading()) {
+        error = transaction.segment->wait_for_disk();
+    }
+    if (!transaction.segment->is_data_ready()) {
+        error = transaction.segment->read_from_disk(device);
+        stat_misses++;
+#if defined(ROFS_DIAGNOSTICS_ENABLED)
+        rofs_cache_misses += 1;
+#endif
+    } else {
+        stat_hits++;
+    }
+    return error;
+}
+
 //
 // This function calls plan_cache_transactions first to identify what part of uio can be
 // read from memory and what needs to be read from disk
 // NOTE: This function is NOT thread-safe and does not need to be because it is called only
 // by rofs_read_with_cache() which in turn is called by vfs_file::read() in a critical section
 // specific to given file. So effectively cache_read() is assumed to be called by one thread
-// at a time and no thread synchronization is needed.
+// at a time per file. Only the segment maps and LRU list, which eviction changes
+// from other threads, are protected by file_cache_lock.
 int
-cache_read(struct rofs_inode *inode, struct device *device, struct rofs_super_block *sb, struct uio *uio) {
+cache_read(struct rofs_inode *inode, struct device *device, struct rofs_info *rofs, struct uio *uio) {
     //
     // Find existing one or create new file cache
-    struct file_cache *cache = get_or_create_file_cache(inode, sb);
+    struct file_cache *cache = get_or_create_file_cache(inode, rofs);
 
     //
     // Prepare list of cache transactions (copy from memory
     // or read from disk into cache memory and then copy into memory)
-    auto segment_transactions = plan_cache_transactions(cache, uio);
+    auto segment_transactions = pin_transactions(cache, uio);
     print("[rofs] [%d] rofs_cache_read called for i-node [%d] at %d with %d ops\n",
           sched::thread::current()->id(), inode->inode_no, uio->uio_offset, segment_transactions.size());
 
@@ -236,39 +572,126 @@ cache_read(struct rofs_inode *inode, struct device *device, struct rofs_super_bl
 
     // Iterate over the list of cache operation and either copy from memory
     // or read from disk into cache memory and then copy into memory
-    auto it = segment_transactions.begin();
-    for (; it != segment_transactions.end(); ++it) {
-        auto transaction = *it;
-#if defined(ROFS_DIAGNOSTICS_ENABLED)
-        rofs_cache_reads += 1;
-#endif
-        if (transaction.transaction_type == CacheTransactionType::READ_FROM_MEMORY) {
-            //
-            // Copy data from segment to target buffer
+    for (auto &transaction : segment_transactions) {
+        error = load_segment(transaction, device);
+        //
+        // Copy data from segment to target buffer
+        if (!error) {
             error = transaction.segment->read(uio, transaction.segment_offset, transaction.bytes_to_read);
         }
-        // Read from disk into segment missing in cache or empty segment that was in cache but had not data because
-        // of failure to read
-        else {
-            error = transaction.segment->read_from_disk(device);
-#if defined(ROFS_DIAGNOSTICS_ENABLED)
-            rofs_cache_misses += 1;
-#endif
-            //
-            // Copy data from segment to target buffer
-            if (!error) {
-                error = transaction.segment->read(uio, transaction.segment_offset, transaction.bytes_to_read);
-            }
-        }
-
         if (error) {
             break;
         }
     }
 
+    unpin_transactions(segment_transactions);
+
     print("[rofs] [%d] rofs_cache_read completed for i-node [%d]\n", sched::thread::current()->id(),
           inode->inode_no);
     return error;
 }
 
+//
+// Maps the cached page at uio_offset into the page cache, for mmap() to
+// share the cache memory rather than copy it. Like cache_read() this is
+// called with the vnode lock held. Returns the error if the page could not
+// be loaded, for the fault to fail.
+int
+cache_map(struct rofs_inode *inode, struct device *device, struct rofs_info *rofs,
+          pagecache::hashkey *key, struct uio *uio) {
+    struct file_cache *cache = get_or_create_file_cache(inode, rofs);
+
+    // A page never straddles segments, which are made of whole pages
+    struct uio page_uio = *uio;
+    page_uio.uio_resid = std::min<uint64_t>(mmu::page_size, inode->file_size - uio->uio_offset);
+    auto segment_transactions = pin_transactions(cache, &page_uio);
+    auto &transaction = segment_transactions.front();
+
+    int error = load_segment(transaction, device);
+    if (!error) {
+        pagecache::map_shared_buf(key, transaction.segment,
+                                  transaction.segment->page(transaction.segment_offset));
+        uio->uio_resid = 0;
+    } else {
+        kprintf("[rofs] Error loading i-node %d page at %d for mapping\n", inode->inode_no, uio->uio_offset);
+    }
+
+    unpin_transactions(segment_transactions);
+    return error;
+}
+
+//
+// Starts loading the segments covering [offset, offset + len) which are not
+// in the cache yet, without waiting for them. Like cache_read() this is
+// called with the vnode lock held.
+//
+// Segments being read ahead cannot be evicted, so with a budget set their
+// room is made when they are issued, and reads ahead in flight take up at
+// most half of the budget.
+void
+cache_readahead(struct rofs_inode *inode, struct device *device, struct rofs_info *rofs,
+                uint64_t offset, uint64_t len) {
+    struct file_cache *cache = get_or_create_file_cache(inode, rofs);
+    uint64_t segment_size = CACHE_SEGMENT_SIZE_IN_BLOCKS * rofs->sb->block_size;
+    uint64_t end = std::min(offset + len, inode->file_size);
+    uint64_t max = osv::rofs_cache::max_bytes.load(std::memory_order_relaxed);
+    uint64_t in_flight = read_ahead_bytes.load();
+
+    std::vector<uint64_t> missing;
+    std::vector<file_cache_segment *> evicted;
+    WITH_LOCK(file_cache_lock) {
+        for (auto index = CACHE_SEGMENT_INDEX(offset); index * segment_size < end; index++) {
+            if (max && in_flight + (missing.size() + 1) * segment_size > max / 2) {
+                break;
+            }
+            if (cache->segments_by_index.find(index) == cache->segments_by_index.end()) {
+                missing.push_back(index);
+            }
+        }
+        evicted = evict_over_budget(missing.size() * segment_size);
+    }
+    free_segments(evicted);
+    //
+    // Only we add segments of this file, so they can be set up unlocked
+    std::vector<file_cache_segment *> new_segments;
+    for (auto index : missing) {
+        auto new_cache_segment = new file_cache_segment(cache, index * CACHE_SEGMENT_SIZE_IN_BLOCKS,
+                                                        CACHE_SEGMENT_SIZE_IN_BLOCKS);
+        new_cache_segment->read_from_disk_async(device);
+        new_segments.push_back(new_cache_segment);
+    }
+    stat_read_aheads += new_segments.size();
+
+    WITH_LOCK(file_cache_lock) {
+        for (auto segment : new_segments) {
+            cache->segments_by_index.emplace(segment->index(), segment);
+            touch_segment(segment);
+        }
+        evicted = evict_over_budget();
+    }
+    free_segments(evicted);
+}
+
+}
+
+namespace osv {
+namespace rofs_cache {
+
+std::atomic<size_t> max_bytes(0);
+
+stats get_stats() {
+    stats ret;
+    WITH_LOCK(rofs::file_cache_lock) {
+        ret.bytes = rofs::cached_bytes;
+        ret.segments = rofs::segments_lru.size();
+    }
+    ret.reads = rofs::stat_reads.load();
+    ret.hits = rofs::stat_hits.load();
+    ret.misses = rofs::stat_misses.load();
+    ret.read_aheads = rofs::stat_read_aheads.load();
+    ret.evictions = rofs::stat_evictions.load();
+    return ret;
+}
+
+}
 }
@@ -57,28 +57,54 @@ void rofs_set_vnode(struct vnode *vnode, struct rofs_inode *inode)
     vnode->v_size = size;
 }
 
-int
-rofs_read_blocks(struct device *device, uint64_t starting_block, uint64_t blocks_count, void *buf)
+//
+// Starts reading blocks from disk and returns without waiting for the data.
+// The caller collects the result with rofs_wait_blocks(), unless a done
+// callback is given: that is then called on completion (with arg in
+// bio_caller1) and owns the bio, so the caller may then only check the
+// returned pointer for allocation failure.
+struct bio *
+rofs_read_blocks_async(struct device *device, uint64_t starting_block, uint64_t blocks_count, void *buf,
+                       void (*done)(struct bio *), void *arg)
 {
-    ROFS_STOPWATCH_START
     struct bio *bio = alloc_bio();
     if (!bio)
-        return ENOMEM;
+        return nullptr;
 
     bio->bio_cmd = BIO_READ;
     bio->bio_dev = device;
     bio->bio_data = buf;
     bio->bio_offset = starting_block << 9;
     bio->bio_bcount = blocks_count * BSIZE;
+    bio->bio_done = done;
+    bio->bio_caller1 = arg;
+
+#if defined(ROFS_DIAGNOSTICS_ENABLED)
+    rofs_block_read_count += blocks_count;
+#endif
 
     bio->bio_dev->driver->devops->strategy(bio);
-    int error = bio_wait(bio);
 
+    return bio;
+}
+
+int
+rofs_wait_blocks(struct bio *bio)
+{
+    int error = bio_wait(bio);
     destroy_bio(bio);
+    return error;
+}
 
-#if defined(ROFS_DIAGNOSTICS_ENABLED)
-    rofs_block_read_count += blocks_count;
-#endif
+int
+rofs_read_blocks(struct device *device, uint64_t starting_block, uint64_t blocks_count, void *buf)
+{
+    ROFS_STOPWATCH_START
+    struct bio *bio = rofs_read_blocks_async(device, starting_block, blocks_count, buf);
+    if (!bio)
+        return ENOMEM;
+
+    int error = rofs_wait_blocks(bio);
     ROFS_STOPWATCH_END(rofs_block_read_ms)
 
     return error;
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+//
+// Decompression of the chunks of compressed ROFS images. The codecs are
+// the ones the kernel already carries for ZFS: zlib (zmod) and LZ4.
+//
+
+#include "rofs.hh"
+#include <errno.h>
+#include <string.h>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <osv/sched.hh>
+#include <osv/mutex.h>
+#include <osv/condvar.h>
+#include <osv/printf.hh>
+
+extern "C" {
+int lz4_decompress(void *src, void *dst, size_t s_len, size_t d_len, int n);
+int z_uncompress(void *dst, size_t *dstlen, const void *src, size_t srclen);
+}
+
+namespace rofs {
+
+int
+decompress_chunk(uint64_t compression, void *src, uint64_t src_len, void *dst, uint64_t dst_len) {
+    //
+    // Chunks which do not compress are stored as is
+    if (src_len == dst_len) {
+        memcpy(dst, src, dst_len);
+        return 0;
+    }
+
+    switch (compression) {
+    case ROFS_COMPRESSION_ZLIB: {
+        size_t len = dst_len;
+        if (z_uncompress(dst, &len, src, src_len) != 0 || len != dst_len) {
+            return EIO;
+        }
+        return 0;
+    }
+    case ROFS_COMPRESSION_LZ4:
+        // The chunk holds a 4-byte big-endian length followed by an LZ4
+        // block, as written by ZFS
+        if (lz4_decompress(src, dst, src_len, dst_len, 0) != 0) {
+            return EIO;
+        }
+        return 0;
+    default:
+        return EINVAL;
+    }
+}
+
+//
+// Worker threads decompressing chunks loaded by read-ahead, so that
+// inflating a file happens on all cpus rather than on the single thread
+// completing the disk reads.
+class decompress_pool {
+public:
+    decompress_pool() {
+        for (auto cpu : sched::cpus) {
+            _threads.emplace_back(sched::thread::make([this] { run(); },
+                sched::thread::attr().name(osv::sprintf("rofs-decompress%d", cpu->id))));
+            _threads.back()->start();
+        }
+    }
+
+    void submit(std::function<void ()> work) {
+        WITH_LOCK(_lock) {
+            _work.push_back(std::move(work));
+            _cond.wake_one();
+        }
+    }
+
+private:
+    void run() {
+        for (;;) {
+            std::function<void ()> work;
+            WITH_LOCK(_lock) {
+                while (_work.empty()) {
+                    _cond.wait(_lock);
+                }
+                work = std::move(_work.front());
+                _work.pop_front();
+            }
+            work();
+        }
+    }
+
+    mutex _lock;
+    condvar _cond;
+    std::deque<std::function<void ()>> _work;
+    std::vector<std::unique_ptr<sched::thread>> _threads;
+};
+
+static decompress_pool *pool;
+static mutex pool_lock;
+
+void
+start_decompress_threads() {
+    WITH_LOCK(pool_lock) {
+        if (!pool) {
+            pool = new decompress_pool();
+        }
+    }
+}
+
+void
+decompress_async(std::function<void ()> work) {
+    pool->submit(std::move(work));
+}
+
+}
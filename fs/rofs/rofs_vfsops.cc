@@ -86,7 +86,7 @@ rofs_mount(struct mount *mp, const char *dev, int flags, const void *data)
         return -1; // TODO: Proper error code
     }
 
-    if (sb->version != ROFS_VERSION) {
+    if (sb->version < 1 || sb->version > ROFS_VERSION) {
         kprintf("[rofs] Found rofs volume but incompatible version!\n");
         kprintf("[rofs] Expecting %llu but found %llu\n", ROFS_VERSION, sb->version);
         free(buf);
@@ -102,6 +102,17 @@ rofs_mount(struct mount *mp, const char *dev, int flags, const void *data)
     print("[rofs] Got directory entries count:     %d\n", sb->directory_entries_count);
     print("[rofs] Got symlinks count:              %d\n", sb->symlinks_count);
     print("[rofs] Got inode count:                 %d\n", sb->inodes_count);
+    print("[rofs] Got compression:                 %d\n", sb->compression);
+    print("[rofs] Got flags:                       0x%llx\n", sb->flags);
+
+    if (sb->compression != ROFS_COMPRESSION_NONE &&
+        ((sb->compression != ROFS_COMPRESSION_ZLIB && sb->compression != ROFS_COMPRESSION_LZ4) ||
+         sb->chunk_size != ROFS_CHUNK_SIZE)) {
+        kprintf("[rofs] Unsupported compression %llu with chunk size %llu\n", sb->compression, sb->chunk_size);
+        free(buf);
+        device_close(device);
+        return -1;
+    }
     //
     // Since we have found ROFS, we can copy the superblock now
     sb = new rofs_super_block;
@@ -157,10 +168,19 @@ rofs_mount(struct mount *mp, const char *dev, int flags, const void *data)
     // Read i-nodes
     rofs->inodes = (struct rofs_inode *) malloc(sizeof(struct rofs_inode) * sb->inodes_count);
     memcpy(rofs->inodes, data_ptr, sb->inodes_count * sizeof(struct rofs_inode));
+    data_ptr += sb->inodes_count * sizeof(struct rofs_inode);
 
     for (unsigned int idx = 0; idx < sb->inodes_count; idx++) {
         print("[rofs] inode: %d, size: %d\n", rofs->inodes[idx].inode_no, rofs->inodes[idx].file_size);
     }
+    //
+    // Read the chunk table of compressed images
+    rofs->chunk_offsets = nullptr;
+    if (sb->compression != ROFS_COMPRESSION_NONE) {
+        rofs->chunk_offsets = (uint64_t *) malloc(sizeof(uint64_t) * sb->chunks_count);
+        memcpy(rofs->chunk_offsets, data_ptr, sb->chunks_count * sizeof(uint64_t));
+        rofs::start_decompress_threads();
+    }
 
     free(buf);
 
@@ -208,6 +228,7 @@ rofs_unmount(struct mount *mp, int flags)
     struct device *dev = mp->m_dev;
 
     int error = device_close(dev);
+    free(rofs->chunk_offsets);
     delete sb;
     delete rofs;
 
@@ -113,6 +113,12 @@ static int rofs_read_without_cache(struct vnode *vnode, struct file *fp, struct
 
     VERIFY_READ_INPUT_ARGUMENTS()
 
+    // Compressed data can only be read a whole chunk at a time, which is
+    // what the cache does
+    if (rofs->chunk_offsets) {
+        return rofs::cache_read(inode, device, rofs, uio);
+    }
+
     int rv = 0;
     int error = -1;
     uint64_t block = inode->data_offset;
@@ -153,13 +159,43 @@ static int rofs_read_without_cache(struct vnode *vnode, struct file *fp, struct
 // by subsequent or contiguous reads. For details look at rofs_cache.cc.
 static int rofs_read_with_cache(struct vnode *vnode, struct file* fp, struct uio *uio, int ioflag) {
     struct rofs_info *rofs = (struct rofs_info *) vnode->v_mount->m_data;
-    struct rofs_super_block *sb = rofs->sb;
     struct rofs_inode *inode = (struct rofs_inode *) vnode->v_data;
     struct device *device = vnode->v_mount->m_dev;
 
     VERIFY_READ_INPUT_ARGUMENTS()
 
-    return rofs::cache_read(inode,device,sb,uio);
+    return rofs::cache_read(inode,device,rofs,uio);
+}
+//
+// Loads data past the reader into the cache asynchronously, as requested by
+// the read-ahead engine or posix_fadvise(POSIX_FADV_WILLNEED)
+static int rofs_readahead(struct vnode *vnode, off_t offset, size_t len) {
+    struct rofs_info *rofs = (struct rofs_info *) vnode->v_mount->m_data;
+    struct rofs_inode *inode = (struct rofs_inode *) vnode->v_data;
+    struct device *device = vnode->v_mount->m_dev;
+
+    if (vnode->v_type != VREG || offset < 0 || (uint64_t)offset >= inode->file_size) {
+        return 0;
+    }
+
+    rofs::cache_readahead(inode, device, rofs, offset, len);
+    return 0;
+}
+//
+// Maps the cached page at uio_offset into the page cache so that mmap()
+// shares it with the cache instead of getting a private copy. The page
+// cache key to map it under comes in the iovec.
+static int rofs_arc(struct vnode *vnode, struct file* fp, struct uio *uio) {
+    struct rofs_info *rofs = (struct rofs_info *) vnode->v_mount->m_data;
+    struct rofs_inode *inode = (struct rofs_inode *) vnode->v_data;
+    struct device *device = vnode->v_mount->m_dev;
+
+    if (vnode->v_type != VREG || uio->uio_offset < 0 || (uint64_t)uio->uio_offset >= inode->file_size) {
+        return 0;
+    }
+
+    auto key = (pagecache::hashkey *) uio->uio_iov->iov_base;
+    return rofs::cache_map(inode, device, rofs, key, uio);
 }
 //
 // This functions reads directory information (dentries) based on information in memory
@@ -208,6 +244,37 @@ static int rofs_readdir(struct vnode *vnode, struct file *fp, struct dirent *dir
     return 0;
 }
 
+//
+// Finds the entry called name among the children of a directory, by binary
+// search if the image has them sorted
+static struct rofs_dir_entry *rofs_find_dir_entry(struct rofs_info *rofs, struct rofs_inode *inode, const char *name)
+{
+    struct rofs_dir_entry *entries = rofs->dir_entries + inode->data_offset;
+
+    if (rofs->sb->flags & ROFS_FLAG_SORTED_DIRS) {
+        uint64_t low = 0, high = inode->dir_children_count;
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            int cmp = strcmp(name, entries[mid].filename);
+            if (cmp == 0) {
+                return &entries[mid];
+            } else if (cmp < 0) {
+                high = mid;
+            } else {
+                low = mid + 1;
+            }
+        }
+        return nullptr;
+    }
+
+    for (unsigned int idx = 0; idx < inode->dir_children_count; idx++) {
+        if (strcmp(name, entries[idx].filename) == 0) {
+            return &entries[idx];
+        }
+    }
+    return nullptr;
+}
+
 //
 // This functions looks up directory entry based on the directory information stored in memory
 // under rofs->dir_entries table
@@ -226,30 +293,28 @@ static int rofs_lookup(struct vnode *vnode, char *name, struct vnode **vpp)
         return ENOTDIR;
     }
 
-    for (unsigned int idx = 0; idx < inode->dir_children_count; idx++) {
-        if (strcmp(name, rofs->dir_entries[inode->data_offset + idx].filename) == 0) {
-            int inode_no = rofs->dir_entries[inode->data_offset + idx].inode_no;
-
-            if (vget(vnode->v_mount, inode_no, &vp)) { //TODO: Will it ever work? Revisit
-                print("[rofs] found vp in cache!\n");
-                *vpp = vp;
-                return 0;
-            }
-
-            struct rofs_inode *found_inode = rofs->inodes + (inode_no - 1); //Check if exists
-            rofs_set_vnode(vp, found_inode);
+    struct rofs_dir_entry *dir_entry = rofs_find_dir_entry(rofs, inode, name);
+    if (!dir_entry) {
+        print("[rofs] FAILED to find up %s\n", name);
+        return ENOENT;
+    }
 
-            print("[rofs] found the directory entry [%s] at at inode %d -> %d!\n", name, inode->inode_no,
-                  found_inode->inode_no);
+    int inode_no = dir_entry->inode_no;
 
-            *vpp = vp;
-            return 0;
-        }
+    if (vget(vnode->v_mount, inode_no, &vp)) { //TODO: Will it ever work? Revisit
+        print("[rofs] found vp in cache!\n");
+        *vpp = vp;
+        return 0;
     }
 
-    print("[rofs] FAILED to find up %s\n", name);
+    struct rofs_inode *found_inode = rofs->inodes + (inode_no - 1); //Check if exists
+    rofs_set_vnode(vp, found_inode);
 
-    return ENOENT;
+    print("[rofs] found the directory entry [%s] at at inode %d -> %d!\n", name, inode->inode_no,
+          found_inode->inode_no);
+
+    *vpp = vp;
+    return 0;
 }
 
 static int rofs_getattr(struct vnode *vnode, struct vattr *attr)
@@ -284,7 +349,6 @@ static int rofs_getattr(struct vnode *vnode, struct vattr *attr)
 #define rofs_inactive    ((vnop_inactive_t)vop_nullop)
 #define rofs_truncate    ((vnop_truncate_t)vop_erofs)
 #define rofs_link        ((vnop_link_t)vop_erofs)
-#define rofs_arc         ((vnop_cache_t) nullptr)
 #define rofs_fallocate   ((vnop_fallocate_t)vop_erofs)
 #define rofs_fsync       ((vnop_fsync_t)vop_nullop)
 #define rofs_symlink     ((vnop_symlink_t)vop_erofs)
@@ -309,12 +373,15 @@ struct vnops rofs_vnops = {
     rofs_inactive,           /* inactive */
     rofs_truncate,           /* truncate - returns error when called*/
     rofs_link,               /* link - returns error when called*/
-    rofs_arc,                /* arc */ //TODO: Implement to allow memory re-use when mapping files
+    rofs_arc,                /* arc */
     rofs_fallocate,          /* fallocate - returns error when called*/
     rofs_readlink,           /* read link */
-    rofs_symlink             /* symbolic link - returns error when called*/
+    rofs_symlink,            /* symbolic link - returns error when called*/
+    rofs_readahead           /* read-ahead */
 };
 
 extern "C" void rofs_disable_cache() {
     rofs_vnops.vop_read = rofs_read_without_cache;
+    rofs_vnops.vop_readahead = nullptr;
+    rofs_vnops.vop_cache = nullptr;
 }
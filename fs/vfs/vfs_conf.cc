@@ -51,6 +51,7 @@ extern struct vfsops devfs_vfsops;
 extern struct vfsops nfs_vfsops;
 extern struct vfsops procfs_vfsops;
 extern struct vfsops zfs_vfsops;
+extern struct vfsops virtiofs_vfsops;
 
 /* add virtfs vfsops */
 extern struct vfsops virtfs_vfsops;
@@ -61,6 +62,7 @@ extern int devfs_init(void);
 extern int nfs_init(void);
 extern int procfs_init(void);
 extern "C" int zfs_init(void);
+extern int virtiofs_init(void);
 
 /* add virtfs init */
 extern int virtfs_init(void);
@@ -75,6 +77,7 @@ const struct vfssw vfssw[] = {
 	{"procfs",	procfs_init,	&procfs_vfsops},
 	{"zfs",		zfs_init,	&zfs_vfsops},
 	{"rofs", 	rofs_init, 	&rofs_vfsops},
+	{"virtiofs",	virtiofs_init,	&virtiofs_vfsops},
 	{"myfs",	virtfs_init,	&virtfs_vfsops},
 	{nullptr,	fs_noop,	nullptr},
 };
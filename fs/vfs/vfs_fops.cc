@@ -44,18 +44,32 @@ int vfs_file::read(struct uio *uio, int flags)
 	int error;
 	size_t count;
 	ssize_t bytes;
+	off_t offset;
 
 	bytes = uio->uio_resid;
 
 	vn_lock(vp);
 	if ((flags & FOF_OFFSET) == 0)
 		uio->uio_offset = fp->f_offset;
+	offset = uio->uio_offset;
 
-	error = VOP_READ(vp, fp, uio, 0);
+	if (pagecache::enabled(vp))
+		error = pagecache::read(vp, fp, uio, 0);
+	else
+		error = VOP_READ(vp, fp, uio, 0);
 	if (!error) {
 		count = bytes - uio->uio_resid;
 		if ((flags & FOF_OFFSET) == 0)
 			fp->f_offset += count;
+		if (pagecache::enabled(vp)) {
+			auto ra = _readahead.on_read(offset, count);
+			if (ra.len)
+				pagecache::readahead(vp, fp, ra.start, ra.len);
+		} else if (vp->v_op->vop_readahead) {
+			auto ra = _readahead.on_read(offset, count);
+			if (ra.len)
+				VOP_READAHEAD(vp, ra.start, ra.len);
+		}
 	}
 	vn_unlock(vp);
 
@@ -84,7 +98,10 @@ int vfs_file::write(struct uio *uio, int flags)
 	if ((flags & FOF_OFFSET) == 0)
 	        uio->uio_offset = fp->f_offset;
 
-	error = VOP_WRITE(vp, uio, ioflags);
+	if (pagecache::enabled(vp))
+		error = pagecache::write(vp, uio, ioflags);
+	else
+		error = VOP_WRITE(vp, uio, ioflags);
 	if (!error) {
 		count = bytes - uio->uio_resid;
 		if ((flags & FOF_OFFSET) == 0)
@@ -153,6 +170,42 @@ void vfs_file::sync(off_t start, off_t end)
     pagecache::sync(this, start, end);
 }
 
+int vfs_file::fadvise(off_t offset, off_t len, int advice)
+{
+	struct vnode *vp = f_dentry->d_vnode;
+
+	switch (advice) {
+	case POSIX_FADV_NORMAL:
+	case POSIX_FADV_SEQUENTIAL:
+	case POSIX_FADV_RANDOM:
+		vn_lock(vp);
+		_readahead.advise(advice);
+		vn_unlock(vp);
+		break;
+	case POSIX_FADV_WILLNEED: {
+		// Read ahead at most as much as a sequential reader would
+		off_t max = osv::readahead::max_bytes.load(std::memory_order_relaxed);
+		bool cached = pagecache::enabled(vp);
+		if (!max || (!cached && !vp->v_op->vop_readahead))
+			break;
+		vn_lock(vp);
+		if (len == 0 || len > vp->v_size - offset)
+			len = vp->v_size - offset;
+		if (len > max)
+			len = max;
+		if (len > 0) {
+			if (cached)
+				pagecache::readahead(vp, this, offset, len);
+			else
+				VOP_READAHEAD(vp, offset, len);
+		}
+		vn_unlock(vp);
+		break;
+	}
+	}
+	return 0;
+}
+
 // Locking: VOP_CACHE will call into the filesystem, and that can trigger an
 // eviction that will hold the mmu-side lock that protects the mappings
 // Always follow that order. We however can't just get rid of the mmu-side lock,
@@ -172,8 +225,11 @@ int vfs_file::get_arcbuf(void* key, off_t offset)
     data.uio_rw = UIO_READ;
 
     vn_lock(vp);
-    assert(VOP_CACHE(vp, this, &data) == 0);
+    int error = VOP_CACHE(vp, this, &data);
     vn_unlock(vp);
+    if (error) {
+        return error;
+    }
 
     return (data.uio_resid != 0) ? -1 : 0;
 }
@@ -182,6 +238,9 @@ std::unique_ptr<mmu::file_vma> vfs_file::mmap(addr_range range, unsigned flags,
 {
 	auto fp = this;
 	struct vnode *vp = fp->f_dentry->d_vnode;
+	if (pagecache::enabled(vp)) {
+		return mmu::map_file_mmap(this, range, flags, perm, offset);
+	}
 	if (!vp->v_op->vop_cache || (vp->v_size < (off_t)mmu::page_size)) {
 		return mmu::default_file_mmap(this, range, flags, perm, offset);
 	}
@@ -48,6 +48,7 @@
 #include <osv/device.h>
 #include <osv/debug.h>
 #include <osv/mutex.h>
+#include <osv/pagecache.hh>
 #include "vfs.h"
 
 #include <memory>
@@ -267,6 +268,9 @@ found:
         goto out;
     }
 
+    // Write back and drop the cached pages of the filesystem's files
+    pagecache::unmount(mp);
+
     if ((error = VFS_UNMOUNT(mp, flags)) != 0)
         goto out;
     mount_list.remove(mp);
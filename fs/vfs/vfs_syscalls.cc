@@ -53,6 +53,7 @@
 #include <osv/prex.h>
 #include <osv/vnode.h>
 #include <osv/vfs_file.hh>
+#include <osv/pagecache.hh>
 #include "vfs.h"
 #include <fs/fs.hh>
 
@@ -188,6 +189,8 @@ sys_open(char *path, int flags, mode_t mode, struct file **fpp)
 	}
 
 	vn_lock(vp);
+	if (pagecache::enabled(vp))
+		pagecache::open(vp);
 	/* Process truncate request */
 	if (flags & O_TRUNC) {
 		error = EINVAL;
@@ -197,6 +200,8 @@ sys_open(char *path, int flags, mode_t mode, struct file **fpp)
 		error = VOP_TRUNCATE(vp, 0);
 		if (error)
 			goto out_vn_unlock;
+		if (pagecache::enabled(vp))
+			pagecache::truncate(vp, 0);
 	}
 
 	try {
@@ -369,7 +374,7 @@ int
 sys_fsync(struct file *fp)
 {
 	struct vnode *vp;
-	int error;
+	int error, wberror;
 
 	DPRINTF(VFSDB_SYSCALL, ("sys_fsync: fp=%x\n", fp));
 
@@ -379,6 +384,9 @@ sys_fsync(struct file *fp)
 	vp = fp->f_dentry->d_vnode;
 	vn_lock(vp);
 	error = VOP_FSYNC(vp, fp);
+	wberror = pagecache::take_writeback_error(vp);
+	if (!error)
+		error = wberror;
 	vn_unlock(vp);
 	return error;
 }
@@ -1121,6 +1129,8 @@ sys_truncate(char *path, off_t length)
 
 	vn_lock(dp->d_vnode);
 	error = VOP_TRUNCATE(dp->d_vnode, length);
+	if (!error && pagecache::enabled(dp->d_vnode))
+		pagecache::truncate(dp->d_vnode, length);
 	vn_unlock(dp->d_vnode);
 
 	drele(dp);
@@ -1139,6 +1149,8 @@ sys_ftruncate(struct file *fp, off_t length)
 	vp = fp->f_dentry->d_vnode;
 	vn_lock(vp);
 	error = VOP_TRUNCATE(vp, length);
+	if (!error && pagecache::enabled(vp))
+		pagecache::truncate(vp, length);
 	vn_unlock(vp);
 
 	return error;
@@ -1417,9 +1429,11 @@ sys_fallocate(struct file *fp, int mode, loff_t offset, loff_t len)
         return EINVAL;
     }
 
-    // Strange, but that's what Linux returns.
+    // Punching a hole never changes the file size, so it must be asked
+    // for with FALLOC_FL_KEEP_SIZE. Strange, but Linux returns EOPNOTSUPP
+    // rather than EINVAL otherwise. File systems rely on this check.
     if ((mode & FALLOC_FL_PUNCH_HOLE) && !(mode & FALLOC_FL_KEEP_SIZE)) {
-        return ENOTSUP;
+        return EOPNOTSUPP;
     }
 
     vp = fp->f_dentry->d_vnode;
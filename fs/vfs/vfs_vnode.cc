@@ -145,6 +145,22 @@ vn_lock(struct vnode *vp)
 	DPRINTF(VFSDB_VNODE, ("vn_lock:   %s\n", vn_path(vp)));
 }
 
+/*
+ * Lock vnode unless another thread holds it
+ */
+int
+vn_trylock(struct vnode *vp)
+{
+	ASSERT(vp);
+	ASSERT(vp->v_refcnt > 0);
+
+	if (!mutex_trylock(&vp->v_lock))
+		return 0;
+	vp->v_nrlocks++;
+	DPRINTF(VFSDB_VNODE, ("vn_trylock: %s\n", vn_path(vp)));
+	return 1;
+}
+
 /*
  * Unlock vnode
  */
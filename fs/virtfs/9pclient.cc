@@ -9,6 +9,8 @@
 #include <api/stdarg.h>
 #include <osv/uio.h>
 #include <osv/debug.h>
+#include <osv/mmu.hh>
+#include <osv/wait_record.hh>
 #include <unordered_map>
 #include <drivers/virtio-9p.hh>
 
@@ -185,6 +187,82 @@ static size_t p9pdu_write_u(struct p9_fcall *pdu, struct uio *from, size_t size)
 	return size - len;
 }
 
+/* zero copy helpers */
+
+/* Most iovecs a zero copy request hands to the transport */
+#define P9_ZC_MAXSEGS	64
+
+/**
+ * p9_zc_span - bytes of a uio which can be transferred without copy
+ * @uio: user data
+ * @len: bytes wanted
+ *
+ * The transport places data straight in the iovecs of @uio. That is
+ * only possible for memory in the linear map, whose physical address
+ * is known without faulting it in, and for a bounded number of
+ * iovecs. Returns 0 when the first iovec does not qualify.
+ */
+static size_t p9_zc_span(struct uio *uio, size_t len)
+{
+	size_t span = 0;
+	int segs = 0;
+
+	for (int i = 0; i < uio->uio_iovcnt && span < len; i++) {
+		struct iovec *iov = &uio->uio_iov[i];
+		size_t n = std::min(len - span, iov->iov_len);
+		if (!n)
+			continue;
+		if (!mmu::is_linear_mapped(iov->iov_base, n) || ++segs > P9_ZC_MAXSEGS)
+			break;
+		span += n;
+	}
+	return span;
+}
+
+/**
+ * p9_uio_advance - consume bytes transferred without copy
+ * @uio: user data
+ * @n: number of bytes
+ *
+ * Same as uiomove(), without moving any data.
+ */
+static void p9_uio_advance(struct uio *uio, size_t n)
+{
+	while (n > 0 && uio->uio_resid) {
+		struct iovec *iov = uio->uio_iov;
+		size_t cnt = iov->iov_len;
+		if (cnt == 0) {
+			uio->uio_iov++;
+			uio->uio_iovcnt--;
+			continue;
+		}
+		if (cnt > n)
+			cnt = n;
+
+		iov->iov_base = (char *)iov->iov_base + cnt;
+		iov->iov_len -= cnt;
+		uio->uio_resid -= cnt;
+		uio->uio_offset += cnt;
+		n -= cnt;
+	}
+}
+
+/**
+ * p9_uio_peek - copy bytes out of a uio without consuming them
+ */
+static void p9_uio_peek(struct uio *uio, void *data, size_t len)
+{
+	char *p = (char *) data;
+
+	for (int i = 0; i < uio->uio_iovcnt && len; i++) {
+		struct iovec *iov = &uio->uio_iov[i];
+		size_t n = std::min(len, iov->iov_len);
+		memcpy(p, iov->iov_base, n);
+		p += n;
+		len -= n;
+	}
+}
+
 /*
 	b - int8_t
 	w - int16_t
@@ -953,22 +1031,38 @@ p9_virtio_request(struct p9_client *client, struct p9_req_t *req)
 	return vt->make_request(req);
 }
 
+inline static int
+p9_virtio_zc_request(struct p9_client *client, struct p9_req_t *req,
+	struct uio *uidata, struct uio *uodata, int inlen, int outlen,
+	int in_hdrlen)
+{
+	virtio::vt9p *vt = (virtio::vt9p *) client->p9_trans();
+
+	return vt->make_request(req, uidata, uodata, inlen, outlen, in_hdrlen);
+}
+
 static int p9_virtio_cancel(struct p9_client *client, struct p9_req_t *req)
 {
 	return 1;
 }
 
 
-#define VIRTQUEUE_NUM   128
+/*
+ * Zero copy data is described page by page in the worst case: keep
+ * the descriptor chains of the largest messages well within the 1024
+ * descriptors hosts accept in an indirect table.
+ */
+#define VIRTIO_MAX_DATA_PAGES	512
 
 struct p9_trans_module p9_virtio_trans = []{
-	struct p9_trans_module mod;
+	struct p9_trans_module mod = {};
 	mod.name = (char *) "virtio";
 	mod.create = p9_virtio_create;
 	mod.close = p9_virtio_close;
 	mod.request = p9_virtio_request;
+	mod.zc_request = p9_virtio_zc_request;
 	mod.cancel = p9_virtio_cancel;
-	mod.maxsize = PAGE_SIZE * (VIRTQUEUE_NUM - 3);
+	mod.maxsize = PAGE_SIZE * VIRTIO_MAX_DATA_PAGES + P9_IOHDRSZ;
 	mod.def = 1;
 	return mod;
 }();
@@ -983,12 +1077,12 @@ p9_client::p9_client(const char *dev_name, char *options)
 
 	memcpy(_name, dev_name, strlen(dev_name) + 1);
 
-	// Reserver tag 0
-	if (_tagpool.p9_idpool_get() < 0)
+	// All tags are free, the lowest ones are handed out first
+	memset(_reqs, 0, sizeof(_reqs));
+	for (_nr_free_tags = 0; _nr_free_tags < P9_MAXTAG; _nr_free_tags++)
 	{
-		throw std::runtime_error("invalid tagpool");
+		_free_tags[_nr_free_tags] = P9_MAXTAG - 1 - _nr_free_tags;
 	}
-	_max_tag = 0;
 
 	// Parse options
 	if (p9_parse_options(options) < 0)
@@ -1004,7 +1098,7 @@ p9_client::p9_client(const char *dev_name, char *options)
 		throw std::runtime_error("failed to create tranport channel");
 	}
 
-	_msize = _trans_mod->maxsize;
+	_msize = std::min<unsigned>(_msize, _trans_mod->maxsize);
 
 	// Get version
 	if (p9_client_version())
@@ -1022,7 +1116,7 @@ p9_client::~p9_client()
 		_trans_mod->close(this);
 	}
 
-	int row, col;
+	int i;
 
 	// Free all fid in _fidlist
 	for (auto fid : _fidlist)
@@ -1033,29 +1127,19 @@ p9_client::~p9_client()
 
 
 	// Check to insure all requests are idle
-	for (row = 0; row < (_max_tag/P9_ROW_MAXTAG); row++) {
-		for (col = 0; col < P9_ROW_MAXTAG; col++) {
-			if (_reqs[row][col].status != REQ_STATUS_IDLE) {
-				debugf("Attempting to cleanup non-free tag %d,%d\n",
-					 row, col);
-				/* TODO: delay execution of cleanup */
-				return;
-			}
+	for (i = 0; i <= P9_MAXTAG; i++) {
+		if (_reqs[i].status != REQ_STATUS_IDLE) {
+			debugf("Attempting to cleanup non-free tag %d\n", i - 1);
+			/* TODO: delay execution of cleanup */
+			return;
 		}
 	}
-	 // Free reserved tag 0
-	_tagpool.p9_idpool_put(0);
 
 	// Free requests associated with tags
-	for (row = 0; row < (_max_tag/P9_ROW_MAXTAG); row++) {
-		for (col = 0; col < P9_ROW_MAXTAG; col++) {
-			// free(c->reqs[row][col].wq);
-			free(_reqs[row][col].tc);
-			free(_reqs[row][col].rc);
-		}
-		free(_reqs[row]);
+	for (i = 0; i <= P9_MAXTAG; i++) {
+		free(_reqs[i].tc);
+		free(_reqs[i].rc);
 	}
-	_max_tag = 0;
 }
 
 /* PUBLIC FUNCTIONS */
@@ -1087,7 +1171,7 @@ int p9_client::p9_is_proto_dotl()
 
 int p9_client::p9_client_show_options(seq *s)
 {
-	if (_msize != 8192)
+	if (_msize != P9_DEF_MSIZE)
 	{
 		s->seq_printf(",msize=%u", _msize);
 	}
@@ -1187,6 +1271,7 @@ void p9_client::p9_client_cb(struct p9_req_t *req, int status)
 	req->status = status;
 
 	debugf("wakeup: %d\n", req->tc->tag);
+	req->wq->wake();
 }
 
 int p9_client::p9_client_clunk(struct p9_fid *fid)
@@ -1381,10 +1466,74 @@ free_and_error:
 	return err;
 }
 
-int p9_client::p9_client_read(struct p9_fid *fid, struct uio *to, size_t len, int *err)
+/**
+ * p9_client_read_once - read data of a file or directory
+ * @fid: fid to read from
+ * @type: P9_TREAD or P9_TREADDIR
+ * @to: destination, advanced past the data read
+ * @offset: offset to read at
+ * @rsize: bytes to read, at most the data a message holds
+ *
+ * Data goes straight into the iovecs of @to when they allow for it,
+ * and through a bounce buffer otherwise. Returns the bytes read.
+ */
+int p9_client::p9_client_read_once(struct p9_fid *fid, int8_t type,
+	struct uio *to, u64 offset, int rsize, int *err)
 {
 	struct p9_client *clnt = fid->clnt;
 	struct p9_req_t *req;
+	struct iovec iov;
+	struct uio bounce;
+	struct uio *dest = to;
+	char *buf = nullptr;
+	int count;
+
+	size_t span = p9_zc_span(to, rsize);
+	if (span) {
+		rsize = span;
+	} else {
+		rsize = std::min(rsize, P9_BOUNCE_SZ);
+		buf = (char *) malloc(rsize);
+		if (!buf) {
+			*err = -ENOMEM;
+			return 0;
+		}
+		iov = {buf, (size_t) rsize};
+		bounce = {&iov, 1, 0, rsize, UIO_READ};
+		dest = &bounce;
+	}
+
+	req = clnt->p9_client_zc_rpc(type, dest, NULL, rsize, 0,
+				P9_ZC_RHDR_SZ, "dqd", fid->fid, offset, rsize);
+	if (!req) {
+		*err = -1;
+		free(buf);
+		return 0;
+	}
+
+	*err = p9pdu_readf(req->rc, clnt->_proto_version, "d", &count);
+	clnt->p9_free_req(req);
+	if (*err) {
+		free(buf);
+		return 0;
+	}
+	if (rsize < count) {
+		debugf("bogus RREAD count (%d > %d)\n", count, rsize);
+		count = rsize;
+	}
+
+	if (buf) {
+		uiomove(buf, count, to);
+		free(buf);
+	} else {
+		p9_uio_advance(to, count);
+	}
+	return count;
+}
+
+int p9_client::p9_client_read(struct p9_fid *fid, struct uio *to, size_t len, int *err)
+{
+	struct p9_client *clnt = fid->clnt;
 	int total = 0;
 	u64 offset = to->uio_offset;
 	*err = 0;
@@ -1395,7 +1544,6 @@ int p9_client::p9_client_read(struct p9_fid *fid, struct uio *to, size_t len, in
 	while (len) {
 		int count = len;
 		int rsize;
-		char *dataptr;
 			
 		rsize = fid->iounit;
 		if (!rsize || (unsigned) rsize > clnt->_msize - P9_IOHDRSZ)
@@ -1404,40 +1552,17 @@ int p9_client::p9_client_read(struct p9_fid *fid, struct uio *to, size_t len, in
 		if (count < rsize)
 			rsize = count;
 
-		req = clnt->p9_client_rpc(P9_TREAD, "dqd", fid->fid, offset,
-					    rsize);
-		if (!req) {
-			*err = -1;
-			break;
-		}
-
-		*err = p9pdu_readf(req->rc, clnt->_proto_version,
-				   "D", &count, &dataptr);
-		if (*err) {
-			clnt->p9_free_req(req);
+		count = p9_client_read_once(fid, P9_TREAD, to, offset, rsize, err);
+		if (*err)
 			break;
-		}
-		if (rsize < count) {
-			debugf("bogus RREAD count (%d > %d)\n", count, rsize);
-			count = rsize;
-		}
 
 		debugf("<<< RREAD count %d\n", count);
-		if (!count) {
-			clnt->p9_free_req(req);
+		if (!count)
 			break;
-		}
 
-		int n = uiomove(dataptr, count, to);
-		len -= n;
-		total += n;
-		offset += n;
-		if (n != count) {
-			*err = -EFAULT;
-			clnt->p9_free_req(req);
-			break;
-		}
-		clnt->p9_free_req(req);
+		len -= count;
+		total += count;
+		offset += count;
 	}
 	return total;
 }
@@ -1463,8 +1588,33 @@ int p9_client::p9_client_write(struct p9_fid *fid, struct uio *from, size_t len,
 		if (count < rsize)
 			rsize = count;
 
-		req = clnt->p9_client_rpc(P9_TWRITE, "dqU", fid->fid,
-						    offset, rsize, from);
+		// Data goes straight from the iovecs of from when they allow
+		// for it, and through a bounce buffer otherwise
+		struct iovec iov;
+		struct uio bounce;
+		struct uio *src = from;
+		char *buf = nullptr;
+		size_t span = p9_zc_span(from, rsize);
+		if (span) {
+			rsize = span;
+		} else {
+			rsize = std::min(rsize, P9_BOUNCE_SZ);
+			buf = (char *) malloc(rsize);
+			if (!buf) {
+				*err = -ENOMEM;
+				break;
+			}
+			uiomove(buf, rsize, from);
+			iov = {buf, (size_t) rsize};
+			bounce = {&iov, 1, 0, rsize, UIO_WRITE};
+			src = &bounce;
+		}
+
+		req = clnt->p9_client_zc_rpc(P9_TWRITE, NULL, src, 0, rsize,
+						P9_ZC_HDR_SZ, "dqd", fid->fid,
+						offset, rsize);
+		bool bounced = buf;
+		free(buf);
 		if (!req) {
 			*err = -1;
 			break;
@@ -1483,9 +1633,13 @@ int p9_client::p9_client_write(struct p9_fid *fid, struct uio *from, size_t len,
 		debugf("<<< RWRITE count %d\n", count);
 
 		clnt->p9_free_req(req);
+		if (!bounced)
+			p9_uio_advance(from, count);
 		len -= count;
 		total += count;
 		offset += count;
+		if (!count)
+			break;
 	}
 	return total;
 }
@@ -1518,8 +1672,8 @@ int p9_client::p9_client_readdir_dotl(struct p9_fid *fid, char *data, u32 count,
 {
 	int err, rsize;
 	struct p9_client *clnt;
-	struct p9_req_t *req;
-	char *dataptr;
+	struct iovec iov;
+	struct uio uio;
 
 	debugf(">>> TREADDIR fid %d offset %llu count %d\n",
 				fid->fid, (unsigned long long) offset, count);
@@ -1534,31 +1688,15 @@ int p9_client::p9_client_readdir_dotl(struct p9_fid *fid, char *data, u32 count,
 	if (count < (unsigned) rsize)
 		rsize = count;
 
-	req = clnt->p9_client_rpc(P9_TREADDIR, "dqd", fid->fid,
-				    offset, rsize);
-	if (!req) {
-		return -1;
-	}
-
-	err = p9pdu_readf(req->rc, clnt->_proto_version, "D", &count, &dataptr);
-	if (err) {
-		goto free_and_error;
-	}
-	if ((unsigned) rsize < count) {
-		debugf("bogus RREADDIR count (%d > %d)\n", count, rsize);
-		count = rsize;
-	}
+	iov = {data, (size_t) rsize};
+	uio = {&iov, 1, 0, rsize, UIO_READ};
+	count = p9_client_read_once(fid, P9_TREADDIR, &uio, offset, rsize, &err);
+	if (err)
+		return err;
 
 	debugf("<<< RREADDIR count %d\n", count);
 
-	memmove(data, dataptr, count);
-
-	clnt->p9_free_req(req);
 	return count;
-
-free_and_error:
-	clnt->p9_free_req(req);
-	return err;
 }
 
 int p9_client::p9_client_readlink_dotl(struct p9_fid *fid, char **target)
@@ -2190,7 +2328,7 @@ int p9_client::p9_parse_options(const char *opts)
 	int ret = 0;
 
 	_proto_version = p9_proto_2000L;
-	_msize = 8192;
+	_msize = P9_DEF_MSIZE;
 
 	if (!opts)
 		return 0;
@@ -2261,64 +2399,66 @@ free_and_return:
 	return ret;
 }
 
+/**
+ * p9_tag_get - allocate a tag for a request
+ *
+ * Waits for a request in flight to complete if all tags are in use.
+ */
+u16 p9_client::p9_tag_get()
+{
+	u16 tag;
+
+	WITH_LOCK(_tags_lock)
+	{
+		while (!_nr_free_tags)
+		{
+			_tags_cond.wait(_tags_lock);
+		}
+		tag = _free_tags[--_nr_free_tags];
+	}
+	return tag;
+}
+
+void p9_client::p9_tag_put(u16 tag)
+{
+	WITH_LOCK(_tags_lock)
+	{
+		_free_tags[_nr_free_tags++] = tag;
+		_tags_cond.wake_one();
+	}
+}
+
 /**
  * p9_alloc_req - lookup/allocate a request by tag
  * @tag: numeric id for transaction
+ * @max_size: size of the request and response buffers
  *
- * this is a simple array lookup, but will grow the
- * request_slots as necessary to accommodate transaction
- * ids which did not previously have a slot.
- *
- * this code relies on the client spinlock to manage locks, its
- * possible we should switch to something else, but I'd rather
- * stick with something low-overhead for the common case.
+ * this is a simple array lookup. The fcalls of a slot are kept
+ * from one request to the next, and only grown when a request
+ * needs larger ones.
  *
  */
 struct p9_req_t *p9_client::p9_alloc_req(u16 tag, unsigned int max_size)
 {
-	// unsigned long flags;
-	int row, col;
 	struct p9_req_t *req;
-	int alloc_msize = std::min<unsigned>(_msize, max_size);
+	unsigned alloc_msize = std::min<unsigned>(_msize, max_size);
 
 	/* This looks up the original request by tag so we know which
 	 * buffer to read the data into */
-	tag++;
+	req = &_reqs[(u16) (tag + 1)];
 
-	if (tag >= _max_tag) {
-		_lock.lock();
-		/* check again since original check was outside of lock */
-		while (tag >= _max_tag) {
-			row = (tag / P9_ROW_MAXTAG);
-			_reqs[row] = (struct p9_req_t *) calloc(P9_ROW_MAXTAG,
-					sizeof(struct p9_req_t));
-
-			if (!_reqs[row]) {
-				debugf("Couldn't grow tag array\n");
-				_lock.unlock();
-				return nullptr;
-			}
-			for (col = 0; col < P9_ROW_MAXTAG; col++) {
-				_reqs[row][col].status = REQ_STATUS_IDLE;
-				_reqs[row][col].tc = NULL;
-			}
-			_max_tag += P9_ROW_MAXTAG;
-		}
-		_lock.unlock();
+	if (req->tc && req->tc->capacity < alloc_msize) {
+		free(req->tc);
+		free(req->rc);
+		req->tc = req->rc = NULL;
 	}
-	row = tag / P9_ROW_MAXTAG;
-	col = tag % P9_ROW_MAXTAG;
-
-	req = &_reqs[row][col];
-
-
 	if (!req->tc)
 		req->tc = p9_fcall_alloc(alloc_msize);
 	if (!req->rc)
 		req->rc = p9_fcall_alloc(alloc_msize);
 	if (!req->tc || !req->rc)
 	{
-		debugf("Couldn't grow tag array\n");
+		debugf("Couldn't allocate request buffers\n");
 		free(req->tc);
 		free(req->rc);
 		req->tc = req->rc = NULL;
@@ -2328,7 +2468,8 @@ struct p9_req_t *p9_client::p9_alloc_req(u16 tag, unsigned int max_size)
 	p9pdu_reset(req->tc);
 	p9pdu_reset(req->rc);
 
-	req->tc->tag = tag-1;
+	req->tc->tag = tag;
+	req->t_err = 0;
 	req->status = REQ_STATUS_ALLOC;
 
 	return req;
@@ -2341,19 +2482,14 @@ struct p9_req_t *p9_client::p9_alloc_req(u16 tag, unsigned int max_size)
  */
 struct p9_req_t *p9_client::p9_lookup_req(u16 tag)
 {
-	int row, col;
-
 	/* This looks up the original request by tag so we know which
 	 * buffer to read the data into */
 	tag++;
 
-	if(tag >= _max_tag) 
+	if (tag > P9_MAXTAG)
 		return NULL;
 
-	row = tag / P9_ROW_MAXTAG;
-	col = tag % P9_ROW_MAXTAG;
-
-	return &_reqs[row][col];
+	return &_reqs[tag];
 }
 
 /**
@@ -2363,12 +2499,12 @@ struct p9_req_t *p9_client::p9_lookup_req(u16 tag)
  */
 void p9_client::p9_free_req(struct p9_req_t *r)
 {
-	int tag = r->tc->tag;
+	u16 tag = r->tc->tag;
 	debugf("req %p tag: %d\n", r, tag);
 
 	r->status = REQ_STATUS_IDLE;
-	if (tag != P9_NOTAG && _tagpool.p9_idpool_check(tag))
-		_tagpool.p9_idpool_put(tag);
+	if (tag != P9_NOTAG)
+		p9_tag_put(tag);
 }
 
 /**
@@ -2400,7 +2536,7 @@ int p9_client::p9_check_errors(struct p9_req_t *req)
 	if (type != P9_RERROR && type != P9_RLERROR)
 		return 0;
 
-	if (p9_is_proto_dotl()) {
+	if (!p9_is_proto_dotl()) {
 		char *ename;
 		err = p9pdu_readf(req->rc, _proto_version, "s?d",
 				  &ename, &ecode);
@@ -2449,14 +2585,14 @@ struct p9_req_t *p9_client::p9_client_prepare_req(int8_t type, int req_size,
 		return nullptr;
 
 	tag = P9_NOTAG;
-	if (type != P9_TVERSION) {
-		if ((tag = _tagpool.p9_idpool_get()) < 0)
-			return nullptr;
-	}
+	if (type != P9_TVERSION)
+		tag = p9_tag_get();
 
-	;
-	if (!(req = p9_alloc_req(tag, req_size)))
+	if (!(req = p9_alloc_req(tag, req_size))) {
+		if (tag != P9_NOTAG)
+			p9_tag_put(tag);
 		return req;
+	}
 
 	/* marshall the data */
 	p9pdu_prepare(req->tc, tag, type);
@@ -2471,27 +2607,56 @@ struct p9_req_t *p9_client::p9_client_prepare_req(int8_t type, int req_size,
 	return req;
 }
 
-struct p9_req_t *p9_client::p9_client_rpc(int8_t type, 
-	const char *fmt, ...)
+/**
+ * p9_client_request - issue a request and wait for its response
+ * @type: type of request
+ * @req_size: size of the request and response buffers
+ * @uidata: destination of the response data, for zero copy
+ * @uodata: source of the request data, for zero copy
+ * @inlen: bytes of response data going to @uidata
+ * @outlen: bytes of request data coming from @uodata
+ * @in_hdrlen: bytes of the response to receive before the data
+ *
+ * Requests are tagged, so many threads may each have one in flight
+ * at once, and responses may arrive in any order: the thread waits
+ * for its own request only.
+ */
+struct p9_req_t *p9_client::p9_client_request(int8_t type, int req_size,
+	struct uio *uidata, struct uio *uodata, int inlen, int outlen,
+	int in_hdrlen, const char *fmt, va_list ap)
 {
-	va_list ap;
 	int err;
 	struct p9_req_t *req;
+	bool zc = uidata || uodata;
 
-	va_start(ap, fmt);
-	req = p9_client_prepare_req(type, _msize, fmt, ap);
-	va_end(ap);
+	req = p9_client_prepare_req(type, req_size, fmt, ap);
 	if (!req)
 		return req;
 
+	if (uodata) {
+		/*
+		 * The size field of the message must include the data
+		 * following the header, which is sent from uodata
+		 */
+		__le32 sz = cpu_to_le32(req->tc->size + outlen);
+		memcpy(&req->tc->sdata[0], &sz, sizeof(sz));
+	}
+
 	/* Issue a request and wait for response
 	 */
-	err = _trans_mod->request(this, req);
+	waiter wq(sched::thread::current());
+	req->wq = &wq;
+	if (zc)
+		err = _trans_mod->zc_request(this, req, uidata, uodata,
+					inlen, outlen, in_hdrlen);
+	else
+		err = _trans_mod->request(this, req);
 	if (err < 0) {
 		if (err != -ERESTART && err != -EFAULT)
 			_status = Disconnected;
 		goto reterr;
 	}
+	wq.wait();
 
 	/*
 	 * Make sure our req is coherent with regard to updates in other
@@ -2517,6 +2682,22 @@ struct p9_req_t *p9_client::p9_client_rpc(int8_t type,
 	if (err < 0)
 		goto reterr;
 
+	if (uidata) {
+		int8_t rtype;
+		int32_t rsize;
+
+		/*
+		 * An error message longer than the header we asked for
+		 * ended up in uidata, bring it back after the header
+		 */
+		err = p9_parse_header(req->rc, &rsize, &rtype, NULL, 0);
+		if (!err && rtype == P9_RERROR && rsize > in_hdrlen) {
+			size_t len = std::min<size_t>(rsize - in_hdrlen,
+					req->rc->capacity - in_hdrlen);
+			p9_uio_peek(uidata, &req->rc->sdata[in_hdrlen], len);
+		}
+	}
+
 	err = p9_check_errors(req);
 	if (!err)
 		return req;
@@ -2525,6 +2706,42 @@ reterr:
 	return nullptr;
 }
 
+struct p9_req_t *p9_client::p9_client_rpc(int8_t type, 
+	const char *fmt, ...)
+{
+	va_list ap;
+	struct p9_req_t *req;
+
+	va_start(ap, fmt);
+	req = p9_client_request(type, P9_RPC_BUFSZ, NULL, NULL, 0, 0, 0,
+				fmt, ap);
+	va_end(ap);
+
+	return req;
+}
+
+/**
+ * p9_client_zc_rpc - issue a request whose data is not copied
+ *
+ * The data of the request comes from uodata, or the data of the
+ * response goes to uidata, as the transport places it there itself.
+ * Neither uio is advanced.
+ */
+struct p9_req_t *p9_client::p9_client_zc_rpc(int8_t type, struct uio *uidata,
+	struct uio *uodata, int inlen, int outlen, int in_hdrlen,
+	const char *fmt, ...)
+{
+	va_list ap;
+	struct p9_req_t *req;
+
+	va_start(ap, fmt);
+	req = p9_client_request(type, P9_ZC_HDR_SZ, uidata, uodata, inlen,
+				outlen, in_hdrlen, fmt, ap);
+	va_end(ap);
+
+	return req;
+}
+
 struct p9_fid *p9_client::p9_fid_create()
 {
 	int ret;
@@ -113,6 +113,8 @@ static int v9fs_mount(struct mount *mp, const char *dev, int flags, const void *
     sb->s_flags |= MS_ACTIVE | MS_DIRSYNC | MS_NOATIME;
     if (!v9ses->cache)
         sb->s_flags |= MS_SYNCHRONOUS;
+    else
+        mp->m_flags |= MNT_PAGECACHE;
 
 #ifdef CONFIG_9P_FS_POSIX_ACL
     if ((v9ses->flags & V9FS_ACL_MASK) == V9FS_POSIX_ACL)
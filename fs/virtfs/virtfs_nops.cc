@@ -257,7 +257,9 @@ static int load_dir_entries(struct v9fs_inode *inode)
     struct v9fs_dirent *entry;
 
     buflen = fid->clnt->p9_msize() - P9_READDIRHDRSZ;
-    rdir = (struct p9_rdir *) malloc(sizeof(struct p9_rdir));
+    rdir = (struct p9_rdir *) malloc(sizeof(struct p9_rdir) + buflen);
+    if (!rdir)
+        return -ENOMEM;
     memset(rdir, 0, sizeof(struct p9_rdir));
 
     while (1)
@@ -268,10 +270,8 @@ static int load_dir_entries(struct v9fs_inode *inode)
             uio = {&iov, 1, pos, buflen, UIO_READ};
             
             n = p9_client::p9_client_read(fid, &uio, buflen, &err);
-            if (err)
-                return err;
-            if (n == 0)
-                return 0;
+            if (err || n == 0)
+                goto out;
 
             rdir->head = 0;
             rdir->tail = n;
@@ -285,7 +285,8 @@ static int load_dir_entries(struct v9fs_inode *inode)
             if (err) {
                 debugf("V9FSl: p9stat_read returned %d\n", err);
                 p9stat_free(&st);
-                return -EIO;
+                err = -EIO;
+                goto out;
             }
             reclen = st.size+2;
 
@@ -303,6 +304,10 @@ static int load_dir_entries(struct v9fs_inode *inode)
             pos = entry->dirent.d_off;
         }
     }
+
+out:
+    free(rdir);
+    return err;
 }
 
 /* Load Children Entries of a directory
@@ -318,7 +323,9 @@ static int load_dir_entries_dotl(struct v9fs_inode *inode)
     struct v9fs_dirent *entry;
 
     buflen = fid->clnt->p9_msize() - P9_READDIRHDRSZ;
-    rdir = (struct p9_rdir *) malloc(sizeof(struct p9_rdir));
+    rdir = (struct p9_rdir *) malloc(sizeof(struct p9_rdir) + buflen);
+    if (!rdir)
+        return -ENOMEM;
     memset(rdir, 0, sizeof(struct p9_rdir));
 
     while (1)
@@ -327,7 +334,7 @@ static int load_dir_entries_dotl(struct v9fs_inode *inode)
         {
             err = p9_client::p9_client_readdir_dotl(fid, rdir->buf, buflen, pos);
             if (err <= 0)
-                return err;
+                goto out;
 
             rdir->head = 0;
             rdir->tail = err;
@@ -340,7 +347,8 @@ static int load_dir_entries_dotl(struct v9fs_inode *inode)
             if (err < 0)
             {
                 debugf("V9FS: p9dirent_read returned %d\n", err);
-                return -EIO;
+                err = -EIO;
+                goto out;
             }
 
             debugf("V9FS: read a dirent, qid(tvp)[%d, %d, %d] off %d type %d name %s\n", 
@@ -355,6 +363,10 @@ static int load_dir_entries_dotl(struct v9fs_inode *inode)
             rdir->head += err;
         }
     }
+
+out:
+    free(rdir);
+    return err;
 }
 
 /* Read the next item in a directory 
@@ -941,5 +953,6 @@ struct vnops v9fs_vnops = {
     v9fs_arc,                /* arc */ //TODO: Implement to allow memory re-use when mapping files
     v9fs_fallocate,          /* fallocate - returns error when called*/
     v9fs_readlink,           /* read link */
-    v9fs_symlink             /* symbolic link - returns error when called*/
+    v9fs_symlink,            /* symbolic link - returns error when called*/
+    (vnop_readahead_t) nullptr, /* read-ahead */
 };
\ No newline at end of file
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+/*
+ * The part of the FUSE protocol (version 7.31) spoken by virtio-fs that
+ * the read-only virtiofs client uses. The layouts follow the Linux
+ * <linux/fuse.h> header, which is the reference for the protocol.
+ */
+
+#ifndef FUSE_KERNEL_H
+#define FUSE_KERNEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FUSE_KERNEL_VERSION		7
+#define FUSE_KERNEL_MINOR_VERSION	31
+
+/* Node id of the root of the file system */
+#define FUSE_ROOT_ID			1
+
+/* Flags of fuse_init_in and fuse_init_out */
+#define FUSE_ASYNC_READ			(1 << 0)
+#define FUSE_BIG_WRITES			(1 << 5)
+#define FUSE_MAX_PAGES			(1 << 22)
+#define FUSE_MAP_ALIGNMENT		(1 << 26)
+
+/* Flags of fuse_setupmapping_in */
+#define FUSE_SETUPMAPPING_FLAG_WRITE	(1ull << 0)
+#define FUSE_SETUPMAPPING_FLAG_READ	(1ull << 1)
+
+enum fuse_opcode {
+	FUSE_LOOKUP		= 1,
+	FUSE_FORGET		= 2,
+	FUSE_GETATTR		= 3,
+	FUSE_READLINK		= 5,
+	FUSE_OPEN		= 14,
+	FUSE_READ		= 15,
+	FUSE_STATFS		= 17,
+	FUSE_RELEASE		= 18,
+	FUSE_INIT		= 26,
+	FUSE_OPENDIR		= 27,
+	FUSE_READDIR		= 28,
+	FUSE_RELEASEDIR		= 29,
+	FUSE_DESTROY		= 38,
+	FUSE_SETUPMAPPING	= 48,
+	FUSE_REMOVEMAPPING	= 49,
+};
+
+struct fuse_attr {
+	uint64_t	ino;
+	uint64_t	size;
+	uint64_t	blocks;
+	uint64_t	atime;
+	uint64_t	mtime;
+	uint64_t	ctime;
+	uint32_t	atimensec;
+	uint32_t	mtimensec;
+	uint32_t	ctimensec;
+	uint32_t	mode;
+	uint32_t	nlink;
+	uint32_t	uid;
+	uint32_t	gid;
+	uint32_t	rdev;
+	uint32_t	blksize;
+	uint32_t	padding;
+};
+
+struct fuse_kstatfs {
+	uint64_t	blocks;
+	uint64_t	bfree;
+	uint64_t	bavail;
+	uint64_t	files;
+	uint64_t	ffree;
+	uint32_t	bsize;
+	uint32_t	namelen;
+	uint32_t	frsize;
+	uint32_t	padding;
+	uint32_t	spare[6];
+};
+
+struct fuse_entry_out {
+	uint64_t	nodeid;
+	uint64_t	generation;
+	uint64_t	entry_valid;
+	uint64_t	attr_valid;
+	uint32_t	entry_valid_nsec;
+	uint32_t	attr_valid_nsec;
+	struct fuse_attr attr;
+};
+
+struct fuse_forget_in {
+	uint64_t	nlookup;
+};
+
+struct fuse_getattr_in {
+	uint32_t	getattr_flags;
+	uint32_t	dummy;
+	uint64_t	fh;
+};
+
+struct fuse_attr_out {
+	uint64_t	attr_valid;
+	uint32_t	attr_valid_nsec;
+	uint32_t	dummy;
+	struct fuse_attr attr;
+};
+
+struct fuse_open_in {
+	uint32_t	flags;
+	uint32_t	unused;
+};
+
+struct fuse_open_out {
+	uint64_t	fh;
+	uint32_t	open_flags;
+	uint32_t	padding;
+};
+
+struct fuse_release_in {
+	uint64_t	fh;
+	uint32_t	flags;
+	uint32_t	release_flags;
+	uint64_t	lock_owner;
+};
+
+struct fuse_read_in {
+	uint64_t	fh;
+	uint64_t	offset;
+	uint32_t	size;
+	uint32_t	read_flags;
+	uint64_t	lock_owner;
+	uint32_t	flags;
+	uint32_t	padding;
+};
+
+struct fuse_statfs_out {
+	struct fuse_kstatfs st;
+};
+
+struct fuse_init_in {
+	uint32_t	major;
+	uint32_t	minor;
+	uint32_t	max_readahead;
+	uint32_t	flags;
+};
+
+struct fuse_init_out {
+	uint32_t	major;
+	uint32_t	minor;
+	uint32_t	max_readahead;
+	uint32_t	flags;
+	uint16_t	max_background;
+	uint16_t	congestion_threshold;
+	uint32_t	max_write;
+	uint32_t	time_gran;
+	uint16_t	max_pages;
+	uint16_t	map_alignment;	/* log2 of the DAX mapping alignment */
+	uint32_t	unused[8];
+};
+
+struct fuse_setupmapping_in {
+	uint64_t	fh;		/* file handle the range is read from */
+	uint64_t	foffset;	/* offset in the file */
+	uint64_t	len;		/* length of the mapping */
+	uint64_t	flags;		/* FUSE_SETUPMAPPING_FLAG_* */
+	uint64_t	moffset;	/* offset in the DAX window */
+};
+
+struct fuse_removemapping_in {
+	uint32_t	count;		/* number of fuse_removemapping_one following */
+};
+
+struct fuse_removemapping_one {
+	uint64_t	moffset;
+	uint64_t	len;
+};
+
+struct fuse_in_header {
+	uint32_t	len;
+	uint32_t	opcode;
+	uint64_t	unique;
+	uint64_t	nodeid;
+	uint32_t	uid;
+	uint32_t	gid;
+	uint32_t	pid;
+	uint32_t	padding;
+};
+
+struct fuse_out_header {
+	uint32_t	len;
+	int32_t		error;		/* zero or a negative errno */
+	uint64_t	unique;
+};
+
+struct fuse_dirent {
+	uint64_t	ino;
+	uint64_t	off;		/* offset of the next entry */
+	uint32_t	namelen;
+	uint32_t	type;
+	char		name[];
+};
+
+#define FUSE_NAME_OFFSET offsetof(struct fuse_dirent, name)
+#define FUSE_DIRENT_ALIGN(x) \
+	(((x) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1))
+#define FUSE_DIRENT_SIZE(d) \
+	FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + (d)->namelen)
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef __INCLUDE_VIRTIOFS_H__
+#define __INCLUDE_VIRTIOFS_H__
+
+#include <map>
+#include <list>
+#include <atomic>
+#include <memory>
+#include <osv/vnode.h>
+#include <osv/mount.h>
+#include <osv/mutex.h>
+#include <osv/condvar.h>
+#include <osv/pagecache.hh>
+#include "drivers/virtio-fs.hh"
+#include "fuse_kernel.h"
+
+//
+// virtiofs: the files a host shares through a virtio-fs device, which
+// speaks FUSE. The client is read-only. When the device has a DAX window,
+// file data is read, and mapped by mmap(), straight from the host page
+// cache through the window; otherwise it is read with FUSE_READ.
+//
+
+struct virtiofs_inode {
+    uint64_t nodeid;
+    uint64_t nlookup;   // Lookups the server counts, returned by FORGET
+    struct fuse_attr attr;
+};
+
+// Open file or directory
+struct virtiofs_file_data {
+    uint64_t fh;
+    // Directory entries returned by the last FUSE_READDIR, the next one
+    // to hand out being at dir_pos, for file offset dir_off
+    char *dir_buf;
+    size_t dir_len;
+    size_t dir_pos;
+    off_t dir_off;
+};
+
+namespace virtiofs {
+
+//
+// Manages the DAX window, split in chunks of chunk_size bytes, each of
+// which maps a chunk-aligned range of one file with FUSE_SETUPMAPPING.
+// Chunks are pinned while read from, and recycled in LRU order once the
+// window is full. Pages of a chunk may be mapped by mmap(), which shares
+// them with the host page cache.
+class dax_manager {
+public:
+    static constexpr uint64_t chunk_size = 2 * 1024 * 1024;
+
+    dax_manager(virtio::fs& drv, const virtio::fs::dax_window& window);
+    ~dax_manager();
+
+    // Reads from the file into uio, which must not go past its end
+    int read(struct virtiofs_inode *inode, uint64_t fh, struct uio *uio);
+    // Maps the page at offset into the page cache under key
+    int map_page(struct virtiofs_inode *inode, uint64_t fh, off_t offset, pagecache::hashkey *key);
+    // Removes the mappings of a file the server is about to forget
+    void drop(uint64_t nodeid);
+
+private:
+    struct chunk : public pagecache::shared_buf {
+        uint64_t moffset;       // Offset in the window
+        uint64_t nodeid;        // File mapped, 0 if none
+        uint64_t index;         // Chunk of the file mapped
+        unsigned pins;
+        std::atomic<bool> shared = { false };
+        std::list<chunk *>::iterator lru;
+
+        virtual void share() override { shared = true; }
+        virtual void unshare() override { shared = false; }
+    };
+
+    int get_chunk(uint64_t nodeid, uint64_t fh, uint64_t index, chunk *&c);
+    void put_chunk(chunk *c);
+    int remove_mapping(chunk *c);
+
+    virtio::fs& _drv;
+    char *_window;
+    std::unique_ptr<chunk[]> _chunks;
+    size_t _nr_chunks;
+
+    mutex _lock;
+    condvar _unpinned;
+    std::map<std::pair<uint64_t, uint64_t>, chunk *> _mapped;
+    std::list<chunk *> _lru;    // Unpinned chunks, least recently used first
+};
+
+}
+
+struct virtiofs_mount_data {
+    virtio::fs *drv;
+    virtiofs::dax_manager *dax;     // nullptr without a DAX window
+    uint32_t max_read;              // Most bytes one FUSE_READ may ask for
+};
+
+extern struct vfsops virtiofs_vfsops;
+extern struct vnops virtiofs_vnops;
+
+int virtiofs_init(void);
+
+// Sends a request and waits for its reply. Arguments which the device
+// cannot reach, like those on the stack of an application thread, are
+// copied. The size of the reply is returned in out_len.
+int fuse_req_send(virtio::fs *drv, uint32_t opcode, uint64_t nodeid,
+                  const void *in, size_t in_size, void *out, size_t out_size,
+                  size_t *out_len = nullptr);
+
+void fuse_forget(virtio::fs *drv, uint64_t nodeid, uint64_t nlookup);
+
+void virtiofs_set_vnode(struct vnode *vnode, struct virtiofs_inode *inode);
+
+#endif
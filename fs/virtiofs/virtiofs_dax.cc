@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+//
+// The DAX window of a virtio-fs device is guest physical memory backed by
+// the host page cache. A range of a file mapped into it with
+// FUSE_SETUPMAPPING is read with a plain memcpy(), and its pages can be
+// mapped by mmap() as they are, without a copy in the guest.
+//
+
+#include <errno.h>
+#include <osv/mmu.hh>
+#include <osv/align.hh>
+#include <osv/uio.h>
+#include <osv/debug.h>
+#include <osv/trace.hh>
+
+#include "virtiofs.hh"
+
+TRACEPOINT(trace_virtiofs_dax_map, "nodeid=%lu, index=%lu, moffset=%lx", uint64_t, uint64_t, uint64_t);
+TRACEPOINT(trace_virtiofs_dax_unmap, "nodeid=%lu, index=%lu, moffset=%lx", uint64_t, uint64_t, uint64_t);
+
+namespace virtiofs {
+
+dax_manager::dax_manager(virtio::fs& drv, const virtio::fs::dax_window& window)
+    : _drv(drv)
+    , _window(const_cast<char *>(static_cast<volatile char *>(window.addr)))
+    , _nr_chunks(window.len / chunk_size)
+{
+    _chunks.reset(new chunk[_nr_chunks]);
+    for (size_t i = 0; i < _nr_chunks; i++) {
+        auto c = &_chunks[i];
+        c->moffset = i * chunk_size;
+        c->nodeid = 0;
+        c->index = 0;
+        c->pins = 0;
+        c->lru = _lru.insert(_lru.end(), c);
+    }
+}
+
+dax_manager::~dax_manager()
+{
+    SCOPE_LOCK(_lock);
+    for (auto& m : _mapped) {
+        remove_mapping(m.second);
+    }
+}
+
+// Returns the chunk mapping the given chunk of the file, pinned, after
+// setting it up in the least recently used chunk if needed
+int dax_manager::get_chunk(uint64_t nodeid, uint64_t fh, uint64_t index, chunk *&c)
+{
+    SCOPE_LOCK(_lock);
+    for (;;) {
+        auto it = _mapped.find({nodeid, index});
+        if (it != _mapped.end()) {
+            c = it->second;
+            if (c->pins++ == 0) {
+                _lru.erase(c->lru);
+            }
+            return 0;
+        }
+        if (!_lru.empty()) {
+            break;
+        }
+        _unpinned.wait(_lock);
+    }
+
+    c = _lru.front();
+    _lru.pop_front();
+    c->pins = 1;
+    if (c->nodeid) {
+        _mapped.erase({c->nodeid, c->index});
+        remove_mapping(c);
+        c->nodeid = 0;
+    }
+
+    struct fuse_setupmapping_in in = {};
+    in.fh = fh;
+    in.foffset = index * chunk_size;
+    in.len = chunk_size;
+    in.flags = FUSE_SETUPMAPPING_FLAG_READ;
+    in.moffset = c->moffset;
+    trace_virtiofs_dax_map(nodeid, index, c->moffset);
+    int error = fuse_req_send(&_drv, FUSE_SETUPMAPPING, nodeid, &in, sizeof(in), nullptr, 0);
+    if (error) {
+        kprintf("[virtiofs] Error %d mapping chunk %lu of node %lu\n", error, index, nodeid);
+        c->pins = 0;
+        c->lru = _lru.insert(_lru.begin(), c);
+        _unpinned.wake_one();
+        return error;
+    }
+
+    c->nodeid = nodeid;
+    c->index = index;
+    _mapped.emplace(std::make_pair(nodeid, index), c);
+    return 0;
+}
+
+void dax_manager::put_chunk(chunk *c)
+{
+    SCOPE_LOCK(_lock);
+    if (--c->pins == 0) {
+        c->lru = _lru.insert(_lru.end(), c);
+        _unpinned.wake_one();
+    }
+}
+
+// Pages of the chunk mapped by mmap() are unmapped first, the next access
+// faults them in again from wherever the file ends up mapped
+int dax_manager::remove_mapping(chunk *c)
+{
+    if (c->shared) {
+        pagecache::unmap_shared_buf(c);
+    }
+
+    struct {
+        struct fuse_removemapping_in in;
+        struct fuse_removemapping_one one;
+    } __attribute__((packed)) args;
+    args.in.count = 1;
+    args.one.moffset = c->moffset;
+    args.one.len = chunk_size;
+    trace_virtiofs_dax_unmap(c->nodeid, c->index, c->moffset);
+    return fuse_req_send(&_drv, FUSE_REMOVEMAPPING, c->nodeid, &args, sizeof(args), nullptr, 0);
+}
+
+int dax_manager::read(struct virtiofs_inode *inode, uint64_t fh, struct uio *uio)
+{
+    while (uio->uio_resid > 0) {
+        uint64_t offset = uio->uio_offset % chunk_size;
+        chunk *c;
+        int error = get_chunk(inode->nodeid, fh, uio->uio_offset / chunk_size, c);
+        if (error) {
+            return error;
+        }
+        // The chunk stays mapped while pinned, but copying may fault on
+        // the destination, so the lock is not held
+        error = uiomove(_window + c->moffset + offset,
+                        std::min<uint64_t>(uio->uio_resid, chunk_size - offset), uio);
+        put_chunk(c);
+        if (error) {
+            return error;
+        }
+    }
+    return 0;
+}
+
+int dax_manager::map_page(struct virtiofs_inode *inode, uint64_t fh, off_t offset, pagecache::hashkey *key)
+{
+    chunk *c;
+    int error = get_chunk(inode->nodeid, fh, offset / chunk_size, c);
+    if (error) {
+        return error;
+    }
+    pagecache::map_shared_buf(key, c, _window + c->moffset + align_down<uint64_t>(offset % chunk_size, mmu::page_size));
+    put_chunk(c);
+    return 0;
+}
+
+void dax_manager::drop(uint64_t nodeid)
+{
+    SCOPE_LOCK(_lock);
+    auto it = _mapped.lower_bound({nodeid, 0});
+    while (it != _mapped.end() && it->first.first == nodeid) {
+        auto c = it->second;
+        // Nothing reads from a file which is no longer referenced
+        assert(c->pins == 0);
+        remove_mapping(c);
+        c->nodeid = 0;
+        _lru.erase(c->lru);
+        c->lru = _lru.insert(_lru.begin(), c);
+        it = _mapped.erase(it);
+    }
+}
+
+}
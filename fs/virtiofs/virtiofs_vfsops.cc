@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include <sys/types.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <osv/device.h>
+#include <osv/debug.h>
+#include <osv/mmu.hh>
+
+#include "virtiofs.hh"
+
+static int virtiofs_mount(struct mount *mp, const char *dev, int flags, const void *data);
+static int virtiofs_sync(struct mount *mp);
+static int virtiofs_statfs(struct mount *mp, struct statfs *statp);
+static int virtiofs_unmount(struct mount *mp, int flags);
+
+#define virtiofs_vget ((vfsop_vget_t)vfs_nullop)
+
+struct vfsops virtiofs_vfsops = {
+    virtiofs_mount,     /* mount */
+    virtiofs_unmount,   /* unmount */
+    virtiofs_sync,      /* sync */
+    virtiofs_vget,      /* vget */
+    virtiofs_statfs,    /* statfs */
+    &virtiofs_vnops     /* vnops */
+};
+
+// Reads of more than this are split in several FUSE_READ requests
+static constexpr uint32_t virtiofs_max_read = 32 * mmu::page_size;
+
+int fuse_req_send(virtio::fs *drv, uint32_t opcode, uint64_t nodeid,
+                  const void *in, size_t in_size, void *out, size_t out_size,
+                  size_t *out_len)
+{
+    std::unique_ptr<virtio::fuse_request> req(new virtio::fuse_request());
+    std::unique_ptr<char[]> in_copy, out_copy;
+    void *in_buf = const_cast<void *>(in);
+    void *out_buf = out;
+
+    if (in_size && !mmu::is_linear_mapped(in, in_size)) {
+        in_copy.reset(new char[in_size]);
+        memcpy(in_copy.get(), in, in_size);
+        in_buf = in_copy.get();
+    }
+    if (out_size && !mmu::is_linear_mapped(out, out_size)) {
+        out_copy.reset(new char[out_size]);
+        out_buf = out_copy.get();
+    }
+
+    req->in_header.opcode = opcode;
+    req->in_header.nodeid = nodeid;
+    req->input_args = in_buf;
+    req->input_args_size = in_size;
+    req->output_args = out_buf;
+    req->output_args_size = out_size;
+
+    int error = drv->make_request(req.get());
+
+    size_t len = 0;
+    if (!error && req->out_header.len > sizeof(req->out_header)) {
+        len = std::min(req->out_header.len - sizeof(req->out_header), out_size);
+    }
+    if (out_copy) {
+        memcpy(out, out_buf, len);
+    }
+    if (out_len) {
+        *out_len = len;
+    }
+    return error;
+}
+
+// FORGET gets no reply, so nothing waits for it: the request frees itself
+// once the device is done with it
+struct fuse_forget_request {
+    virtio::fuse_request req;
+    struct fuse_forget_in in;
+};
+
+void fuse_forget(virtio::fs *drv, uint64_t nodeid, uint64_t nlookup)
+{
+    auto forget = new fuse_forget_request();
+    forget->req.in_header.opcode = FUSE_FORGET;
+    forget->req.in_header.nodeid = nodeid;
+    forget->req.input_args = &forget->in;
+    forget->req.input_args_size = sizeof(forget->in);
+    forget->req.done = [] (virtio::fuse_request *req) {
+        delete reinterpret_cast<fuse_forget_request *>(req);
+    };
+    forget->in.nlookup = nlookup;
+    drv->make_request(&forget->req, true);
+}
+
+static int
+virtiofs_mount(struct mount *mp, const char *dev, int flags, const void *data)
+{
+    struct device *device;
+
+    int error = device_open(dev + 5, DO_RDWR, &device);
+    if (error) {
+        kprintf("[virtiofs] Error opening device!\n");
+        return error;
+    }
+    auto drv = static_cast<virtio::fs_priv *>(device->private_data)->drv;
+
+    struct fuse_init_in init_in = {};
+    init_in.major = FUSE_KERNEL_VERSION;
+    init_in.minor = FUSE_KERNEL_MINOR_VERSION;
+    init_in.flags = FUSE_MAX_PAGES | FUSE_MAP_ALIGNMENT;
+    struct fuse_init_out init_out = {};
+    error = fuse_req_send(drv, FUSE_INIT, FUSE_ROOT_ID, &init_in, sizeof(init_in),
+                          &init_out, sizeof(init_out));
+    if (error) {
+        kprintf("[virtiofs] Error %d initializing the session with tag %s\n", error, drv->get_tag().c_str());
+        device_close(device);
+        return error;
+    }
+    if (init_out.major != FUSE_KERNEL_VERSION) {
+        kprintf("[virtiofs] Unsupported FUSE protocol version %u.%u\n", init_out.major, init_out.minor);
+        device_close(device);
+        return EPROTONOSUPPORT;
+    }
+
+    auto root = new virtiofs_inode();
+    root->nodeid = FUSE_ROOT_ID;
+    struct fuse_getattr_in getattr_in = {};
+    struct fuse_attr_out attr_out = {};
+    error = fuse_req_send(drv, FUSE_GETATTR, FUSE_ROOT_ID, &getattr_in, sizeof(getattr_in),
+                          &attr_out, sizeof(attr_out));
+    if (error) {
+        kprintf("[virtiofs] Error %d getting the attributes of the root\n", error);
+        delete root;
+        device_close(device);
+        return error;
+    }
+    root->attr = attr_out.attr;
+
+    auto m = new virtiofs_mount_data();
+    m->drv = drv;
+    m->max_read = virtiofs_max_read;
+    if (init_out.flags & FUSE_MAX_PAGES) {
+        m->max_read = std::min<uint32_t>(m->max_read, init_out.max_pages * mmu::page_size);
+    }
+
+    // Chunks of the DAX window must be aligned as the server asks
+    auto window = drv->get_dax();
+    if (window) {
+        uint64_t alignment = (init_out.flags & FUSE_MAP_ALIGNMENT) ? (1ull << init_out.map_alignment) : 1;
+        if (virtiofs::dax_manager::chunk_size % alignment == 0 &&
+            window->len >= virtiofs::dax_manager::chunk_size) {
+            m->dax = new virtiofs::dax_manager(*drv, *window);
+        } else {
+            kprintf("[virtiofs] Not using the DAX window, mapping alignment %lu unsupported\n", alignment);
+        }
+    }
+
+    mp->m_data = m;
+    mp->m_dev = device;
+    virtiofs_set_vnode(mp->m_root->d_vnode, root);
+
+    debugf("virtiofs: mounted tag %s, protocol %u.%u, dax %s\n", drv->get_tag().c_str(),
+           init_out.major, init_out.minor, m->dax ? "on" : "off");
+    return 0;
+}
+
+static int virtiofs_sync(struct mount *mp) {
+    return 0;
+}
+
+static int virtiofs_statfs(struct mount *mp, struct statfs *statp)
+{
+    auto m = static_cast<virtiofs_mount_data *>(mp->m_data);
+    struct fuse_statfs_out out = {};
+
+    int error = fuse_req_send(m->drv, FUSE_STATFS, FUSE_ROOT_ID, nullptr, 0, &out, sizeof(out));
+    if (error) {
+        return error;
+    }
+
+    statp->f_bsize = out.st.bsize;
+    statp->f_blocks = out.st.blocks;
+    statp->f_bfree = out.st.bfree;
+    statp->f_bavail = out.st.bavail;
+    statp->f_files = out.st.files;
+    statp->f_ffree = out.st.ffree;
+    statp->f_namelen = out.st.namelen;
+
+    return 0;
+}
+
+static int
+virtiofs_unmount(struct mount *mp, int flags)
+{
+    auto m = static_cast<virtiofs_mount_data *>(mp->m_data);
+
+    // Releasing the root vnode still needs the mount data
+    release_mp_dentries(mp);
+    delete m->dax;
+    delete m;
+    return 0;
+}
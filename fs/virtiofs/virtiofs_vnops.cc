@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <sys/param.h>
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+
+#include <algorithm>
+#include <memory>
+
+#include <osv/prex.h>
+#include <osv/vnode.h>
+#include <osv/file.h>
+#include <osv/mount.h>
+#include <osv/debug.h>
+
+#include "virtiofs.hh"
+
+// Size of the directory entries asked for by one FUSE_READDIR
+static constexpr size_t virtiofs_dir_buf_size = 8192;
+
+// vnops of regular files on mounts with a DAX window, whose pages mmap()
+// maps straight from the window
+static struct vnops virtiofs_dax_vnops;
+
+static struct virtiofs_mount_data *mount_data(struct vnode *vp)
+{
+    return static_cast<struct virtiofs_mount_data *>(vp->v_mount->m_data);
+}
+
+void virtiofs_set_vnode(struct vnode *vnode, struct virtiofs_inode *inode)
+{
+    if (vnode == nullptr || inode == nullptr) {
+        return;
+    }
+
+    vnode->v_data = inode;
+    vnode->v_ino = inode->nodeid;
+
+    auto mode = inode->attr.mode;
+    if (S_ISDIR(mode)) {
+        vnode->v_type = VDIR;
+    } else if (S_ISREG(mode)) {
+        vnode->v_type = VREG;
+        if (mount_data(vnode)->dax) {
+            vnode->v_op = &virtiofs_dax_vnops;
+        }
+    } else if (S_ISLNK(mode)) {
+        vnode->v_type = VLNK;
+    }
+
+    vnode->v_mode = mode & ~S_IFMT;
+    vnode->v_size = inode->attr.size;
+}
+
+static int virtiofs_open(struct file *fp)
+{
+    if ((file_flags(fp) & FWRITE)) {
+        // Do no allow opening files to write
+        return (EROFS);
+    }
+
+    struct vnode *vp = fp->f_dentry.get()->d_vnode;
+    auto inode = static_cast<struct virtiofs_inode *>(vp->v_data);
+    struct fuse_open_in in = {};
+    struct fuse_open_out out = {};
+    in.flags = O_RDONLY;
+
+    int error = fuse_req_send(mount_data(vp)->drv, vp->v_type == VDIR ? FUSE_OPENDIR : FUSE_OPEN,
+                              inode->nodeid, &in, sizeof(in), &out, sizeof(out));
+    if (error) {
+        return error;
+    }
+
+    auto data = new virtiofs_file_data();
+    data->fh = out.fh;
+    file_setdata(fp, data);
+    return 0;
+}
+
+static int virtiofs_close(struct vnode *vp, struct file *fp)
+{
+    auto inode = static_cast<struct virtiofs_inode *>(vp->v_data);
+    auto data = static_cast<struct virtiofs_file_data *>(file_data(fp));
+    if (!data) {
+        return 0;
+    }
+
+    struct fuse_release_in in = {};
+    in.fh = data->fh;
+    in.flags = O_RDONLY;
+    int error = fuse_req_send(mount_data(vp)->drv, vp->v_type == VDIR ? FUSE_RELEASEDIR : FUSE_RELEASE,
+                              inode->nodeid, &in, sizeof(in), nullptr, 0);
+
+    free(data->dir_buf);
+    delete data;
+    file_setdata(fp, nullptr);
+    return error;
+}
+
+static int virtiofs_readlink(struct vnode *vp, struct uio *uio)
+{
+    auto inode = static_cast<struct virtiofs_inode *>(vp->v_data);
+
+    if (vp->v_type != VLNK) {
+        return EINVAL; //This node is not a symbolic link
+    }
+
+    std::unique_ptr<char[]> buf(new char[PATH_MAX]);
+    size_t len;
+    int error = fuse_req_send(mount_data(vp)->drv, FUSE_READLINK, inode->nodeid,
+                              nullptr, 0, buf.get(), PATH_MAX, &len);
+    if (error) {
+        return error;
+    }
+    return uiomove(buf.get(), len, uio);
+}
+
+//
+// With a DAX window, data is copied straight from the host page cache;
+// otherwise it is read with FUSE_READ, at most max_read bytes at a time
+static int virtiofs_read(struct vnode *vp, struct file *fp, struct uio *uio, int ioflag)
+{
+    struct virtiofs_mount_data *m = mount_data(vp);
+    auto inode = static_cast<struct virtiofs_inode *>(vp->v_data);
+    auto data = static_cast<struct virtiofs_file_data *>(file_data(fp));
+
+    if (vp->v_type == VDIR) {
+        return EISDIR;
+    }
+    if (vp->v_type != VREG) {
+        return EINVAL;
+    }
+    if (uio->uio_offset < 0) {
+        return EINVAL;
+    }
+    if (uio->uio_resid == 0 || uio->uio_offset >= vp->v_size) {
+        return 0;
+    }
+
+    if (m->dax) {
+        // The window maps whole chunks, which may go past the end of the file
+        auto resid = uio->uio_resid;
+        auto len = std::min<off_t>(resid, vp->v_size - uio->uio_offset);
+        uio->uio_resid = len;
+        int error = m->dax->read(inode, data->fh, uio);
+        uio->uio_resid += resid - len;
+        return error;
+    }
+
+    size_t buf_size = std::min<size_t>(uio->uio_resid, m->max_read);
+    std::unique_ptr<char[]> buf(new char[buf_size]);
+    while (uio->uio_resid > 0) {
+        struct fuse_read_in in = {};
+        in.fh = data->fh;
+        in.offset = uio->uio_offset;
+        in.size = std::min<size_t>(uio->uio_resid, buf_size);
+        size_t len;
+        int error = fuse_req_send(m->drv, FUSE_READ, inode->nodeid, &in, sizeof(in),
+                                  buf.get(), in.size, &len);
+        if (error) {
+            return error;
+        }
+        error = uiomove(buf.get(), len, uio);
+        if (error || len < in.size) {
+            return error;
+        }
+    }
+    return 0;
+}
+
+//
+// Maps the page at uio_offset, in the DAX window, into the page cache so
+// that mmap() shares it with the host. The page cache key to map it under
+// comes in the iovec. uio_resid is left untouched if the page could not
+// be mapped.
+static int virtiofs_cache(struct vnode *vp, struct file *fp, struct uio *uio)
+{
+    struct virtiofs_mount_data *m = mount_data(vp);
+    auto inode = static_cast<struct virtiofs_inode *>(vp->v_data);
+    auto data = static_cast<struct virtiofs_file_data *>(file_data(fp));
+
+    if (vp->v_type != VREG || uio->uio_offset < 0 || uio->uio_offset >= vp->v_size) {
+        return 0;
+    }
+
+    auto key = (pagecache::hashkey *) uio->uio_iov->iov_base;
+    if (m->dax->map_page(inode, data->fh, uio->uio_offset, key) == 0) {
+        uio->uio_resid = 0;
+    }
+    return 0;
+}
+
+//
+// Hands out the entries of the last FUSE_READDIR one by one. Each entry
+// carries the offset of the next one, which becomes the file offset, so
+// that telldir() and seekdir() work.
+static int virtiofs_readdir(struct vnode *vp, struct file *fp, struct dirent *dir)
+{
+    struct virtiofs_mount_data *m = mount_data(vp);
+    auto inode = static_cast<struct virtiofs_inode *>(vp->v_data);
+    auto data = static_cast<struct virtiofs_file_data *>(file_data(fp));
+
+    if (vp->v_type != VDIR) {
+        return ENOTDIR;
+    }
+
+    if (!data->dir_buf || data->dir_pos >= data->dir_len || data->dir_off != fp->f_offset) {
+        if (!data->dir_buf) {
+            data->dir_buf = static_cast<char *>(malloc(virtiofs_dir_buf_size));
+            if (!data->dir_buf) {
+                return ENOMEM;
+            }
+        }
+        struct fuse_read_in in = {};
+        in.fh = data->fh;
+        in.offset = fp->f_offset;
+        in.size = virtiofs_dir_buf_size;
+        size_t len;
+        int error = fuse_req_send(m->drv, FUSE_READDIR, inode->nodeid, &in, sizeof(in),
+                                  data->dir_buf, virtiofs_dir_buf_size, &len);
+        if (error) {
+            return error;
+        }
+        data->dir_len = len;
+        data->dir_pos = 0;
+        data->dir_off = fp->f_offset;
+        if (len == 0) {
+            return ENOENT;
+        }
+    }
+
+    auto ent = reinterpret_cast<struct fuse_dirent *>(data->dir_buf + data->dir_pos);
+    if (data->dir_pos + FUSE_NAME_OFFSET > data->dir_len ||
+        data->dir_pos + FUSE_DIRENT_SIZE(ent) > data->dir_len) {
+        return EIO;
+    }
+
+    dir->d_ino = ent->ino;
+    dir->d_fileno = ent->ino;
+    // FUSE gives the type as in the mode, which is what DT_* are
+    dir->d_type = ent->type;
+    size_t namelen = std::min<size_t>(ent->namelen, sizeof(dir->d_name) - 1);
+    memcpy(dir->d_name, ent->name, namelen);
+    dir->d_name[namelen] = '\0';
+
+    data->dir_pos += FUSE_DIRENT_SIZE(ent);
+    data->dir_off = ent->off;
+    fp->f_offset = ent->off;
+
+    return 0;
+}
+
+static int virtiofs_lookup(struct vnode *dvp, char *name, struct vnode **vpp)
+{
+    struct virtiofs_mount_data *m = mount_data(dvp);
+    auto inode = static_cast<struct virtiofs_inode *>(dvp->v_data);
+    struct vnode *vp = nullptr;
+
+    if (*name == '\0') {
+        return ENOENT;
+    }
+
+    if (dvp->v_type != VDIR) {
+        return ENOTDIR;
+    }
+
+    struct fuse_entry_out out = {};
+    int error = fuse_req_send(m->drv, FUSE_LOOKUP, inode->nodeid, name, strlen(name) + 1,
+                              &out, sizeof(out));
+    if (error) {
+        return error;
+    }
+    // A zero node id is a negative entry
+    if (out.nodeid == 0) {
+        return ENOENT;
+    }
+
+    // The server counts every lookup, FORGET returns them all once the
+    // vnode goes away
+    if (vget(dvp->v_mount, out.nodeid, &vp)) {
+        auto found = static_cast<struct virtiofs_inode *>(vp->v_data);
+        found->nlookup++;
+        *vpp = vp;
+        return 0;
+    }
+    if (!vp) {
+        fuse_forget(m->drv, out.nodeid, 1);
+        return ENOMEM;
+    }
+
+    auto found = new virtiofs_inode();
+    found->nodeid = out.nodeid;
+    found->nlookup = 1;
+    found->attr = out.attr;
+    virtiofs_set_vnode(vp, found);
+
+    *vpp = vp;
+    return 0;
+}
+
+//
+// Files may change on the host, so attributes are always asked for
+static int virtiofs_getattr(struct vnode *vp, struct vattr *attr)
+{
+    auto inode = static_cast<struct virtiofs_inode *>(vp->v_data);
+    struct fuse_getattr_in in = {};
+    struct fuse_attr_out out = {};
+
+    int error = fuse_req_send(mount_data(vp)->drv, FUSE_GETATTR, inode->nodeid,
+                              &in, sizeof(in), &out, sizeof(out));
+    if (error) {
+        return error;
+    }
+    inode->attr = out.attr;
+    vp->v_mode = inode->attr.mode & ~S_IFMT;
+    vp->v_size = inode->attr.size;
+
+    attr->va_type = (enum vtype) vp->v_type;
+    attr->va_mode = vp->v_mode;
+    attr->va_nlink = inode->attr.nlink;
+    attr->va_uid = inode->attr.uid;
+    attr->va_gid = inode->attr.gid;
+    attr->va_nodeid = vp->v_ino;
+    attr->va_atime = { (time_t) inode->attr.atime, inode->attr.atimensec };
+    attr->va_mtime = { (time_t) inode->attr.mtime, inode->attr.mtimensec };
+    attr->va_ctime = { (time_t) inode->attr.ctime, inode->attr.ctimensec };
+    attr->va_rdev = inode->attr.rdev;
+    attr->va_nblocks = inode->attr.blocks;
+    attr->va_size = vp->v_size;
+
+    return 0;
+}
+
+//
+// The server forgets a node once told how many lookups it answered for
+// it; the root was never looked up
+static int virtiofs_inactive(struct vnode *vp)
+{
+    struct virtiofs_mount_data *m = mount_data(vp);
+    auto inode = static_cast<struct virtiofs_inode *>(vp->v_data);
+
+    if (!inode) {
+        return 0;
+    }
+    if (m->dax && vp->v_type == VREG) {
+        m->dax->drop(inode->nodeid);
+    }
+    if (inode->nlookup) {
+        fuse_forget(m->drv, inode->nodeid, inode->nlookup);
+    }
+    delete inode;
+    vp->v_data = nullptr;
+    return 0;
+}
+
+int virtiofs_init(void)
+{
+    virtiofs_dax_vnops = virtiofs_vnops;
+    virtiofs_dax_vnops.vop_cache = virtiofs_cache;
+    return 0;
+}
+
+#define virtiofs_write       ((vnop_write_t)vop_erofs)
+#define virtiofs_seek        ((vnop_seek_t)vop_nullop)
+#define virtiofs_ioctl       ((vnop_ioctl_t)vop_einval)
+#define virtiofs_create      ((vnop_create_t)vop_erofs)
+#define virtiofs_remove      ((vnop_remove_t)vop_erofs)
+#define virtiofs_rename      ((vnop_rename_t)vop_erofs)
+#define virtiofs_mkdir       ((vnop_mkdir_t)vop_erofs)
+#define virtiofs_rmdir       ((vnop_rmdir_t)vop_erofs)
+#define virtiofs_setattr     ((vnop_setattr_t)vop_erofs)
+#define virtiofs_truncate    ((vnop_truncate_t)vop_erofs)
+#define virtiofs_link        ((vnop_link_t)vop_erofs)
+#define virtiofs_fallocate   ((vnop_fallocate_t)vop_erofs)
+#define virtiofs_fsync       ((vnop_fsync_t)vop_nullop)
+#define virtiofs_symlink     ((vnop_symlink_t)vop_erofs)
+
+struct vnops virtiofs_vnops = {
+    virtiofs_open,           /* open */
+    virtiofs_close,          /* close */
+    virtiofs_read,           /* read */
+    virtiofs_write,          /* write - returns error when called */
+    virtiofs_seek,           /* seek */
+    virtiofs_ioctl,          /* ioctl */
+    virtiofs_fsync,          /* fsync */
+    virtiofs_readdir,        /* readdir */
+    virtiofs_lookup,         /* lookup */
+    virtiofs_create,         /* create - returns error when called */
+    virtiofs_remove,         /* remove - returns error when called */
+    virtiofs_rename,         /* rename - returns error when called */
+    virtiofs_mkdir,          /* mkdir - returns error when called */
+    virtiofs_rmdir,          /* rmdir - returns error when called */
+    virtiofs_getattr,        /* getattr */
+    virtiofs_setattr,        /* setattr - returns error when called */
+    virtiofs_inactive,       /* inactive */
+    virtiofs_truncate,       /* truncate - returns error when called*/
+    virtiofs_link,           /* link - returns error when called*/
+    nullptr,                 /* arc, only with a DAX window */
+    virtiofs_fallocate,      /* fallocate - returns error when called*/
+    virtiofs_readlink,       /* read link */
+    virtiofs_symlink,        /* symbolic link - returns error when called*/
+    nullptr                  /* read-ahead */
+};
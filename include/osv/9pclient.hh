@@ -9,6 +9,8 @@
 #define __OSV_P9CLIENT_H
 
 #include <osv/irqlock.hh>
+#include <osv/mutex.h>
+#include <osv/condvar.h>
 #include <api/limits.h>
 #include <unordered_set>
 #include <list>
@@ -286,6 +288,18 @@ enum p9_qid_t {
 /* size of header for zero copy read/write */
 #define P9_ZC_HDR_SZ 4096
 
+/* size of the Rread/Rreaddir header placed before zero copy data */
+#define P9_ZC_RHDR_SZ	11
+
+/* default maximum message size, 1MB of data plus the header */
+#define P9_DEF_MSIZE	(1024 * 1024 + P9_IOHDRSZ)
+
+/* buffer size of requests not carrying file data */
+#define P9_RPC_BUFSZ	8192
+
+/* largest read or write going through a bounce buffer */
+#define P9_BOUNCE_SZ	(64 * 1024)
+
 
 /**
  * struct p9_qid - file system entity information
@@ -517,8 +531,8 @@ struct p9_fcall {
 #define MINOR(dev)  ((unsigned int) ((dev) & MINORMASK))
 #define MKDEV(ma,mi)    (((ma) << MINORBITS) | (mi))
 
-/* Number of requests per row */
-#define P9_ROW_MAXTAG 255
+/* Number of requests which may be in flight at once */
+#define P9_MAXTAG 128
 
 #define __NEW_UTS_LEN 64
 
@@ -575,32 +589,33 @@ enum p9_req_status_t {
 	REQ_STATUS_ERROR,
 };
 
+class waiter;
+struct uio;
+
 /**
  * struct p9_req_t - request slots
  * @status: status of this request slot
  * @t_err: transport error
  * @flush_tag: tag of request being flushed (for flush requests)
- * @wq: wait_queue for the client to block on for this request
+ * @wq: waiter for the client to block on for this request
  * @tc: the request fcall structure
  * @rc: the response fcall structure
  * @aux: transport specific data (provided for trans_fd migration)
  * @req_list: link for higher level objects to chain requests
  *
  * Transport use an array to track outstanding requests
- * instead of a list.  While this may incurr overhead during initial
- * allocation or expansion, it makes request lookup much easier as the
+ * instead of a list.  It makes request lookup much easier as the
  * tag id is a index into an array.  (We use tag+1 so that we can accommodate
  * the -1 tag for the T_VERSION request).
- * This also has the nice effect of only having to allocate wait_queues
- * once, instead of constantly allocating and freeing them.  Its possible
- * other resources could benefit from this scheme as well.
+ * This also has the nice effect of only having to allocate fcalls
+ * once per slot, instead of constantly allocating and freeing them.
  *
  */
 struct p9_req_t {
 	int status;
 	int t_err;
 	// struct kref refcount;
-	// wait_queue_head_t *wq;
+	waiter *wq;
 	struct p9_fcall *tc;
 	struct p9_fcall *rc;
 	void *aux;
@@ -780,7 +795,7 @@ struct p9_trans_module {
 	int (*cancel) (struct p9_client *, struct p9_req_t *req);
 	int (*cancelled)(struct p9_client *, struct p9_req_t *req);
 	int (*zc_request)(struct p9_client *, struct p9_req_t *,
-			  struct iov_iter *, struct iov_iter *, int , int, int);
+			  struct uio *, struct uio *, int , int, int);
 	int (*show_options)(struct seq *, struct p9_client *);
 };
 
@@ -796,21 +811,20 @@ extern struct p9_trans_module p9_virtio_trans;
  * @trans: tranport instance state and API
  * @fidpool: fid handle accounting for session
  * @fidlist: List of active fid handles
- * @tagpool - transaction id accounting for session
- * @reqs - 2D array of requests
- * @max_tag - current maximum tag id allocated
+ * @tags_lock - protect @free_tags
+ * @tags_cond - wait for a free tag while all are in flight
+ * @free_tags - stack of the tags not in flight
+ * @nr_free_tags - number of entries of @free_tags
+ * @reqs - array of requests, indexed by tag+1
  * @name - node name used as client id
  *
  * The client structure is used to keep track of various per-client
  * state that has been instantiated.
  * In order to minimize per-transaction overhead we use a
  * simple array to lookup requests instead of a hash table
- * or linked list.  In order to support larger number of
- * transactions, we make this a 2D array, allocating new rows
- * when we need to grow the total number of the transactions.
- *
- * Each row is 256 requests and we'll support up to 256 rows for
- * a total of 64k concurrent requests per session.
+ * or linked list.  The array holds P9_MAXTAG requests, which may
+ * all be in flight at once, each with its own tag; a request
+ * beyond that waits for a tag to be freed.
  *
  * Bugs: duplicated data and potentially unnecessary elements.
  */
@@ -905,6 +919,8 @@ private:
 	int p9_parse_options(const char *opts);
 
 	/* REQ FUNCTIONS */
+	u16 p9_tag_get();
+	void p9_tag_put(u16 tag);
 	struct p9_req_t *p9_alloc_req(u16 tag, unsigned int max_size);
 	struct p9_req_t *p9_lookup_req(u16 tag);
 	void p9_free_req(struct p9_req_t *r);
@@ -916,8 +932,18 @@ private:
 		const char *fmt, va_list ap);
 
 	/* RPC FUNCTION*/
+	struct p9_req_t *p9_client_request(int8_t type, int req_size,
+		struct uio *uidata, struct uio *uodata, int inlen, int outlen,
+		int in_hdrlen, const char *fmt, va_list ap);
 	struct p9_req_t *p9_client_rpc(int8_t type, 
 		const char *fmt, ...);
+	struct p9_req_t *p9_client_zc_rpc(int8_t type, struct uio *uidata,
+		struct uio *uodata, int inlen, int outlen, int in_hdrlen,
+		const char *fmt, ...);
+
+	/* DATA FUNCTIONS */
+	static int p9_client_read_once(struct p9_fid *fid, int8_t type,
+		struct uio *to, u64 offset, int rsize, int *err);
 
 	/* FID FUNCTIONS */
 	struct p9_fid *p9_fid_create();
@@ -951,9 +977,11 @@ private:
 	p9_idpool _fidpool;
 	std::list<struct p9_fid *> _fidlist;
 
-	p9_idpool _tagpool;
-	struct p9_req_t *_reqs[P9_ROW_MAXTAG];
-	int _max_tag;
+	mutex _tags_lock;
+	condvar _tags_cond;
+	u16 _free_tags[P9_MAXTAG];
+	int _nr_free_tags;
+	struct p9_req_t _reqs[P9_MAXTAG + 1];
 
 	char _name[__NEW_UTS_LEN + 1];
 
@@ -159,6 +159,12 @@ private:
  * The callback needs to consult try_fire() after it acquired the lock
  * but before it does its task, to check if it hasn't been cancelled
  * or rescheduled.
+ *
+ * Postponing a pending timer (the common case for TCP timers, which are
+ * pushed forward on every segment) does not touch the underlying
+ * timer_task. Only the new deadline is recorded; if the old timer then
+ * goes off before it, try_fire() re-arms it for the recorded deadline and
+ * rejects the callback.
  */
 class serial_timer_task {
 public:
@@ -175,6 +181,9 @@ public:
      * try_fire() will be rejected when they call try_fire(). If there
      * are multiple callbacks waiting to take the lock, only one of them
      * will be allowed to pass by try_lock().
+     *
+     * O(1) and free of cross-CPU traffic when the timer is pending and
+     * the new deadline is not earlier than the one it is armed for.
      */
     void reschedule(clock::duration delay);
 
@@ -216,8 +225,14 @@ public:
     bool try_fire();
 
 private:
+    bool fired_early();
+
     bool _active;
     int _n_scheduled;
+    // _armed_at is what _task is scheduled for, _deadline is when the
+    // callback is actually due; _armed_at <= _deadline while _active.
+    clock::time_point _armed_at;
+    clock::time_point _deadline;
     mutex& _lock;
     timer_task _task;
     waitqueue _all_done;
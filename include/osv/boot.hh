@@ -2,6 +2,7 @@
 #define BOOT_HH
 
 #include "arch-setup.hh"
+#include <atomic>
 
 class time_element {
 public:
@@ -9,11 +10,22 @@ public:
     u64 stamp;
 };
 
+class time_span {
+public:
+    char str[32];
+    u64 start;
+    u64 end;
+    unsigned cpu;
+};
+
 class boot_time_chart {
 public:
     void event(const char *str);
     void event(int event_idx, const char *str);
     void event(int event_idx, const char *str, u64 stamp);
+    // Records work done concurrently with the events, like probing one
+    // device, listed after them. Can be called from any thread.
+    void span(const char *str, u64 start, u64 end, unsigned cpu);
     void print_chart();
     void print_total_time();
 private:
@@ -24,6 +36,8 @@ private:
     // middle of the list, and we want to preserve order.
     int _event = 4;
     time_element arrays[16];
+    std::atomic<int> _span = { 0 };
+    time_span spans[32];
 
     void print_one_time(int index);
     double to_msec(u64 time);
@@ -22,6 +22,9 @@
 #include <boost/asio/ip/address.hpp>
 #include <boost/asio/ip/address_v4.hpp>
 
+// Without wait, dhcp_start() keeps sending discovers in the background,
+// and the lease releases the network ready latch (osv/net_ready.hh), while
+// dhcp_renew() sends one request and returns
 extern "C" {
 void dhcp_start(bool wait);
 void dhcp_release();
@@ -16,6 +16,7 @@
 #include <unordered_set>
 #include <osv/types.h>
 #include <atomic>
+#include <osv/rcu-hashtable.hh>
 
 #include "arch-elf.hh"
 
@@ -382,11 +383,17 @@ private:
     Elf64_Dyn& dynamic_tag(unsigned tag);
     Elf64_Dyn* _dynamic_tag(unsigned tag);
     symbol_module symbol(unsigned idx, bool ignore_missing = false);
+    symbol_module cached_symbol(unsigned idx, const char* name);
     symbol_module symbol_other(unsigned idx);
     Elf64_Xword symbol_tls_module(unsigned idx);
     void relocate_rela();
     void relocate_pltgot();
     unsigned symtab_len();
+    unsigned dynsym_count();
+    template <typename Func>
+    void for_each_exported_symbol(Func func);
+    u64 fingerprint();
+    bool load_reloc_cache();
     ulong get_tls_size();
     void collect_dependencies(std::unordered_set<elf::object*>& ds);
     void prepare_initial_tls(void* buffer, size_t size, std::vector<ptrdiff_t>& offsets);
@@ -415,6 +422,29 @@ protected:
     bool _is_executable;
     bool is_core();
 
+    // Symbol resolutions recorded at build time by scripts/gen-reloc-cache.py
+    // for the list of modules this object is relocated against, indexed by
+    // symbol. They are only used by relocate(), and only if the modules
+    // loaded then are the ones the cache was built for.
+    struct cached_resolution {
+        u32 module;
+        u32 sym;
+    };
+    std::vector<object*> _cached_modules;
+    std::vector<cached_resolution> _cached_resolutions;
+    // Hash of the dynamic symbol and string tables, by which the cache
+    // recognizes modules, and the number of dynamic symbols
+    u64 _fingerprint;
+    unsigned _nsyms;
+
+    struct addr_symbol {
+        void* addr;
+        Elf64_Sym* sym;
+    };
+    const std::vector<addr_symbol>& addr_index();
+    std::atomic<std::vector<addr_symbol>*> _addr_index;
+    mutex _addr_index_mutex;
+
     // Keep list of references to other modules, to prevent them from being
     // unloaded. When this object is unloaded, the reference count of all
     // objects listed here goes down, and they too may be unloaded.
@@ -444,6 +474,7 @@ private:
     bool visible(void) const;
 public:
     void setprivate(bool);
+    friend class program;
 };
 
 class file : public object {
@@ -591,6 +622,8 @@ private:
     void del_debugger_obj(object* obj);
     void* do_lookup_function(const char* symbol);
     void remove_object(object *obj);
+    void add_symbols(object* obj);
+    void remove_symbols(object* obj);
     ulong register_dtv(object* obj);
     void free_dtv(object* obj);
     std::shared_ptr<object> load_object(std::string name,
@@ -609,6 +642,22 @@ private:
     osv::rcu_ptr<modules_list> _modules_rcu;
     modules_list modules_get() const;
 
+    // Symbols exported by the objects on _modules, but the kernel, so that
+    // lookup() finds a symbol without searching each object in turn. The
+    // object loaded first (lowest rank) which defines a name interposes.
+    struct global_symbol {
+        const char* name;
+        uint_fast32_t hash;
+        u64 rank;
+        object* obj;
+        Elf64_Sym* sym;
+    };
+    struct global_symbol_hash {
+        size_t operator()(const global_symbol& s) const { return s.hash; }
+    };
+    osv::rcu_hashtable<global_symbol, global_symbol_hash> _symbols;
+    u64 _next_symbols_rank = 0;
+
     // If _module_delete_disable > 0, objects are not deleted but rather
     // collected for deletion when _modules_delete_disable becomes 0.
     mutex _modules_delete_mutex;
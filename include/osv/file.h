@@ -168,6 +168,7 @@ struct file {
 	virtual bool put_page(void *addr, uintptr_t offset, mmu::hw_ptep<0> ptep) { throw make_error(ENOSYS); }
 	virtual bool put_page(void *addr, uintptr_t offset, mmu::hw_ptep<1> ptep) { throw make_error(ENOSYS); }
 	virtual void sync(off_t start, off_t end) { throw make_error(ENOSYS); }
+	virtual int fadvise(off_t offset, off_t len, int advice) { return 0; }
 
 	int		f_flags;	/* open flags */
 	int		f_count;	/* reference count, see below */
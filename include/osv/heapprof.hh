@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef _OSV_HEAPPROF_HH
+#define _OSV_HEAPPROF_HH
+
+#include <string>
+#include <cstddef>
+
+// Sampling heap profiler. Unlike memory::alloc_tracker, which records
+// every allocation, it records the call stack of about one allocation per
+// config::sample_bytes bytes allocated, which is cheap enough to leave
+// running in production.
+//
+// malloc() only calls in here while heapprof::enabled is set, and free()
+// while heapprof::tracking is, which costs them a test of each otherwise.
+namespace heapprof {
+
+extern bool enabled;
+extern bool tracking;
+
+struct config {
+    // Mean number of bytes allocated between two samples. The intervals
+    // are randomized, so that allocations of every size get sampled in
+    // proportion to the bytes they allocate.
+    size_t sample_bytes = 512 * 1024;
+    // Most sampled allocations still in use which are remembered, and most
+    // distinct allocation call stacks. Samples beyond either are left out
+    // of the profile.
+    unsigned max_samples = 65536;
+    unsigned max_stacks = 8192;
+};
+
+// malloc() returned @addr, for a request of @size bytes
+void allocated(void* addr, size_t size);
+
+// free() is releasing @addr
+void released(void* addr);
+
+/**
+ * Starts sampling allocations, discarding the earlier profile.
+ *
+ * May block.
+ */
+void start(config);
+
+/**
+ * Stops sampling allocations. The profile remains available to
+ * get_profile(), and sampled allocations freed since are still taken out
+ * of its in-use counts.
+ *
+ * May block.
+ */
+void stop();
+
+/**
+ * Returns the profile in the legacy text format of gperftools' heap
+ * profiler, which pprof reads: for each call stack, the number and bytes
+ * of its sampled allocations still in use, then of all those made since
+ * the profiler started, followed by the address ranges of the loaded
+ * objects. pprof scales the sampled counts up by the sampling interval.
+ *
+ * May block.
+ */
+std::string get_profile();
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef _OSV_LOCKSTAT_HH
+#define _OSV_LOCKSTAT_HH
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Lock contention statistics for mutexes, rwlocks and spinlocks.
+//
+// The lock primitives only call in here while lockstat is enabled, which
+// costs them a test of lockstat::enabled otherwise.
+namespace lockstat {
+
+enum class lock_type : unsigned char {
+    mutex, rwlock, spinlock,
+};
+
+extern bool enabled;
+
+// Timestamp for the start of a wait, never 0
+uint64_t now();
+
+// The current thread acquired @lock, called at @site, after waiting for it
+// since @wait_start, or 0 if the lock was free.
+void acquired(const void* lock, lock_type type, const void* site, uint64_t wait_start);
+
+// The current thread released @lock
+void released(const void* lock);
+
+struct site_stats {
+    std::string site;
+    uint64_t contended;
+    uint64_t wait_ns;
+};
+
+// Locks are grouped by class: a lock which is a global variable, or in
+// one, is its own class; others, typically members of dynamically
+// allocated objects, are classed by where they were first acquired.
+struct class_stats {
+    std::string name;
+    lock_type type;
+    uint64_t locks;
+    uint64_t acquired;
+    uint64_t contended;
+    uint64_t wait_ns;
+    uint64_t max_wait_ns;
+    uint64_t hold_ns;
+    uint64_t max_hold_ns;
+    // Call sites which waited for locks of the class, most first
+    std::vector<site_stats> top_sites;
+};
+
+// Start collecting statistics, discarding earlier ones.
+void start();
+
+// Stop collecting statistics; they remain available to get_stats().
+void stop();
+
+// Statistics per lock class, longest total wait first, with up to
+// @max_sites call sites each. Locks and call sites beyond the capacity
+// of the statistics tables are left out, and counted by @dropped.
+std::vector<class_stats> get_stats(unsigned max_sites, uint64_t& dropped);
+
+const char* type_name(lock_type type);
+
+}
+
+#endif
@@ -108,6 +108,19 @@ struct page_range {
 };
 
 void free_initial_memory_range(void* addr, size_t size);
+
+// Boot hands the allocator only its first boot_online_memory bytes. The
+// rest is queued with defer_initial_memory_range(), and brought online in
+// chunks, each mapped with map first, by threads on all cpus started with
+// start_deferred_memory_init(), from when on stats count all of it as
+// free. Allocations which run out of memory before that is done bring
+// chunks online themselves, or wait for those on their way, rather than
+// wait for the reclaimer.
+constexpr size_t boot_online_memory = size_t(2) << 30;
+void defer_initial_memory_range(uintptr_t addr, size_t size,
+                                void (*map)(uintptr_t addr, size_t size));
+void start_deferred_memory_init();
+
 void enable_debug_allocator();
 
 extern bool tracker_enabled;
@@ -90,6 +90,8 @@ struct mount {
 #define	MNT_LOCAL	0x00001000	/* filesystem is stored locally */
 #define	MNT_QUOTA	0x00002000	/* quotas are enabled on filesystem */
 #define	MNT_ROOTFS	0x00004000	/* identifies the root filesystem */
+#define	MNT_PAGECACHE	0x00008000	/* file data cached in the page cache */
+#define	MNT_DIRECTMAP	0x00010000	/* shared mappings map the file's own pages */
 
 /*
  * Mask of flags that are visible to statfs()
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef OSV_NET_BUSY_POLL_HH
+#define OSV_NET_BUSY_POLL_HH
+
+#include <atomic>
+#include <functional>
+
+// Low-latency socket polling (SO_BUSY_POLL).
+//
+// Network drivers register a poller which processes whatever is pending on
+// their receive queues from the calling thread and returns true if it made
+// progress. A thread that is about to sleep waiting for network input may
+// instead spin for a short, bounded time calling the registered pollers,
+// avoiding the interrupt -> rx thread -> socket wakeup round trip.
+namespace osv {
+namespace busy_poll {
+
+// Default per-socket busy-read budget in microseconds, applied to newly
+// created sockets (Linux net.core.busy_read). Zero disables.
+extern std::atomic<unsigned> read_usecs;
+// Busy-poll budget in microseconds for epoll_wait() and friends
+// (Linux net.core.busy_poll). Zero disables.
+extern std::atomic<unsigned> poll_usecs;
+
+typedef unsigned poller_id;
+
+// Register the receive queue poller of the network interface with index
+// ifindex. The poller may be called concurrently from several threads and
+// must serialize itself against its own receive path (typically with a
+// try_lock, giving up if the queue is busy).
+poller_id register_poller(unsigned ifindex, std::function<bool ()> poll);
+void unregister_poller(poller_id id);
+
+// Poll the receive queues of interface ifindex, or of every interface if
+// ifindex is 0, until ready() returns true or usecs microseconds have
+// elapsed. Returns the final value of ready(), right away if there is no
+// queue to poll. Must be called without holding locks that the receive
+// path takes.
+bool spin(unsigned usecs, unsigned ifindex, std::function<bool ()> ready);
+
+}
+}
+
+#endif
@@ -53,6 +53,8 @@ public:
     }
     // consumer: consume all available packets using process_packet()
     void process_queue();
+    // consumer: check for pending packets without waiting
+    bool empty() const { return _queue.empty(); }
     // add/remove current thread from poller list
     void add_poller(pollreq& pr);
     void del_poller(pollreq& pr);
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef OSV_NET_READY_HH
+#define OSV_NET_READY_HH
+
+#include <sys/socket.h>
+#include <chrono>
+
+// The "network ready" latch.
+//
+// With --async-dhcp the application starts while DHCP is still looking for
+// a lease. Socket operations which need an address or a route, like
+// connecting or sending to a remote address, and DNS lookups, which need
+// the name servers DHCP hands out, wait on the latch until the first
+// interface is configured. Everything else, like listening on a port,
+// goes ahead right away. Without --async-dhcp the latch is released
+// before the application starts.
+namespace osv {
+namespace net_ready {
+
+// How long blocking operations wait for the network, before failing as if
+// there was no route
+constexpr std::chrono::seconds max_wait(30);
+
+// Releases the latch, once an interface has an address and routes
+void set();
+bool is_set();
+// Blocks until the latch is released, for at most timeout. Returns 0, or
+// ENETUNREACH if it is still not released, or EINTR if interrupted.
+int wait(std::chrono::nanoseconds timeout = max_wait);
+// For an operation on socket fd with flags, sending to or connecting to
+// addr, a sockaddr in the Linux layout: if it needs the network, that is
+// addr is any but a loopback, unspecified or non-IP address, waits as
+// wait() does. A non-blocking socket, or flags with MSG_DONTWAIT, fail
+// with ENETUNREACH right away instead.
+int wait_for(int fd, int flags, const void *addr, socklen_t len);
+
+}
+}
+
+#endif
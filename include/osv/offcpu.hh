@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef _OSV_OFFCPU_HH
+#define _OSV_OFFCPU_HH
+
+#include <string>
+
+namespace prof {
+
+struct offcpu_config {
+    // Most distinct call stacks recorded on each cpu. The blocked time of
+    // stacks seen once the table is full is only counted as dropped.
+    unsigned max_stacks = 1024;
+};
+
+/**
+ * Starts the off-CPU profiler, which records how long threads are blocked
+ * in sched::thread::wait() (on mutexes, condition variables, I/O, timers...)
+ * and the call stacks they block in.
+ *
+ * If the profiler is already running it is restarted, discarding what it
+ * recorded.
+ *
+ * May block.
+ */
+void start_offcpu_profiler(offcpu_config);
+
+/**
+ * Stops the off-CPU profiler. What it recorded remains available to
+ * offcpu_folded_stacks() until it is started again.
+ *
+ * May block.
+ */
+void stop_offcpu_profiler();
+
+/**
+ * Returns the blocked time recorded so far, in microseconds, per call
+ * stack in the "folded" format of flame graph tools: one line per stack,
+ * with its frames from the outermost down, separated by ';', then a space
+ * and the time.
+ *
+ * May block.
+ */
+std::string offcpu_folded_stacks();
+
+}
+
+#endif
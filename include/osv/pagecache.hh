@@ -10,6 +10,8 @@
 #include <osv/mmu.hh>
 
 struct arc_buf;
+struct vnode;
+struct mount;
 typedef arc_buf arc_buf_t;
 
 namespace pagecache {
@@ -35,4 +37,45 @@ bool release(vfs_file* fp, void *addr, off_t offset, mmu::hw_ptep<0> ptep);
 void sync(vfs_file* fp, off_t start, off_t end);
 void unmap_arc_buf(arc_buf_t* ab);
 void map_arc_buf(hashkey* key, arc_buf_t* ab, void* page);
+
+// Other filesystems can have the pages of their own cache mapped directly,
+// like ZFS does with ARC buffers: their VOP_CACHE calls map_shared_buf()
+// with the page holding the offset asked for. The page cache calls share()
+// when it maps the first page of a buffer and unshare() once none is
+// mapped any more; a shared buffer may only be freed after
+// unmap_shared_buf(). Both are called with the page cache lock held.
+class shared_buf {
+public:
+    virtual ~shared_buf() {}
+    virtual void share() = 0;
+    virtual void unshare() = 0;
+};
+void map_shared_buf(hashkey* key, shared_buf* buf, void* page);
+void unmap_shared_buf(shared_buf* buf);
+// Like unmap_shared_buf(), but gives up if that would block, for memory
+// reclaim: the page cache lock is held while allocating. Returns true
+// if the buffer was unmapped, and is no longer shared.
+bool try_unmap_shared_buf(shared_buf* buf);
+
+// Generic page cache for regular files on filesystems mounted with
+// MNT_PAGECACHE. read() and write() go through it instead of straight to
+// VOP_READ/VOP_WRITE, and mmap() faults map the same pages. Callers of
+// read(), write() and truncate() hold the vnode lock.
+bool enabled(struct vnode* vp);
+// Called by open(), with the vnode lock held: the next access checks
+// whether the file changed since its pages were cached
+void open(struct vnode* vp);
+int read(struct vnode* vp, struct file* fp, struct uio* uio, int ioflag);
+// Reads the range's missing pages into the cache, for read-ahead. Called
+// with the vnode lock held.
+void readahead(struct vnode* vp, struct file* fp, off_t offset, size_t len);
+int write(struct vnode* vp, struct uio* uio, int ioflag);
+void truncate(struct vnode* vp, off_t length);
+// Writes back and drops the cached pages of the filesystem's files, of
+// any filesystem, before it is unmounted
+void unmount(struct mount* mp);
+// Returns the first error writing back the file's pages since the last
+// call, of writebacks done in the background or on eviction, for fsync()
+// to report. Called with the vnode lock held.
+int take_writeback_error(struct vnode* vp);
 }
@@ -173,6 +173,81 @@ private:
 #endif
 } CACHELINE_ALIGNED;
 
+/**
+ * @class xmit_batch
+ *
+ * Marks a section in which the current thread transmits a batch of packets
+ * (e.g. a sendmmsg() call).
+ *
+ * While a batch is open, xmitter::xmit() doesn't notify the HW after every
+ * packet it manages to send in-place: the notification is deferred until the
+ * batch is closed, so that the HW is kicked once for the whole batch.
+ */
+class xmit_batch {
+public:
+    xmit_batch() : _prev(current()) {
+        current() = this;
+    }
+
+    ~xmit_batch() {
+        flush();
+        current() = _prev;
+    }
+
+    xmit_batch(const xmit_batch&) = delete;
+    xmit_batch& operator=(const xmit_batch&) = delete;
+
+    /**
+     * @return the batch opened by the current thread, or nullptr
+     */
+    static xmit_batch* active() { return current(); }
+
+    /**
+     * Register a kick to be issued when the batch is closed.
+     *
+     * @param owner the object to be kicked
+     * @param kick function issuing the kick on the owner
+     *
+     * @return false if the batch can't track any more owners, in which case
+     *         the caller should kick right away.
+     */
+    bool defer(void* owner, void (*kick)(void*)) {
+        for (unsigned i = 0; i < _nr_pending; i++) {
+            if (_pending[i].owner == owner) {
+                return true;
+            }
+        }
+        if (_nr_pending == max_pending) {
+            return false;
+        }
+        _pending[_nr_pending++] = { owner, kick };
+        return true;
+    }
+
+private:
+    void flush() {
+        for (unsigned i = 0; i < _nr_pending; i++) {
+            _pending[i].kick(_pending[i].owner);
+        }
+        _nr_pending = 0;
+    }
+
+    static xmit_batch*& current() {
+        static __thread xmit_batch* batch;
+        return batch;
+    }
+
+    struct pending_kick {
+        void* owner;
+        void (*kick)(void*);
+    };
+
+    static constexpr unsigned max_pending = 4;
+    pending_kick _pending[max_pending];
+    unsigned _nr_pending = 0;
+    xmit_batch* _prev;
+};
+
 /**
  * @class xmitter
  *
@@ -290,7 +365,14 @@ public:
 
         // Alright!!!
         if (!rc) {
-            _txq->kick_hw();
+            kick_or_defer();
+        } else {
+            //
+            // The HW ring may be full of packets sent in-place by an open
+            // xmit_batch that the HW hasn't been told about yet: nothing
+            // will free a slot on the ring until they are kicked.
+            //
+            flush_deferred_kick();
         }
 
         unlock_running();
@@ -319,6 +401,49 @@ public:
     }
 
 private:
+    /**
+     * Kick the HW after an in-place transmit, unless the current thread has
+     * an open xmit_batch, in which case the kick is issued when the batch is
+     * closed.
+     *
+     * Must be called with the RUNNING lock held.
+     */
+    void kick_or_defer() {
+        auto batch = xmit_batch::active();
+
+        if (batch && batch->defer(this, &xmitter::kick_deferred)) {
+            _kick_deferred = true;
+        } else {
+            _kick_deferred = false;
+            _txq->kick_hw();
+        }
+    }
+
+    static void kick_deferred(void* obj) {
+        auto x = static_cast<xmitter*>(obj);
+
+        x->lock_running();
+        x->flush_deferred_kick();
+        x->unlock_running();
+
+        if (x->has_pending()) {
+            x->wake_worker();
+        }
+    }
+
+    /**
+     * Kick the HW for the packets sent in-place while an xmit_batch was
+     * open, if it hasn't been kicked since.
+     *
+     * Must be called with the RUNNING lock held.
+     */
+    void flush_deferred_kick() {
+        if (_kick_deferred) {
+            _kick_deferred = false;
+            _txq->kick_hw();
+        }
+    }
+
     void wake_worker() {
         WITH_LOCK(migration_lock)
         {
@@ -356,6 +481,7 @@ private:
         // waiting for a new work.
         //
         lock_running();
+        flush_deferred_kick();
 
         _txq->stats.tx_worker_wakeups++;
 
@@ -395,6 +521,11 @@ private:
                     sched::thread::wait_until([this] { return has_pending(); });
 lock:
                     lock_running();
+                    //
+                    // Packets sent in-place by an open xmit_batch occupy
+                    // the HW ring: the worker may wait for it to drain.
+                    //
+                    flush_deferred_kick();
                     if (smp) {
                         start = osv::clock::uptime::now();
                         budget = qsize;
@@ -587,6 +718,12 @@ private:
     //
     std::atomic_flag                              _running    CACHELINE_ALIGNED
                                                            = ATOMIC_FLAG_INIT;
+    //
+    // Set when packets were put on the HW ring in-place but the HW wasn't
+    // notified yet because of an open xmit_batch. Protected by the RUNNING
+    // lock.
+    //
+    bool _kick_deferred = false;
 };
 
 /**
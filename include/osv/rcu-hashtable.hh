@@ -144,6 +144,26 @@ public:
         return reader_find(key, _hash, std::equal_to<T>());
     }
 
+    /// Executes a function on all items matching a given @key
+    ///
+    /// Like reader_find(), for tables holding several items matching
+    /// the same key.
+    ///
+    /// Must be run within an RCU read-side critical section.
+    template <typename Key, typename KeyHash, typename KeyValueCompare, typename Func>
+    void reader_for_each_match(const Key& key, KeyHash key_hash, KeyValueCompare kvc, Func func) {
+        auto& buckets = *_buckets.read();
+        auto hash = key_hash(key);
+        next_ptr* p = buckets[hash & (buckets.size() - 1)].next.read();
+        while (p) {
+            auto q = static_cast<element*>(p);
+            if (kvc(key, q->data)) {
+                func(q->data);
+            }
+            p = q->next.read();
+        }
+    }
+
     /// Find an item using a given @key.
     ///
     /// Looks for an item in the bucket given by @key_hash(@key), and matched element e
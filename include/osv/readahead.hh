@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef OSV_READAHEAD_HH
+#define OSV_READAHEAD_HH
+
+#include <atomic>
+#include <sys/types.h>
+
+// Sequential read-ahead.
+//
+// Each open file keeps a readahead_state which is told about every read().
+// Once reads look sequential it returns a range past the reader for the
+// filesystem to start reading asynchronously (VOP_READAHEAD). The window
+// starts at a few times the read size and doubles each time the reader has
+// consumed half of what was read ahead, up to max_bytes. A read elsewhere
+// in the file ends the stream.
+namespace osv {
+namespace readahead {
+
+// Largest read-ahead window in bytes (Linux read_ahead_kb). Zero disables
+// read-ahead.
+extern std::atomic<size_t> max_bytes;
+
+class state {
+public:
+    struct range {
+        off_t start;
+        size_t len;
+    };
+    // Called with the range of each read; returns what to read ahead, with
+    // len == 0 if nothing.
+    range on_read(off_t offset, size_t len);
+    // POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL or POSIX_FADV_RANDOM
+    void advise(int advice);
+private:
+    off_t _next = 0;     // where a sequential reader reads next
+    off_t _ra_end = 0;   // end of the range read ahead so far
+    size_t _window = 0;  // current window, 0 when not streaming
+    int _advice = 0;     // POSIX_FADV_NORMAL
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#ifndef OSV_ROFS_CACHE_HH
+#define OSV_ROFS_CACHE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Tunables and statistics of the ROFS segment cache (fs/rofs/rofs_cache.cc).
+// Cached segments are kept on an LRU list and evicted once the cache grows
+// past max_bytes, or when the memory reclaimer asks for memory.
+namespace osv {
+namespace rofs_cache {
+
+// Most memory the cache may hold, in bytes. Zero means no fixed limit, the
+// cache then only shrinks under memory pressure.
+extern std::atomic<size_t> max_bytes;
+
+struct stats {
+    uint64_t bytes;         // memory held by cached segments
+    uint64_t segments;      // number of cached segments
+    uint64_t reads;         // segment reads served by the cache
+    uint64_t hits;          // ... of which found the data in memory
+    uint64_t misses;        // ... of which had to read it from disk
+    uint64_t read_aheads;   // segments loaded ahead of the reader
+    uint64_t evictions;     // segments evicted
+};
+
+stats get_stats();
+
+}
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <regex>
+#include <functional>
+#include <cstdint>
 
 class tracepoint_base;
 
@@ -57,6 +59,33 @@ set_event_state(tracepoint_base &, bool enable, bool stacktrace = false);
 std::string
 create_trace_dump();
 
+// Receives the trace stream, in the trace dump format, piece by piece.
+// Returns false on failure, which ends the stream. It is finally called
+// with a null buffer, once the stream is stopped.
+typedef std::function<bool (const char *, size_t)> stream_sink_func;
+
+// Start streaming the trace buffers as their pages fill up, rather
+// than dumping them once. Pages overwritten before they are streamed are
+// lost, and counted as such, since tracepoints never wait for the stream.
+void
+start_trace_stream(stream_sink_func);
+
+// Stream to a file, or a device such as a serial port
+void
+start_trace_stream(const std::string & path);
+
+// Stream what is left in the trace buffers and end the stream.
+void
+stop_trace_stream();
+
+struct stream_stats {
+    uint64_t written_pages;
+    uint64_t lost_pages;
+};
+
+stream_stats
+get_trace_stream_stats();
+
 struct symbol {
     std::string name;
     const void * addr;
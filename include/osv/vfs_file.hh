@@ -9,6 +9,7 @@
 #define VFS_FILE_HH_
 
 #include <osv/file.h>
+#include <osv/readahead.hh>
 
 class vfs_file final : public file {
 public:
@@ -25,8 +26,11 @@ public:
     virtual bool map_page(uintptr_t offset, mmu::hw_ptep<0> ptep, mmu::pt_element<0> pte, bool write, bool shared);
     virtual bool put_page(void *addr, uintptr_t offset, mmu::hw_ptep<0> ptep);
     virtual void sync(off_t start, off_t end);
+    virtual int fadvise(off_t offset, off_t len, int advice) override;
 
     int get_arcbuf(void *key, off_t offset);
+private:
+    osv::readahead::state _readahead; // protected by the vnode lock
 };
 
 #endif /* VFS_FILE_HH_ */
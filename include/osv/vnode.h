@@ -79,6 +79,7 @@ struct vnode {
 	mutex_t		v_lock;		/* lock for this vnode */
 	LIST_HEAD(, dentry) v_names;	/* directory entries pointing at this */
 	int		v_nrlocks;	/* lock count (for debug) */
+	int		v_wberror;	/* error of a background writeback */
 	void		*v_data;	/* private data for fs */
 };
 
@@ -86,6 +87,7 @@ struct vnode {
 #define VROOT		0x0001		/* root of its file system */
 #define VISTTY		0x0002		/* device is tty */
 #define VPROTDEV	0x0004		/* protected device */
+#define VPAGECACHE	0x0008		/* cached pages validated */
 
 /*
  * Vnode attribute
@@ -149,6 +151,7 @@ typedef int (*vnop_cache_t) (struct vnode *, struct file *, struct uio *);
 typedef int (*vnop_fallocate_t) (struct vnode *, int, loff_t, loff_t);
 typedef int (*vnop_readlink_t)  (struct vnode *, struct uio *);
 typedef int (*vnop_symlink_t)   (struct vnode *, char *, char *);
+typedef int (*vnop_readahead_t) (struct vnode *, off_t, size_t);
 
 /*
  * vnode operations
@@ -177,6 +180,7 @@ struct vnops {
 	vnop_fallocate_t	vop_fallocate;
 	vnop_readlink_t		vop_readlink;
 	vnop_symlink_t		vop_symlink;
+	vnop_readahead_t	vop_readahead;
 };
 
 /*
@@ -206,6 +210,7 @@ struct vnops {
 #define VOP_FALLOCATE(VP, M, OFF, LEN) ((VP)->v_op->vop_fallocate)(VP, M, OFF, LEN)
 #define VOP_READLINK(VP, U)        ((VP)->v_op->vop_readlink)(VP, U)
 #define VOP_SYMLINK(DVP, OP, NP)   ((DVP)->v_op->vop_symlink)(DVP, OP, NP)
+#define VOP_READAHEAD(VP, OFF, LEN) ((VP)->v_op->vop_readahead)(VP, OFF, LEN)
 
 int	 vop_nullop(void);
 int	 vop_einval(void);
@@ -213,6 +218,7 @@ int	 vop_eperm(void);
 int	 vop_erofs(void);
 struct vnode *vn_lookup(struct mount *, uint64_t);
 void	 vn_lock(struct vnode *);
+int	 vn_trylock(struct vnode *);
 void	 vn_unlock(struct vnode *);
 int	 vn_stat(struct vnode *, struct stat *);
 int	 vn_settimes(struct vnode *, struct timespec[2]);
@@ -12,6 +12,7 @@
 #include <unistd.h>
 #include <pthread.h>
 #include "__dns.hh"
+#include <osv/net_ready.hh>
 #include <stdio.h>
 
 #define TIMEOUT 5
@@ -106,6 +107,9 @@ int __dns_doqueries(unsigned char *dest, const char *name, int *rr, int rrcnt)
 	id = (ts.tv_nsec + ts.tv_nsec/65536UL) & 0xffff;
 
 	/* Get nameservers from OSv first, fallback to resolv.conf */
+	/* DHCP may still be on its way to hand them out; if it does not
+	 * in time, the queries time out as with no network */
+	osv::net_ready::wait(std::chrono::seconds(TIMEOUT));
 	nns = 0;
 	vector<address> servers = osv::get_nameservers();
 	for (auto it = servers.begin(); nns < 3 && it != servers.end(); ++it) {
@@ -415,6 +415,8 @@ long syscall(long number, ...)
     SYSCALL3(sendmsg, int, const struct msghdr *, int);
     SYSCALL6(recvfrom, int, void *, size_t, int, struct sockaddr *, socklen_t *);
     SYSCALL3(recvmsg, int, struct msghdr *, int);
+    SYSCALL4(sendmmsg, int, struct mmsghdr *, unsigned int, unsigned int);
+    SYSCALL5(recvmmsg, int, struct mmsghdr *, unsigned int, unsigned int, struct timespec *);
     SYSCALL3(dup3, int, int, int);
     SYSCALL2(flock, int, int);
     SYSCALL4(pwrite64, int, const void *, size_t, off_t);
@@ -29,6 +29,7 @@
 #include "arch.hh"
 #include "arch-setup.hh"
 #include "osv/trace.hh"
+#include "osv/tracecontrol.hh"
 #include <osv/power.hh>
 #include <osv/rcu.hh>
 #include <osv/mempool.hh>
@@ -45,6 +46,10 @@
 #include <osv/app.hh>
 #include <osv/firmware.hh>
 #include <osv/xen.hh>
+#include <osv/net_busy_poll.hh>
+#include <osv/net_ready.hh>
+#include <osv/readahead.hh>
+#include <osv/rofs_cache.hh>
 #include <dirent.h>
 #include <iostream>
 #include <fstream>
@@ -141,6 +146,8 @@ static std::vector<std::string> opt_ip;
 static std::string opt_defaultgw;
 static std::string opt_nameserver;
 static std::string opt_redirect;
+static std::string opt_trace_stream;
+static bool opt_async_dhcp = false;
 static std::chrono::nanoseconds boot_delay;
 bool opt_maxnic = false;
 int maxnic;
@@ -163,6 +170,7 @@ void parse_options(int loader_argc, char** loader_argv)
         ("sampler", bpo::value<int>(), "start stack sampling profiler")
         ("trace", bpo::value<std::vector<std::string>>(), "tracepoints to enable")
         ("trace-backtrace", "log backtraces in the tracepoint log")
+        ("trace-stream", bpo::value<std::string>(), "stream the tracepoint log to a file or device as it fills up")
         ("leak", "start leak detector after boot")
         ("nomount", "don't mount the ZFS file system")
         ("nopivot", "do not pivot the root from bootfs to the ZFS")
@@ -180,10 +188,17 @@ void parse_options(int loader_argc, char** loader_argv)
         ("ip", bpo::value<std::vector<std::string>>(), "set static IP on NIC")
         ("defaultgw", bpo::value<std::string>(), "set default gateway address")
         ("nameserver", bpo::value<std::string>(), "set nameserver address")
+        ("async-dhcp", "start the application while DHCP looks for a lease in the background")
         ("delay", bpo::value<float>()->default_value(0), "delay in seconds before boot")
         ("redirect", bpo::value<std::string>(), "redirect stdout and stderr to file")
         ("disable_rofs_cache", "disable ROFS memory cache")
+        ("rofs-cache-max", bpo::value<size_t>(), "most memory the ROFS cache may hold in bytes, 0 for no fixed limit")
+        ("readahead-max", bpo::value<size_t>(), "largest sequential read-ahead window in bytes, 0 disables read-ahead")
         ("nopci", "disable PCI enumeration")
+        ("busy-read", bpo::value<unsigned>(), "default SO_BUSY_POLL budget for new sockets, in microseconds")
+        ("busy-poll", bpo::value<unsigned>(), "busy poll budget for epoll_wait(), in microseconds")
+        ("tcp-syncookies", bpo::value<int>(), "SYN cookies: 0 off, 1 on syncache overflow, 2 always")
+        ("tcp-fastopen", bpo::value<int>(), "TCP Fast Open: bit 1 enables the client side, bit 2 the server side")
     ;
     bpo::variables_map vars;
     // don't allow --foo bar (require --foo=bar) so we can find the first non-option
@@ -210,6 +225,30 @@ void parse_options(int loader_argc, char** loader_argv)
         opt_disable_rofs_cache = true;
     }
 
+    if (vars.count("rofs-cache-max")) {
+        osv::rofs_cache::max_bytes = vars["rofs-cache-max"].as<size_t>();
+    }
+
+    if (vars.count("readahead-max")) {
+        osv::readahead::max_bytes = vars["readahead-max"].as<size_t>();
+    }
+
+    if (vars.count("busy-read")) {
+        osv::busy_poll::read_usecs = vars["busy-read"].as<unsigned>();
+    }
+
+    if (vars.count("busy-poll")) {
+        osv::busy_poll::poll_usecs = vars["busy-poll"].as<unsigned>();
+    }
+
+    if (vars.count("tcp-syncookies")) {
+        osv::set_tcp_syncookies(vars["tcp-syncookies"].as<int>());
+    }
+
+    if (vars.count("tcp-fastopen")) {
+        osv::set_tcp_fastopen(vars["tcp-fastopen"].as<int>());
+    }
+
     if (vars.count("noshutdown")) {
         opt_noshutdown = true;
     }
@@ -296,6 +335,14 @@ void parse_options(int loader_argc, char** loader_argv)
         opt_redirect = vars["redirect"].as<std::string>();
     }
 
+    if (vars.count("trace-stream")) {
+        opt_trace_stream = vars["trace-stream"].as<std::string>();
+    }
+
+    if (vars.count("async-dhcp")) {
+        opt_async_dhcp = true;
+    }
+
     boot_delay = std::chrono::duration_cast<std::chrono::nanoseconds>(1_s * vars["delay"].as<float>());
 
     if (vars.count("nopci")) {
@@ -367,6 +414,14 @@ void* do_main_thread(void *_main_args)
         }
     }
 
+    if (!opt_trace_stream.empty()) {
+        try {
+            trace::start_trace_stream(opt_trace_stream);
+        } catch (std::exception& e) {
+            printf("trace stream to %s not started: %s\n", opt_trace_stream.c_str(), e.what());
+        }
+    }
+
     bool has_if = false;
     osv::for_each_if([&has_if] (std::string if_name) {
         if (if_name == "lo0")
@@ -380,7 +435,7 @@ void* do_main_thread(void *_main_args)
     });
     if (has_if) {
         if (opt_ip.size() == 0) {
-            dhcp_start(true);
+            dhcp_start(!opt_async_dhcp);
         } else {
             for (auto t : opt_ip) {
                 std::vector<std::string> tmp;
@@ -405,17 +460,23 @@ void* do_main_thread(void *_main_args)
         }
     }
 
-    std::string if_ip;
-    auto nr_ips = 0;
+    // With DHCP still in the background, the latch is released by the
+    // lease, and there is no address for OSV_IP yet
+    if (!has_if || !opt_ip.empty() || !opt_async_dhcp) {
+        osv::net_ready::set();
 
-    osv::for_each_if([&](std::string if_name) {
-        if (if_name == "lo0")
-            return;
-        if_ip = osv::if_ip(if_name);
-        nr_ips++;
-    });
-    if (nr_ips == 1) {
-       setenv("OSV_IP", if_ip.c_str(), 1);
+        std::string if_ip;
+        auto nr_ips = 0;
+
+        osv::for_each_if([&](std::string if_name) {
+            if (if_name == "lo0")
+                return;
+            if_ip = osv::if_ip(if_name);
+            nr_ips++;
+        });
+        if (nr_ips == 1) {
+           setenv("OSV_IP", if_ip.c_str(), 1);
+        }
     }
 
     if (!opt_chdir.empty()) {
@@ -576,6 +637,7 @@ void main_cont(int loader_argc, char** loader_argv)
         enable_backtraces();
     }
     sched::init_detached_threads_reaper();
+    memory::start_deferred_memory_init();
 
     bsd_init();
 
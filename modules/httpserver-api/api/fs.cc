@@ -7,6 +7,7 @@
 
 #include "fs.hh"
 #include "osv/mount.h"
+#include "osv/rofs_cache.hh"
 #include "json/formatter.hh"
 #include "autogen/fs.json.hh"
 #include <string>
@@ -85,6 +86,21 @@ void init(routes& routes) {
             return res;
         });
 
+    getRofsCacheStats.set_handler([](const_req req)
+        {
+            auto stats = osv::rofs_cache::get_stats();
+            httpserver::json::RofsCacheStats res;
+            res.bytes = stats.bytes;
+            res.max_bytes = osv::rofs_cache::max_bytes.load();
+            res.segments = stats.segments;
+            res.reads = stats.reads;
+            res.hits = stats.hits;
+            res.misses = stats.misses;
+            res.read_aheads = stats.read_aheads;
+            res.evictions = stats.evictions;
+            return res;
+        });
+
 }
 
 }
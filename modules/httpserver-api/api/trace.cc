@@ -17,6 +17,9 @@
 #include <sys/stat.h>
 #include <osv/tracecontrol.hh>
 #include <osv/sampler.hh>
+#include <osv/offcpu.hh>
+#include <osv/lockstat.hh>
+#include <osv/heapprof.hh>
 #include <osv/trace-count.hh>
 
 using namespace httpserver::json;
@@ -99,6 +102,93 @@ void httpserver::api::trace::init(routes & routes)
         return "Sampler started successfully";
     });
 
+    trace_json::setOffcpuProfilerState.set_handler([](const_req req) {
+        if (!str2bool(req.get_query_param("enabled"))) {
+            prof::stop_offcpu_profiler();
+            return "Off-CPU profiler stopped successfully";
+        }
+
+        prof::offcpu_config config;
+        const auto max_stacks = req.get_query_param("max_stacks");
+        if (!max_stacks.empty()) {
+            config.max_stacks = std::stoi(max_stacks);
+        }
+        prof::start_offcpu_profiler(config);
+        return "Off-CPU profiler started successfully";
+    });
+
+    trace_json::getOffcpuProfile.set_handler(new function_handler(
+            [](const_req req) {
+                return prof::offcpu_folded_stacks();
+            }, "txt"));
+
+    trace_json::setLockstatState.set_handler([](const_req req) {
+        if (!str2bool(req.get_query_param("enabled"))) {
+            lockstat::stop();
+            return "Lock statistics stopped successfully";
+        }
+        lockstat::start();
+        return "Lock statistics started successfully";
+    });
+
+    trace_json::getLockstat.set_handler([](const_req req) {
+        const auto sites = req.get_query_param("sites");
+        const unsigned max_sites = sites.empty() ? 5 : std::stoi(sites);
+        uint64_t dropped;
+        httpserver::json::LockStats ret;
+        for (auto & c : lockstat::get_stats(max_sites, dropped)) {
+            LockClass lc;
+            lc.name = c.name;
+            lc.type = lockstat::type_name(c.type);
+            lc.locks = c.locks;
+            lc.acquired = c.acquired;
+            lc.contended = c.contended;
+            lc.wait_ns = c.wait_ns;
+            lc.max_wait_ns = c.max_wait_ns;
+            lc.hold_ns = c.hold_ns;
+            lc.max_hold_ns = c.max_hold_ns;
+            for (auto & s : c.top_sites) {
+                LockSite ls;
+                ls.site = s.site;
+                ls.contended = s.contended;
+                ls.wait_ns = s.wait_ns;
+                lc.top_sites.push(ls);
+            }
+            ret.list.push(lc);
+        }
+        ret.enabled = lockstat::enabled;
+        ret.dropped = dropped;
+        return ret;
+    });
+
+    trace_json::setHeapProfilerState.set_handler([](const_req req) {
+        if (!str2bool(req.get_query_param("enabled"))) {
+            heapprof::stop();
+            return "Heap profiler stopped successfully";
+        }
+
+        heapprof::config config;
+        const auto sample_bytes = req.get_query_param("sample_bytes");
+        if (!sample_bytes.empty()) {
+            config.sample_bytes = std::stoul(sample_bytes);
+        }
+        const auto max_samples = req.get_query_param("max_samples");
+        if (!max_samples.empty()) {
+            config.max_samples = std::stoi(max_samples);
+        }
+        const auto max_stacks = req.get_query_param("max_stacks");
+        if (!max_stacks.empty()) {
+            config.max_stacks = std::stoi(max_stacks);
+        }
+        heapprof::start(config);
+        return "Heap profiler started successfully";
+    });
+
+    trace_json::getHeapProfile.set_handler(new function_handler(
+            [](const_req req) {
+                return heapprof::get_profile();
+            }, "txt"));
+
     class create_trace_dump_file {
     public:
         create_trace_dump_file()
@@ -13,6 +13,13 @@ class testfs(basetest.Basetest):
         self.assertGreaterEqual(val["btotal"], 20000000)
         self.assertEqual(val["filesystem"], "/dev/vblk0.1")
 
+    def test_rofs_cache(self):
+        val = self.curl("/fs/rofs/cache")
+        for key in ["segments", "reads", "hits", "misses", "read_aheads", "evictions"]:
+            self.assertGreaterEqual(val[key], 0)
+        if val["max_bytes"] > 0:
+            self.assertLessEqual(val["bytes"], val["max_bytes"])
+
     @classmethod
     def setUpClass(cls):
         cls.fs_api = cls.get_json_api("fs.json")
@@ -43,6 +43,7 @@
 #include <sys/time.h>
 #include <osv/mmu.hh>
 #include "libc/libc.hh"
+#include "fs/fs.hh"
 #include <api/sys/times.h>
 #include <map>
 #include <boost/range/adaptor/reversed.hpp>
@@ -248,10 +249,18 @@ int posix_fadvise(int fd, off_t offset, off_t len, int advice)
     case POSIX_FADV_NOREUSE:
     case POSIX_FADV_WILLNEED:
     case POSIX_FADV_DONTNEED:
-        return 0;
+        break;
     default:
         return EINVAL;
     }
+    if (len < 0) {
+        return EINVAL;
+    }
+    fileref f(fileref_from_fd(fd));
+    if (!f) {
+        return EBADF;
+    }
+    return f->fadvise(offset, len, advice);
 }
 LFS64(posix_fadvise);
 
@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+
+#
+# Compares boot time, and time spent reading from disk, of ROFS images,
+# typically the same application built with and without compression:
+#
+#   ./scripts/build fs=rofs image=... && cp build/release/usr.img plain.img
+#   ./scripts/build fs=rofs rofs_compress=lz4 image=... && cp build/release/usr.img lz4.img
+#   ./scripts/benchs/rofs_boot.py -i plain.img -i lz4.img -e "/app"
+#
+
+import subprocess
+import sys
+import re
+import os
+import argparse
+import time
+from math import sqrt
+
+class stats(object):
+    def __init__(self):
+        self.samples = []
+
+    def add(self, value):
+        self.samples.append(value)
+
+    def summary(self):
+        n = len(self.samples)
+        avg = sum(self.samples) / n
+        stdev = sqrt(sum((x - avg) ** 2 for x in self.samples) / n)
+        return "%.1f\t%.1f\t%.1f\t%.1f" % (min(self.samples), max(self.samples), avg, stdev)
+
+def run_once(image, command):
+    start = time.time()
+    osv = subprocess.Popen('./scripts/run.py -i %s -e "--bootchart %s"' % (image, command),
+                           shell = True, stdout=subprocess.PIPE)
+    boot_time = None
+    mount_time = None
+    disk_time = None
+    for line in osv.stdout:
+        if 'Booted up in' in line:
+            boot_time = float(re.findall("\d+.\d+", line)[0])
+        elif 'ROFS mounted' in line:
+            mount_time = float(re.findall("\d+.\d+", line)[1])
+        elif 'ROFS: spent' in line:
+            disk_time = float(re.findall("\d+.\d+", line)[0])
+    osv.wait()
+    total_time = (time.time() - start) * 1000
+
+    if boot_time is None or mount_time is None:
+        print "error: %s did not boot from ROFS with --bootchart!" % image
+        sys.exit(1)
+    return (mount_time, boot_time, total_time, disk_time)
+
+def run_rofs_boot_bench(images, command, total_samples):
+    print "image\tmetric\tmin\tmax\tavg\tstdev"
+    print "-----\t------\t---\t---\t---\t-----"
+    for image in images:
+        mount, boot, total, disk = stats(), stats(), stats(), stats()
+        for sample in range(total_samples):
+            mount_time, boot_time, total_time, disk_time = run_once(image, command)
+            mount.add(mount_time)
+            boot.add(boot_time)
+            total.add(total_time)
+            if disk_time is not None:
+                disk.add(disk_time)
+
+        name = os.path.basename(image)
+        print "%s\tmount\t%s" % (name, mount.summary())
+        print "%s\tboot\t%s" % (name, boot.summary())
+        print "%s\ttotal\t%s" % (name, total.summary())
+        if disk.samples:
+            print "%s\tdisk\t%s" % (name, disk.summary())
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(prog='rofs_boot')
+    parser.add_argument("-i", "--image", action="append", required=True,
+                        help="ROFS image to measure, may be given more than once")
+    parser.add_argument("-e", "--execute", action="store", required=True,
+                        help="command to run once booted")
+    parser.add_argument("-s", "--samples", action="store", default="5",
+                        help="specify number of samples")
+    if not os.path.exists("./arch/x64"):
+        print "Please, run this script from the OSv root directory"
+    cmdargs = parser.parse_args()
+    print "Running ROFS boot time benchmark, total samples: %s" % cmdargs.samples
+    print "unit of time: millisecond (ms); total is the whole run including the host side"
+    run_rofs_boot_bench(cmdargs.image, cmdargs.execute, int(cmdargs.samples))
@@ -0,0 +1,386 @@
+#!/usr/bin/python
+
+#
+# Copyright (C) 2026 Cloudius Systems, Ltd.
+#
+# This work is open source software, licensed under the terms of the
+# BSD license as described in the LICENSE file in the top-level directory.
+#
+
+#
+# Records, for the shared objects an image runs, how the symbols referenced
+# by their relocations resolve, so that the dynamic linker (core/elf.cc) does
+# not have to look each of them up in every loaded module when the image
+# boots.
+#
+# The loading of each program given (by default, those on the command line
+# of the image) is replayed the way elf::program::load_object() does it:
+# every object is relocated against the modules loaded at that point, in
+# search order, the kernel being last. For each object, the resolutions are
+# written to <object>.relcache, along with fingerprints of the dynamic
+# symbol tables of those modules, which is how the dynamic linker checks
+# that it relocates the object against the very same modules. If it does
+# not, the cache is ignored; objects loaded in more than one way get a
+# context for each. The cache files are added to the manifest.
+#
+
+import os, optparse, struct, sys
+from manifest_common import add_var, expand, unsymlink, read_manifest, defines
+
+DT_NULL, DT_NEEDED, DT_PLTRELSZ, DT_HASH, DT_STRTAB, DT_SYMTAB, DT_RELA, \
+    DT_RELASZ, DT_STRSZ = 0, 1, 2, 4, 5, 6, 7, 8, 10
+DT_SONAME, DT_RPATH, DT_JMPREL = 14, 15, 23
+DT_GNU_HASH = 0x6ffffef5
+PT_LOAD, PT_DYNAMIC = 1, 2
+SHN_UNDEF = 0
+
+RELOC_CACHE_MAGIC = b'OSVRELC\0'
+RELOC_CACHE_VERSION = 1
+UNRESOLVED = 0xffffffff
+
+# Libraries whose features the kernel supplies (see elf::program::program())
+kernel_supplied = {
+    'x64': ['ld-linux-x86-64.so.2', 'libboost_system.so.1.55.0',
+            'libboost_program_options.so.1.55.0'],
+    'aarch64': ['ld-linux-aarch64.so.1', 'libboost_system-mt.so.1.55.0',
+                'libboost_program_options-mt.so.1.55.0'],
+}
+kernel_supplied_common = ['libresolv.so.2', 'libc.so.6', 'libm.so.6',
+                          'libpthread.so.0', 'libdl.so.2', 'librt.so.1',
+                          'libstdc++.so.6', 'libaio.so.1', 'libxenstore.so.3.0',
+                          'libcrypt.so.1']
+
+search_path = ['/', '/usr/lib']
+
+def fnv1a(h, data):
+    for c in bytearray(data):
+        h = ((h ^ c) * 1099511628211) & 0xffffffffffffffff
+    return h
+
+def dl_new_hash(name):
+    h = 5381
+    for c in bytearray(name):
+        h = (h * 33 + c) & 0xffffffff
+    return h
+
+def elf64_hash(name):
+    h = 0
+    for c in bytearray(name):
+        h = ((h << 4) + c) & 0xffffffff
+        g = h & 0xf0000000
+        if g:
+            h ^= g >> 24
+        h &= 0x0fffffff
+    return h
+
+class ElfObject(object):
+    def __init__(self, path, hostpath):
+        self.path = path
+        with open(hostpath, 'rb') as f:
+            self.data = f.read()
+        d = self.data
+        if d[:4] != b'\x7fELF' or bytearray(d)[4] != 2:
+            raise ValueError('not a 64-bit ELF file')
+        (e_phoff,) = struct.unpack_from('<Q', d, 32)
+        e_phentsize, e_phnum = struct.unpack_from('<HH', d, 54)
+        self.loads = []
+        dynamic = None
+        for i in range(e_phnum):
+            p_type, _, p_offset, p_vaddr, _, p_filesz = \
+                struct.unpack_from('<IIQQQQ', d, e_phoff + i * e_phentsize)
+            if p_type == PT_LOAD:
+                self.loads.append((p_vaddr, p_offset, p_filesz))
+            elif p_type == PT_DYNAMIC:
+                dynamic = p_offset
+        if dynamic is None:
+            raise ValueError('no dynamic section')
+        self.dyn = {}
+        self.needed = []
+        off = dynamic
+        while True:
+            tag, val = struct.unpack_from('<qQ', d, off)
+            off += 16
+            if tag == DT_NULL:
+                break
+            if tag == DT_NEEDED:
+                self.needed.append(val)
+            else:
+                self.dyn.setdefault(tag, val)
+        self.strtab = self.offset(self.dyn[DT_STRTAB])
+        self.symtab = self.offset(self.dyn[DT_SYMTAB])
+        self.needed = [self.string(n) for n in self.needed]
+        self.soname = self.string(self.dyn[DT_SONAME]) if DT_SONAME in self.dyn else None
+        self.rpath = self.string(self.dyn[DT_RPATH]) if DT_RPATH in self.dyn else None
+        self.nsyms = self.count_symbols()
+        self._fingerprint = None
+
+    def offset(self, vaddr):
+        for start, offset, size in self.loads:
+            if start <= vaddr < start + size:
+                return vaddr - start + offset
+        raise ValueError('address %x not in file' % vaddr)
+
+    def string(self, idx):
+        start = self.strtab + idx
+        return self.data[start:self.data.index(b'\0', start)]
+
+    def sym(self, idx):
+        # (st_name, st_info, st_shndx)
+        return struct.unpack_from('<IBxH', self.data, self.symtab + idx * 24)
+
+    def words(self, vaddr, n):
+        return struct.unpack_from('<%dI' % n, self.data, self.offset(vaddr))
+
+    # Same as object::symtab_len() plus, for DT_GNU_HASH, the symbols
+    # before symndx, which it does not count
+    def count_symbols(self):
+        if DT_HASH in self.dyn:
+            return self.words(self.dyn[DT_HASH], 2)[1]
+        ht = self.dyn[DT_GNU_HASH]
+        nbucket, symndx, maskwords = self.words(ht, 3)
+        buckets = ht + 16 + maskwords * 8
+        chains = buckets + nbucket * 4
+        n = symndx
+        for idx in self.words(buckets, nbucket):
+            if idx == 0:
+                continue
+            while True:
+                (c,) = self.words(chains + (idx - symndx) * 4, 1)
+                n += 1
+                idx += 1
+                if c & 1:
+                    break
+        return n
+
+    # Same as object::fingerprint()
+    def fingerprint(self):
+        if self._fingerprint is None:
+            h = 14695981039346656037
+            for i in range(self.nsyms):
+                name, info, shndx = self.sym(i)
+                h = fnv1a(h, struct.pack('<IBB', name, info, shndx != SHN_UNDEF))
+            if DT_STRSZ in self.dyn:
+                h = fnv1a(h, self.data[self.strtab:self.strtab + self.dyn[DT_STRSZ]])
+            self._fingerprint = h or 1
+        return self._fingerprint
+
+    # Same as object::lookup_symbol(), walking the hash table the same way
+    def lookup(self, name):
+        if DT_GNU_HASH in self.dyn:
+            ht = self.dyn[DT_GNU_HASH]
+            nbucket, symndx, maskwords = self.words(ht, 3)
+            buckets = ht + 16 + maskwords * 8
+            chains = buckets + nbucket * 4
+            h = dl_new_hash(name)
+            (idx,) = self.words(buckets + (h % nbucket) * 4, 1)
+            if idx == 0:
+                return None
+            while True:
+                (c,) = self.words(chains + (idx - symndx) * 4, 1)
+                if (c & ~1) == (h & ~1) and self.string(self.sym(idx)[0]) == name:
+                    return idx if self.sym(idx)[2] != SHN_UNDEF else None
+                if c & 1:
+                    return None
+                idx += 1
+        ht = self.dyn[DT_HASH]
+        nbucket, nchain = self.words(ht, 2)
+        (idx,) = self.words(ht + 8 + (elf64_hash(name) % nbucket) * 4, 1)
+        while idx != 0:
+            if self.string(self.sym(idx)[0]) == name:
+                return idx if self.sym(idx)[2] != SHN_UNDEF else None
+            (idx,) = self.words(ht + 8 + (nbucket + idx) * 4, 1)
+        return None
+
+    # Symbols referenced by the DT_RELA and DT_JMPREL relocations
+    def referenced_symbols(self):
+        syms = set()
+        for table, size in ((DT_RELA, DT_RELASZ), (DT_JMPREL, DT_PLTRELSZ)):
+            if table not in self.dyn:
+                continue
+            start = self.offset(self.dyn[table])
+            for off in range(start, start + self.dyn[size], 24):
+                (info,) = struct.unpack_from('<Q', self.data, off + 8)
+                if info >> 32:
+                    syms.add(info >> 32)
+        return syms
+
+class Loader(object):
+    def __init__(self, files, kernel, arch):
+        self.files = files
+        self.kernel = kernel
+        self.loaded = {}
+        for name in kernel_supplied_common + kernel_supplied[arch]:
+            self.loaded[name] = kernel
+        self.modules = [kernel]
+        self.objects = {}
+        self.contexts = {}
+
+    def resolve(self, path):
+        path = os.path.normpath(path)
+        for _ in range(16):
+            hostpath = self.files.get(path)
+            if hostpath is None or not hostpath.startswith('->'):
+                return path
+            link = hostpath[2:]
+            if not link.startswith('/'):
+                link = os.path.join(os.path.dirname(path), link)
+            path = os.path.normpath(link)
+        return path
+
+    def get_object(self, path):
+        if path not in self.objects:
+            try:
+                self.objects[path] = ElfObject(path, self.files[path])
+            except (ValueError, KeyError, IOError, struct.error) as e:
+                print('%s: not caching relocations, %s' % (path, e))
+                self.objects[path] = None
+        return self.objects[path]
+
+    # Replays elf::program::load_object()
+    def load(self, name, extra_path=[]):
+        if name in self.loaded:
+            return self.loaded[name]
+        if '/' not in name:
+            for d in extra_path + search_path:
+                path = self.resolve(d + '/' + name)
+                if path in self.files:
+                    name = path
+                    break
+            else:
+                return None
+        else:
+            name = self.resolve(name if name.startswith('/') else '/' + name)
+        if name in self.loaded:
+            return self.loaded[name]
+        if name not in self.files:
+            return None
+        obj = self.get_object(name)
+        if not obj:
+            return None
+        self.modules.insert(len(self.modules) - 1, obj)
+        rpath = []
+        if obj.rpath:
+            rpath = obj.rpath.decode().replace('$ORIGIN', os.path.dirname(name) or '/').split(':')
+        for lib in obj.needed:
+            self.load(lib.decode(), rpath)
+        self.relocate(obj)
+        self.loaded[name] = obj
+        if obj.soname:
+            self.loaded[obj.soname.decode()] = obj
+        return obj
+
+    def relocate(self, obj):
+        resolutions = [(UNRESOLVED, UNRESOLVED)] * obj.nsyms
+        for idx in obj.referenced_symbols():
+            if idx >= obj.nsyms:
+                continue
+            name = obj.string(obj.sym(idx)[0])
+            for m, module in enumerate(self.modules):
+                sym = module.lookup(name)
+                if sym is not None:
+                    resolutions[idx] = (m, sym)
+                    break
+        context = (tuple(m.fingerprint() for m in self.modules), tuple(resolutions))
+        contexts = self.contexts.setdefault(obj.path, [])
+        if context not in contexts:
+            contexts.append(context)
+
+    def unload_all(self):
+        self.modules = [self.kernel]
+        self.loaded = dict((k, v) for k, v in self.loaded.items() if v is self.kernel)
+
+def write_cache(fn, contexts):
+    with open(fn, 'wb') as f:
+        f.write(struct.pack('<8sII', RELOC_CACHE_MAGIC, RELOC_CACHE_VERSION, len(contexts)))
+        for fingerprints, resolutions in contexts:
+            f.write(struct.pack('<II', len(fingerprints), len(resolutions)))
+            f.write(struct.pack('<%dQ' % len(fingerprints), *fingerprints))
+            for m, sym in resolutions:
+                f.write(struct.pack('<II', m, sym))
+
+# Programs run by a command line like "--nomount /tools/foo.so a b; /bar.so"
+def cmdline_programs(cmdline):
+    programs = []
+    for command in cmdline.replace('&!', ';').replace('&', ';').split(';'):
+        words = [w for w in command.split() if not w.startswith('-')]
+        if words:
+            programs.append(words[0])
+    return programs
+
+def main():
+    make_option = optparse.make_option
+
+    opt = optparse.OptionParser(option_list=[
+            make_option('-m',
+                        dest='manifest',
+                        help='read manifest from FILE, and add the caches to it',
+                        metavar='FILE'),
+            make_option('-k',
+                        dest='kernel',
+                        default='loader-stripped.elf',
+                        help='kernel ELF image',
+                        metavar='FILE'),
+            make_option('-c',
+                        dest='cmdline',
+                        default='cmdline',
+                        help='take the programs to cache from the command line in FILE',
+                        metavar='FILE'),
+            make_option('-p',
+                        dest='programs',
+                        action='append',
+                        default=[],
+                        help='cache the relocations of PROGRAM (may be repeated)',
+                        metavar='PROGRAM'),
+            make_option('-o',
+                        dest='output',
+                        default='reloc-cache',
+                        help='write the caches under DIR',
+                        metavar='DIR'),
+            make_option('-a',
+                        dest='arch',
+                        default='x64',
+                        choices=list(kernel_supplied.keys()),
+                        help='architecture of the image'),
+            make_option('-D',
+                        type='string',
+                        help='define VAR=DATA',
+                        metavar='VAR=DATA',
+                        action='callback',
+                        callback=add_var),
+    ])
+
+    (options, args) = opt.parse_args()
+
+    manifest = read_manifest(options.manifest)
+    files = [(x, y % defines) for (x, y) in manifest]
+    files = dict((os.path.normpath(x), unsymlink(y)) for (x, y) in expand(files))
+
+    programs = options.programs
+    if not programs and os.path.exists(options.cmdline):
+        with open(options.cmdline) as f:
+            programs = cmdline_programs(f.read())
+
+    kernel = ElfObject('', options.kernel)
+    loader = Loader(files, kernel, options.arch)
+    for program in programs:
+        # The application's libvdso.so is loaded before the program
+        loader.load('libvdso.so')
+        loader.load(program)
+        loader.unload_all()
+
+    entries = []
+    for path, contexts in sorted(loader.contexts.items()):
+        fn = os.path.join(options.output, path.lstrip('/') + '.relcache')
+        if not os.path.isdir(os.path.dirname(fn)):
+            os.makedirs(os.path.dirname(fn))
+        write_cache(fn, contexts)
+        entries.append('%s.relcache: %s\n' % (path, os.path.abspath(fn)))
+
+    with open(options.manifest) as f:
+        lines = [l for l in f if not l.split(':')[0].strip().endswith('.relcache')]
+    with open(options.manifest, 'w') as f:
+        f.writelines(lines + entries)
+    print('Cached relocations of %d objects' % len(entries))
+
+if __name__ == '__main__':
+    main()
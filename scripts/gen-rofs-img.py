@@ -41,9 +41,19 @@
 # Table of inodes where each specifies type (dir,file,symlink) and data offset
 # (for files it is a block on a disk, for symlinks and directories it is an
 # offset in one of the 2 tables above)
+#
+# Compressed images (version 2) store each file as a sequence of chunks of
+# 32K of file data, each compressed on its own (a chunk which does not
+# compress is stored as is), and append the chunk table to the above: the
+# byte offsets on disk of all chunks, each file ending with the offset just
+# past its last chunk. The data offset of a file i-node is then the index
+# of its first chunk in that table.
+#
+# The entries of each directory are written sorted by name, so that lookups
+# can binary search them, which the superblock flags advertise.
 ##################################################################################
 
-import os, optparse, io
+import os, optparse, io, zlib
 from struct import *
 from ctypes import *
 from manifest_common import add_var, expand, unsymlink, read_manifest, defines, strip_file
@@ -54,7 +64,15 @@ DIR_MODE  = int('0x4000', 16)
 REG_MODE  = int('0x8000', 16)
 LINK_MODE = int('0xA000', 16)
 
+CHUNK_SIZE = 32 * 1024
+
+COMPRESSION = { 'none': 0, 'zlib': 1, 'lz4': 2 }
+
+FLAG_SORTED_DIRS = 1
+
 block = 0
+compression = 'none'
+chunk_offsets = []
 
 class SuperBlock(Structure):
     _fields_ = [
@@ -65,11 +83,15 @@ class SuperBlock(Structure):
         ('structure_info_blocks_count', c_ulonglong),
         ('directory_entries_count', c_ulonglong),
         ('symlinks_count', c_ulonglong),
-        ('inodes_count', c_ulonglong)
+        ('inodes_count', c_ulonglong),
+        ('compression', c_ulonglong),
+        ('chunk_size', c_ulonglong),
+        ('chunks_count', c_ulonglong),
+        ('flags', c_ulonglong)
     ]
 
 # data_offset and count represent different things depending on mode:
-# file - number of first block on disk and size in bytes (number of blocks can be deduced)
+# file - number of first block on disk (or first chunk when compressed) and size in bytes
 # directory - index of the first entry in the directory entries array and number of entries
 # symlink - index of the entry in the symlink entries array and 1
 class Inode(Structure):
@@ -181,6 +203,50 @@ def write_file(fp, path):
 
     return total
 
+def compress_chunk(raw):
+    if compression == 'zlib':
+        return zlib.compress(raw, 9)
+    # LZ4 block prefixed with its big-endian length, as ZFS stores it
+    import lz4.block
+    data = lz4.block.compress(raw, store_size=False)
+    return pack('>I', len(data)) + data
+
+def write_compressed_file(fp, path):
+    global block
+    global chunk_offsets
+
+    first_chunk = len(chunk_offsets)
+    start = block * OSV_BLOCK_SIZE
+    pos = start
+    total = 0
+
+    with open(path, 'rb') as f:
+        while True:
+            raw = f.read(CHUNK_SIZE)
+            if not raw:
+                break
+            total += len(raw)
+            data = compress_chunk(raw)
+            if len(data) >= len(raw):
+                data = raw
+            chunk_offsets.append(pos)
+            fp.write(data)
+            pos += len(data)
+
+    chunk_offsets.append(pos)
+    written = pos - start
+    if written % OSV_BLOCK_SIZE > 0:
+        written += pad(fp, OSV_BLOCK_SIZE - written % OSV_BLOCK_SIZE)
+    block += written / OSV_BLOCK_SIZE
+
+    return (first_chunk, total)
+
+def write_chunk_offsets(fp):
+    for offset in chunk_offsets:
+        fp.write(c_ulonglong(offset))
+
+    return len(chunk_offsets) * sizeof(c_ulonglong)
+
 def write_inodes(fp):
     global inodes
 
@@ -201,7 +267,8 @@ def write_dir(fp, manifest, dirpath, parent_dir):
     global directory_entries_count
 
     directory_entry_inodes = []
-    for entry in manifest:
+    # Sorted by bytes, the way strcmp() compares names when looking them up
+    for entry in sorted(manifest):
         inode = next_inode()
         directory_entry_inodes.append((entry,inode))
 
@@ -222,8 +289,11 @@ def write_dir(fp, manifest, dirpath, parent_dir):
             else: #file
                 inode.mode = REG_MODE
                 global block
-                inode.data_offset = block
-                inode.count = write_file(fp, val)
+                if compression != 'none':
+                    inode.data_offset, inode.count = write_compressed_file(fp, val)
+                else:
+                    inode.data_offset = block
+                    inode.count = write_file(fp, val)
                 print 'Adding %s' % (dirpath + '/' + entry)
 
     # This needs to be added so that later we can walk the tree
@@ -261,6 +331,9 @@ def write_fs(fp, manifest):
     write_inodes(fp)
     bytes_written += len(inodes) * sizeof(Inode)
 
+    if compression != 'none':
+        bytes_written += write_chunk_offsets(fp)
+
     return (block_no, bytes_written)
 
 def gen_image(out, manifest):
@@ -281,7 +354,7 @@ def gen_image(out, manifest):
     global symlinks
 
     sb = SuperBlock()
-    sb.version = 1
+    sb.version = 2 if compression != 'none' else 1
     sb.magic = int('0xDEADBEAD', 16)
     sb.block_size = OSV_BLOCK_SIZE
     sb.structure_info_first_block = system_structure_block
@@ -289,11 +362,18 @@ def gen_image(out, manifest):
     sb.directory_entries_count = len(directory_entries)
     sb.symlinks_count = len(symlinks)
     sb.inodes_count = len(inodes)
+    sb.compression = COMPRESSION[compression]
+    sb.flags = FLAG_SORTED_DIRS
+    if compression != 'none':
+        sb.chunk_size = CHUNK_SIZE
+        sb.chunks_count = len(chunk_offsets)
 
     print 'First block: %d, blocks count: %d' % (sb.structure_info_first_block, sb.structure_info_blocks_count)
     print 'Directory entries count %d' % sb.directory_entries_count
     print 'Symlinks count %d' % sb.symlinks_count
     print 'Inodes count %d' % sb.inodes_count
+    if compression != 'none':
+        print 'Compressed with %s, chunks count %d' % (compression, sb.chunks_count)
 
     fp.seek(0)
     fp.write(sb)
@@ -357,10 +437,20 @@ def main():
                         metavar='VAR=DATA',
                         action='callback',
                         callback=add_var),
+            make_option('-c',
+                        dest='compression',
+                        type='choice',
+                        choices=COMPRESSION.keys(),
+                        default='none',
+                        help='compress file data with zlib or lz4',
+                        metavar='ALGORITHM'),
     ])
 
     (options, args) = opt.parse_args()
 
+    global compression
+    compression = options.compression
+
     manifest = read_manifest(options.manifest)
 
     outfile = os.path.abspath(options.output)
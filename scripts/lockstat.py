@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# Connect to a running OSv guest through the HTTP API and display the lock
+# classes with the most contention, with the call sites waiting for them.
+#
+# Lock statistics must be started first ("lockstat.py --start"), which
+# makes lock operations somewhat slower until they are stopped again
+# ("lockstat.py --stop"). Without either option, the statistics are shown
+# and refreshed periodically, or once with "--once".
+#
+# The host:port to connect to can be specified on the command line, or
+# defaults to localhost:8000 (which is where "run.py --api" redirects the
+# guest's API port).
+
+import requests
+import argparse
+import time
+import sys
+
+from osv.client import Client
+
+try:
+    import curses
+    curses.setupterm()
+    clear = curses.tigetstr('clear').decode()
+except:
+    clear = '\033[H\033[2J'
+
+parser = argparse.ArgumentParser(description="""
+    Connects to a running OSv guest through the HTTP API and displays the lock
+    classes with the most contention, with the call sites waiting for them.""")
+Client.add_arguments(parser)
+parser.add_argument('--start', help='start collecting lock statistics, discarding earlier ones', action="store_true")
+parser.add_argument('--stop', help='stop collecting lock statistics', action="store_true")
+parser.add_argument('-l','--lines', help='number of lock classes to show', type=int, default=20)
+parser.add_argument('-s','--sites', help='number of call sites to show per lock class', type=int, default=3)
+parser.add_argument('-p','--period', help='refresh period (in seconds)', type=float, default=2.0)
+parser.add_argument('--once', help='show the statistics once and exit', action="store_true")
+
+args = parser.parse_args()
+client = Client(args)
+
+url = client.get_url() + "/trace/lockstat"
+ssl_kwargs = client.get_request_kwargs()
+
+def set_state(enabled):
+    r = requests.post(url, params={'enabled': enabled and 'true' or 'false'}, **ssl_kwargs)
+    r.raise_for_status()
+    print(r.json())
+
+def format_ns(ns):
+    if ns >= 1000000000:
+        return '%.2fs' % (ns / 1e9)
+    if ns >= 1000000:
+        return '%.2fms' % (ns / 1e6)
+    if ns >= 1000:
+        return '%.2fus' % (ns / 1e3)
+    return '%dns' % ns
+
+def show():
+    r = requests.get(url, params={'sites': args.sites}, **ssl_kwargs)
+    r.raise_for_status()
+    stats = r.json()
+    out = []
+    if not stats['enabled']:
+        out.append('Lock statistics are stopped')
+    if stats['dropped']:
+        out.append('%d lock operations left out, the statistics tables are full' % stats['dropped'])
+    out.append('%10s %10s %10s %10s %10s %10s  %s' %
+               ('ACQUIRED', 'CONTENDED', 'WAIT', 'MAX WAIT', 'HOLD', 'MAX HOLD', 'CLASS'))
+    for c in stats['list'][:args.lines]:
+        out.append('%10d %10d %10s %10s %10s %10s  %s: %s (%d locks)' % (
+            c['acquired'], c['contended'], format_ns(c['wait_ns']),
+            format_ns(c['max_wait_ns']), format_ns(c['hold_ns']),
+            format_ns(c['max_hold_ns']), c['type'], c['name'], c['locks']))
+        for s in c['top_sites']:
+            out.append('%10s %10d %10s %10s %10s %10s    %s' % (
+                '', s['contended'], format_ns(s['wait_ns']), '', '', '', s['site']))
+    return '\n'.join(out)
+
+if args.start or args.stop:
+    set_state(args.start)
+    sys.exit(0)
+
+if args.once:
+    print(show())
+    sys.exit(0)
+
+try:
+    while True:
+        text = show()
+        sys.stdout.write(clear)
+        print(text)
+        time.sleep(args.period)
+except KeyboardInterrupt:
+    pass
@@ -2,6 +2,7 @@ import mmap
 import struct
 import heapq
 import bisect
+import sys
 
 from osv import debug
 
@@ -353,7 +354,10 @@ class TraceDumpReader(TraceDumpReaderBase) :
     def __init__(self, filename):
         self.tracepoints = {}
         self.trace_buffers = []
+        self.lost_pages = {}
         TraceDumpReaderBase.__init__(self, filename)
+        for cpu, pages in sorted(self.lost_pages.items()):
+            sys.stderr.write("warning: %d trace pages of cpu %d were lost while streaming\n" % (pages, cpu))
 
     def readStruct(self, tag, size):
         if tag == 0x54524344: # 'TRCD'
@@ -362,6 +366,11 @@ class TraceDumpReader(TraceDumpReaderBase) :
             data = self.file.read(size)
             self.trace_buffers.append(data)
             return True
+        elif tag == 0x4C4F5354: # 'LOST'
+            cpu = self.read('I')
+            pages = self.read('Q')
+            self.lost_pages[cpu] = self.lost_pages.get(cpu, 0) + pages
+            return True
         else:
             return False
 
@@ -1,5 +1,6 @@
 from tests.testing import *
 import os
+import socket
 import subprocess
 
 @test
@@ -53,3 +54,29 @@ def tracing_smoke_test():
         assert('192.168.122.1.67 > 255.255.255.255.68: BOOTP/DHCP, Reply' in tcpdump)
     finally:
         guest.kill()
+
+@test
+def trace_stream_test():
+    host_port = 7777
+    guest = run_command_in_guest('/tests/misc-trace-stream.so',
+        forward=[(host_port, 7777)])
+
+    wait_for_line(guest, 'listening...')
+
+    s = socket.create_connection(('localhost', host_port))
+    with open('tracestream', 'wb') as f:
+        while True:
+            data = s.recv(65536)
+            if not data:
+                break
+            f.write(data)
+    s.close()
+    guest.join()
+
+    trace_script = os.path.join(osv_base, 'scripts', 'trace.py')
+    proc = subprocess.Popen([trace_script, 'summary', 'tracestream'],
+        stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    summary, warnings = proc.communicate()
+    assert(proc.returncode == 0)
+    assert('misc_trace_stream' in summary.decode())
+    assert('were lost while streaming' in warnings.decode())
@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// Library loaded by tst-reloc-cache.cc, which defines reloc_cache_value
+// too and thus interposes on the definition here.
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+int reloc_cache_value = 1;
+
+// What the relocations of this library resolved to
+extern "C" void reloc_cache_refs(void** refs)
+{
+    refs[0] = &reloc_cache_value;
+    refs[1] = reinterpret_cast<void*>(&strlen);
+    refs[2] = reinterpret_cast<void*>(&malloc);
+    refs[3] = reinterpret_cast<void*>(&puts);
+}
@@ -8,7 +8,9 @@
 #include <time.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <assert.h>
 #include <osv/debug.h>
+#include <osv/sched.hh>
 #include <bsd/porting/callout.h>
 #include <bsd/porting/netport.h>
 #include <bsd/porting/sync_stub.h>
@@ -160,9 +162,104 @@ void test2(void)
     tdbg("BSD Callout Test2 - END\n");
 }
 
+/********************** Test 3 **********************/
+
+/* Stop/drain return values, and callouts firing on the arming cpu */
+struct callout t3;
+int t3_fired;
+sched::cpu* t3_cpu;
+
+void t3_fn(void *unused)
+{
+    t3_cpu = sched::cpu::current();
+    t3_fired++;
+}
+
+void test3(void)
+{
+    tdbg("BSD Callout Test3 - BEGIN\n");
+
+    callout_init(&t3, 1);
+    assert(callout_stop(&t3) == 0);
+
+    // Stopping a pending callout cancels it
+    callout_reset(&t3, hz, t3_fn, NULL);
+    assert(callout_pending(&t3));
+    assert(callout_stop(&t3) == 1);
+    assert(!callout_pending(&t3) && !callout_active(&t3));
+
+    // Re-arming reports the cancelled pending instance
+    callout_reset(&t3, hz, t3_fn, NULL);
+    assert(callout_reset(&t3, hz, t3_fn, NULL) == 1);
+
+    // Draining a pending callout cancels it without waiting for it
+    assert(callout_drain(&t3) == 1);
+    usleep(1200000);
+    assert(t3_fired == 0);
+
+    // The handler runs on the cpu which armed the callout
+    for (auto cpu : sched::cpus) {
+        sched::thread::pin(cpu);
+        t3_cpu = nullptr;
+        callout_reset(&t3, 1, t3_fn, NULL);
+        usleep(100000);
+        tdbg("armed on cpu %d, fired on cpu %d\n", cpu->id, t3_cpu ? t3_cpu->id : -1);
+        assert(t3_cpu == cpu);
+    }
+    callout_drain(&t3);
+    assert(t3_fired == (int)sched::cpus.size());
+
+    tdbg("BSD Callout Test3 - END\n");
+}
+
+/********************** Test 4 **********************/
+
+/* Re-arming a callout whose handler waits for the lock we hold */
+struct callout t4;
+struct mtx t4_lock;
+int t4_fired;
+
+void t4_fn(void *unused)
+{
+    t4_fired++;
+}
+
+void test4(void)
+{
+    tdbg("BSD Callout Test4 - BEGIN\n");
+    mtx_init(&t4_lock, NULL, NULL, 0);
+    callout_init_mtx(&t4, &t4_lock, 0);
+
+    // The handler comes due while we hold its lock, then we re-arm it, as
+    // ARP does with its entry's lock held: only the re-armed one may run
+    mtx_lock(&t4_lock);
+    callout_reset(&t4, 1, t4_fn, NULL);
+    usleep(100000);
+    assert(callout_reset(&t4, hz, t4_fn, NULL) == 1);
+    mtx_unlock(&t4_lock);
+    usleep(100000);
+    assert(t4_fired == 0);
+    usleep(1200000);
+    assert(t4_fired == 1);
+
+    // Same when stopping it
+    mtx_lock(&t4_lock);
+    callout_reset(&t4, 1, t4_fn, NULL);
+    usleep(100000);
+    assert(callout_stop(&t4) == 1);
+    mtx_unlock(&t4_lock);
+    usleep(100000);
+    assert(t4_fired == 1);
+
+    callout_drain(&t4);
+    tdbg("BSD Callout Test4 - END\n");
+}
+
 int main(int argc, char **argv)
 {
     test1();
     test2();
+    test3();
+    test4();
     return 0;
 }
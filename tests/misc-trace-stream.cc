@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// Streams the trace buffers over a TCP connection, for
+// scripts/tests/test_tracing.py to read back with scripts/trace.py. The
+// tracepoint fires faster than the stream can keep up with at the end, so
+// that pages are lost and reported as such.
+
+#include <osv/trace.hh>
+#include <osv/tracecontrol.hh>
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <chrono>
+
+#define LISTEN_PORT 7777
+
+TRACEPOINT(trace_misc_trace_stream, "i=%d", int);
+
+using _clock = std::chrono::high_resolution_clock;
+
+int main(int argc, char**argv)
+{
+    auto listen_s = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_s < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    struct sockaddr_in laddr = {};
+    laddr.sin_family = AF_INET;
+    laddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    laddr.sin_port = htons(LISTEN_PORT);
+
+    if (bind(listen_s, (struct sockaddr *) &laddr, sizeof(laddr)) < 0) {
+        perror("bind");
+        return -1;
+    }
+
+    if (listen(listen_s, 1) < 0) {
+        perror("listen");
+        return -1;
+    }
+
+    printf("listening...\n");
+
+    int client_s;
+    if ((client_s = accept(listen_s, NULL, NULL)) < 0) {
+        perror("accept");
+        return -1;
+    }
+
+    trace::set_event_state(trace_misc_trace_stream, true);
+    trace::start_trace_stream([client_s] (const char *data, size_t len) {
+        if (!data) {
+            close(client_s);
+            return true;
+        }
+        while (len) {
+            auto n = write(client_s, data, len);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            len -= n;
+        }
+        return true;
+    });
+
+    // Records the stream keeps up with, then a burst overwriting the
+    // trace buffers many times over before the stream copies them
+    int i;
+    for (i = 0; i < 10; i++) {
+        trace_misc_trace_stream(i);
+        usleep(10000);
+    }
+    auto end = _clock::now() + std::chrono::milliseconds(300);
+    while (_clock::now() < end) {
+        for (int j = 0; j < 1000; j++) {
+            trace_misc_trace_stream(i++);
+        }
+    }
+
+    trace::stop_trace_stream();
+    trace::set_event_state(trace_misc_trace_stream, false);
+    close(listen_s);
+
+    auto stats = trace::get_trace_stream_stats();
+    printf("streamed %lu pages, lost %lu pages\n", stats.written_pages, stats.lost_pages);
+    return stats.written_pages && stats.lost_pages ? 0 : 1;
+}
@@ -490,3 +490,49 @@ BOOST_AUTO_TEST_CASE(test_serial_timer__callback_fires_if_not_cancelled)
     lock.lock();
 }
 
+
+BOOST_AUTO_TEST_CASE(test_serial_timer__postponed_timer_does_not_fire_early)
+{
+    std::promise<bool> proceed;
+    std::atomic<int> rejected {0};
+    int counter = 0;
+    bool early = false;
+    mutex lock;
+    clock::time_point due;
+
+    serial_timer_task task(lock, [&] (serial_timer_task& timer) {
+        WITH_LOCK(lock) {
+            if (!timer.try_fire()) {
+                rejected++;
+                return;
+            }
+            early = clock::now() < due;
+            counter++;
+        }
+
+        proceed.set_value(true);
+    });
+
+    WITH_LOCK(lock) {
+        task.reschedule(10_ms);
+        due = clock::now() + 50_ms;
+        // Pushed forward without re-arming, like a TCP keepalive timer
+        for (int i = 0; i < 100; i++) {
+            task.reschedule(50_ms);
+        }
+        BOOST_REQUIRE(task.is_active());
+    }
+
+    assert_resolves(proceed, 200_ms);
+
+    WITH_LOCK(lock) {
+        task.cancel_sync();
+        BOOST_REQUIRE(!task.is_active());
+    }
+
+    BOOST_REQUIRE(counter == 1);
+    BOOST_REQUIRE(!early);
+    BOOST_REQUIRE(rejected == 1);
+
+    lock.lock();
+}
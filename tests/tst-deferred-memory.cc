@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// Tests memory past the first memory::boot_online_memory bytes, which
+// comes online in the background: the memory stats count it from the
+// start, and allocations which outrun the threads bringing it online get
+// it all the same. Only exercises that with more memory than that, say
+// with run.py -m 6G.
+
+#include <osv/mempool.hh>
+#include <sys/sysinfo.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thread>
+#include <vector>
+
+static int tests = 0, fails = 0;
+
+static void report(bool ok, const char *msg)
+{
+    ++tests;
+    fails += !ok;
+    printf("%s: %s\n", (ok ? "PASS" : "FAIL"), msg);
+}
+
+constexpr size_t buf_size = 1 << 20;
+
+int main(int argc, char **argv)
+{
+    auto total_mem = memory::stats::total();
+    auto free_mem = memory::stats::free();
+    printf("physical %lu MB, total %lu MB, free %lu MB\n", memory::phys_mem_size >> 20,
+           total_mem >> 20, free_mem >> 20);
+
+    struct sysinfo info;
+    report(sysinfo(&info) == 0 && info.totalram * info.mem_unit == total_mem,
+           "sysinfo() reports the total memory");
+    // Less only the kernel and what boot keeps for itself
+    report(total_mem + (256 << 20) > memory::phys_mem_size,
+           "total memory counts memory not online yet");
+
+    // Right at startup, from every cpu at once, allocate most of the memory
+    unsigned nthreads = std::thread::hardware_concurrency();
+    size_t per_thread = free_mem / 4 * 3 / nthreads / buf_size;
+    std::vector<std::vector<void*>> bufs(nthreads);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < nthreads; i++) {
+        threads.emplace_back([&, i] {
+            for (size_t j = 0; j < per_thread; j++) {
+                auto p = static_cast<char*>(malloc(buf_size));
+                if (!p) {
+                    break;
+                }
+                p[0] = p[buf_size - 1] = 1;
+                bufs[i].push_back(p);
+            }
+        });
+    }
+    bool ok = true;
+    for (unsigned i = 0; i < nthreads; i++) {
+        threads[i].join();
+        ok &= bufs[i].size() == per_thread;
+    }
+    report(ok, "allocate three quarters of the free memory");
+    report(memory::stats::total() == total_mem, "total memory unchanged");
+
+    for (auto& b : bufs) {
+        for (auto p : b) {
+            free(p);
+        }
+    }
+    report(memory::stats::free() > free_mem / 4 * 3, "memory freed");
+
+    printf("SUMMARY: %d tests, %d failures\n", tests, fails);
+    return fails == 0 ? 0 : 1;
+}
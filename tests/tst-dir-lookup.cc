@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// Tests looking names up in directories with many entries: ramfs, on a
+// ramfs mounted of its own as /tmp is not ramfs on every image, and when
+// built with READ_ONLY_FS, the sorted directories of the ROFS root.
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define TEST_DIR "/tmp/tst-dir-lookup"
+
+int sys_mount(const char *dev, const char *dir, const char *fsname, int flags, void *data);
+int sys_umount(const char *path);
+
+static int tests = 0, fails = 0;
+
+static void report(bool ok, const char *msg)
+{
+    ++tests;
+    fails += !ok;
+    printf("%s: %s\n", (ok ? "PASS" : "FAIL"), msg);
+}
+
+static std::vector<std::string> list_dir(const char *path)
+{
+    std::vector<std::string> names;
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return names;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") && strcmp(ent->d_name, "..")) {
+            names.push_back(ent->d_name);
+        }
+    }
+    closedir(dir);
+    return names;
+}
+
+static bool exists(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+static bool missing(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == -1 && errno == ENOENT;
+}
+
+// ramfs looks names up by hash, but readdir() still returns entries in the
+// order they were created, also after renames and removals
+static void test_ramfs()
+{
+    mkdir(TEST_DIR, 0777);
+    report(sys_mount("", TEST_DIR, "ramfs", 0, nullptr) == 0, "mount ramfs");
+
+    bool ok = true;
+    for (int i = 999; i >= 0; i--) {
+        auto name = TEST_DIR "/f" + std::to_string(i);
+        int fd = open(name.c_str(), O_CREAT|O_EXCL|O_WRONLY, 0666);
+        ok &= fd >= 0;
+        close(fd);
+    }
+    report(ok, "create 1000 files");
+    ok = true;
+    for (int i = 0; i < 1000; i++) {
+        ok &= exists(TEST_DIR "/f" + std::to_string(i));
+    }
+    report(ok, "look up 1000 files");
+    report(missing(TEST_DIR "/f1000") && missing(TEST_DIR "/f"), "look up missing names");
+
+    report(unlink(TEST_DIR "/f500") == 0, "unlink from the middle");
+    report(rename(TEST_DIR "/f999", TEST_DIR "/g") == 0, "rename shorter");
+    report(rename(TEST_DIR "/f998", TEST_DIR "/a-much-longer-name") == 0, "rename longer");
+    report(missing(TEST_DIR "/f999") && missing(TEST_DIR "/f998"), "old names gone");
+    report(missing(TEST_DIR "/f500"), "unlinked name gone");
+    report(exists(TEST_DIR "/g") && exists(TEST_DIR "/a-much-longer-name"),
+           "look up renamed files");
+    report(exists(TEST_DIR "/f0"), "look up last created");
+
+    std::vector<std::string> names;
+    for (int i = 999; i >= 0; i--) {
+        if (i == 999) {
+            names.push_back("g");
+        } else if (i == 998) {
+            names.push_back("a-much-longer-name");
+        } else if (i != 500) {
+            names.push_back("f" + std::to_string(i));
+        }
+    }
+    report(list_dir(TEST_DIR) == names, "readdir in creation order");
+
+    for (auto& name : names) {
+        unlink((TEST_DIR "/" + name).c_str());
+    }
+    report(list_dir(TEST_DIR).empty(), "directory emptied");
+    report(sys_umount(TEST_DIR) == 0, "umount");
+    rmdir(TEST_DIR);
+}
+
+#ifdef READ_ONLY_FS
+// The image generator writes directory entries sorted by name, which
+// lookups binary search
+static void test_rofs(const char *path)
+{
+    auto names = list_dir(path);
+    report(names.size() > 1, "list rofs directory");
+    report(std::is_sorted(names.begin(), names.end(),
+           [] (const std::string& a, const std::string& b) {
+               return strcmp(a.c_str(), b.c_str()) < 0;
+           }), "rofs directory sorted by name");
+
+    std::string dir(path);
+    if (dir.back() == '/') {
+        dir.pop_back();
+    }
+    bool found = true, not_found = true;
+    for (auto& name : names) {
+        found &= exists(dir + "/" + name);
+        // Sorts right before and right after the name, between it and
+        // its neighbours
+        auto before = name.substr(0, name.size() - 1);
+        if (!before.empty() && !std::binary_search(names.begin(), names.end(), before)) {
+            not_found &= missing(dir + "/" + before);
+        }
+        auto after = name + '\x01';
+        not_found &= missing(dir + "/" + after);
+    }
+    report(found, "look up every rofs entry");
+    report(not_found, "look up names between rofs entries");
+    report(missing(dir + "/" + std::string(1, '\x01')) && missing(dir + "/\x7f\x7f"),
+           "look up names before the first and after the last rofs entry");
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    test_ramfs();
+#ifdef READ_ONLY_FS
+    test_rofs("/tests");
+    test_rofs("/");
+#endif
+
+    printf("SUMMARY: %d tests, %d failures\n", tests, fails);
+    return fails == 0 ? 0 : 1;
+}
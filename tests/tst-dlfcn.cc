@@ -8,6 +8,7 @@
 #define BOOST_TEST_MODULE tst-dlfcn
 
 #include <dlfcn.h>
+#include <string.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -53,3 +54,22 @@ BOOST_AUTO_TEST_CASE(test_dladdr)
     BOOST_CHECK_EQUAL("vfprintf", info.dli_sname);
     BOOST_CHECK_EQUAL(vfprintf, info.dli_saddr);
 }
+
+extern "C" __attribute__((noinline)) int tst_dladdr_target(int x)
+{
+    return x * 3 + 1;
+}
+
+BOOST_AUTO_TEST_CASE(test_dladdr_in_library)
+{
+    Dl_info info;
+
+    BOOST_REQUIRE(dladdr(adj_addr(tst_dladdr_target, 0), &info) != 0);
+    BOOST_CHECK_EQUAL("tst_dladdr_target", info.dli_sname);
+    BOOST_CHECK_EQUAL(reinterpret_cast<void*>(tst_dladdr_target), info.dli_saddr);
+    BOOST_REQUIRE(strstr(info.dli_fname, "tst-dlfcn") != nullptr);
+
+    BOOST_REQUIRE(dladdr(adj_addr(tst_dladdr_target, 1), &info) != 0);
+    BOOST_CHECK_EQUAL("tst_dladdr_target", info.dli_sname);
+    BOOST_CHECK_EQUAL(reinterpret_cast<void*>(tst_dladdr_target), info.dli_saddr);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+// To compile on Linux, use: g++ -g -std=c++11 tests/tst-fadvise.cc
+
+// Tests posix_fadvise() argument checking, and that sequential, random and
+// WILLNEED-prefetched reads of a file (with read-ahead active on ROFS) all
+// return the file's contents.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <iostream>
+#include <vector>
+
+static int tests = 0, fails = 0;
+
+template<typename T>
+bool do_expect(T actual, T expected, const char *actuals, const char *expecteds, const char *file, int line)
+{
+    ++tests;
+    if (actual != expected) {
+        fails++;
+        std::cout << "FAIL: " << file << ":" << line << ": For " << actuals
+                << " expected " << expecteds << "(" << expected << "), saw "
+                << actual << ".\n";
+        return false;
+    }
+    std::cout << "OK: " << file << ":" << line << ".\n";
+    return true;
+}
+#define expect(actual, expected) do_expect(actual, expected, #actual, #expected, __FILE__, __LINE__)
+
+// Reads the whole file with reads of the given size
+static std::vector<char> read_all(int fd, size_t chunk)
+{
+    std::vector<char> ret;
+    std::vector<char> buf(chunk);
+    lseek(fd, 0, SEEK_SET);
+    ssize_t n;
+    while ((n = read(fd, buf.data(), chunk)) > 0) {
+        ret.insert(ret.end(), buf.begin(), buf.begin() + n);
+    }
+    return ret;
+}
+
+int main(int ac, char** av)
+{
+    // Any reasonably large file in the image will do; use ourselves
+    const char* path = ac > 1 ? av[1] : "/tests/tst-fadvise.so";
+    int fd = open(path, O_RDONLY);
+    expect(fd >= 0, true);
+    struct stat st;
+    expect(fstat(fd, &st), 0);
+
+    expect(posix_fadvise(fd, 0, 0, 12345), EINVAL);
+    expect(posix_fadvise(fd, 0, -1, POSIX_FADV_NORMAL), EINVAL);
+    expect(posix_fadvise(-1, 0, 0, POSIX_FADV_NORMAL), EBADF);
+
+    // Read in pread()-sized pieces as the reference
+    std::vector<char> ref(st.st_size);
+    size_t done = 0;
+    while (done < ref.size()) {
+        ssize_t n = pread(fd, ref.data() + done, std::min<size_t>(ref.size() - done, 512), done);
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    expect(done, (size_t)st.st_size);
+
+    expect(posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL), 0);
+    expect(read_all(fd, 4096) == ref, true);
+    expect(posix_fadvise(fd, 0, 0, POSIX_FADV_NORMAL), 0);
+    expect(read_all(fd, 1000) == ref, true);
+    expect(posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM), 0);
+    expect(read_all(fd, 65536) == ref, true);
+
+    // Prefetch the second half, then read it
+    off_t half = st.st_size / 2;
+    expect(posix_fadvise(fd, half, 0, POSIX_FADV_WILLNEED), 0);
+    std::vector<char> buf(st.st_size - half);
+    expect(pread(fd, buf.data(), buf.size(), half), (ssize_t)buf.size());
+    expect(memcmp(buf.data(), ref.data() + half, buf.size()), 0);
+    // Past the end of the file is fine, too
+    expect(posix_fadvise(fd, st.st_size + 4096, 4096, POSIX_FADV_WILLNEED), 0);
+    expect(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), 0);
+
+    close(fd);
+
+    std::cout << "SUMMARY: " << tests << " tests, " << fails << " failures\n";
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include <osv/heapprof.hh>
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+
+struct totals {
+    unsigned long inuse_count, inuse_bytes, alloc_count, alloc_bytes;
+};
+
+// Parses the header line of the profile,
+// "heap profile: N: B [ N: B] @ heap_v2/S"
+static totals profile_totals(const std::string& profile)
+{
+    totals t;
+    unsigned long sample_bytes;
+    auto n = sscanf(profile.c_str(), "heap profile: %lu: %lu [%lu: %lu] @ heap_v2/%lu",
+            &t.inuse_count, &t.inuse_bytes, &t.alloc_count, &t.alloc_bytes,
+            &sample_bytes);
+    assert(n == 5);
+    assert(profile.find("\nMAPPED_LIBRARIES:\n") != std::string::npos);
+    return t;
+}
+
+int main(int argc, char const *argv[])
+{
+    std::cout << "Starting" << std::endl;
+    heapprof::config config;
+    config.sample_bytes = 64 * 1024;
+    heapprof::start(config);
+
+    // 64MB in 4KB buffers, about 1000 samples
+    std::vector<void*> bufs;
+    for (int i = 0; i < 16384; i++) {
+        bufs.push_back(malloc(4096));
+    }
+
+    auto live = profile_totals(heapprof::get_profile());
+    std::cout << "in use: " << live.inuse_count << " samples, "
+              << live.inuse_bytes << " bytes" << std::endl;
+    assert(live.inuse_count > 500 && live.inuse_count < 2000);
+    assert(live.alloc_count >= live.inuse_count);
+
+    std::cout << "Freeing" << std::endl;
+    for (auto p : bufs) {
+        free(p);
+    }
+    auto freed = profile_totals(heapprof::get_profile());
+    // Little else is allocated meanwhile, and kept
+    assert(freed.inuse_count < live.inuse_count / 10);
+    assert(freed.alloc_count >= live.alloc_count);
+
+    std::cout << "Stopping" << std::endl;
+    heapprof::stop();
+    for (int i = 0; i < 16384; i++) {
+        free(malloc(4096));
+    }
+    auto stopped = profile_totals(heapprof::get_profile());
+    assert(stopped.alloc_count < freed.alloc_count + 10);
+
+    std::cout << "Done" << std::endl;
+    return 0;
+}
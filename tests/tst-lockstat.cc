@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include <osv/lockstat.hh>
+#include <osv/mutex.h>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <cassert>
+
+mutex tst_lockstat_mutex;
+
+static void contend()
+{
+    for (int i = 0; i < 100; i++) {
+        WITH_LOCK(tst_lockstat_mutex) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    std::cout << "Starting" << std::endl;
+    lockstat::start();
+
+    std::thread t1(contend), t2(contend);
+    t1.join();
+    t2.join();
+
+    std::cout << "Stopping" << std::endl;
+    lockstat::stop();
+
+    uint64_t dropped;
+    auto stats = lockstat::get_stats(3, dropped);
+    assert(!stats.empty());
+    bool found = false;
+    for (auto& c : stats) {
+        if (c.type == lockstat::lock_type::mutex && c.acquired >= 200 &&
+                c.contended > 0 && c.hold_ns >= 200 * 100000) {
+            std::cout << c.name << ": acquired " << c.acquired << ", contended "
+                    << c.contended << ", waited " << c.wait_ns << "ns\n";
+            assert(c.max_wait_ns <= c.wait_ns);
+            assert(!c.top_sites.empty() && c.top_sites.size() <= 3);
+            found = true;
+        }
+    }
+    assert(found);
+
+    std::cout << "Done" << std::endl;
+    return 0;
+}
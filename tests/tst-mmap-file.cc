@@ -15,6 +15,8 @@
 #include <stdio.h>
 #include <errno.h>
 
+#include <chrono>
+
 static int tests = 0, fails = 0;
 
 static void report(bool ok, const char* msg)
@@ -143,6 +145,30 @@ int main(int argc, char *argv[])
     report(munmap(b, 4096) == 0, "munmap temporary mapping");
     report(close(fd) == 0, "close again");
 
+    // Pages dirtied through a shared mapping are written back in the
+    // background, with no msync() or munmap(), after a few seconds. Poll
+    // the file for them, giving up well after they are due.
+    fd = open("/tmp/mmap-file-test", O_RDWR);
+    report(fd > 0, "open file again: O_RDWR");
+    auto* m = reinterpret_cast<unsigned char*>(mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0));
+    report(m != MAP_FAILED, "mmap for background writeback");
+    memset(m, 0x5a, size);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    bool read_ok, written_back;
+    do {
+        usleep(100000);
+        unsigned char buf[size];
+        read_ok = pread(fd, buf, size, 0) == size;
+        written_back = read_ok;
+        for (int i = 0; read_ok && i < size; i++) {
+            written_back &= buf[i] == 0x5a;
+        }
+    } while (read_ok && !written_back && std::chrono::steady_clock::now() < deadline);
+    report(read_ok, "pread written back pages");
+    report(written_back, "dirty pages written back in the background");
+    report(munmap(m, size) == 0, "munmap background writeback mapping");
+    report(close(fd) == 0, "close again");
+
     // TODO: map an append-only file with prot asking for PROT_WRITE, mmap should return EACCES.
     // TODO: map a file under a fs mounted with the flag NO_EXEC and prot asked for PROT_EXEC (expect EPERM).
 
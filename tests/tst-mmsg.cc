@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+// To compile on Linux, use: g++ -g -pthread -std=c++11 tests/tst-mmsg.cc
+
+// Tests sendmmsg() and recvmmsg() on UDP sockets over the loopback interface,
+// including sendmmsg() batches larger than a NIC's transmit ring.
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+static int tests = 0, fails = 0;
+
+template<typename T>
+bool do_expect(T actual, T expected, const char *actuals, const char *expecteds, const char *file, int line)
+{
+    ++tests;
+    if (actual != expected) {
+        fails++;
+        std::cout << "FAIL: " << file << ":" << line << ": For " << actuals
+                << " expected " << expecteds << "(" << expected << "), saw "
+                << actual << ".\n";
+        return false;
+    }
+    std::cout << "OK: " << file << ":" << line << ".\n";
+    return true;
+}
+#define expect(actual, expected) do_expect(actual, expected, #actual, #expected, __FILE__, __LINE__)
+
+static constexpr int nmsgs = 16;
+
+static int bound_udp_socket(struct sockaddr_in& sa)
+{
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = 0;
+    bind(s, (struct sockaddr *)&sa, sizeof(sa));
+    socklen_t len = sizeof(sa);
+    getsockname(s, (struct sockaddr *)&sa, &len);
+    return s;
+}
+
+// Sends batches of more datagrams than a NIC's transmit ring holds, to a
+// socket on the loopback interface which lets most of them drop
+static void test_large_batches()
+{
+    struct sockaddr_in dst, src;
+    int r = bound_udp_socket(dst);
+    int s = bound_udp_socket(src);
+    expect(r >= 0, true);
+    expect(s >= 0, true);
+
+    // virtio-net rings hold 256 descriptors
+    constexpr int vlen = 1024;
+    static char buf[512];
+    std::vector<struct iovec> iov(vlen);
+    std::vector<struct mmsghdr> msgs(vlen);
+    for (int i = 0; i < vlen; i++) {
+        iov[i].iov_base = buf;
+        iov[i].iov_len = sizeof(buf);
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = &dst;
+        msgs[i].msg_hdr.msg_namelen = sizeof(dst);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 16; round++) {
+        expect(sendmmsg(s, msgs.data(), vlen, 0), vlen);
+    }
+    expect(std::chrono::steady_clock::now() - start < std::chrono::seconds(10), true);
+
+    close(s);
+    close(r);
+}
+
+int main(int ac, char** av)
+{
+    struct sockaddr_in rsa, ssa;
+    int r = bound_udp_socket(rsa);
+    int s = bound_udp_socket(ssa);
+    expect(r >= 0, true);
+    expect(s >= 0, true);
+
+    // Send nmsgs datagrams of different sizes in one call
+    char sbufs[nmsgs][64];
+    struct iovec siov[nmsgs];
+    struct mmsghdr smsgs[nmsgs];
+    memset(smsgs, 0, sizeof(smsgs));
+    for (int i = 0; i < nmsgs; i++) {
+        memset(sbufs[i], 'a' + i, sizeof(sbufs[i]));
+        siov[i].iov_base = sbufs[i];
+        siov[i].iov_len = i + 1;
+        smsgs[i].msg_hdr.msg_name = &rsa;
+        smsgs[i].msg_hdr.msg_namelen = sizeof(rsa);
+        smsgs[i].msg_hdr.msg_iov = &siov[i];
+        smsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    expect(sendmmsg(s, smsgs, nmsgs, 0), nmsgs);
+    for (int i = 0; i < nmsgs; i++) {
+        expect(smsgs[i].msg_len, (unsigned)(i + 1));
+        // The caller's destination address must be left untouched
+        expect(smsgs[i].msg_hdr.msg_name == &rsa, true);
+    }
+
+    // Receive them all in one call. The last datagram is truncated.
+    char rbufs[nmsgs][64];
+    struct iovec riov[nmsgs];
+    struct mmsghdr rmsgs[nmsgs];
+    struct sockaddr_in from[nmsgs];
+    memset(rmsgs, 0, sizeof(rmsgs));
+    for (int i = 0; i < nmsgs; i++) {
+        riov[i].iov_base = rbufs[i];
+        riov[i].iov_len = i == nmsgs - 1 ? 4 : sizeof(rbufs[i]);
+        rmsgs[i].msg_hdr.msg_name = &from[i];
+        rmsgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        rmsgs[i].msg_hdr.msg_iov = &riov[i];
+        rmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    expect(recvmmsg(r, rmsgs, nmsgs, MSG_WAITFORONE, nullptr), nmsgs);
+    for (int i = 0; i < nmsgs - 1; i++) {
+        expect(rmsgs[i].msg_len, (unsigned)(i + 1));
+        expect(rbufs[i][0], (char)('a' + i));
+        expect(from[i].sin_family, (sa_family_t)AF_INET);
+        expect(from[i].sin_port, ssa.sin_port);
+    }
+    expect(rmsgs[nmsgs - 1].msg_len, 4U);
+    expect((rmsgs[nmsgs - 1].msg_hdr.msg_flags & MSG_TRUNC) != 0, true);
+
+    // With MSG_WAITFORONE we only wait for the first datagram
+    expect(sendmmsg(s, smsgs, 2, 0), 2);
+    rmsgs[nmsgs - 1].msg_hdr.msg_iov[0].iov_len = sizeof(rbufs[0]);
+    int n = recvmmsg(r, rmsgs, nmsgs, MSG_WAITFORONE, nullptr);
+    expect(n >= 1 && n <= 2, true);
+    if (n == 1) {
+        expect(recvmmsg(r, rmsgs, nmsgs, MSG_WAITFORONE, nullptr), 1);
+    }
+
+    // Nothing is queued: non-blocking receive fails with EAGAIN
+    expect(recvmmsg(r, rmsgs, nmsgs, MSG_DONTWAIT, nullptr), -1);
+    expect(errno, EAGAIN);
+
+    // The timeout is only checked after a datagram was received
+    struct timespec ts = { 0, 0 };
+    expect(sendmmsg(s, smsgs, 1, 0), 1);
+    expect(recvmmsg(r, rmsgs, nmsgs, 0, &ts), 1);
+
+#ifdef __OSV__
+    // Control messages aren't supported by sendmmsg(), which must fail
+    // rather than send without them
+    char control[64] = {};
+    smsgs[0].msg_hdr.msg_control = control;
+    smsgs[0].msg_hdr.msg_controllen = sizeof(control);
+    expect(sendmmsg(s, smsgs, 1, 0), -1);
+    expect(errno, EINVAL);
+    smsgs[0].msg_hdr.msg_control = nullptr;
+    smsgs[0].msg_hdr.msg_controllen = 0;
+#endif
+
+    close(s);
+    close(r);
+
+    test_large_batches();
+
+    std::cout << "SUMMARY: " << tests << " tests, " << fails << " failures\n";
+    return fails == 0 ? 0 : 1;
+}
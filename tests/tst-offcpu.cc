@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+#include <osv/offcpu.hh>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <sstream>
+#include <cassert>
+#include <algorithm>
+
+// Sums up the blocked time of the folded stacks
+static unsigned long total_us(const std::string& folded)
+{
+    std::istringstream in(folded);
+    std::string line;
+    unsigned long total = 0;
+    while (std::getline(in, line)) {
+        auto space = line.rfind(' ');
+        assert(space != std::string::npos && space > 0);
+        total += std::stoul(line.substr(space + 1));
+    }
+    return total;
+}
+
+int main(int argc, char const *argv[])
+{
+    std::cout << "Starting" << std::endl;
+    prof::start_offcpu_profiler(prof::offcpu_config());
+
+    for (int i = 0; i < 10; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::cout << "Reading while running" << std::endl;
+    auto live = prof::offcpu_folded_stacks();
+    // This thread alone slept for about 100ms
+    assert(total_us(live) >= 90000);
+
+    std::cout << "Stopping" << std::endl;
+    prof::stop_offcpu_profiler();
+
+    auto stopped = prof::offcpu_folded_stacks();
+    assert(total_us(stopped) >= total_us(live));
+
+    std::cout << "Restarting" << std::endl;
+    prof::offcpu_config config;
+    config.max_stacks = 1;
+    prof::start_offcpu_profiler(config);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    prof::stop_offcpu_profiler();
+    // One stack per cpu at most, and the time of the others as dropped
+    auto limited = prof::offcpu_folded_stacks();
+    auto lines = std::count(limited.begin(), limited.end(), '\n');
+    assert(lines <= std::thread::hardware_concurrency() + 1);
+
+    std::cout << "Done" << std::endl;
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// Tests ramfs file storage on a ramfs mounted of its own, as /tmp is not
+// ramfs on every image: files growing page by page, holes, truncation,
+// fallocate() and mmap() of the file pages.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#define TEST_DIR "/tmp/tst-ramfs"
+#define TEST_FILE TEST_DIR "/file"
+
+#ifndef FALLOC_FL_COLLAPSE_RANGE
+#define FALLOC_FL_COLLAPSE_RANGE 0x08
+#endif
+
+int sys_mount(const char *dev, const char *dir, const char *fsname, int flags, void *data);
+int sys_umount(const char *path);
+
+static int tests = 0, fails = 0;
+
+static void report(bool ok, const char *msg)
+{
+    ++tests;
+    fails += !ok;
+    printf("%s: %s\n", (ok ? "PASS" : "FAIL"), msg);
+}
+
+static off_t file_size(int fd)
+{
+    struct stat st;
+    fstat(fd, &st);
+    return st.st_size;
+}
+
+// Every byte of the range reads as c
+static bool reads_as(int fd, off_t offset, size_t len, char c)
+{
+    std::vector<char> buf(len);
+    if (pread(fd, buf.data(), len, offset) != (ssize_t)len) {
+        return false;
+    }
+    for (auto b : buf) {
+        if (b != c) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_append()
+{
+    int fd = open(TEST_FILE, O_CREAT|O_TRUNC|O_RDWR|O_APPEND, 0666);
+    // Odd sized writes, so that they straddle pages
+    char buf[1000];
+    bool ok = true;
+    for (int i = 0; i < 8192; i++) {
+        memset(buf, i & 0xff, sizeof(buf));
+        ok &= write(fd, buf, sizeof(buf)) == sizeof(buf);
+    }
+    report(ok && file_size(fd) == 8192 * 1000, "append 8MB");
+    ok = true;
+    for (int i = 0; i < 8192; i += 97) {
+        ok &= reads_as(fd, i * 1000, 1000, i & 0xff);
+    }
+    report(ok, "read back appended data");
+    close(fd);
+    unlink(TEST_FILE);
+}
+
+static void test_holes()
+{
+    int fd = open(TEST_FILE, O_CREAT|O_TRUNC|O_RDWR, 0666);
+    report(pwrite(fd, "x", 1, 10 << 20) == 1, "write past a hole");
+    report(file_size(fd) == (10 << 20) + 1, "size after the hole");
+    report(reads_as(fd, 0, 1 << 20, 0), "hole reads as zeroes");
+    report(reads_as(fd, 10 << 20, 1, 'x'), "data after the hole");
+
+    // Shrinking and growing back must not bring old data back
+    report(pwrite(fd, "yyyy", 4, 5000) == 4, "write");
+    report(ftruncate(fd, 5002) == 0, "truncate down");
+    report(ftruncate(fd, 8192) == 0, "truncate up");
+    report(reads_as(fd, 5000, 2, 'y') && reads_as(fd, 5002, 8192 - 5002, 0),
+           "zeroes past the old end");
+    report(pwrite(fd, "z", 1, 9000) == 1, "write past the end");
+    report(reads_as(fd, 8192, 9000 - 8192, 0), "zeroes up to the write");
+    close(fd);
+    unlink(TEST_FILE);
+}
+
+static void test_fallocate()
+{
+    int fd = open(TEST_FILE, O_CREAT|O_TRUNC|O_RDWR, 0666);
+    report(fallocate(fd, 0, 0, 1 << 20) == 0, "fallocate");
+    report(file_size(fd) == 1 << 20, "fallocate extends the file");
+    report(fallocate(fd, FALLOC_FL_KEEP_SIZE, 1 << 20, 1 << 20) == 0, "fallocate FALLOC_FL_KEEP_SIZE");
+    report(file_size(fd) == 1 << 20, "FALLOC_FL_KEEP_SIZE keeps the size");
+    report(reads_as(fd, 0, 1 << 20, 0), "allocated pages read as zeroes");
+
+    std::vector<char> buf(1 << 20, 'a');
+    report(pwrite(fd, buf.data(), buf.size(), 0) == (ssize_t)buf.size(), "write");
+    report(fallocate(fd, FALLOC_FL_PUNCH_HOLE, 1000, 20000) == -1 && errno == EOPNOTSUPP &&
+           reads_as(fd, 0, 1 << 20, 'a'), "punch hole without FALLOC_FL_KEEP_SIZE");
+    report(fallocate(fd, FALLOC_FL_PUNCH_HOLE, (1 << 20) - 4096, 8192) == -1 && errno == EOPNOTSUPP &&
+           file_size(fd) == 1 << 20 && reads_as(fd, (1 << 20) - 4096, 4096, 'a'),
+           "punch hole past the end without FALLOC_FL_KEEP_SIZE");
+    report(fallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, 1000, 20000) == 0, "punch hole");
+    report(reads_as(fd, 0, 1000, 'a') && reads_as(fd, 1000, 20000, 0) &&
+           reads_as(fd, 21000, (1 << 20) - 21000, 'a'), "hole punched");
+    report(file_size(fd) == 1 << 20, "punching keeps the size");
+    report(fallocate(fd, FALLOC_FL_COLLAPSE_RANGE, 0, 4096) == -1 && errno == EOPNOTSUPP,
+           "unsupported mode");
+    close(fd);
+    unlink(TEST_FILE);
+}
+
+static void test_mmap()
+{
+    const size_t size = 64 * 4096;
+    int fd = open(TEST_FILE, O_CREAT|O_TRUNC|O_RDWR, 0666);
+    report(ftruncate(fd, size) == 0, "truncate");
+    report(pwrite(fd, "hello", 5, 4096) == 5, "write");
+
+    auto p = (char *)mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    report(p != MAP_FAILED, "mmap shared");
+    report(!memcmp(p + 4096, "hello", 5), "mapping sees file data");
+    report(p[0] == 0 && p[size - 1] == 0, "mapping sees holes as zeroes");
+
+    // The mapping and the file are the same pages
+    memcpy(p + 8192, "mapped", 6);
+    report(reads_as(fd, 8192, 1, 'm'), "read() sees writes to the mapping");
+    report(pwrite(fd, "written", 7, 3 * 4096) == 7, "write");
+    report(!memcmp(p + 3 * 4096, "written", 7), "mapping sees write()");
+
+    auto q = (char *)mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    report(q != MAP_FAILED, "mmap private");
+    report(!memcmp(q + 8192, "mapped", 6), "private mapping sees file data");
+    q[8192] = 'M';
+    report(p[8192] == 'm' && reads_as(fd, 8192, 1, 'm'), "private writes stay private");
+
+    munmap(q, size);
+    munmap(p, size);
+
+    // Mapped pages may be freed by truncation
+    p = (char *)mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    report(p[8192] == 'm', "mmap again");
+    report(ftruncate(fd, 4096) == 0 && ftruncate(fd, size) == 0, "truncate mapped file");
+    report(p[8192] == 0, "mapping sees truncation");
+    munmap(p, size);
+    close(fd);
+    unlink(TEST_FILE);
+}
+
+int main(int argc, char **argv)
+{
+    mkdir(TEST_DIR, 0777);
+    report(sys_mount("", TEST_DIR, "ramfs", 0, nullptr) == 0, "mount ramfs");
+
+    test_append();
+    test_holes();
+    test_fallocate();
+    test_mmap();
+
+    report(sys_umount(TEST_DIR) == 0, "umount");
+    rmdir(TEST_DIR);
+
+    printf("SUMMARY: %d tests, %d failures\n", tests, fails);
+    return fails == 0 ? 0 : 1;
+}
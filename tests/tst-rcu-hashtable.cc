@@ -68,6 +68,27 @@ BOOST_AUTO_TEST_CASE(test_rcu_hashtable_basic) {
     BOOST_REQUIRE(test_element::ctors == test_element::dtors);
 }
 
+BOOST_AUTO_TEST_CASE(test_rcu_hashtable_for_each_match) {
+    {
+        osv::rcu_hashtable<test_element> ht(8);
+        ht.emplace(5);
+        ht.emplace(7);
+        ht.emplace(5);
+        int fives = 0, sixes = 0;
+        WITH_LOCK(osv::rcu_read_lock) {
+            auto count = [] (int& n) { return [&n] (const test_element& x) { x.validate(); ++n; }; };
+            ht.reader_for_each_match(test_element(5), std::hash<test_element>(),
+                    std::equal_to<test_element>(), count(fives));
+            ht.reader_for_each_match(test_element(6), std::hash<test_element>(),
+                    std::equal_to<test_element>(), count(sixes));
+        }
+        BOOST_REQUIRE(fives == 2);
+        BOOST_REQUIRE(sixes == 0);
+    }
+    osv::rcu_flush();
+    BOOST_REQUIRE(test_element::ctors == test_element::dtors);
+}
+
 struct element_status {
     int insertions_lower_bound = {};
     int insertions_upper_bound = {};
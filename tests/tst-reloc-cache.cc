@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// Tests loading a library with the relocation cache which
+// scripts/gen-reloc-cache.py writes next to it: symbols must resolve the
+// same way as without a cache, whether the cache is valid, was built for
+// other modules, names the wrong symbols or is truncated. The cache is
+// written here in the same format, for the modules loaded when the test
+// runs; resolving a symbol differently than lookup would, which a real
+// cache never does, shows whether the cache was used.
+
+#include <osv/elf.hh>
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+using namespace elf;
+
+// Interposes on the definition in libreloc-cache.so
+int reloc_cache_value = 2;
+
+static int tests = 0, fails = 0;
+
+static void report(bool ok, const char *msg)
+{
+    ++tests;
+    fails += !ok;
+    printf("%s: %s\n", (ok ? "PASS" : "FAIL"), msg);
+}
+
+static const char* lib_src = "/tests/libreloc-cache.so";
+static const char* lib = "/tmp/libreloc-cache.so";
+static const char* cache = "/tmp/libreloc-cache.so.relcache";
+
+typedef std::array<void*, 4> refs;
+
+// The dynamic symbol table of a loaded module, as object::fingerprint()
+// and object::cached_symbol() see it
+struct dynsyms {
+    explicit dynsyms(object* obj);
+    const char* name(unsigned idx) const { return strtab + symtab[idx].st_name; }
+    unsigned find(const char* name) const;
+    uint64_t fingerprint() const;
+
+    const Elf64_Sym* symtab = nullptr;
+    const char* strtab = nullptr;
+    size_t strsz = 0;
+    unsigned count = 0;
+};
+
+dynsyms::dynsyms(object* obj)
+{
+    auto base = static_cast<const char*>(obj->base());
+    const Elf64_Dyn* dyn = nullptr;
+    for (auto& phdr : *obj->phdrs()) {
+        if (phdr.p_type == PT_DYNAMIC) {
+            dyn = reinterpret_cast<const Elf64_Dyn*>(base + phdr.p_vaddr);
+        }
+    }
+    const Elf64_Word* hash = nullptr;
+    const Elf64_Word* gnu_hash = nullptr;
+    for (; dyn->d_tag != DT_NULL; dyn++) {
+        auto ptr = base + dyn->d_un.d_ptr;
+        switch (dyn->d_tag) {
+        case DT_SYMTAB:
+            symtab = reinterpret_cast<const Elf64_Sym*>(ptr);
+            break;
+        case DT_STRTAB:
+            strtab = ptr;
+            break;
+        case DT_STRSZ:
+            strsz = dyn->d_un.d_val;
+            break;
+        case DT_HASH:
+            hash = reinterpret_cast<const Elf64_Word*>(ptr);
+            break;
+        case DT_GNU_HASH:
+            gnu_hash = reinterpret_cast<const Elf64_Word*>(ptr);
+            break;
+        }
+    }
+    // As object::dynsym_count()
+    if (hash) {
+        count = hash[1];
+        return;
+    }
+    auto nbucket = gnu_hash[0];
+    auto symndx = gnu_hash[1];
+    auto maskwords = gnu_hash[2];
+    auto bloom = reinterpret_cast<const Elf64_Xword*>(gnu_hash + 4);
+    auto buckets = reinterpret_cast<const Elf64_Word*>(bloom + maskwords);
+    auto chains = buckets + nbucket - symndx;
+    count = symndx;
+    for (unsigned b = 0; b < nbucket; ++b) {
+        auto idx = buckets[b];
+        if (idx == 0) {
+            continue;
+        }
+        do {
+            ++count;
+        } while ((chains[idx++] & 1) == 0);
+    }
+}
+
+// The index of the definition lookup would pick in this module, or 0
+unsigned dynsyms::find(const char* name) const
+{
+    for (unsigned i = 1; i < count; i++) {
+        auto binding = symtab[i].st_info >> 4;
+        if (symtab[i].st_shndx != SHN_UNDEF &&
+            (binding == STB_GLOBAL || binding == STB_WEAK) &&
+            strcmp(this->name(i), name) == 0) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+// As object::fingerprint()
+uint64_t dynsyms::fingerprint() const
+{
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h] (const void* data, size_t len) {
+        auto p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < len; i++) {
+            h = (h ^ p[i]) * 1099511628211ull;
+        }
+    };
+    for (unsigned i = 0; i < count; i++) {
+        uint32_t name = symtab[i].st_name;
+        uint8_t info = symtab[i].st_info;
+        uint8_t defined = symtab[i].st_shndx != SHN_UNDEF;
+        mix(&name, sizeof(name));
+        mix(&info, sizeof(info));
+        mix(&defined, sizeof(defined));
+    }
+    mix(strtab, strsz);
+    return h ? h : 1;
+}
+
+struct resolution {
+    uint32_t module;
+    uint32_t sym;
+};
+
+static constexpr resolution unresolved = { ~0u, ~0u };
+
+struct context {
+    std::vector<uint64_t> fingerprints;
+    std::vector<resolution> resolutions;
+};
+
+// Writes the cache, cut short by truncate bytes
+static bool write_cache(const std::vector<context>& contexts, size_t truncate = 0)
+{
+    std::string buf("OSVRELC", 8);
+    auto put = [&buf] (const void* data, size_t len) {
+        buf.append(static_cast<const char*>(data), len);
+    };
+    uint32_t version = 1, ncontexts = contexts.size();
+    put(&version, sizeof(version));
+    put(&ncontexts, sizeof(ncontexts));
+    for (auto& c : contexts) {
+        uint32_t nmodules = c.fingerprints.size(), nresolutions = c.resolutions.size();
+        put(&nmodules, sizeof(nmodules));
+        put(&nresolutions, sizeof(nresolutions));
+        put(c.fingerprints.data(), nmodules * sizeof(uint64_t));
+        put(c.resolutions.data(), nresolutions * sizeof(resolution));
+    }
+    buf.resize(buf.size() - truncate);
+    auto f = fopen(cache, "w");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    return fclose(f) == 0 && ok;
+}
+
+static bool copy_file(const char* from, const char* to)
+{
+    auto in = fopen(from, "r");
+    if (!in) {
+        return false;
+    }
+    auto out = fopen(to, "w");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+    char buf[4096];
+    size_t n;
+    bool ok = true;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        ok &= fwrite(buf, 1, n, out) == n;
+    }
+    fclose(in);
+    return fclose(out) == 0 && ok;
+}
+
+// Loads the library and returns what its relocations resolved to, and
+// where its own definition of reloc_cache_value is
+static bool load(refs& r, void** own = nullptr)
+{
+    auto handle = dlopen(lib, RTLD_NOW);
+    if (!handle) {
+        return false;
+    }
+    auto f = reinterpret_cast<void (*)(void**)>(dlsym(handle, "reloc_cache_refs"));
+    if (f) {
+        f(r.data());
+    }
+    if (own) {
+        *own = dlsym(handle, "reloc_cache_value");
+    }
+    dlclose(handle);
+    return f != nullptr;
+}
+
+int main(int argc, char **argv)
+{
+    unlink(cache);
+    report(copy_file(lib_src, lib), "copy the library to a writable file system");
+
+    // Without a cache: what lookup resolves the symbols to, and the
+    // modules loaded along with the library, in search order, with the
+    // resolutions gen-reloc-cache.py would record for them. The symbol
+    // tables are only read while the library is loaded.
+    auto handle = dlopen(lib, RTLD_NOW);
+    report(handle, "load the library without a cache");
+    if (!handle) {
+        printf("SUMMARY: %d tests, %d failures\n", tests, fails);
+        return 1;
+    }
+    auto obj = reinterpret_cast<std::shared_ptr<object>*>(handle)->get();
+    std::vector<dynsyms> modules;
+    unsigned self = 0;
+    get_program()->with_modules([&](const program::modules_list& ml) {
+        for (auto m : ml.objects) {
+            if (m == obj) {
+                self = modules.size();
+            }
+            modules.emplace_back(m);
+        }
+    });
+    context valid;
+    for (auto& m : modules) {
+        valid.fingerprints.push_back(m.fingerprint());
+    }
+    auto& lib_syms = modules[self];
+    auto nsyms = lib_syms.count;
+    valid.resolutions.assign(nsyms, unresolved);
+    unsigned value_idx = 0;
+    for (unsigned i = 1; i < nsyms; i++) {
+        auto name = lib_syms.name(i);
+        if (!strcmp(name, "reloc_cache_value")) {
+            value_idx = i;
+        }
+        for (unsigned m = 0; m < modules.size(); m++) {
+            if (auto idx = modules[m].find(name)) {
+                valid.resolutions[i] = { m, idx };
+                break;
+            }
+        }
+    }
+    refs baseline{};
+    reinterpret_cast<void (*)(void**)>(dlsym(handle, "reloc_cache_refs"))(baseline.data());
+    auto own = dlsym(handle, "reloc_cache_value");
+    dlclose(handle);
+    report(baseline[0] == &reloc_cache_value && own && own != baseline[0] &&
+           baseline[1] == dlsym(RTLD_DEFAULT, "strlen") &&
+           baseline[2] == dlsym(RTLD_DEFAULT, "malloc") &&
+           baseline[3] == dlsym(RTLD_DEFAULT, "puts"),
+           "symbols resolve to the definitions found by lookup");
+    report(value_idx && valid.resolutions[value_idx].module != self,
+           "reloc_cache_value is found before the library");
+
+    // The same, but resolving reloc_cache_value to the library's own
+    // definition, to tell whether the cache is used
+    auto redirected = valid;
+    redirected.resolutions[value_idx] = { self, value_idx };
+
+    refs r{};
+    bool ok = write_cache({valid});
+    report(ok && load(r) && r == baseline, "valid cache");
+
+    ok = write_cache({redirected});
+    report(ok && load(r, &own) && r[0] == own && r[1] == baseline[1] &&
+           r[2] == baseline[2] && r[3] == baseline[3],
+           "valid cache is used");
+
+    auto other = redirected;
+    other.fingerprints.push_back(other.fingerprints.back());
+    ok = write_cache({other, redirected});
+    report(ok && load(r, &own) && r[0] == own, "context for the loaded modules is picked");
+
+    auto stale = redirected;
+    stale.fingerprints[self] ^= 1;
+    ok = write_cache({stale});
+    report(ok && load(r) && r == baseline, "cache with stale fingerprints is ignored");
+
+    // Each resolution names the wrong symbol, so each is looked up
+    auto wrong = valid;
+    for (unsigned i = 1; i < nsyms; i++) {
+        wrong.resolutions[i] = { self, i % (nsyms - 1) + 1 };
+    }
+    ok = write_cache({wrong});
+    report(ok && load(r) && r == baseline, "resolutions of the wrong symbols are ignored");
+
+    ok = write_cache({redirected}, sizeof(resolution) / 2);
+    report(ok && load(r) && r == baseline, "cache truncated in a context is ignored");
+
+    auto size = 24 + redirected.fingerprints.size() * sizeof(uint64_t) +
+                redirected.resolutions.size() * sizeof(resolution);
+    ok = write_cache({redirected}, size - 14);
+    report(ok && load(r) && r == baseline, "cache truncated in a header is ignored");
+
+    unlink(cache);
+    report(load(r) && r == baseline, "library loads again without a cache");
+    unlink(lib);
+
+    printf("SUMMARY: %d tests, %d failures\n", tests, fails);
+    return fails == 0 ? 0 : 1;
+}
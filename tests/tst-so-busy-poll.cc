@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+// To compile on Linux, use: g++ -g -pthread -std=c++11 tests/tst-so-busy-poll.cc
+
+// Tests the SO_BUSY_POLL socket option: set/get, inheritance by accepted
+// sockets, and that blocking receives still complete (and still sleep
+// once the busy poll budget runs out) on busy polling sockets, without
+// spinning past their receive timeout.
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+static int tests = 0, fails = 0;
+
+template<typename T>
+bool do_expect(T actual, T expected, const char *actuals, const char *expecteds, const char *file, int line)
+{
+    ++tests;
+    if (actual != expected) {
+        fails++;
+        std::cout << "FAIL: " << file << ":" << line << ": For " << actuals
+                << " expected " << expecteds << "(" << expected << "), saw "
+                << actual << ".\n";
+        return false;
+    }
+    std::cout << "OK: " << file << ":" << line << ".\n";
+    return true;
+}
+#define expect(actual, expected) do_expect(actual, expected, #actual, #expected, __FILE__, __LINE__)
+
+static int bound_socket(int type, struct sockaddr_in& sa)
+{
+    int s = socket(AF_INET, type, 0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = 0;
+    bind(s, (struct sockaddr *)&sa, sizeof(sa));
+    socklen_t len = sizeof(sa);
+    getsockname(s, (struct sockaddr *)&sa, &len);
+    return s;
+}
+
+static int get_busy_poll(int s)
+{
+    int val = -1;
+    socklen_t len = sizeof(val);
+    if (getsockopt(s, SOL_SOCKET, SO_BUSY_POLL, &val, &len) < 0) {
+        return -1;
+    }
+    return val;
+}
+
+static void test_udp()
+{
+    struct sockaddr_in rsa, ssa;
+    int r = bound_socket(SOCK_DGRAM, rsa);
+    int s = bound_socket(SOCK_DGRAM, ssa);
+    expect(r >= 0, true);
+    expect(s >= 0, true);
+
+    int val = 50;
+    expect(setsockopt(r, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)), 0);
+    expect(get_busy_poll(r), 50);
+    val = -1;
+    expect(setsockopt(r, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)), -1);
+    expect(errno, EINVAL);
+    expect(get_busy_poll(r), 50);
+
+    // The sender shows up well after the busy poll budget has run out, so
+    // the receiver must fall back to sleeping and still be woken up.
+    std::thread sender([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        sendto(s, "hello", 5, 0, (struct sockaddr *)&rsa, sizeof(rsa));
+    });
+    char buf[16];
+    expect(recv(r, buf, sizeof(buf), 0), (ssize_t)5);
+    expect(memcmp(buf, "hello", 5), 0);
+    sender.join();
+
+    // And data that is already queued is returned without spinning at all
+    expect(sendto(s, "again", 5, 0, (struct sockaddr *)&rsa, sizeof(rsa)), (ssize_t)5);
+    expect(recv(r, buf, sizeof(buf), 0), (ssize_t)5);
+    expect(memcmp(buf, "again", 5), 0);
+
+    // epoll_wait() on a busy polling socket
+    int ep = epoll_create1(0);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = r;
+    expect(epoll_ctl(ep, EPOLL_CTL_ADD, r, &ev), 0);
+    expect(epoll_wait(ep, &ev, 1, 10), 0);
+    expect(sendto(s, "epoll", 5, 0, (struct sockaddr *)&rsa, sizeof(rsa)), (ssize_t)5);
+    expect(epoll_wait(ep, &ev, 1, 1000), 1);
+    expect(ev.data.fd, r);
+    expect(recv(r, buf, sizeof(buf), 0), (ssize_t)5);
+    close(ep);
+
+    close(r);
+    close(s);
+}
+
+static void test_tcp()
+{
+    struct sockaddr_in lsa, csa;
+    int l = bound_socket(SOCK_STREAM, lsa);
+    expect(l >= 0, true);
+    int val = 30;
+    expect(setsockopt(l, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)), 0);
+    expect(listen(l, 1), 0);
+
+    int c = bound_socket(SOCK_STREAM, csa);
+    expect(connect(c, (struct sockaddr *)&lsa, sizeof(lsa)), 0);
+    int a = accept(l, nullptr, nullptr);
+    expect(a >= 0, true);
+    // Accepted sockets inherit the listener's setting
+    expect(get_busy_poll(a), 30);
+
+    std::thread sender([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        write(c, "stream", 6);
+    });
+    char buf[16];
+    expect(read(a, buf, sizeof(buf)), (ssize_t)6);
+    expect(memcmp(buf, "stream", 6), 0);
+    sender.join();
+
+    close(a);
+    close(c);
+    close(l);
+}
+
+// A busy poll budget longer than the receive timeout must not delay it
+static void test_rcvtimeo()
+{
+    struct sockaddr_in rsa, ssa;
+    int r = bound_socket(SOCK_DGRAM, rsa);
+    int s = bound_socket(SOCK_DGRAM, ssa);
+    int val = 5000000;
+    expect(setsockopt(r, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)), 0);
+    struct timeval tv = { 0, 50000 };
+    expect(setsockopt(r, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)), 0);
+
+    // Once so that the socket knows which interface its traffic comes from
+    expect(sendto(s, "first", 5, 0, (struct sockaddr *)&rsa, sizeof(rsa)), (ssize_t)5);
+    char buf[16];
+    expect(recv(r, buf, sizeof(buf), 0), (ssize_t)5);
+
+    auto start = std::chrono::steady_clock::now();
+    expect(recv(r, buf, sizeof(buf), 0), (ssize_t)-1);
+    expect(errno, EAGAIN);
+    expect(std::chrono::steady_clock::now() - start < std::chrono::seconds(1), true);
+
+    close(r);
+    close(s);
+}
+
+int main(int ac, char** av)
+{
+    test_udp();
+    test_tcp();
+    test_rcvtimeo();
+
+    std::cout << "SUMMARY: " << tests << " tests, " << fails << " failures\n";
+    return fails == 0 ? 0 : 1;
+}
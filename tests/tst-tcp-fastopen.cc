@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2026 Cloudius Systems, Ltd.
+ *
+ * This work is open source software, licensed under the terms of the
+ * BSD license as described in the LICENSE file in the top-level directory.
+ */
+
+// Tests TCP Fast Open over the loopback: the TCP_FASTOPEN socket option,
+// fetching a cookie on a first connection, and delivering data with the
+// SYN on the next one. Also checks the /proc/sys/net/ipv4 and
+// /proc/net/netstat entries.
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <string>
+
+#include <bsd/porting/networking.hh>
+
+static int tests = 0, fails = 0;
+
+template<typename T>
+bool do_expect(T actual, T expected, const char *actuals, const char *expecteds, const char *file, int line)
+{
+    ++tests;
+    if (actual != expected) {
+        fails++;
+        std::cout << "FAIL: " << file << ":" << line << ": For " << actuals
+                << " expected " << expecteds << "(" << expected << "), saw "
+                << actual << ".\n";
+        return false;
+    }
+    std::cout << "OK: " << file << ":" << line << ".\n";
+    return true;
+}
+#define expect(actual, expected) do_expect(actual, expected, #actual, #expected, __FILE__, __LINE__)
+
+static int bound_socket(struct sockaddr_in& sa)
+{
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = 0;
+    bind(s, (struct sockaddr *)&sa, sizeof(sa));
+    socklen_t len = sizeof(sa);
+    getsockname(s, (struct sockaddr *)&sa, &len);
+    return s;
+}
+
+static std::string read_file(const char *path)
+{
+    std::ifstream f(path);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+// Parses the "TcpExt:" header and value lines of /proc/net/netstat
+static std::map<std::string, unsigned long> tcp_ext()
+{
+    std::map<std::string, unsigned long> ret;
+    std::istringstream in(read_file("/proc/net/netstat"));
+    std::string names, values;
+    std::getline(in, names);
+    std::getline(in, values);
+    std::istringstream n(names), v(values);
+    std::string name, value;
+    n >> name;
+    v >> value;
+    while (n >> name && v >> value) {
+        ret[name] = std::stoul(value);
+    }
+    return ret;
+}
+
+// Connects with data in the SYN (if we have a cookie), and checks the
+// data and a reply make it across.
+static void tfo_connect(int l, struct sockaddr_in& lsa, const char *msg)
+{
+    int c = socket(AF_INET, SOCK_STREAM, 0);
+    expect(sendto(c, msg, strlen(msg), MSG_FASTOPEN,
+            (struct sockaddr *)&lsa, sizeof(lsa)), (ssize_t)strlen(msg));
+    int a = accept(l, nullptr, nullptr);
+    expect(a >= 0, true);
+    char buf[16];
+    expect(read(a, buf, sizeof(buf)), (ssize_t)strlen(msg));
+    expect(memcmp(buf, msg, strlen(msg)), 0);
+    expect(write(a, "reply", 5), (ssize_t)5);
+    expect(read(c, buf, sizeof(buf)), (ssize_t)5);
+    expect(memcmp(buf, "reply", 5), 0);
+    close(a);
+    close(c);
+}
+
+int main(int ac, char** av)
+{
+    int saved_mode = osv::tcp_fastopen();
+    osv::set_tcp_fastopen(3);
+    expect(read_file("/proc/sys/net/ipv4/tcp_fastopen"), std::string("3\n"));
+    expect(read_file("/proc/sys/net/ipv4/tcp_syncookies").empty(), false);
+
+    struct sockaddr_in lsa;
+    int l = bound_socket(lsa);
+    expect(l >= 0, true);
+    int val = 5;
+    expect(setsockopt(l, IPPROTO_TCP, TCP_FASTOPEN, &val, sizeof(val)), 0);
+    val = -1;
+    expect(setsockopt(l, IPPROTO_TCP, TCP_FASTOPEN, &val, sizeof(val)), -1);
+    expect(errno, EINVAL);
+    socklen_t len = sizeof(val);
+    expect(getsockopt(l, IPPROTO_TCP, TCP_FASTOPEN, &val, &len), 0);
+    expect(val, 5);
+    expect(listen(l, 5), 0);
+
+    auto before = tcp_ext();
+
+    // No cookie yet: the SYN asks for one and the data follows the
+    // handshake
+    tfo_connect(l, lsa, "hello");
+    auto after = tcp_ext();
+    expect(after["TCPFastOpenCookieReqd"] - before["TCPFastOpenCookieReqd"], 1UL);
+    expect(after["TCPFastOpenPassive"] - before["TCPFastOpenPassive"], 0UL);
+
+    // Now the data goes with the SYN
+    tfo_connect(l, lsa, "again");
+    auto last = tcp_ext();
+    expect(last["TCPFastOpenPassive"] - after["TCPFastOpenPassive"], 1UL);
+    expect(last["TCPFastOpenActive"] - after["TCPFastOpenActive"], 1UL);
+
+    close(l);
+    osv::set_tcp_fastopen(saved_mode);
+
+    std::cout << "SUMMARY: " << tests << " tests, " << fails << " failures\n";
+    return fails == 0 ? 0 : 1;
+}